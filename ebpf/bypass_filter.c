@@ -62,15 +62,17 @@ struct pair {
     __u64 bytes;
 };
 
+/* LRU maps so that a full table evicts the least recently seen flows
+ * instead of refusing new bypass entries */
 struct {
-    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
     __type(key, struct flowv4_keys);
     __type(value, struct pair);
     __uint(max_entries, 32768);
 } flow_table_v4 SEC(".maps");
 
 struct {
-    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
     __type(key, struct flowv6_keys);
     __type(value, struct pair);
     __uint(max_entries, 32768);
@@ -95,9 +95,12 @@ struct pair {
     __u64 bytes;
 };
 
+/* LRU maps so that a full table evicts the least recently seen flows
+ * instead of refusing new bypass entries. Hardware offload only supports
+ * plain hashes. */
 struct {
 #if USE_PERCPU_HASH
-    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
 #else
     __uint(type, BPF_MAP_TYPE_HASH);
 #endif
@@ -108,7 +111,7 @@ struct {
 
 struct {
 #if USE_PERCPU_HASH
-    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
 #else
     __uint(type, BPF_MAP_TYPE_HASH);
 #endif
@@ -0,0 +1,378 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Prebuilt binary dataset files.
+ *
+ * A binary dataset holds the sorted keys of a set. It is mapped read-only,
+ * so loading it does no parsing or copying, and the pages are shared
+ * through the page cache by all sets, tenants and reloads using the file.
+ */
+
+#include "suricata-common.h"
+#include "datasets-binary.h"
+#include "util-debug.h"
+
+typedef struct DatasetBinaryRecord_ {
+    const uint8_t *key;
+    uint32_t key_len;
+    DataRepType rep;
+} DatasetBinaryRecord;
+
+/** \brief key order: bytes first, then length */
+static inline int DatasetBinaryCompare(
+        const uint8_t *a, const uint64_t a_len, const uint8_t *b, const uint64_t b_len)
+{
+    const int r = memcmp(a, b, MIN(a_len, b_len));
+    if (r != 0)
+        return r;
+    if (a_len == b_len)
+        return 0;
+    return a_len < b_len ? -1 : 1;
+}
+
+static int DatasetBinaryRecordCompare(const void *a, const void *b)
+{
+    const DatasetBinaryRecord *ra = a;
+    const DatasetBinaryRecord *rb = b;
+    return DatasetBinaryCompare(ra->key, ra->key_len, rb->key, rb->key_len);
+}
+
+bool DatasetBinaryIsBinaryFile(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+        return false;
+    char magic[8];
+    const bool r = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+                   memcmp(magic, DATASET_BINARY_MAGIC, sizeof(magic)) == 0;
+    fclose(fp);
+    return r;
+}
+
+/** \brief check that a section is inside the mapping and aligned */
+static bool DatasetBinarySectionValid(
+        const DatasetBinary *b, const uint64_t offset, const uint64_t size, const uint64_t align)
+{
+    return offset % align == 0 && offset >= sizeof(DatasetBinaryHeader) &&
+           offset <= b->map_size && size <= b->map_size - offset;
+}
+
+/**
+ * \brief map a binary dataset file
+ *
+ * \param type expected set type
+ * \param key_len expected key length, 0 for strings
+ *
+ * \retval b mapped set or NULL on error
+ */
+DatasetBinary *DatasetBinaryOpen(const char *path, const uint32_t type, const uint32_t key_len)
+{
+#ifdef HAVE_SYS_MMAN_H
+    DatasetBinary *b = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        SCLogError("open '%s' failed: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        SCLogError("stat '%s' failed: %s", path, strerror(errno));
+        goto error;
+    }
+    if ((uint64_t)st.st_size < sizeof(DatasetBinaryHeader)) {
+        SCLogError("binary dataset '%s' is truncated", path);
+        goto error;
+    }
+
+    b = SCCalloc(1, sizeof(*b));
+    if (b == NULL)
+        goto error;
+    b->map_size = (size_t)st.st_size;
+    void *map = mmap(NULL, b->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        SCLogError("mmap '%s' failed: %s", path, strerror(errno));
+        goto error;
+    }
+    b->map = map;
+    close(fd);
+    fd = -1;
+#ifdef MADV_RANDOM
+    /* lookups are a binary search, readahead only wastes page cache */
+    (void)madvise(map, b->map_size, MADV_RANDOM);
+#endif
+
+    const DatasetBinaryHeader *hdr = b->hdr = map;
+    if (memcmp(hdr->magic, DATASET_BINARY_MAGIC, sizeof(hdr->magic)) != 0 ||
+            hdr->version != DATASET_BINARY_VERSION) {
+        SCLogError("'%s' is not a binary dataset of version %u", path, DATASET_BINARY_VERSION);
+        goto error;
+    }
+    if (hdr->byte_order != DATASET_BINARY_BYTE_ORDER) {
+        SCLogError("binary dataset '%s' was created on a host with a different byte order", path);
+        goto error;
+    }
+    if (hdr->type != type || hdr->key_len != key_len) {
+        SCLogError("binary dataset '%s' type doesn't match the set type", path);
+        goto error;
+    }
+    if (!DatasetBinarySectionValid(b, hdr->keys_offset, hdr->keys_size, 1)) {
+        SCLogError("binary dataset '%s' is corrupt", path);
+        goto error;
+    }
+    b->keys = b->map + hdr->keys_offset;
+
+    if (key_len > 0) {
+        if (hdr->cnt > hdr->keys_size / key_len || hdr->cnt * key_len != hdr->keys_size) {
+            SCLogError("binary dataset '%s' is corrupt", path);
+            goto error;
+        }
+    } else {
+        if (hdr->cnt >= b->map_size / sizeof(uint64_t) ||
+                !DatasetBinarySectionValid(b, hdr->index_offset,
+                        (hdr->cnt + 1) * sizeof(uint64_t), sizeof(uint64_t))) {
+            SCLogError("binary dataset '%s' is corrupt", path);
+            goto error;
+        }
+        b->index = (const uint64_t *)(b->map + hdr->index_offset);
+    }
+
+    if (hdr->flags & DATASET_BINARY_FLAG_REP) {
+        if (hdr->cnt >= b->map_size / sizeof(uint16_t) ||
+                !DatasetBinarySectionValid(
+                        b, hdr->rep_offset, hdr->cnt * sizeof(uint16_t), sizeof(uint16_t))) {
+            SCLogError("binary dataset '%s' is corrupt", path);
+            goto error;
+        }
+        b->rep = (const uint16_t *)(b->map + hdr->rep_offset);
+    }
+
+    SCLogDebug("mapped %s: %" PRIu64 " keys", path, hdr->cnt);
+    return b;
+error:
+    if (fd >= 0)
+        close(fd);
+    DatasetBinaryClose(b);
+    return NULL;
+#else
+    SCLogError("binary datasets are not supported on this platform");
+    return NULL;
+#endif
+}
+
+void DatasetBinaryClose(DatasetBinary *b)
+{
+    if (b == NULL)
+        return;
+#ifdef HAVE_SYS_MMAN_H
+    if (b->map != NULL)
+        munmap((void *)b->map, b->map_size);
+#endif
+    SCFree(b);
+}
+
+/**
+ * \brief look up a key in a binary dataset
+ *
+ * \param rep if not NULL, set to the reputation of the key if found
+ *
+ * \retval 1 found
+ * \retval 0 not found
+ * \retval -1 error
+ */
+int DatasetBinaryLookup(
+        const DatasetBinary *b, const uint8_t *key, const uint32_t key_len, DataRepType *rep)
+{
+    const DatasetBinaryHeader *hdr = b->hdr;
+    if (hdr->key_len > 0 && key_len != hdr->key_len)
+        return -1;
+
+    uint64_t lo = 0;
+    uint64_t hi = hdr->cnt;
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        const uint8_t *k;
+        uint64_t k_len;
+        if (b->index != NULL) {
+            const uint64_t start = b->index[mid];
+            const uint64_t end = b->index[mid + 1];
+            if (start > end || end > hdr->keys_size)
+                return -1;
+            k = b->keys + start;
+            k_len = end - start;
+        } else {
+            k = b->keys + mid * hdr->key_len;
+            k_len = hdr->key_len;
+        }
+
+        const int r = DatasetBinaryCompare(key, key_len, k, k_len);
+        if (r == 0) {
+            if (rep != NULL)
+                rep->value = b->rep != NULL ? b->rep[mid] : 0;
+            return 1;
+        }
+        if (r < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return 0;
+}
+
+static int DatasetBinaryWritePadded(FILE *fp, const void *data, const size_t size, uint64_t *offset)
+{
+    static const uint8_t zero[8] = { 0 };
+    if (size > 0 && fwrite(data, size, 1, fp) != 1)
+        return -1;
+    *offset += size;
+    const size_t pad = (8 - (*offset % 8)) % 8;
+    if (pad > 0 && fwrite(zero, pad, 1, fp) != 1)
+        return -1;
+    *offset += pad;
+    return 0;
+}
+
+/**
+ * \brief write the records of a hash as binary dataset
+ *
+ * The file is written under a temporary name and renamed into place, so
+ * running instances that have the old file mapped are not affected.
+ *
+ * \param key_len fixed key length of the set type, 0 for strings
+ *
+ * \retval 0 ok
+ * \retval -1 error
+ */
+int DatasetBinaryWrite(THashTableContext *hash, const uint32_t type, const uint32_t key_len,
+        DatasetBinaryGetKeyFunc GetKey, const char *path)
+{
+    int ret = -1;
+    FILE *fp = NULL;
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    const uint32_t cnt = SC_ATOMIC_GET(hash->counter);
+    DatasetBinaryRecord *records = SCCalloc(MAX(cnt, 1), sizeof(*records));
+    if (records == NULL) {
+        SCLogError("failed to allocate %u records for binary dataset '%s'", cnt, path);
+        return -1;
+    }
+
+    /* the hash is private to the caller, no row locking needed */
+    uint64_t n = 0;
+    uint64_t keys_size = 0;
+    bool has_rep = false;
+    for (uint32_t u = 0; u < hash->config.hash_size; u++) {
+        for (THashData *h = hash->array[u].head; h != NULL; h = h->next) {
+            if (n == cnt) {
+                SCLogError("hash holds more than its %u counted records, not writing '%s'",
+                        cnt, path);
+                goto out;
+            }
+            DatasetBinaryRecord *r = &records[n++];
+            GetKey(h->data, &r->key, &r->key_len, &r->rep);
+            keys_size += r->key_len;
+            if (r->rep.value != 0)
+                has_rep = true;
+        }
+    }
+    qsort(records, n, sizeof(*records), DatasetBinaryRecordCompare);
+
+    fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        SCLogError("fopen '%s' failed: %s", tmp_path, strerror(errno));
+        goto out;
+    }
+
+    DatasetBinaryHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, DATASET_BINARY_MAGIC, sizeof(hdr.magic));
+    hdr.version = DATASET_BINARY_VERSION;
+    hdr.byte_order = DATASET_BINARY_BYTE_ORDER;
+    hdr.type = type;
+    hdr.flags = has_rep ? DATASET_BINARY_FLAG_REP : 0;
+    hdr.key_len = key_len;
+    hdr.cnt = n;
+    hdr.keys_size = keys_size;
+
+    uint64_t offset = 0;
+    /* placeholder, rewritten once the offsets are known */
+    if (DatasetBinaryWritePadded(fp, &hdr, sizeof(hdr), &offset) < 0)
+        goto write_error;
+
+    hdr.keys_offset = offset;
+    for (uint64_t i = 0; i < n; i++) {
+        if (records[i].key_len > 0 && fwrite(records[i].key, records[i].key_len, 1, fp) != 1)
+            goto write_error;
+        offset += records[i].key_len;
+    }
+    if (DatasetBinaryWritePadded(fp, NULL, 0, &offset) < 0)
+        goto write_error;
+
+    if (key_len == 0) {
+        hdr.index_offset = offset;
+        uint64_t key_offset = 0;
+        for (uint64_t i = 0; i <= n; i++) {
+            if (fwrite(&key_offset, sizeof(key_offset), 1, fp) != 1)
+                goto write_error;
+            if (i < n)
+                key_offset += records[i].key_len;
+        }
+        offset += (n + 1) * sizeof(uint64_t);
+    }
+
+    if (has_rep) {
+        hdr.rep_offset = offset;
+        for (uint64_t i = 0; i < n; i++) {
+            if (fwrite(&records[i].rep.value, sizeof(uint16_t), 1, fp) != 1)
+                goto write_error;
+        }
+        offset += n * sizeof(uint16_t);
+        if (DatasetBinaryWritePadded(fp, NULL, 0, &offset) < 0)
+            goto write_error;
+    }
+
+    if (fseek(fp, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+        goto write_error;
+    if (fclose(fp) != 0) {
+        fp = NULL;
+        goto write_error;
+    }
+    fp = NULL;
+
+    if (rename(tmp_path, path) != 0) {
+        SCLogError("rename '%s' to '%s' failed: %s", tmp_path, path, strerror(errno));
+        (void)unlink(tmp_path);
+        goto out;
+    }
+    SCLogNotice("wrote %" PRIu64 " records to binary dataset '%s'", n, path);
+    ret = 0;
+    goto out;
+
+write_error:
+    SCLogError("writing '%s' failed: %s", tmp_path, strerror(errno));
+    if (fp != NULL)
+        fclose(fp);
+    fp = NULL;
+    (void)unlink(tmp_path);
+out:
+    SCFree(records);
+    return ret;
+}
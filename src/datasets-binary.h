@@ -0,0 +1,81 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef SURICATA_DATASETS_BINARY_H
+#define SURICATA_DATASETS_BINARY_H
+
+#include "util-thash.h"
+#include "datasets-reputation.h"
+
+#define DATASET_BINARY_MAGIC   "SCDSBIN"
+#define DATASET_BINARY_VERSION 1
+/** written by the host that created the file, used to detect a byte
+ *  order mismatch */
+#define DATASET_BINARY_BYTE_ORDER 0x01020304U
+
+#define DATASET_BINARY_FLAG_REP BIT_U32(0)
+
+/** \brief on disk header of a binary dataset file
+ *
+ *  All sections start at an 8 byte aligned offset. Keys are sorted, so
+ *  lookups are a binary search over the mapped file.
+ *
+ *  Fixed size types: the keys section holds cnt keys of key_len bytes.
+ *  Strings: the keys section holds the string bytes and the index
+ *  section cnt + 1 uint64_t offsets into it.
+ *  If DATASET_BINARY_FLAG_REP is set the rep section holds cnt uint16_t
+ *  reputation values in key order. */
+typedef struct DatasetBinaryHeader_ {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t type; /**< enum DatasetTypes */
+    uint32_t flags;
+    uint32_t key_len; /**< 0 for strings */
+    uint32_t pad;
+    uint64_t cnt;
+    uint64_t keys_offset;
+    uint64_t keys_size;
+    uint64_t index_offset;
+    uint64_t rep_offset;
+} DatasetBinaryHeader;
+
+typedef struct DatasetBinary_ {
+    /** mapping of the whole file */
+    const uint8_t *map;
+    size_t map_size;
+
+    const DatasetBinaryHeader *hdr;
+    const uint8_t *keys;
+    const uint64_t *index;
+    const uint16_t *rep;
+} DatasetBinary;
+
+bool DatasetBinaryIsBinaryFile(const char *path);
+DatasetBinary *DatasetBinaryOpen(const char *path, const uint32_t type, const uint32_t key_len);
+void DatasetBinaryClose(DatasetBinary *b);
+int DatasetBinaryLookup(const DatasetBinary *b, const uint8_t *key, const uint32_t key_len,
+        DataRepType *rep);
+
+/** \brief get the key and reputation of a hash record */
+typedef void (*DatasetBinaryGetKeyFunc)(
+        const void *data, const uint8_t **key, uint32_t *key_len, DataRepType *rep);
+
+int DatasetBinaryWrite(THashTableContext *hash, const uint32_t type, const uint32_t key_len,
+        DatasetBinaryGetKeyFunc GetKey, const char *path);
+
+#endif /* SURICATA_DATASETS_BINARY_H */
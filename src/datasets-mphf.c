@@ -0,0 +1,167 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Read-only dataset storage for static sets. The records of the load
+ * time hash are moved into flat arrays indexed by a minimal perfect hash,
+ * so lookups take no locks and write no shared memory.
+ */
+
+#include "suricata-common.h"
+#include "datasets-mphf.h"
+#include "util-debug.h"
+
+typedef struct DatasetMphfRecord_ {
+    const uint8_t *key;
+    uint32_t key_len;
+    DataRepType rep;
+    uint64_t hash;
+} DatasetMphfRecord;
+
+/**
+ * \brief build a perfect hash set from the records of a hash
+ *
+ * The hash has to be private to the caller while this runs.
+ *
+ * \param key_len fixed key length of the set type, 0 for strings
+ *
+ * \retval set or NULL on error
+ */
+DatasetMphf *DatasetMphfBuild(
+        THashTableContext *hash, const uint32_t key_len, DatasetBinaryGetKeyFunc GetKey)
+{
+    DatasetMphf *m = NULL;
+    uint64_t *hashes = NULL;
+    const uint32_t cnt = SC_ATOMIC_GET(hash->counter);
+    DatasetMphfRecord *records = SCCalloc(MAX(cnt, 1), sizeof(*records));
+    if (records == NULL)
+        return NULL;
+
+    uint64_t n = 0;
+    uint64_t keys_size = 0;
+    bool has_rep = false;
+    for (uint32_t u = 0; u < hash->config.hash_size; u++) {
+        for (THashData *h = hash->array[u].head; h != NULL; h = h->next) {
+            if (n == cnt)
+                goto error;
+            DatasetMphfRecord *r = &records[n++];
+            GetKey(h->data, &r->key, &r->key_len, &r->rep);
+            if (key_len > 0 && r->key_len != key_len)
+                goto error;
+            keys_size += r->key_len;
+            if (r->rep.value != 0)
+                has_rep = true;
+        }
+    }
+    /* string offsets are 32 bit */
+    if (key_len == 0 && keys_size > UINT32_MAX)
+        goto error;
+
+    hashes = SCMalloc(MAX(n, 1) * sizeof(uint64_t));
+    if (hashes == NULL)
+        goto error;
+    for (uint64_t i = 0; i < n; i++) {
+        records[i].hash = SCMphfHash(records[i].key, records[i].key_len);
+        hashes[i] = records[i].hash;
+    }
+
+    m = SCCalloc(1, sizeof(*m));
+    if (m == NULL)
+        goto error;
+    m->cnt = n;
+    m->key_len = key_len;
+    m->mphf = SCMphfBuild(hashes, n);
+    if (m->mphf == NULL)
+        goto error;
+    SCFree(hashes);
+    hashes = NULL;
+
+    m->keys = SCMalloc(MAX(keys_size, 1));
+    m->fps = SCMalloc(MAX(n, 1) * sizeof(uint16_t));
+    if (m->keys == NULL || m->fps == NULL)
+        goto error;
+    if (has_rep) {
+        m->rep = SCMalloc(n * sizeof(uint16_t));
+        if (m->rep == NULL)
+            goto error;
+    }
+    if (key_len == 0) {
+        m->offsets = SCCalloc(n + 1, sizeof(uint32_t));
+        if (m->offsets == NULL)
+            goto error;
+        /* lengths in index order, then turn them into offsets */
+        for (uint64_t i = 0; i < n; i++) {
+            m->offsets[SCMphfLookup(m->mphf, records[i].hash) + 1] = records[i].key_len;
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            m->offsets[i + 1] += m->offsets[i];
+        }
+    }
+
+    for (uint64_t i = 0; i < n; i++) {
+        const DatasetMphfRecord *r = &records[i];
+        const uint64_t idx = SCMphfLookup(m->mphf, r->hash);
+        uint8_t *dst = key_len > 0 ? m->keys + idx * key_len : m->keys + m->offsets[idx];
+        if (r->key_len > 0)
+            memcpy(dst, r->key, r->key_len);
+        m->fps[idx] = (uint16_t)(r->hash >> 48);
+        if (m->rep != NULL)
+            m->rep[idx] = r->rep.value;
+    }
+
+    SCFree(records);
+    return m;
+
+error:
+    if (hashes != NULL)
+        SCFree(hashes);
+    SCFree(records);
+    DatasetMphfFree(m);
+    return NULL;
+}
+
+void DatasetMphfFree(DatasetMphf *m)
+{
+    if (m == NULL)
+        return;
+    SCMphfFree(m->mphf);
+    if (m->keys != NULL)
+        SCFree(m->keys);
+    if (m->offsets != NULL)
+        SCFree(m->offsets);
+    if (m->fps != NULL)
+        SCFree(m->fps);
+    if (m->rep != NULL)
+        SCFree(m->rep);
+    SCFree(m);
+}
+
+uint64_t DatasetMphfMemoryUse(const DatasetMphf *m)
+{
+    uint64_t size = sizeof(*m) + SCMphfMemoryUse(m->mphf);
+    if (m->key_len > 0) {
+        size += m->cnt * m->key_len;
+    } else {
+        size += m->offsets[m->cnt] + (m->cnt + 1) * sizeof(uint32_t);
+    }
+    size += m->cnt * sizeof(uint16_t);
+    if (m->rep != NULL)
+        size += m->cnt * sizeof(uint16_t);
+    return size;
+}
@@ -0,0 +1,81 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef SURICATA_DATASETS_MPHF_H
+#define SURICATA_DATASETS_MPHF_H
+
+#include "util-mphf.h"
+#include "datasets-binary.h"
+
+/** \brief read-only set indexed by a minimal perfect hash
+ *
+ *  Record i has its key, a 16 bit fingerprint of the key hash and the
+ *  optional reputation at index i. The fingerprint rejects most keys that
+ *  are not in the set without touching the key. */
+typedef struct DatasetMphf_ {
+    SCMphf *mphf;
+    uint64_t cnt;
+    /** fixed key length, 0 for strings */
+    uint32_t key_len;
+
+    /** cnt * key_len bytes, or the string bytes */
+    uint8_t *keys;
+    /** strings: cnt + 1 offsets into keys */
+    uint32_t *offsets;
+    uint16_t *fps;
+    /** NULL if all reputation values are 0 */
+    uint16_t *rep;
+} DatasetMphf;
+
+DatasetMphf *DatasetMphfBuild(
+        THashTableContext *hash, const uint32_t key_len, DatasetBinaryGetKeyFunc GetKey);
+void DatasetMphfFree(DatasetMphf *m);
+uint64_t DatasetMphfMemoryUse(const DatasetMphf *m);
+
+/**
+ * \brief look up a key
+ *
+ * \retval 1 found, rep is set if not NULL
+ * \retval 0 not found
+ * \retval -1 invalid key length
+ */
+static inline int DatasetMphfLookup(
+        const DatasetMphf *m, const uint8_t *key, const uint32_t key_len, DataRepType *rep)
+{
+    if (m->key_len > 0 && key_len != m->key_len)
+        return -1;
+
+    const uint64_t hash = SCMphfHash(key, key_len);
+    const uint64_t idx = SCMphfLookup(m->mphf, hash);
+    if (idx == SC_MPHF_NOT_FOUND || m->fps[idx] != (uint16_t)(hash >> 48))
+        return 0;
+
+    if (m->key_len > 0) {
+        if (memcmp(m->keys + idx * m->key_len, key, key_len) != 0)
+            return 0;
+    } else {
+        const uint32_t start = m->offsets[idx];
+        if (m->offsets[idx + 1] - start != key_len ||
+                (key_len > 0 && memcmp(m->keys + start, key, key_len) != 0))
+            return 0;
+    }
+    if (rep != NULL)
+        rep->value = m->rep != NULL ? m->rep[idx] : 0;
+    return 1;
+}
+
+#endif /* SURICATA_DATASETS_MPHF_H */
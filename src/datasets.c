@@ -32,6 +32,8 @@
 #include "datasets-md5.h"
 #include "datasets-sha256.h"
 #include "datasets-reputation.h"
+#include "datasets-binary.h"
+#include "datasets-mphf.h"
 #include "util-conf.h"
 #include "util-thash.h"
 #include "util-print.h"
@@ -53,6 +55,10 @@ static inline void DatasetUnlockData(THashData *d)
     THashDataUnlock(d);
 }
 static bool DatasetIsStatic(const char *save, const char *load);
+static inline bool DatasetIsReadOnly(const Dataset *set)
+{
+    return set->bin != NULL || set->mphf != NULL;
+}
 static void GetDefaultMemcap(uint64_t *memcap, uint32_t *hashsize);
 
 enum DatasetTypes DatasetGetTypeFromString(const char *s)
@@ -573,6 +579,46 @@ static int DatasetLoadString(Dataset *set)
     return 0;
 }
 
+/** \brief key length of the fixed size types, 0 for strings */
+static uint32_t DatasetKeyLength(enum DatasetTypes type)
+{
+    switch (type) {
+        case DATASET_TYPE_MD5:
+            return 16;
+        case DATASET_TYPE_SHA256:
+            return 32;
+        case DATASET_TYPE_IPV4:
+            return 4;
+        case DATASET_TYPE_IPV6:
+            return 16;
+        case DATASET_TYPE_STRING:
+            break;
+    }
+    return 0;
+}
+
+/** \brief map a binary set created by --dataset-compile
+ *
+ *  The set is read-only: it can't be combined with save or state and
+ *  add/remove operations fail. */
+static int DatasetLoadBinary(Dataset *set)
+{
+    if (strlen(set->save) > 0) {
+        SCLogError("dataset %s: binary file '%s' is read-only, it can't be used with "
+                   "save or state",
+                set->name, set->load);
+        return -1;
+    }
+
+    SCLogConfig("dataset: %s mapping binary file '%s'", set->name, set->load);
+    set->bin = DatasetBinaryOpen(set->load, set->type, DatasetKeyLength(set->type));
+    if (set->bin == NULL)
+        return -1;
+
+    SCLogConfig("dataset: %s loaded %" PRIu64 " records", set->name, set->bin->hdr->cnt);
+    return 0;
+}
+
 extern bool g_system;
 
 enum DatasetGetPathType {
@@ -694,6 +740,12 @@ Dataset *DatasetGet(const char *name, enum DatasetTypes type, const char *save,
     char cnf_name[128];
     snprintf(cnf_name, sizeof(cnf_name), "datasets.%s.hash", name);
 
+    if (load && strlen(load) && DatasetBinaryIsBinaryFile(load)) {
+        if (DatasetLoadBinary(set) < 0)
+            goto out_err;
+        goto done;
+    }
+
     GetDefaultMemcap(&default_memcap, &default_hashsize);
     switch (type) {
         case DATASET_TYPE_MD5:
@@ -747,12 +799,16 @@ Dataset *DatasetGet(const char *name, enum DatasetTypes type, const char *save,
                 goto out_err;
             break;
     }
+    /* detection only looks up, writes come from set/unset and unix socket */
+    if (set->hash)
+        THashEnableLocklessReads(set->hash);
 
     if (set->hash && SC_ATOMIC_GET(set->hash->memcap_reached)) {
         SCLogError("dataset too large for set memcap");
         goto out_err;
     }
 
+done:
     SCLogDebug("set %p/%s type %u save %s load %s",
             set, set->name, set->type, set->save, set->load);
 
@@ -766,6 +822,8 @@ out_err:
         if (set->hash) {
             THashShutdown(set->hash);
         }
+        DatasetBinaryClose(set->bin);
+        DatasetMphfFree(set->mphf);
         SCFree(set);
     }
     SCMutexUnlock(&sets_lock);
@@ -825,7 +883,10 @@ void DatasetPostReloadCleanup(void)
         } else {
             sets = next;
         }
-        THashShutdown(cur->hash);
+        if (cur->hash)
+            THashShutdown(cur->hash);
+        DatasetBinaryClose(cur->bin);
+        DatasetMphfFree(cur->mphf);
         SCFree(cur);
         cur = next;
     }
@@ -995,7 +1056,10 @@ void DatasetsDestroy(void)
     while (set) {
         SCLogDebug("destroying set %s", set->name);
         Dataset *next = set->next;
-        THashShutdown(set->hash);
+        if (set->hash)
+            THashShutdown(set->hash);
+        DatasetBinaryClose(set->bin);
+        DatasetMphfFree(set->mphf);
         SCFree(set);
         set = next;
     }
@@ -1106,17 +1170,223 @@ void DatasetsSave(void)
     SCMutexUnlock(&sets_lock);
 }
 
+static void StringGetKey(
+        const void *data, const uint8_t **key, uint32_t *key_len, DataRepType *rep)
+{
+    const StringType *str = data;
+    *key = str->ptr;
+    *key_len = str->len;
+    *rep = str->rep;
+}
+
+static void Md5GetKey(const void *data, const uint8_t **key, uint32_t *key_len, DataRepType *rep)
+{
+    const Md5Type *md5 = data;
+    *key = md5->md5;
+    *key_len = sizeof(md5->md5);
+    *rep = md5->rep;
+}
+
+static void Sha256GetKey(
+        const void *data, const uint8_t **key, uint32_t *key_len, DataRepType *rep)
+{
+    const Sha256Type *sha256 = data;
+    *key = sha256->sha256;
+    *key_len = sizeof(sha256->sha256);
+    *rep = sha256->rep;
+}
+
+static void IPv4GetKey(const void *data, const uint8_t **key, uint32_t *key_len, DataRepType *rep)
+{
+    const IPv4Type *ip = data;
+    *key = ip->ipv4;
+    *key_len = sizeof(ip->ipv4);
+    *rep = ip->rep;
+}
+
+static void IPv6GetKey(const void *data, const uint8_t **key, uint32_t *key_len, DataRepType *rep)
+{
+    const IPv6Type *ip = data;
+    *key = ip->ipv6;
+    *key_len = sizeof(ip->ipv6);
+    *rep = ip->rep;
+}
+
+static DatasetBinaryGetKeyFunc DatasetGetKeyFunc(enum DatasetTypes type)
+{
+    switch (type) {
+        case DATASET_TYPE_STRING:
+            return StringGetKey;
+        case DATASET_TYPE_MD5:
+            return Md5GetKey;
+        case DATASET_TYPE_SHA256:
+            return Sha256GetKey;
+        case DATASET_TYPE_IPV4:
+            return IPv4GetKey;
+        case DATASET_TYPE_IPV6:
+            return IPv6GetKey;
+    }
+    return NULL;
+}
+
+/**
+ *  \brief mark a set as modified by rules, which keeps it out of the
+ *         read-only storage
+ *
+ *  \retval 0 ok
+ *  \retval -1 set is read-only
+ */
+int DatasetMarkWritable(Dataset *set)
+{
+    int r = 0;
+    SCMutexLock(&sets_lock);
+    if (DatasetIsReadOnly(set)) {
+        r = -1;
+    } else {
+        set->rule_write = true;
+    }
+    SCMutexUnlock(&sets_lock);
+    return r;
+}
+
+/** \brief check if static sets are converted to perfect hashes
+ *
+ *  Off by default: a frozen set can't be modified through the unix socket,
+ *  and a later rule load (reload, other tenant) can't use set/unset on it.
+ */
+bool DatasetsPerfectHashEnabled(void)
+{
+    int enabled = 0;
+    if (ConfGetBool("datasets.perfect-hash", &enabled) != 1)
+        return false;
+    return enabled != 0;
+}
+
+/**
+ *  \brief move static sets into read-only perfect hash storage
+ *
+ *  Called after a rule load, before the new rules are in use. Only sets
+ *  created since the previous call are converted: older sets may be in
+ *  use by the packet threads.
+ */
+void DatasetsFreezeStatic(void)
+{
+    const bool enabled = DatasetsPerfectHashEnabled();
+
+    SCMutexLock(&sets_lock);
+    for (Dataset *set = sets; set != NULL; set = set->next) {
+        if (set->freeze_checked)
+            continue;
+        set->freeze_checked = true;
+
+        if (!enabled || set->hidden || set->rule_write || set->hash == NULL ||
+                !DatasetIsStatic(set->save, set->load))
+            continue;
+
+        DatasetMphf *m = DatasetMphfBuild(
+                set->hash, DatasetKeyLength(set->type), DatasetGetKeyFunc(set->type));
+        if (m == NULL) {
+            SCLogWarning("dataset %s: building the perfect hash failed, keeping the hash table",
+                    set->name);
+            continue;
+        }
+        const uint64_t hash_memuse = SC_ATOMIC_GET(set->hash->memuse);
+        THashShutdown(set->hash);
+        set->hash = NULL;
+        set->mphf = m;
+        SCLogConfig("dataset: %s using perfect hash for %" PRIu64 " records, %" PRIu64
+                    " bytes instead of %" PRIu64,
+                set->name, m->cnt, DatasetMphfMemoryUse(m), hash_memuse);
+    }
+    SCMutexUnlock(&sets_lock);
+}
+
+/** \brief count the lines of a file to size the hash table */
+static uint32_t DatasetCountLines(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return 0;
+
+    uint64_t lines = 0;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (buf[i] == '\n')
+                lines++;
+        }
+    }
+    fclose(fp);
+    return (uint32_t)MIN(lines, UINT32_MAX);
+}
+
+/**
+ *  \brief compile a dataset file into the memory mapped binary format
+ *
+ *  \param arg "<type>,<input>,<output>"
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int DatasetsCompile(const char *arg)
+{
+    char type_str[16];
+    char in[PATH_MAX];
+    char out[PATH_MAX];
+
+    const char *sep1 = strchr(arg, ',');
+    const char *sep2 = sep1 ? strchr(sep1 + 1, ',') : NULL;
+    if (sep1 == NULL || sep2 == NULL || sep1 == arg || sep2 == sep1 + 1 || sep2[1] == '\0') {
+        SCLogError("invalid dataset compile argument '%s', expected <type>,<input>,<output>",
+                arg);
+        return -1;
+    }
+    if ((size_t)(sep1 - arg) >= sizeof(type_str) || (size_t)(sep2 - sep1) > sizeof(in)) {
+        SCLogError("invalid dataset compile argument '%s'", arg);
+        return -1;
+    }
+    strlcpy(type_str, arg, sep1 - arg + 1);
+    strlcpy(in, sep1 + 1, sep2 - sep1);
+    strlcpy(out, sep2 + 1, sizeof(out));
+
+    enum DatasetTypes type = DatasetGetTypeFromString(type_str);
+    DatasetBinaryGetKeyFunc GetKey = DatasetGetKeyFunc(type);
+    if (GetKey == NULL) {
+        SCLogError("unknown dataset type '%s'", type_str);
+        return -1;
+    }
+    if (DatasetBinaryIsBinaryFile(in)) {
+        SCLogError("'%s' is already a binary dataset file", in);
+        return -1;
+    }
+
+    /* a hash sized for the input keeps loading of large sets fast. The
+     * runtime memcap doesn't apply to an offline compile, so don't limit
+     * memory use. */
+    const uint32_t hashsize = MAX(DatasetCountLines(in) / 4, 4096);
+    Dataset *set = DatasetGet("compile", type, NULL, in, UINT64_MAX, hashsize);
+    if (set == NULL) {
+        SCLogError("failed to load dataset file '%s'", in);
+        return -1;
+    }
+
+    int r = DatasetBinaryWrite(set->hash, type, DatasetKeyLength(type), GetKey, out);
+    if (r < 0) {
+        SCLogError("failed to compile %s dataset '%s' into '%s'", type_str, in, out);
+    }
+    DatasetsDestroy();
+    return r;
+}
+
 static int DatasetLookupString(Dataset *set, const uint8_t *data, const uint32_t data_len)
 {
     if (set == NULL)
         return -1;
 
     StringType lookup = { .ptr = (uint8_t *)data, .len = data_len, .rep.value = 0 };
-    THashData *rdata = THashLookupFromHash(set->hash, &lookup);
-    if (rdata) {
-        DatasetUnlockData(rdata);
+    if (THashLookupFromHashNoLock(set->hash, &lookup, NULL))
         return 1;
-    }
     return 0;
 }
 
@@ -1129,13 +1399,10 @@ static DataRepResultType DatasetLookupStringwRep(Dataset *set,
         return rrep;
 
     StringType lookup = { .ptr = (uint8_t *)data, .len = data_len, .rep = *rep };
-    THashData *rdata = THashLookupFromHash(set->hash, &lookup);
-    if (rdata) {
-        StringType *found = rdata->data;
+    StringType found;
+    if (THashLookupFromHashNoLock(set->hash, &lookup, &found)) {
         rrep.found = true;
-        rrep.rep = found->rep;
-        DatasetUnlockData(rdata);
-        return rrep;
+        rrep.rep = found.rep;
     }
     return rrep;
 }
@@ -1150,11 +1417,8 @@ static int DatasetLookupIPv4(Dataset *set, const uint8_t *data, const uint32_t d
 
     IPv4Type lookup = { .rep.value = 0 };
     memcpy(lookup.ipv4, data, 4);
-    THashData *rdata = THashLookupFromHash(set->hash, &lookup);
-    if (rdata) {
-        DatasetUnlockData(rdata);
+    if (THashLookupFromHashNoLock(set->hash, &lookup, NULL))
         return 1;
-    }
     return 0;
 }
 
@@ -1171,13 +1435,10 @@ static DataRepResultType DatasetLookupIPv4wRep(
 
     IPv4Type lookup = { .rep.value = 0 };
     memcpy(lookup.ipv4, data, data_len);
-    THashData *rdata = THashLookupFromHash(set->hash, &lookup);
-    if (rdata) {
-        IPv4Type *found = rdata->data;
+    IPv4Type found;
+    if (THashLookupFromHashNoLock(set->hash, &lookup, &found)) {
         rrep.found = true;
-        rrep.rep = found->rep;
-        DatasetUnlockData(rdata);
-        return rrep;
+        rrep.rep = found.rep;
     }
     return rrep;
 }
@@ -1192,11 +1453,8 @@ static int DatasetLookupIPv6(Dataset *set, const uint8_t *data, const uint32_t d
 
     IPv6Type lookup = { .rep.value = 0 };
     memcpy(lookup.ipv6, data, data_len);
-    THashData *rdata = THashLookupFromHash(set->hash, &lookup);
-    if (rdata) {
-        DatasetUnlockData(rdata);
+    if (THashLookupFromHashNoLock(set->hash, &lookup, NULL))
         return 1;
-    }
     return 0;
 }
 
@@ -1213,13 +1471,10 @@ static DataRepResultType DatasetLookupIPv6wRep(
 
     IPv6Type lookup = { .rep.value = 0 };
     memcpy(lookup.ipv6, data, data_len);
-    THashData *rdata = THashLookupFromHash(set->hash, &lookup);
-    if (rdata) {
-        IPv6Type *found = rdata->data;
+    IPv6Type found;
+    if (THashLookupFromHashNoLock(set->hash, &lookup, &found)) {
         rrep.found = true;
-        rrep.rep = found->rep;
-        DatasetUnlockData(rdata);
-        return rrep;
+        rrep.rep = found.rep;
     }
     return rrep;
 }
@@ -1234,11 +1489,8 @@ static int DatasetLookupMd5(Dataset *set, const uint8_t *data, const uint32_t da
 
     Md5Type lookup = { .rep.value = 0 };
     memcpy(lookup.md5, data, data_len);
-    THashData *rdata = THashLookupFromHash(set->hash, &lookup);
-    if (rdata) {
-        DatasetUnlockData(rdata);
+    if (THashLookupFromHashNoLock(set->hash, &lookup, NULL))
         return 1;
-    }
     return 0;
 }
 
@@ -1255,13 +1507,10 @@ static DataRepResultType DatasetLookupMd5wRep(Dataset *set,
 
     Md5Type lookup = { .rep.value = 0};
     memcpy(lookup.md5, data, data_len);
-    THashData *rdata = THashLookupFromHash(set->hash, &lookup);
-    if (rdata) {
-        Md5Type *found = rdata->data;
+    Md5Type found;
+    if (THashLookupFromHashNoLock(set->hash, &lookup, &found)) {
         rrep.found = true;
-        rrep.rep = found->rep;
-        DatasetUnlockData(rdata);
-        return rrep;
+        rrep.rep = found.rep;
     }
     return rrep;
 }
@@ -1276,11 +1525,8 @@ static int DatasetLookupSha256(Dataset *set, const uint8_t *data, const uint32_t
 
     Sha256Type lookup = { .rep.value = 0 };
     memcpy(lookup.sha256, data, data_len);
-    THashData *rdata = THashLookupFromHash(set->hash, &lookup);
-    if (rdata) {
-        DatasetUnlockData(rdata);
+    if (THashLookupFromHashNoLock(set->hash, &lookup, NULL))
         return 1;
-    }
     return 0;
 }
 
@@ -1297,17 +1543,39 @@ static DataRepResultType DatasetLookupSha256wRep(Dataset *set,
 
     Sha256Type lookup = { .rep.value = 0 };
     memcpy(lookup.sha256, data, data_len);
-    THashData *rdata = THashLookupFromHash(set->hash, &lookup);
-    if (rdata) {
-        Sha256Type *found = rdata->data;
+    Sha256Type found;
+    if (THashLookupFromHashNoLock(set->hash, &lookup, &found)) {
         rrep.found = true;
-        rrep.rep = found->rep;
-        DatasetUnlockData(rdata);
-        return rrep;
+        rrep.rep = found.rep;
     }
     return rrep;
 }
 
+static int DatasetLookupReadOnlywRep(
+        Dataset *set, const uint8_t *data, const uint32_t data_len, DataRepType *rep)
+{
+    uint8_t ipv6[16];
+    uint32_t len = data_len;
+    if (set->type == DATASET_TYPE_IPV6 && data_len == 4) {
+        /* IPv4 addresses are stored zero padded, like in the hash */
+        memset(ipv6, 0, sizeof(ipv6));
+        memcpy(ipv6, data, 4);
+        data = ipv6;
+        len = sizeof(ipv6);
+    }
+    if (set->mphf != NULL)
+        return DatasetMphfLookup(set->mphf, data, len, rep);
+    return DatasetBinaryLookup(set->bin, data, len, rep);
+}
+
+static int DatasetLookupReadOnly(Dataset *set, const uint8_t *data, const uint32_t data_len)
+{
+    if (set == NULL)
+        return -1;
+
+    return DatasetLookupReadOnlywRep(set, data, data_len, NULL);
+}
+
 /**
  *  \brief see if \a data is part of the set
  *  \param set dataset
@@ -1321,6 +1589,8 @@ int DatasetLookup(Dataset *set, const uint8_t *data, const uint32_t data_len)
 {
     if (set == NULL)
         return -1;
+    if (DatasetIsReadOnly(set))
+        return DatasetLookupReadOnly(set, data, data_len);
 
     switch (set->type) {
         case DATASET_TYPE_STRING:
@@ -1343,6 +1613,11 @@ DataRepResultType DatasetLookupwRep(Dataset *set, const uint8_t *data, const uin
     DataRepResultType rrep = { .found = false, .rep = { .value = 0 }};
     if (set == NULL)
         return rrep;
+    if (DatasetIsReadOnly(set)) {
+        if (DatasetLookupReadOnlywRep(set, data, data_len, &rrep.rep) == 1)
+            rrep.found = true;
+        return rrep;
+    }
 
     switch (set->type) {
         case DATASET_TYPE_STRING:
@@ -1556,6 +1831,8 @@ int DatasetAdd(Dataset *set, const uint8_t *data, const uint32_t data_len)
 {
     if (set == NULL)
         return -1;
+    if (DatasetIsReadOnly(set))
+        return -1;
 
     switch (set->type) {
         case DATASET_TYPE_STRING:
@@ -1577,6 +1854,8 @@ static int DatasetAddwRep(Dataset *set, const uint8_t *data, const uint32_t data
 {
     if (set == NULL)
         return -1;
+    if (DatasetIsReadOnly(set))
+        return -1;
 
     switch (set->type) {
         case DATASET_TYPE_STRING:
@@ -1658,6 +1937,8 @@ static int DatasetOpSerialized(Dataset *set, const char *string, DatasetOpFunc D
  */
 int DatasetAddSerialized(Dataset *set, const char *string)
 {
+    if (set != NULL && DatasetIsReadOnly(set))
+        return -1;
     return DatasetOpSerialized(set, string, DatasetAddString, DatasetAddMd5, DatasetAddSha256,
             DatasetAddIPv4, DatasetAddIPv6);
 }
@@ -1670,6 +1951,9 @@ int DatasetAddSerialized(Dataset *set, const char *string)
  */
 int DatasetLookupSerialized(Dataset *set, const char *string)
 {
+    if (set != NULL && DatasetIsReadOnly(set))
+        return DatasetOpSerialized(set, string, DatasetLookupReadOnly, DatasetLookupReadOnly,
+                DatasetLookupReadOnly, DatasetLookupReadOnly, DatasetLookupReadOnly);
     return DatasetOpSerialized(set, string, DatasetLookupString, DatasetLookupMd5,
             DatasetLookupSha256, DatasetLookupIPv4, DatasetLookupIPv6);
 }
@@ -1748,6 +2032,8 @@ static int DatasetRemoveSha256(Dataset *set, const uint8_t *data, const uint32_t
  *  \retval int -2 DATA error */
 int DatasetRemoveSerialized(Dataset *set, const char *string)
 {
+    if (set != NULL && DatasetIsReadOnly(set))
+        return -1;
     return DatasetOpSerialized(set, string, DatasetRemoveString, DatasetRemoveMd5,
             DatasetRemoveSha256, DatasetRemoveIPv4, DatasetRemoveIPv6);
 }
@@ -1756,6 +2042,8 @@ int DatasetRemove(Dataset *set, const uint8_t *data, const uint32_t data_len)
 {
     if (set == NULL)
         return -1;
+    if (DatasetIsReadOnly(set))
+        return -1;
 
     switch (set->type) {
         case DATASET_TYPE_STRING:
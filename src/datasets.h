@@ -20,6 +20,8 @@
 
 #include "util-thash.h"
 #include "datasets-reputation.h"
+#include "datasets-binary.h"
+#include "datasets-mphf.h"
 
 int DatasetsInit(void);
 void DatasetsDestroy(void);
@@ -44,6 +46,14 @@ typedef struct Dataset {
     bool from_yaml;                     /* Mark whether the set was retrieved from YAML */
     bool hidden;                        /* Mark the old sets hidden in case of reload */
     THashTableContext *hash;
+    /** read-only set mapped from a binary file, hash is NULL */
+    DatasetBinary *bin;
+    /** read-only perfect hash of a static set, hash is NULL */
+    DatasetMphf *mphf;
+    /** set/unset is used on the set by a rule */
+    bool rule_write;
+    /** set was considered by DatasetsFreezeStatic */
+    bool freeze_checked;
 
     char load[PATH_MAX];
     char save[PATH_MAX];
@@ -65,4 +75,9 @@ int DatasetAddSerialized(Dataset *set, const char *string);
 int DatasetRemoveSerialized(Dataset *set, const char *string);
 int DatasetLookupSerialized(Dataset *set, const char *string);
 
+int DatasetMarkWritable(Dataset *set);
+bool DatasetsPerfectHashEnabled(void);
+void DatasetsFreezeStatic(void);
+int DatasetsCompile(const char *arg);
+
 #endif /* SURICATA_DATASETS_H */
@@ -136,13 +136,11 @@ ExceptionPolicyStatsSetts flow_memcap_eps_stats = {
 /**
  * \brief Initialize PacketAlerts with dynamic alerts array size
  *
+ * \retval pa_array alerts array or NULL if out of memory
  */
 PacketAlert *PacketAlertCreate(void)
 {
-    PacketAlert *pa_array = SCCalloc(packet_alert_max, sizeof(PacketAlert));
-    BUG_ON(pa_array == NULL);
-
-    return pa_array;
+    return SCCalloc(packet_alert_max, sizeof(PacketAlert));
 }
 
 void PacketAlertFree(PacketAlert *pa)
@@ -267,6 +267,8 @@ typedef struct PacketAlerts_ {
     uint16_t cnt;
     uint16_t discarded;
     uint16_t suppressed;
+    /** packet_alert_max sized array, allocated on the first alert and
+     *  then kept for the life time of the packet */
     PacketAlert *alerts;
     /* single pa used when we're dropping,
      * so we can log it out in the drop log. */
@@ -1255,7 +1257,9 @@ void DecodeUnregisterCounters(void);
 
 /** Flag to indicate that packet contents should not be inspected */
 #define PKT_NOPAYLOAD_INSPECTION BIT_U32(2)
-// vacancy
+/** Packet::flow_hash was set by the capture method before decoding, see
+ *  FlowGetRawHash */
+#define PKT_HAS_RAW_FLOW_HASH BIT_U32(3)
 
 /** Packet has matched a tag */
 #define PKT_HAS_TAG BIT_U32(4)
@@ -72,6 +72,7 @@ int DetectDatarepBufferMatch(DetectEngineThreadCtx *det_ctx,
     if (data == NULL || data_len == 0)
         return 0;
 
+    StatsIncr(det_ctx->tv, det_ctx->counter_dataset_lookups);
     DataRepResultType r = DatasetLookupwRep(sd->set, data, data_len, &sd->rep);
     if (!r.found)
         return 0;
@@ -76,6 +76,7 @@ int DetectDatasetBufferMatch(DetectEngineThreadCtx *det_ctx,
     switch (sd->cmd) {
         case DETECT_DATASET_CMD_ISSET: {
             //PrintRawDataFp(stdout, data, data_len);
+            StatsIncr(det_ctx->tv, det_ctx->counter_dataset_lookups);
             int r = DatasetLookup(sd->set, data, data_len);
             SCLogDebug("r %d", r);
             if (r == 1)
@@ -84,6 +85,7 @@ int DetectDatasetBufferMatch(DetectEngineThreadCtx *det_ctx,
         }
         case DETECT_DATASET_CMD_ISNOTSET: {
             //PrintRawDataFp(stdout, data, data_len);
+            StatsIncr(det_ctx->tv, det_ctx->counter_dataset_lookups);
             int r = DatasetLookup(sd->set, data, data_len);
             SCLogDebug("r %d", r);
             if (r < 1)
@@ -417,6 +419,11 @@ int DetectDatasetSetup (DetectEngineCtx *de_ctx, Signature *s, const char *rawst
         SCLogError("failed to set up dataset '%s'.", name);
         return -1;
     }
+    if ((cmd == DETECT_DATASET_CMD_SET || cmd == DETECT_DATASET_CMD_UNSET) &&
+            DatasetMarkWritable(set) < 0) {
+        SCLogError("dataset '%s' is read-only, it can't be used with %s", name, cmd_str);
+        return -1;
+    }
 
     cd = SCCalloc(1, sizeof(DetectDatasetData));
     if (unlikely(cd == NULL))
@@ -414,6 +414,14 @@ void PacketAlertFinalize(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx
             /* we will not copy this to the AlertQueue */
             p->alerts.suppressed++;
         } else if (p->alerts.cnt < packet_alert_max) {
+            if (unlikely(p->alerts.alerts == NULL)) {
+                p->alerts.alerts = PacketAlertCreate();
+                if (p->alerts.alerts == NULL) {
+                    /* no memory to store the alert */
+                    p->alerts.discarded++;
+                    continue;
+                }
+            }
             p->alerts.alerts[p->alerts.cnt] = *pa;
             SCLogDebug("Appending sid %" PRIu32 " alert to Packet::alerts at pos %u", s->id, i);
 
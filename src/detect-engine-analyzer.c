@@ -1285,6 +1285,9 @@ void EngineAnalysisRules2(const DetectEngineCtx *de_ctx, const Signature *s)
         const char *mname = sigmatch_table[s->init_data->prefilter_sm->type].name;
         jb_set_string(ctx.js, "name", mname);
         jb_close(ctx.js);
+        if (s->init_data->prefilter_sm->type == DETECT_PCRE)
+            AnalyzerNote(&ctx, (char *)"pcre prefilter is accelerated by Hyperscan, matches are "
+                                       "confirmed by pcre");
     }
 
     if (ctx.js_warnings) {
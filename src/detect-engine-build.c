@@ -31,6 +31,7 @@
 #include "detect-engine-prefilter.h"
 #include "detect-engine-proto.h"
 #include "detect-engine-threshold.h"
+#include "detect-engine-payload.h"
 
 #include "detect-dsize.h"
 #include "detect-tcp-flags.h"
@@ -610,6 +611,7 @@ static json_t *RulesGroupPrintSghStats(const DetectEngineCtx *de_ctx, const SigG
     uint32_t negmpm_cnt = 0;
     uint32_t any5_cnt = 0;
     uint32_t payload_no_mpm_cnt = 0;
+    uint32_t prefilter_pcre_cnt = 0;
     uint32_t syn_cnt = 0;
 
     uint32_t mpms_min = 0;
@@ -669,6 +671,9 @@ static json_t *RulesGroupPrintSghStats(const DetectEngineCtx *de_ctx, const SigG
         }
 
         prefilter_cnt += (s->init_data->prefilter_sm != 0);
+        if (s->init_data->prefilter_sm != NULL && s->init_data->prefilter_sm->type == DETECT_PCRE) {
+            prefilter_pcre_cnt++;
+        }
         if (s->init_data->mpm_sm == NULL) {
             nonmpm_cnt++;
 
@@ -786,6 +791,7 @@ static json_t *RulesGroupPrintSghStats(const DetectEngineCtx *de_ctx, const SigG
     json_object_set_new(types, "negated_mpm", json_integer(negmpm_cnt));
     json_object_set_new(types, "payload_but_no_mpm", json_integer(payload_no_mpm_cnt));
     json_object_set_new(types, "prefilter", json_integer(prefilter_cnt));
+    json_object_set_new(types, "prefilter_pcre", json_integer(prefilter_pcre_cnt));
     json_object_set_new(types, "syn", json_integer(syn_cnt));
     json_object_set_new(types, "any5", json_integer(any5_cnt));
     json_object_set_new(stats, "types", types);
@@ -852,6 +858,12 @@ static json_t *RulesGroupPrintSghStats(const DetectEngineCtx *de_ctx, const SigG
     }
     json_object_set_new(js, "stats", stats);
 
+    uint64_t shared = 0;
+    json_t *mem = json_object();
+    json_object_set_new(mem, "total", json_integer(SigGroupHeadMemoryUse(de_ctx, sgh, &shared)));
+    json_object_set_new(mem, "shared", json_integer(shared));
+    json_object_set_new(js, "memory", mem);
+
     json_object_set_new(js, "score", json_integer(sgh->init->score));
 
     return js;
@@ -1718,6 +1730,7 @@ int SigPrepareStage1(DetectEngineCtx *de_ctx)
     uint32_t cnt_payload = 0;
     uint32_t cnt_applayer = 0;
     uint32_t cnt_deonly = 0;
+    uint32_t cnt_pcre_prefilter = 0;
 
     if (!(de_ctx->flags & DE_QUIET)) {
         SCLogDebug("building signature grouping structure, stage 1: "
@@ -1818,6 +1831,23 @@ int SigPrepareStage1(DetectEngineCtx *de_ctx)
                     }
                 }
             }
+        } else if (!g_skip_prefilter && de_ctx->prefilter_pcre && !(s->flags & SIG_FLAG_PREFILTER) &&
+                   sigmatch_table[DETECT_PCRE].SupportsPrefilter(s)) {
+            /* pcre only rule: use the first payload pcre as prefilter */
+            for (SigMatch *sm = s->init_data->smlists[DETECT_SM_LIST_PMATCH]; sm != NULL;
+                    sm = sm->next) {
+                if (sm->type == DETECT_PCRE) {
+                    s->init_data->prefilter_sm = sm;
+                    s->flags |= SIG_FLAG_PREFILTER;
+                    de_ctx->sm_types_prefilter[DETECT_PCRE] = true;
+                    SCLogDebug("sid %u: prefilter is on \"pcre\"", s->id);
+                    break;
+                }
+            }
+        }
+
+        if (s->init_data->prefilter_sm != NULL && s->init_data->prefilter_sm->type == DETECT_PCRE) {
+            cnt_pcre_prefilter++;
         }
 
         /* run buffer type callbacks if any */
@@ -1845,6 +1875,11 @@ int SigPrepareStage1(DetectEngineCtx *de_ctx)
                       " inspect application layer, %" PRIu32 " are decoder event only",
                     de_ctx->sig_cnt, cnt_iponly, cnt_payload, cnt_applayer, cnt_deonly);
 
+        if (cnt_pcre_prefilter > 0) {
+            SCLogConfig("%" PRIu32 " rules use the Hyperscan accelerated pcre prefilter",
+                    cnt_pcre_prefilter);
+        }
+
         SCLogConfig("building signature grouping structure, stage 1: "
                "preprocessing rules... complete");
     }
@@ -1954,6 +1989,7 @@ int SigAddressCleanupStage1(DetectEngineCtx *de_ctx)
         SCLogDebug("sgh %p", sgh);
         SigGroupHeadFree(de_ctx, sgh);
     }
+    SigGroupHeadNonPrefilterHashFree(de_ctx);
     SCFree(de_ctx->sgh_array);
     de_ctx->sgh_array = NULL;
     de_ctx->sgh_array_cnt = 0;
@@ -2031,6 +2067,7 @@ int SigPrepareStage4(DetectEngineCtx *de_ctx)
          * signature not decode event only. */
         SigGroupHeadBuildNonPrefilterArray(de_ctx, de_ctx->decoder_event_sgh);
     }
+    SigGroupHeadReportMemory(de_ctx);
 
     int dump_grouping = 0;
     (void)ConfGetBool("detect.profiling.grouping.dump-to-disk", &dump_grouping);
@@ -2069,6 +2106,51 @@ extern bool rule_engine_analysis_set;
  *  - Setup per signature inspect engines
  *  - remove signature init data.
  */
+static void SigContentFilterAdd(SigContentFilter *cf, const uint16_t bit)
+{
+    if (cf->cnt == DETECT_CONTENT_FILTER_MAX)
+        return;
+    for (uint8_t i = 0; i < cf->cnt; i++) {
+        if (cf->bits[i] == bit)
+            return;
+    }
+    cf->bits[cf->cnt++] = bit;
+}
+
+/** \internal
+ *  \brief set up the content filter for a signature
+ *
+ *  Every non-negated content in the payload list has to be present in the
+ *  buffer for the signature to match, so the first and last bigram of each
+ *  of them can be checked against the buffer bigram map before doing the
+ *  full inspection. The fast pattern is skipped as the prefilter checked it.
+ */
+static void SigContentFilterSetup(Signature *s)
+{
+    SigContentFilter cf = { .cnt = 0 };
+
+    for (const SigMatch *sm = s->init_data->smlists[DETECT_SM_LIST_PMATCH]; sm != NULL;
+            sm = sm->next) {
+        if (sm->type != DETECT_CONTENT || sm == s->init_data->mpm_sm)
+            continue;
+        const DetectContentData *cd = (const DetectContentData *)sm->ctx;
+        if ((cd->flags & DETECT_CONTENT_NEGATED) || cd->content_len < 2)
+            continue;
+
+        SigContentFilterAdd(&cf, DetectContentFilterBit(cd->content[0], cd->content[1]));
+        SigContentFilterAdd(&cf, DetectContentFilterBit(cd->content[cd->content_len - 2],
+                                         cd->content[cd->content_len - 1]));
+    }
+    if (cf.cnt == 0)
+        return;
+
+    s->content_filter = SCMalloc(sizeof(*s->content_filter));
+    if (s->content_filter == NULL)
+        return;
+    *s->content_filter = cf;
+    SCLogDebug("sid %u: content filter with %u bigrams", s->id, cf.cnt);
+}
+
 static int SigMatchPrepare(DetectEngineCtx *de_ctx)
 {
     SCEnter();
@@ -2089,6 +2171,9 @@ static int SigMatchPrepare(DetectEngineCtx *de_ctx)
         /* set up the pkt inspection engines */
         DetectEnginePktInspectionSetup(s);
 
+        if (de_ctx->content_filter)
+            SigContentFilterSetup(s);
+
         if (rule_engine_analysis_set) {
             EngineAnalysisAddAllRulePatterns(de_ctx, s);
             EngineAnalysisRules2(de_ctx, s);
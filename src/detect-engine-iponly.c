@@ -955,6 +955,14 @@ void IPOnlyDeinit(DetectEngineCtx *de_ctx, DetectEngineIPOnlyCtx *io_ctx)
     if (io_ctx == NULL)
         return;
 
+    /* tables reference the user data of the trees, free them first */
+    SCLpmFree(io_ctx->lpm_ipv4src);
+    SCLpmFree(io_ctx->lpm_ipv4dst);
+    SCLpmFree(io_ctx->lpm_ipv6src);
+    SCLpmFree(io_ctx->lpm_ipv6dst);
+    io_ctx->lpm_ipv4src = io_ctx->lpm_ipv4dst = NULL;
+    io_ctx->lpm_ipv6src = io_ctx->lpm_ipv6dst = NULL;
+
     SCRadix4TreeRelease(&io_ctx->tree_ipv4src, &iponly_radix4_config);
     SCRadix4TreeRelease(&io_ctx->tree_ipv4dst, &iponly_radix4_config);
 
@@ -1005,19 +1013,33 @@ void IPOnlyMatchPacket(ThreadVars *tv, const DetectEngineCtx *de_ctx,
     SCEnter();
 
     if (p->src.family == AF_INET) {
-        (void)SCRadix4TreeFindBestMatch(
-                &io_ctx->tree_ipv4src, (uint8_t *)&GET_IPV4_SRC_ADDR_U32(p), &user_data_src);
+        if (io_ctx->lpm_ipv4src != NULL)
+            user_data_src =
+                    SCLpmLookup(io_ctx->lpm_ipv4src, (uint8_t *)&GET_IPV4_SRC_ADDR_U32(p));
+        else
+            (void)SCRadix4TreeFindBestMatch(
+                    &io_ctx->tree_ipv4src, (uint8_t *)&GET_IPV4_SRC_ADDR_U32(p), &user_data_src);
     } else if (p->src.family == AF_INET6) {
-        (void)SCRadix6TreeFindBestMatch(
-                &io_ctx->tree_ipv6src, (uint8_t *)&GET_IPV6_SRC_ADDR(p), &user_data_src);
+        if (io_ctx->lpm_ipv6src != NULL)
+            user_data_src = SCLpmLookup(io_ctx->lpm_ipv6src, (uint8_t *)&GET_IPV6_SRC_ADDR(p));
+        else
+            (void)SCRadix6TreeFindBestMatch(
+                    &io_ctx->tree_ipv6src, (uint8_t *)&GET_IPV6_SRC_ADDR(p), &user_data_src);
     }
 
     if (p->dst.family == AF_INET) {
-        (void)SCRadix4TreeFindBestMatch(
-                &io_ctx->tree_ipv4dst, (uint8_t *)&GET_IPV4_DST_ADDR_U32(p), &user_data_dst);
+        if (io_ctx->lpm_ipv4dst != NULL)
+            user_data_dst =
+                    SCLpmLookup(io_ctx->lpm_ipv4dst, (uint8_t *)&GET_IPV4_DST_ADDR_U32(p));
+        else
+            (void)SCRadix4TreeFindBestMatch(
+                    &io_ctx->tree_ipv4dst, (uint8_t *)&GET_IPV4_DST_ADDR_U32(p), &user_data_dst);
     } else if (p->dst.family == AF_INET6) {
-        (void)SCRadix6TreeFindBestMatch(
-                &io_ctx->tree_ipv6dst, (uint8_t *)&GET_IPV6_DST_ADDR(p), &user_data_dst);
+        if (io_ctx->lpm_ipv6dst != NULL)
+            user_data_dst = SCLpmLookup(io_ctx->lpm_ipv6dst, (uint8_t *)&GET_IPV6_DST_ADDR(p));
+        else
+            (void)SCRadix6TreeFindBestMatch(
+                    &io_ctx->tree_ipv6dst, (uint8_t *)&GET_IPV6_DST_ADDR(p), &user_data_dst);
     }
 
     src = user_data_src;
@@ -1397,6 +1419,16 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
         dst = dst->next;
         SCFree(tmpaux);
     }
+
+    /* the trees are final now, compile them into lookup tables */
+    DetectEngineIPOnlyCtx *io_ctx = &de_ctx->io_ctx;
+    io_ctx->lpm_ipv4src = SCLpmBuildIPv4(&io_ctx->tree_ipv4src);
+    io_ctx->lpm_ipv4dst = SCLpmBuildIPv4(&io_ctx->tree_ipv4dst);
+    io_ctx->lpm_ipv6src = SCLpmBuildIPv6(&io_ctx->tree_ipv6src);
+    io_ctx->lpm_ipv6dst = SCLpmBuildIPv6(&io_ctx->tree_ipv6dst);
+    SCLogDebug("iponly lookup tables use %" PRIu64 " bytes",
+            SCLpmMemoryUse(io_ctx->lpm_ipv4src) + SCLpmMemoryUse(io_ctx->lpm_ipv4dst) +
+                    SCLpmMemoryUse(io_ctx->lpm_ipv6src) + SCLpmMemoryUse(io_ctx->lpm_ipv6dst));
 }
 
 /**
@@ -42,6 +42,7 @@
 #include "util-detect.h"
 #include "util-threshold-config.h"
 #include "util-path.h"
+#include "datasets.h"
 
 #include "rust.h"
 
@@ -400,6 +401,9 @@ int SigLoadSignatures(DetectEngineCtx *de_ctx, char *sig_file, bool sig_file_exc
     if (SigGroupBuild(de_ctx) < 0)
         goto end;
 
+    /* the rules are loaded, so it's known which sets are never modified */
+    DatasetsFreezeStatic();
+
     ret = 0;
 
  end:
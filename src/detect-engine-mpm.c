@@ -1443,6 +1443,8 @@ void MpmStoreReportStats(const DetectEngineCtx *de_ctx)
     int frame_mpms_cnt = de_ctx->buffer_type_id;
     uint32_t framestats[frame_mpms_cnt + 1]; // +1 to silence scan-build
     memset(&framestats, 0x00, sizeof(framestats));
+    uint64_t mpm_memory = 0;
+    uint32_t mpm_cnt = 0;
 
     for (htb = HashListTableGetListHead(de_ctx->mpm_hash_table);
             htb != NULL;
@@ -1452,6 +1454,8 @@ void MpmStoreReportStats(const DetectEngineCtx *de_ctx)
         if (ms == NULL || ms->mpm_ctx == NULL) {
             continue;
         }
+        mpm_memory += ms->mpm_ctx->memory_size;
+        mpm_cnt++;
         if (ms->buffer < MPMB_MAX)
             stats[ms->buffer]++;
         else if (ms->sm_list != DETECT_SM_LIST_PMATCH) {
@@ -1517,6 +1521,11 @@ void MpmStoreReportStats(const DetectEngineCtx *de_ctx)
             }
             um = um->next;
         }
+
+        SCLogPerf("Tenant %u memory: MPM %" PRIu64 " bytes in %u contexts, "
+                  "PCRE %" PRIu64 " bytes for %u expressions (%u shared with other engines)",
+                de_ctx->tenant_id, mpm_memory, mpm_cnt, de_ctx->pcre_memory, de_ctx->pcre_cnt,
+                de_ctx->pcre_shared_cnt);
     }
 }
 
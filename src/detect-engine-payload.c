@@ -137,6 +137,44 @@ int PrefilterPktPayloadRegister(DetectEngineCtx *de_ctx,
 }
 
 
+/** \internal
+ *  \brief check the signature content filter against the buffer
+ *
+ *  The bigram map of the buffer is built once and reused for all
+ *  signatures inspecting the same buffer.
+ *
+ *  \retval true signature may match, run the full inspection
+ *  \retval false signature can't match
+ */
+static bool DetectContentFilterCheck(DetectEngineThreadCtx *det_ctx, const Signature *s,
+        const uint8_t *buf, const uint32_t buf_len)
+{
+    const SigContentFilter *cf = s->content_filter;
+    if (cf == NULL)
+        return true;
+
+    uint64_t *map = det_ctx->content_filter_map;
+    if (det_ctx->content_filter_buf != buf || det_ctx->content_filter_buf_len != buf_len) {
+        memset(map, 0, sizeof(det_ctx->content_filter_map));
+        for (uint32_t i = 1; i < buf_len; i++) {
+            const uint16_t bit = DetectContentFilterBit(buf[i - 1], buf[i]);
+            map[bit / 64] |= BIT_U64(bit % 64);
+        }
+        det_ctx->content_filter_buf = buf;
+        det_ctx->content_filter_buf_len = buf_len;
+    }
+
+    for (uint8_t i = 0; i < cf->cnt; i++) {
+        const uint16_t bit = cf->bits[i];
+        if ((map[bit / 64] & BIT_U64(bit % 64)) == 0) {
+            SCLogDebug("sid %u rejected by content filter", s->id);
+            StatsIncr(det_ctx->tv, det_ctx->counter_content_filter_rejects);
+            return false;
+        }
+    }
+    return true;
+}
+
 /**
  *  \brief Do the content inspection & validation for a signature
  *
@@ -157,6 +195,9 @@ uint8_t DetectEngineInspectPacketPayload(DetectEngineCtx *de_ctx, DetectEngineTh
     if (s->sm_arrays[DETECT_SM_LIST_PMATCH] == NULL) {
         SCReturnInt(0);
     }
+    if (!DetectContentFilterCheck(det_ctx, s, p->payload, p->payload_len)) {
+        SCReturnInt(0);
+    }
 #ifdef DEBUG
     det_ctx->payload_persig_cnt++;
     det_ctx->payload_persig_size += p->payload_len;
@@ -192,6 +233,9 @@ static uint8_t DetectEngineInspectStreamUDPPayload(DetectEngineCtx *de_ctx,
     if (smd == NULL) {
         SCReturnInt(0);
     }
+    if (!DetectContentFilterCheck(det_ctx, s, p->payload, p->payload_len)) {
+        SCReturnInt(0);
+    }
 #ifdef DEBUG
     det_ctx->payload_persig_cnt++;
     det_ctx->payload_persig_size += p->payload_len;
@@ -1137,6 +1181,52 @@ static int PayloadTestSig34(void)
     PASS;
 }
 
+/** \test content filter rejects buffers missing a required content */
+static int PayloadTestContentFilter01(void)
+{
+    uint8_t *buf1 = (uint8_t *)"abcdef 123456";
+    uint8_t *buf2 = (uint8_t *)"abcdef 12 xYz 3456";
+    Packet *p1 = UTHBuildPacket(buf1, (uint16_t)strlen((char *)buf1), IPPROTO_TCP);
+    FAIL_IF_NULL(p1);
+    Packet *p2 = UTHBuildPacket(buf2, (uint16_t)strlen((char *)buf2), IPPROTO_TCP);
+    FAIL_IF_NULL(p2);
+
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    memset(&th_v, 0, sizeof(th_v));
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->content_filter = true;
+
+    Signature *s = DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+                                                 "(content:\"abcdef\"; fast_pattern; "
+                                                 "content:\"XYZ\"; nocase; sid:1;)");
+    FAIL_IF_NULL(s);
+
+    SigGroupBuild(de_ctx);
+    FAIL_IF_NULL(s->content_filter);
+    FAIL_IF_NOT(s->content_filter->cnt == 2);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p1);
+    FAIL_IF(PacketAlertCheck(p1, 1));
+    /* the filter was evaluated on p1's payload and rejects it */
+    FAIL_IF_NOT(det_ctx->content_filter_buf == p1->payload);
+    FAIL_IF(DetectContentFilterCheck(det_ctx, s, p1->payload, p1->payload_len));
+
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p2);
+    FAIL_IF_NOT(PacketAlertCheck(p2, 1));
+    FAIL_IF_NOT(DetectContentFilterCheck(det_ctx, s, p2->payload, p2->payload_len));
+
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    UTHFreePacket(p1);
+    UTHFreePacket(p2);
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void PayloadRegisterTests(void)
@@ -1178,5 +1268,7 @@ void PayloadRegisterTests(void)
     UtRegisterTest("PayloadTestSig32", PayloadTestSig32);
     UtRegisterTest("PayloadTestSig33", PayloadTestSig33);
     UtRegisterTest("PayloadTestSig34", PayloadTestSig34);
+
+    UtRegisterTest("PayloadTestContentFilter01", PayloadTestContentFilter01);
 #endif /* UNITTESTS */
 }
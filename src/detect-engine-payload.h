@@ -38,6 +38,15 @@ uint8_t DetectEngineInspectStream(DetectEngineCtx *de_ctx, DetectEngineThreadCtx
         const struct DetectEngineAppInspectionEngine_ *engine, const Signature *s, Flow *f,
         uint8_t flags, void *alstate, void *txv, uint64_t tx_id);
 
+/** \brief map a bigram to its bit in the content filter map
+ *
+ *  Case is folded by setting 0x20 on both bytes, so nocase contents can use
+ *  the same map. Other collisions only weaken the filter. */
+static inline uint16_t DetectContentFilterBit(const uint8_t a, const uint8_t b)
+{
+    return (uint16_t)((((a | 0x20) << 4) ^ (b | 0x20)) & (DETECT_CONTENT_FILTER_MAP_BITS - 1));
+}
+
 void PayloadRegisterTests(void);
 
 #endif /* SURICATA_DETECT_ENGINE_PAYLOAD_H */
@@ -166,17 +166,12 @@ void SigGroupHeadFree(const DetectEngineCtx *de_ctx, SigGroupHead *sgh)
 
     SCLogDebug("sgh %p", sgh);
 
-    if (sgh->non_pf_other_store_array != NULL) {
-        SCFree(sgh->non_pf_other_store_array);
-        sgh->non_pf_other_store_array = NULL;
-        sgh->non_pf_other_store_cnt = 0;
-    }
-
-    if (sgh->non_pf_syn_store_array != NULL) {
-        SCFree(sgh->non_pf_syn_store_array);
-        sgh->non_pf_syn_store_array = NULL;
-        sgh->non_pf_syn_store_cnt = 0;
-    }
+    /* the non prefilter arrays are owned by
+     * DetectEngineCtx::non_pf_store_hash_table */
+    sgh->non_pf_other_store_array = NULL;
+    sgh->non_pf_other_store_cnt = 0;
+    sgh->non_pf_syn_store_array = NULL;
+    sgh->non_pf_syn_store_cnt = 0;
 
     if (sgh->init != NULL) {
         SigGroupHeadInitDataFree(sgh->init);
@@ -316,6 +311,187 @@ void SigGroupHeadHashFree(DetectEngineCtx *de_ctx)
     de_ctx->sgh_hash_table = NULL;
 }
 
+/** non prefilter array shared by all sgh's with the same array contents */
+typedef struct SigGroupHeadNonPrefilterArray_ {
+    SignatureNonPrefilterStore *array;
+    uint32_t cnt;
+    /** number of users. A sgh using the array for both its lists counts
+     *  twice. */
+    uint32_t refs;
+} SigGroupHeadNonPrefilterArray;
+
+static uint32_t NonPrefilterArrayHashFunc(HashListTable *ht, void *data, uint16_t datalen)
+{
+    const SigGroupHeadNonPrefilterArray *a = data;
+    uint32_t hash = a->cnt;
+
+    for (uint32_t i = 0; i < a->cnt; i++)
+        hash = hash * 31 + a->array[i].id;
+
+    return hash % ht->array_size;
+}
+
+static char NonPrefilterArrayCompareFunc(void *data1, uint16_t len1, void *data2, uint16_t len2)
+{
+    const SigGroupHeadNonPrefilterArray *a1 = data1;
+    const SigGroupHeadNonPrefilterArray *a2 = data2;
+
+    if (a1->cnt != a2->cnt)
+        return 0;
+
+    for (uint32_t i = 0; i < a1->cnt; i++) {
+        if (a1->array[i].id != a2->array[i].id || a1->array[i].mask != a2->array[i].mask ||
+                a1->array[i].alproto != a2->array[i].alproto)
+            return 0;
+    }
+    return 1;
+}
+
+static void NonPrefilterArrayFreeFunc(void *data)
+{
+    SigGroupHeadNonPrefilterArray *a = data;
+    SCFree(a->array);
+    SCFree(a);
+}
+
+/**
+ * \brief get the shared copy of a non prefilter array
+ *
+ * If an array with the same contents was stored before, \a array is freed
+ * and the stored one is returned. Otherwise \a array is stored.
+ *
+ * \retval array to use in the sgh, owned by the hash table
+ */
+static SignatureNonPrefilterStore *SigGroupHeadNonPrefilterArrayShare(
+        DetectEngineCtx *de_ctx, SignatureNonPrefilterStore *array, const uint32_t cnt)
+{
+    if (de_ctx->non_pf_store_hash_table == NULL) {
+        de_ctx->non_pf_store_hash_table = HashListTableInit(4096, NonPrefilterArrayHashFunc,
+                NonPrefilterArrayCompareFunc, NonPrefilterArrayFreeFunc);
+        BUG_ON(de_ctx->non_pf_store_hash_table == NULL);
+    }
+
+    SigGroupHeadNonPrefilterArray lookup = { .array = array, .cnt = cnt };
+    SigGroupHeadNonPrefilterArray *a =
+            HashListTableLookup(de_ctx->non_pf_store_hash_table, &lookup, 0);
+    if (a != NULL) {
+        if (a->array != array)
+            SCFree(array);
+        a->refs++;
+        return a->array;
+    }
+
+    a = SCCalloc(1, sizeof(*a));
+    BUG_ON(a == NULL);
+    a->array = array;
+    a->cnt = cnt;
+    a->refs = 1;
+    int r = HashListTableAdd(de_ctx->non_pf_store_hash_table, a, 0);
+    BUG_ON(r != 0);
+    return array;
+}
+
+static uint32_t NonPrefilterArrayRefs(
+        const DetectEngineCtx *de_ctx, SignatureNonPrefilterStore *array, const uint32_t cnt)
+{
+    if (de_ctx->non_pf_store_hash_table == NULL || array == NULL)
+        return 0;
+
+    SigGroupHeadNonPrefilterArray lookup = { .array = array, .cnt = cnt };
+    const SigGroupHeadNonPrefilterArray *a =
+            HashListTableLookup(de_ctx->non_pf_store_hash_table, &lookup, 0);
+    return a != NULL ? a->refs : 0;
+}
+
+/**
+ * \brief Frees the shared non prefilter arrays.
+ *
+ * \param de_ctx Pointer to the detection engine context.
+ */
+void SigGroupHeadNonPrefilterHashFree(DetectEngineCtx *de_ctx)
+{
+    if (de_ctx->non_pf_store_hash_table == NULL)
+        return;
+
+    HashListTableFree(de_ctx->non_pf_store_hash_table);
+    de_ctx->non_pf_store_hash_table = NULL;
+}
+
+static uint64_t PrefilterEnginesMemoryUse(const PrefilterEngine *e)
+{
+    uint64_t size = 0;
+    if (e == NULL)
+        return 0;
+    do {
+        size += sizeof(*e);
+    } while (!(e++)->is_last);
+    return size;
+}
+
+/**
+ * \brief get the memory used by the runtime part of a SigGroupHead
+ *
+ * Mpm contexts are not included as they are shared through the MpmStore.
+ *
+ * \param shared set to the part of the memory in non prefilter arrays that
+ *        is shared with other sgh's
+ */
+uint64_t SigGroupHeadMemoryUse(
+        const DetectEngineCtx *de_ctx, const SigGroupHead *sgh, uint64_t *shared)
+{
+    uint64_t size = sizeof(*sgh);
+    *shared = 0;
+
+    const uint64_t other = sgh->non_pf_other_store_cnt * sizeof(SignatureNonPrefilterStore);
+    const uint64_t syn = sgh->non_pf_syn_store_cnt * sizeof(SignatureNonPrefilterStore);
+    size += other;
+    if (NonPrefilterArrayRefs(de_ctx, sgh->non_pf_other_store_array,
+                sgh->non_pf_other_store_cnt) > 1)
+        *shared += other;
+    if (sgh->non_pf_syn_store_array != sgh->non_pf_other_store_array) {
+        size += syn;
+        if (NonPrefilterArrayRefs(de_ctx, sgh->non_pf_syn_store_array,
+                    sgh->non_pf_syn_store_cnt) > 1)
+            *shared += syn;
+    }
+
+    size += PrefilterEnginesMemoryUse(sgh->pkt_engines);
+    size += PrefilterEnginesMemoryUse(sgh->payload_engines);
+    size += PrefilterEnginesMemoryUse(sgh->tx_engines);
+    size += PrefilterEnginesMemoryUse(sgh->frame_engines);
+    return size;
+}
+
+/**
+ * \brief log the memory used by the rule groups and the savings from
+ *        sharing the non prefilter arrays
+ */
+void SigGroupHeadReportMemory(const DetectEngineCtx *de_ctx)
+{
+    uint64_t total = 0;
+    for (uint32_t idx = 0; idx < de_ctx->sgh_array_cnt; idx++) {
+        const SigGroupHead *sgh = de_ctx->sgh_array[idx];
+        if (sgh == NULL)
+            continue;
+        uint64_t shared;
+        total += SigGroupHeadMemoryUse(de_ctx, sgh, &shared);
+    }
+
+    uint32_t unique = 0;
+    uint64_t saved = 0;
+    if (de_ctx->non_pf_store_hash_table != NULL) {
+        for (HashListTableBucket *htb = HashListTableGetListHead(de_ctx->non_pf_store_hash_table);
+                htb != NULL; htb = HashListTableGetListNext(htb)) {
+            const SigGroupHeadNonPrefilterArray *a = HashListTableGetListData(htb);
+            unique++;
+            saved += (uint64_t)(a->refs - 1) * a->cnt * sizeof(SignatureNonPrefilterStore);
+        }
+    }
+    SCLogPerf("Rule groups use %" PRIu64 " bytes (excluding mpm), %u unique non-prefilter "
+              "arrays, %" PRIu64 " bytes saved by sharing them",
+            total, unique, saved);
+}
+
 /**
  * \brief Add a Signature to a SigGroupHead.
  *
@@ -692,6 +868,17 @@ int SigGroupHeadBuildNonPrefilterArray(DetectEngineCtx *de_ctx, SigGroupHead *sg
     if (max > de_ctx->non_pf_store_cnt_max)
         de_ctx->non_pf_store_cnt_max = max;
 
+    /* many sgh's end up with the same arrays, and without sigs that need
+     * SYN packets the two lists are the same too, so share them */
+    if (sgh->non_pf_other_store_array != NULL) {
+        sgh->non_pf_other_store_array = SigGroupHeadNonPrefilterArrayShare(
+                de_ctx, sgh->non_pf_other_store_array, sgh->non_pf_other_store_cnt);
+    }
+    if (sgh->non_pf_syn_store_array != NULL) {
+        sgh->non_pf_syn_store_array = SigGroupHeadNonPrefilterArrayShare(
+                de_ctx, sgh->non_pf_syn_store_array, sgh->non_pf_syn_store_cnt);
+    }
+
     return 0;
 }
 
@@ -1077,6 +1264,51 @@ static int SigGroupHeadTest06(void)
 
     PASS;
 }
+
+static const SigGroupHead *SigGroupHeadTestGetPortSgh(const DetectPort *list, const uint16_t port)
+{
+    for (; list != NULL; list = list->next) {
+        if (list->port <= port && port <= list->port2)
+            return list->sh;
+    }
+    return NULL;
+}
+
+/**
+ * \test sgh's with the same non prefilter sigs share their arrays
+ */
+static int SigGroupHeadTest07(void)
+{
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any 80 "
+                                               "(content:\"abc\"; sid:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any 443 "
+                                               "(content:\"def\"; sid:2;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any (sid:3;)"));
+    SigGroupBuild(de_ctx);
+
+    const SigGroupHead *sgh80 = SigGroupHeadTestGetPortSgh(de_ctx->flow_gh[1].tcp, 80);
+    const SigGroupHead *sgh443 = SigGroupHeadTestGetPortSgh(de_ctx->flow_gh[1].tcp, 443);
+    FAIL_IF_NULL(sgh80);
+    FAIL_IF_NULL(sgh443);
+    FAIL_IF(sgh80 == sgh443);
+
+    /* only sid 3 is not prefiltered in both groups */
+    FAIL_IF_NOT(sgh80->non_pf_other_store_cnt == 1);
+    FAIL_IF_NOT(sgh80->non_pf_other_store_array == sgh443->non_pf_other_store_array);
+    /* no sigs need SYN packets, so the lists are the same */
+    FAIL_IF_NOT(sgh80->non_pf_syn_store_array == sgh80->non_pf_other_store_array);
+
+    uint64_t shared = 0;
+    uint64_t total = SigGroupHeadMemoryUse(de_ctx, sgh80, &shared);
+    FAIL_IF_NOT(shared == sizeof(SignatureNonPrefilterStore));
+    FAIL_IF(total < sizeof(SigGroupHead) + shared);
+
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
 #endif
 
 void SigGroupHeadRegisterTests(void)
@@ -1088,5 +1320,6 @@ void SigGroupHeadRegisterTests(void)
     UtRegisterTest("SigGroupHeadTest04", SigGroupHeadTest04);
     UtRegisterTest("SigGroupHeadTest05", SigGroupHeadTest05);
     UtRegisterTest("SigGroupHeadTest06", SigGroupHeadTest06);
+    UtRegisterTest("SigGroupHeadTest07", SigGroupHeadTest07);
 #endif
 }
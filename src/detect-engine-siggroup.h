@@ -56,5 +56,9 @@ void SigGroupHeadStore(DetectEngineCtx *, SigGroupHead *);
 void SigGroupHeadSetupFiles(const DetectEngineCtx *de_ctx, SigGroupHead *sgh);
 
 int SigGroupHeadBuildNonPrefilterArray(DetectEngineCtx *de_ctx, SigGroupHead *sgh);
+void SigGroupHeadNonPrefilterHashFree(DetectEngineCtx *de_ctx);
+uint64_t SigGroupHeadMemoryUse(
+        const DetectEngineCtx *de_ctx, const SigGroupHead *sgh, uint64_t *shared);
+void SigGroupHeadReportMemory(const DetectEngineCtx *de_ctx);
 
 #endif /* SURICATA_DETECT_ENGINE_SIGGROUP_H */
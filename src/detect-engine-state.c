@@ -19,10 +19,10 @@
  * \defgroup sigstate State support
  *
  * State is stored in the ::DetectEngineState structure. This is
- * basically a container for storage item of type ::DeStateStore.
- * They contains an array of ::DeStateStoreItem which store the
+ * basically a container for a ::DetectEngineStateDirection per
+ * direction. They contain an array of ::DeStateStoreItem which store the
  * state of match for an individual signature identified by
- * DeStateStoreItem::sid.
+ * DeStateStoreItem::sid, sorted by sid.
  *
  * @{
  */
@@ -79,36 +79,116 @@ static inline int StateIsValid(uint16_t alproto, void *alstate)
     return 0;
 }
 
-static DeStateStore *DeStateStoreAlloc(void)
+/** freed item arrays of DE_STATE_STORE_MIN items are kept by the thread
+ *  for reuse by the next tx, up to DE_STATE_POOL_MAX of them. Only threads
+ *  that allocate stores keep a pool, so threads that only free txs, like
+ *  the flow recycler, don't collect arrays they never use. */
+#define DE_STATE_POOL_MAX 128
+
+typedef struct DeStatePoolItem_ {
+    struct DeStatePoolItem_ *next;
+} DeStatePoolItem;
+
+static thread_local DeStatePoolItem *de_state_pool = NULL;
+static thread_local uint32_t de_state_pool_cnt = 0;
+static thread_local bool de_state_pool_enabled = false;
+
+static DeStateStoreItem *DeStateItemsAlloc(void)
 {
-    DeStateStore *d = SCCalloc(1, sizeof(DeStateStore));
-    if (unlikely(d == NULL))
-        return NULL;
+    de_state_pool_enabled = true;
+    if (de_state_pool != NULL) {
+        DeStatePoolItem *p = de_state_pool;
+        de_state_pool = p->next;
+        de_state_pool_cnt--;
+        return (DeStateStoreItem *)p;
+    }
+    return SCMalloc(DE_STATE_STORE_MIN * sizeof(DeStateStoreItem));
+}
 
-    return d;
+static void DeStateItemsFree(DeStateStoreItem *items, const SigIntId size)
+{
+    if (items == NULL)
+        return;
+    if (size == DE_STATE_STORE_MIN && de_state_pool_enabled &&
+            de_state_pool_cnt < DE_STATE_POOL_MAX) {
+        DeStatePoolItem *p = (DeStatePoolItem *)items;
+        p->next = de_state_pool;
+        de_state_pool = p;
+        de_state_pool_cnt++;
+        return;
+    }
+    SCFree(items);
+}
+
+/** \brief free the calling thread's pool of item arrays */
+void DetectEngineStateThreadCleanup(void)
+{
+    while (de_state_pool != NULL) {
+        DeStatePoolItem *p = de_state_pool;
+        de_state_pool = p->next;
+        SCFree(p);
+    }
+    de_state_pool_cnt = 0;
+    de_state_pool_enabled = false;
+}
+
+static int DeStateItemCompare(const void *a, const void *b)
+{
+    const DeStateStoreItem *i0 = a;
+    const DeStateStoreItem *i1 = b;
+    if (i0->sid == i1->sid)
+        return 0;
+    return i0->sid > i1->sid ? 1 : -1;
+}
+
+/**
+ * \brief sort the items appended since the last call into the store
+ *
+ * Sigs are inspected in ascending order, so the appended items are usually
+ * in order already and only need sorting if they interleave with the
+ * older ones. Must not be called while item indexes are in use.
+ */
+void DeStateStoreSort(DetectEngineStateDirection *dir_state)
+{
+    if (dir_state->sorted_cnt == dir_state->cnt)
+        return;
+
+    bool sorted = true;
+    for (SigIntId i = MAX(dir_state->sorted_cnt, 1); i < dir_state->cnt; i++) {
+        if (dir_state->items[i - 1].sid > dir_state->items[i].sid) {
+            sorted = false;
+            break;
+        }
+    }
+    if (!sorted) {
+        qsort(dir_state->items, dir_state->cnt, sizeof(DeStateStoreItem), DeStateItemCompare);
+    }
+    dir_state->sorted_cnt = dir_state->cnt;
 }
 
 #ifdef DEBUG_VALIDATION
 static int DeStateSearchState(DetectEngineState *state, uint8_t direction, SigIntId num)
 {
     DetectEngineStateDirection *dir_state = &state->dir_state[direction & STREAM_TOSERVER ? 0 : 1];
-    DeStateStore *tx_store = dir_state->head;
-    SigIntId store_cnt;
-    SigIntId state_cnt = 0;
-
-    for (; tx_store != NULL; tx_store = tx_store->next) {
-        SCLogDebug("tx_store %p", tx_store);
-        for (store_cnt = 0;
-             store_cnt < DE_STATE_CHUNK_SIZE && state_cnt < dir_state->cnt;
-             store_cnt++, state_cnt++)
-        {
-            DeStateStoreItem *item = &tx_store->store[store_cnt];
-            if (item->sid == num) {
-                SCLogDebug("sid %u already in state: %p %p %p %u %u, direction %s",
-                            num, state, dir_state, tx_store, state_cnt,
-                            store_cnt, direction & STREAM_TOSERVER ? "toserver" : "toclient");
-                return 1;
-            }
+
+    /* binary search the sorted part */
+    SigIntId lo = 0;
+    SigIntId hi = dir_state->sorted_cnt;
+    while (lo < hi) {
+        const SigIntId mid = lo + (hi - lo) / 2;
+        if (dir_state->items[mid].sid < num)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < dir_state->sorted_cnt && dir_state->items[lo].sid == num)
+        return 1;
+
+    for (SigIntId i = dir_state->sorted_cnt; i < dir_state->cnt; i++) {
+        if (dir_state->items[i].sid == num) {
+            SCLogDebug("sid %u already in state: %p %p %u, direction %s", num, state, dir_state,
+                    i, direction & STREAM_TOSERVER ? "toserver" : "toclient");
+            return 1;
         }
     }
     return 0;
@@ -126,33 +206,25 @@ static void DeStateSignatureAppend(DetectEngineState *state,
 #ifdef DEBUG_VALIDATION
     BUG_ON(DeStateSearchState(state, direction, s->num));
 #endif
-    DeStateStore *store = dir_state->tail;
-    if (store == NULL) {
-        store = DeStateStoreAlloc();
-        dir_state->head = store;
-        dir_state->cur = store;
-        dir_state->tail = store;
-    } else if (dir_state->cur) {
-        store = dir_state->cur;
-    } else {
-        store = DeStateStoreAlloc();
-        if (store != NULL) {
-            dir_state->tail->next = store;
-            dir_state->tail = store;
-            dir_state->cur = store;
+    if (dir_state->cnt == dir_state->size) {
+        DeStateStoreItem *items;
+        SigIntId size;
+        if (dir_state->items == NULL) {
+            size = DE_STATE_STORE_MIN;
+            items = DeStateItemsAlloc();
+        } else {
+            size = dir_state->size * 2;
+            items = SCRealloc(dir_state->items, size * sizeof(DeStateStoreItem));
         }
+        if (items == NULL)
+            SCReturn;
+        dir_state->items = items;
+        dir_state->size = size;
     }
-    if (store == NULL)
-        SCReturn;
-
-    SigIntId idx = dir_state->cnt % DE_STATE_CHUNK_SIZE;
-    store->store[idx].sid = s->num;
-    store->store[idx].flags = inspect_flags;
-    dir_state->cnt++;
-    /* if current chunk is full, progress cur */
-    if (dir_state->cnt % DE_STATE_CHUNK_SIZE == 0) {
-        dir_state->cur = dir_state->cur->next;
-    }
+
+    DeStateStoreItem *item = &dir_state->items[dir_state->cnt++];
+    item->sid = s->num;
+    item->flags = inspect_flags;
 
     SCReturn;
 }
@@ -168,17 +240,8 @@ DetectEngineState *DetectEngineStateAlloc(void)
 
 void DetectEngineStateFree(DetectEngineState *state)
 {
-    DeStateStore *store;
-    DeStateStore *store_next;
-    int i = 0;
-
-    for (i = 0; i < 2; i++) {
-        store = state->dir_state[i].head;
-        while (store != NULL) {
-            store_next = store->next;
-            SCFree(store);
-            store = store_next;
-        }
+    for (int i = 0; i < 2; i++) {
+        DeStateItemsFree(state->dir_state[i].items, state->dir_state[i].size);
     }
     SCFree(state);
 }
@@ -239,17 +302,16 @@ void DetectRunStoreStateTx(
 static inline void ResetTxState(DetectEngineState *s)
 {
     if (s) {
+        /* keep the item arrays for reuse */
         s->dir_state[0].cnt = 0;
+        s->dir_state[0].sorted_cnt = 0;
         s->dir_state[0].filestore_cnt = 0;
         s->dir_state[0].flags = 0;
-        /* reset 'cur' back to the list head */
-        s->dir_state[0].cur = s->dir_state[0].head;
 
         s->dir_state[1].cnt = 0;
+        s->dir_state[1].sorted_cnt = 0;
         s->dir_state[1].filestore_cnt = 0;
         s->dir_state[1].flags = 0;
-        /* reset 'cur' back to the list head */
-        s->dir_state[1].cur = s->dir_state[1].head;
     }
 }
 
@@ -292,8 +354,8 @@ static int DeStateTest01(void)
 {
     SCLogDebug("sizeof(DetectEngineState)\t\t%"PRIuMAX,
             (uintmax_t)sizeof(DetectEngineState));
-    SCLogDebug("sizeof(DeStateStore)\t\t\t%"PRIuMAX,
-            (uintmax_t)sizeof(DeStateStore));
+    SCLogDebug("sizeof(DetectEngineStateDirection)\t%"PRIuMAX,
+            (uintmax_t)sizeof(DetectEngineStateDirection));
     SCLogDebug("sizeof(DeStateStoreItem)\t\t%"PRIuMAX"",
             (uintmax_t)sizeof(DeStateStoreItem));
 
@@ -305,148 +367,114 @@ static int DeStateTest02(void)
     uint8_t direction = STREAM_TOSERVER;
     DetectEngineState *state = DetectEngineStateAlloc();
     FAIL_IF_NULL(state);
-    FAIL_IF_NOT_NULL(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head);
+    DetectEngineStateDirection *dir_state = &state->dir_state[direction & STREAM_TOSERVER ? 0 : 1];
+    FAIL_IF_NOT_NULL(dir_state->items);
 
     Signature s;
     memset(&s, 0x00, sizeof(s));
 
-    s.num = 0;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 11;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 22;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 33;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 44;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 55;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 66;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 77;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 88;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 99;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 100;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 111;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 122;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 133;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    FAIL_IF_NOT(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head ==
-                state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].cur);
-
-    s.num = 144;
-    DeStateSignatureAppend(state, &s, 0, direction);
-
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[14].sid != 144);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head ==
-            state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].cur);
-    FAIL_IF_NOT(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].cur == NULL);
-
-    s.num = 155;
-    DeStateSignatureAppend(state, &s, 0, direction);
+    for (int r = 0; r < 2; r++) {
+        for (SigIntId i = 0; i < DE_STATE_STORE_MIN; i++) {
+            s.num = i * 11;
+            DeStateSignatureAppend(state, &s, 0, direction);
+        }
+        FAIL_IF_NOT(dir_state->cnt == DE_STATE_STORE_MIN);
+        FAIL_IF_NOT(dir_state->size == (r == 0 ? DE_STATE_STORE_MIN : DE_STATE_STORE_MIN * 2));
+
+        s.num = 1000;
+        DeStateSignatureAppend(state, &s, 0, direction);
+        s.num = 1011;
+        DeStateSignatureAppend(state, &s, 0, direction);
+
+        FAIL_IF_NOT(dir_state->cnt == DE_STATE_STORE_MIN + 2);
+        FAIL_IF_NOT(dir_state->size == DE_STATE_STORE_MIN * 2);
+        FAIL_IF(dir_state->items[1].sid != 11);
+        FAIL_IF(dir_state->items[DE_STATE_STORE_MIN - 1].sid != (DE_STATE_STORE_MIN - 1) * 11);
+        FAIL_IF(dir_state->items[DE_STATE_STORE_MIN].sid != 1000);
+        FAIL_IF(dir_state->items[DE_STATE_STORE_MIN + 1].sid != 1011);
+
+        /* reset keeps the array */
+        ResetTxState(state);
+        FAIL_IF_NULL(dir_state->items);
+        FAIL_IF_NOT(dir_state->cnt == 0);
+    }
 
-    FAIL_IF_NOT(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].tail ==
-                state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].cur);
+    DetectEngineStateFree(state);
 
-    s.num = 166;
-    DeStateSignatureAppend(state, &s, 0, direction);
+    PASS;
+}
 
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head == NULL);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[1].sid != 11);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next == NULL);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[14].sid != 144);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next->store[0].sid != 155);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next->store[1].sid != 166);
+static int DeStateTest03(void)
+{
+    DetectEngineState *state = DetectEngineStateAlloc();
+    FAIL_IF_NULL(state);
 
-    ResetTxState(state);
+    Signature s;
+    memset(&s, 0x00, sizeof(s));
 
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head == NULL);
-    FAIL_IF_NOT(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head ==
-                state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].cur);
+    uint8_t direction = STREAM_TOSERVER;
 
-    s.num = 0;
-    DeStateSignatureAppend(state, &s, 0, direction);
     s.num = 11;
     DeStateSignatureAppend(state, &s, 0, direction);
     s.num = 22;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 33;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 44;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 55;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 66;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 77;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 88;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 99;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 100;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 111;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 122;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 133;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    FAIL_IF_NOT(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head ==
-                state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].cur);
-    s.num = 144;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[14].sid != 144);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head ==
-            state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].cur);
-    FAIL_IF_NOT(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].tail ==
-                state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].cur);
-    s.num = 155;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 166;
-    DeStateSignatureAppend(state, &s, 0, direction);
+    DeStateSignatureAppend(state, &s, BIT_U32(DE_STATE_FLAG_BASE), direction);
 
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head == NULL);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[1].sid != 11);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next == NULL);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[14].sid != 144);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next->store[0].sid != 155);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next->store[1].sid != 166);
+    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].items == NULL);
+    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].items[0].sid != 11);
+    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].items[0].flags & BIT_U32(DE_STATE_FLAG_BASE));
+    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].items[1].sid != 22);
+    FAIL_IF(!(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].items[1].flags & BIT_U32(DE_STATE_FLAG_BASE)));
 
     DetectEngineStateFree(state);
-
     PASS;
 }
 
-static int DeStateTest03(void)
+/** \test sorting appended items into the store */
+static int DeStateTest04(void)
 {
     DetectEngineState *state = DetectEngineStateAlloc();
     FAIL_IF_NULL(state);
+    DetectEngineStateDirection *dir_state = &state->dir_state[1];
 
     Signature s;
     memset(&s, 0x00, sizeof(s));
 
-    uint8_t direction = STREAM_TOSERVER;
-
-    s.num = 11;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 22;
-    DeStateSignatureAppend(state, &s, BIT_U32(DE_STATE_FLAG_BASE), direction);
-
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head == NULL);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[0].sid != 11);
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[0].flags & BIT_U32(DE_STATE_FLAG_BASE));
-    FAIL_IF(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[1].sid != 22);
-    FAIL_IF(!(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[1].flags & BIT_U32(DE_STATE_FLAG_BASE)));
+    /* ascending appends are sorted as is */
+    const SigIntId first[] = { 5, 20, 40 };
+    for (size_t i = 0; i < ARRAY_SIZE(first); i++) {
+        s.num = first[i];
+        DeStateSignatureAppend(state, &s, (uint32_t)i, STREAM_TOCLIENT);
+    }
+    DeStateStoreSort(dir_state);
+    FAIL_IF_NOT(dir_state->sorted_cnt == 3);
+    FAIL_IF_NOT(dir_state->items[0].sid == 5 && dir_state->items[2].sid == 40);
+
+    /* appends that interleave with the stored sigs */
+    const SigIntId second[] = { 1, 30, 50 };
+    for (size_t i = 0; i < ARRAY_SIZE(second); i++) {
+        s.num = second[i];
+        DeStateSignatureAppend(state, &s, 10 + (uint32_t)i, STREAM_TOCLIENT);
+    }
+    FAIL_IF_NOT(dir_state->sorted_cnt == 3);
+    DeStateStoreSort(dir_state);
+    FAIL_IF_NOT(dir_state->sorted_cnt == 6);
+
+    const SigIntId sids[] = { 1, 5, 20, 30, 40, 50 };
+    const uint32_t flags[] = { 10, 0, 1, 11, 2, 12 };
+    for (size_t i = 0; i < ARRAY_SIZE(sids); i++) {
+        FAIL_IF_NOT(dir_state->items[i].sid == sids[i]);
+        FAIL_IF_NOT(dir_state->items[i].flags == flags[i]);
+    }
 
+    /* the freed array is reused by the next store */
+    DeStateStoreItem *items = dir_state->items;
+    DetectEngineStateFree(state);
+    state = DetectEngineStateAlloc();
+    FAIL_IF_NULL(state);
+    DeStateSignatureAppend(state, &s, 0, STREAM_TOSERVER);
+    FAIL_IF_NOT(state->dir_state[0].items == items);
     DetectEngineStateFree(state);
+    DetectEngineStateThreadCleanup();
     PASS;
 }
 
@@ -614,7 +642,7 @@ static int DeStateSigTest02(void)
     FAIL_IF(tx_de_state->dir_state[0].cnt != 1);
     /* http_header(mpm): 5, uri: 3, method: 6, cookie: 7 */
     uint32_t expected_flags = (BIT_U32(5) | BIT_U32(3) | BIT_U32(6) | BIT_U32(4));
-    FAIL_IF(tx_de_state->dir_state[0].head->store[0].flags != expected_flags);
+    FAIL_IF(tx_de_state->dir_state[0].items[0].flags != expected_flags);
 
     r = AppLayerParserParse(NULL, alp_tctx, &f, ALPROTO_HTTP1, STREAM_TOSERVER, httpbuf4, httplen4);
     FAIL_IF(r != 0);
@@ -1443,6 +1471,7 @@ void DeStateRegisterTests(void)
     UtRegisterTest("DeStateTest01", DeStateTest01);
     UtRegisterTest("DeStateTest02", DeStateTest02);
     UtRegisterTest("DeStateTest03", DeStateTest03);
+    UtRegisterTest("DeStateTest04", DeStateTest04);
     UtRegisterTest("DeStateSigTest01", DeStateSigTest01);
     UtRegisterTest("DeStateSigTest02", DeStateSigTest02);
     UtRegisterTest("DeStateSigTest03", DeStateSigTest03);
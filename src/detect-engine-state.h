@@ -48,8 +48,11 @@
  *  more files that have ongoing inspection. */
 #define DETECT_ENGINE_INSPECT_SIG_MATCH_MORE_FILES 4
 
-/** number of DeStateStoreItem's in one DeStateStore object */
-#define DE_STATE_CHUNK_SIZE             15
+/** initial number of DeStateStoreItem's in a direction's store */
+#define DE_STATE_STORE_MIN              16
+
+/** RuleMatchCandidateTx::state_idx value for sigs without stored state */
+#define DE_STATE_IDX_NONE               UINT32_MAX
 
 /* per sig flags */
 #define DE_STATE_FLAG_FULL_INSPECT              BIT_U32(0)
@@ -74,16 +77,13 @@ typedef struct DeStateStoreItem_ {
     SigIntId sid;
 } DeStateStoreItem;
 
-typedef struct DeStateStore_ {
-    DeStateStoreItem store[DE_STATE_CHUNK_SIZE];
-    struct DeStateStore_ *next;
-} DeStateStore;
-
 typedef struct DetectEngineStateDirection_ {
-    DeStateStore *head; /**< head of the list */
-    DeStateStore *cur;  /**< current active store */
-    DeStateStore *tail; /**< tail of the list */
+    /** stored sigs. The first sorted_cnt are sorted by sid, the ones after
+     *  that were appended since the last DeStateStoreSort call. */
+    DeStateStoreItem *items;
     SigIntId cnt;
+    SigIntId size;       /**< number of allocated items */
+    SigIntId sorted_cnt;
     uint16_t filestore_cnt;
     uint8_t flags;
     /* coccinelle: DetectEngineStateDirection:flags:DETECT_ENGINE_STATE_FLAG_ */
@@ -107,6 +107,9 @@ DetectEngineState *DetectEngineStateAlloc(void);
  */
 void DetectEngineStateFree(DetectEngineState *state);
 
+void DeStateStoreSort(DetectEngineStateDirection *dir_state);
+void DetectEngineStateThreadCleanup(void);
+
 #endif /* SURICATA_DETECT_ENGINE_STATE_H */
 
 /**
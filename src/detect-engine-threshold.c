@@ -58,6 +58,13 @@
 
 struct Thresholds {
     THashTableContext *thash;
+    /** approximate mode: workers count hits locally and merge them into
+     *  thash in batches */
+    bool approximate;
+    /** max hits a worker holds back per entry */
+    uint32_t max_pending;
+    /** max seconds between merges of an entry */
+    uint32_t sync_interval;
 } ctx;
 
 static int ThresholdsInit(struct Thresholds *t);
@@ -213,6 +220,36 @@ static int ThresholdsInit(struct Thresholds *t)
         hashsize = (uint32_t)value;
     }
 
+    t->approximate = false;
+    int approximate = 0;
+    if (ConfGetBool("detect.thresholds.approximate.enabled", &approximate) == 1 && approximate) {
+        t->approximate = true;
+        t->max_pending = 16;
+        t->sync_interval = 1;
+
+        if (ConfGetInt("detect.thresholds.approximate.max-pending", &value) == 1) {
+            if (value < 1 || value > UINT16_MAX) {
+                SCLogError("'detect.thresholds.approximate.max-pending' value %" PRIiMAX
+                           " out of range. Valid range 1-65535.",
+                        value);
+                return -1;
+            }
+            t->max_pending = (uint32_t)value;
+        }
+        if (ConfGetInt("detect.thresholds.approximate.sync-interval", &value) == 1) {
+            if (value < 1 || value > 3600) {
+                SCLogError("'detect.thresholds.approximate.sync-interval' value %" PRIiMAX
+                           " out of range. Valid range 1-3600.",
+                        value);
+                return -1;
+            }
+            t->sync_interval = (uint32_t)value;
+        }
+        SCLogConfig("thresholds: approximate mode, workers hold back up to %u hits per "
+                    "entry for at most %us",
+                t->max_pending, t->sync_interval);
+    }
+
     t->thash = THashInit("thresholds", sizeof(ThresholdEntry), ThresholdEntrySet,
             ThresholdEntryFree, ThresholdEntryHash, ThresholdEntryCompare, ThresholdEntryExpire,
             NULL, 0, memcap, hashsize);
@@ -235,6 +272,59 @@ uint32_t ThresholdsExpire(const SCTime_t ts)
     return THashExpire(ctx.thash, ts);
 }
 
+bool ThresholdsApproximate(void)
+{
+    return ctx.approximate;
+}
+
+/** protects DetectEngineCtx::threshold_merges */
+static SCMutex threshold_merges_lock = SCMUTEX_INITIALIZER;
+
+/** \brief set up the per rule merge counts of a detect thread */
+void ThresholdsThreadInit(DetectEngineThreadCtx *det_ctx)
+{
+    if (!ctx.approximate || det_ctx->de_ctx->sig_array_len == 0)
+        return;
+
+    det_ctx->threshold_merges = SCCalloc(det_ctx->de_ctx->sig_array_len, sizeof(uint64_t));
+}
+
+/** \brief add the merge counts of a detect thread to its detect engine */
+void ThresholdsThreadCleanup(DetectEngineThreadCtx *det_ctx)
+{
+    if (det_ctx->threshold_merges == NULL)
+        return;
+
+    DetectEngineCtx *de_ctx = det_ctx->de_ctx;
+    SCMutexLock(&threshold_merges_lock);
+    if (de_ctx->threshold_merges == NULL) {
+        de_ctx->threshold_merges = SCCalloc(de_ctx->sig_array_len, sizeof(uint64_t));
+    }
+    if (de_ctx->threshold_merges != NULL) {
+        for (uint32_t i = 0; i < de_ctx->sig_array_len; i++) {
+            de_ctx->threshold_merges[i] += det_ctx->threshold_merges[i];
+        }
+    }
+    SCMutexUnlock(&threshold_merges_lock);
+
+    SCFree(det_ctx->threshold_merges);
+    det_ctx->threshold_merges = NULL;
+}
+
+/** \brief log the approximate mode merge counts per rule */
+void ThresholdsLogMerges(const DetectEngineCtx *de_ctx)
+{
+    if (de_ctx->threshold_merges == NULL)
+        return;
+
+    for (const Signature *s = de_ctx->sig_list; s != NULL; s = s->next) {
+        if (de_ctx->threshold_merges[s->num] > 0) {
+            SCLogPerf("rule %u:%u:%u: %" PRIu64 " threshold merges", s->gid, s->id, s->rev,
+                    de_ctx->threshold_merges[s->num]);
+        }
+    }
+}
+
 #define TC_ADDRESS 0
 #define TC_SID     1
 #define TC_GID     2
@@ -451,6 +541,126 @@ static int CheckCache(const Packet *p, const int8_t track, const uint32_t sid, c
     return -1; // cache miss - not found
 }
 
+/* approximate mode: thread local hit counts */
+
+typedef struct ThresholdLocalEntry_ {
+    /** key of the global entry */
+    ThresholdEntry key;
+    /** hits not merged into the global entry yet */
+    uint32_t pending;
+    /** count of the global entry at the last merge */
+    uint32_t count;
+    /** result of every hit until window_end, -1 if not fixed */
+    int ret;
+    /** end of the global entry's window, or of its rate_filter timeout */
+    SCTime_t window_end;
+    /** time of the last merge */
+    SCTime_t synced;
+    struct ThresholdLocalEntry_ *next;
+} ThresholdLocalEntry;
+
+/** max entries per thread, hits for other entries go to the global hash
+ *  directly */
+#define THRESHOLD_LOCAL_MAX 65536
+
+static thread_local HashTable *threshold_local_ht = NULL;
+/** all entries, for housekeeping */
+static thread_local ThresholdLocalEntry *threshold_local_list = NULL;
+static thread_local uint32_t threshold_local_cnt = 0;
+static thread_local uint64_t threshold_local_housekeeping_ts = 0;
+
+static uint32_t ThresholdLocalHashFunc(HashTable *ht, void *data, uint16_t datalen)
+{
+    ThresholdLocalEntry *e = data;
+    return ThresholdEntryHash(0, &e->key) % ht->array_size;
+}
+
+static char ThresholdLocalHashCompareFunc(
+        void *data1, uint16_t datalen1, void *data2, uint16_t datalen2)
+{
+    ThresholdLocalEntry *e1 = data1;
+    ThresholdLocalEntry *e2 = data2;
+    return ThresholdEntryCompare(&e1->key, &e2->key);
+}
+
+static void ThresholdLocalHashFreeFunc(void *data)
+{
+    SCFree(data);
+}
+
+/** \internal
+ *  \brief add hits a thread counted locally to a global entry
+ *
+ *  Hits from a window that already ended are dropped, like the window's
+ *  own count is reset by the next hit. While a rate_filter's new action is
+ *  active the count isn't used. */
+static void ThresholdAddPending(ThresholdEntry *te, const SCTime_t ts, const uint32_t pending)
+{
+    if (te->tv_timeout != 0)
+        return;
+    if (SCTIME_CMP_GT(ts, SCTIME_ADD_SECS(te->tv1, te->seconds)))
+        return;
+    if (UINT32_MAX - te->current_count < pending) {
+        te->current_count = UINT32_MAX;
+    } else {
+        te->current_count += pending;
+    }
+}
+
+static ThresholdLocalEntry *ThresholdLocalAdd(const ThresholdEntry *key)
+{
+    if (threshold_local_ht == NULL) {
+        threshold_local_ht = HashTableInit(4096, ThresholdLocalHashFunc,
+                ThresholdLocalHashCompareFunc, ThresholdLocalHashFreeFunc);
+        if (threshold_local_ht == NULL)
+            return NULL;
+    }
+    if (threshold_local_cnt >= THRESHOLD_LOCAL_MAX)
+        return NULL;
+
+    ThresholdLocalEntry *le = SCCalloc(1, sizeof(*le));
+    if (le == NULL)
+        return NULL;
+    le->key = *key;
+    if (HashTableAdd(threshold_local_ht, le, 0) != 0) {
+        SCFree(le);
+        return NULL;
+    }
+    le->next = threshold_local_list;
+    threshold_local_list = le;
+    threshold_local_cnt++;
+    return le;
+}
+
+/** \internal
+ *  \brief merge and remove the entries that weren't merged for
+ *         sync_interval seconds */
+static void ThresholdLocalExpire(const struct Thresholds *tctx, const SCTime_t now)
+{
+    threshold_local_housekeeping_ts = SCTIME_SECS(now);
+
+    ThresholdLocalEntry **pe = &threshold_local_list;
+    while (*pe != NULL) {
+        ThresholdLocalEntry *le = *pe;
+        if (SCTIME_SECS(now) < SCTIME_SECS(le->synced) + tctx->sync_interval) {
+            pe = &le->next;
+            continue;
+        }
+
+        if (le->pending > 0) {
+            THashData *h = THashLookupFromHash(tctx->thash, &le->key);
+            if (h != NULL) {
+                ThresholdAddPending(h->data, now, le->pending);
+                (void)THashDecrUsecnt(h);
+                THashDataUnlock(h);
+            }
+        }
+        *pe = le->next;
+        threshold_local_cnt--;
+        HashTableRemove(threshold_local_ht, le, 0);
+    }
+}
+
 void ThresholdCacheThreadFree(void)
 {
     if (threshold_cache_ht) {
@@ -459,6 +669,15 @@ void ThresholdCacheThreadFree(void)
     }
     RB_INIT(&threshold_cache_tree);
     DumpCacheStats();
+
+    /* hits still held back are lost, which is within the bounds of the
+     * approximate mode */
+    if (threshold_local_ht) {
+        HashTableFree(threshold_local_ht);
+        threshold_local_ht = NULL;
+    }
+    threshold_local_list = NULL;
+    threshold_local_cnt = 0;
 }
 
 /**
@@ -844,47 +1063,53 @@ static int ThresholdCheckUpdate(const DetectThresholdData *td, ThresholdEntry *t
     return ret;
 }
 
-static int ThresholdGetFromHash(struct Thresholds *tctx, const Packet *p, const Signature *s,
-        const DetectThresholdData *td, PacketAlert *pa)
+static void ThresholdBuildKey(ThresholdEntry *lookup, const Packet *p, const Signature *s,
+        const DetectThresholdData *td)
 {
-    /* fast track for count 1 threshold */
-    if (td->count == 1 && td->type == TYPE_THRESHOLD) {
-        return 1;
-    }
-
-    ThresholdEntry lookup;
-    memset(&lookup, 0, sizeof(lookup));
-    lookup.key[SID] = s->id;
-    lookup.key[GID] = s->gid;
-    lookup.key[REV] = s->rev;
-    lookup.key[TRACK] = td->track;
-    lookup.key[TENANT] = p->tenant_id;
+    memset(lookup, 0, sizeof(*lookup));
+    lookup->key[SID] = s->id;
+    lookup->key[GID] = s->gid;
+    lookup->key[REV] = s->rev;
+    lookup->key[TRACK] = td->track;
+    lookup->key[TENANT] = p->tenant_id;
     if (td->track == TRACK_SRC) {
-        COPY_ADDRESS(&p->src, &lookup.addr);
+        COPY_ADDRESS(&p->src, &lookup->addr);
     } else if (td->track == TRACK_DST) {
-        COPY_ADDRESS(&p->dst, &lookup.addr);
+        COPY_ADDRESS(&p->dst, &lookup->addr);
     } else if (td->track == TRACK_BOTH) {
         /* make sure lower ip address is first */
         if (PacketIsIPv4(p)) {
             if (SCNtohl(p->src.addr_data32[0]) < SCNtohl(p->dst.addr_data32[0])) {
-                COPY_ADDRESS(&p->src, &lookup.addr);
-                COPY_ADDRESS(&p->dst, &lookup.addr2);
+                COPY_ADDRESS(&p->src, &lookup->addr);
+                COPY_ADDRESS(&p->dst, &lookup->addr2);
             } else {
-                COPY_ADDRESS(&p->dst, &lookup.addr);
-                COPY_ADDRESS(&p->src, &lookup.addr2);
+                COPY_ADDRESS(&p->dst, &lookup->addr);
+                COPY_ADDRESS(&p->src, &lookup->addr2);
             }
         } else {
             if (AddressIPv6Lt(&p->src, &p->dst)) {
-                COPY_ADDRESS(&p->src, &lookup.addr);
-                COPY_ADDRESS(&p->dst, &lookup.addr2);
+                COPY_ADDRESS(&p->src, &lookup->addr);
+                COPY_ADDRESS(&p->dst, &lookup->addr2);
             } else {
-                COPY_ADDRESS(&p->dst, &lookup.addr);
-                COPY_ADDRESS(&p->src, &lookup.addr2);
+                COPY_ADDRESS(&p->dst, &lookup->addr);
+                COPY_ADDRESS(&p->src, &lookup->addr2);
             }
         }
     }
+}
 
-    struct THashDataGetResult res = THashGetFromHash(tctx->thash, &lookup);
+/** \internal
+ *  \brief update the global entry for a hit
+ *
+ *  \param pending hits counted locally since the last merge
+ *  \param snap if not NULL, gets a copy of the entry after the update
+ *  \param found if not NULL, set to true if the entry was updated
+ */
+static int ThresholdUpdateHash(struct Thresholds *tctx, ThresholdEntry *lookup, const Packet *p,
+        const Signature *s, const DetectThresholdData *td, PacketAlert *pa, const uint32_t pending,
+        ThresholdEntry *snap, bool *found)
+{
+    struct THashDataGetResult res = THashGetFromHash(tctx->thash, lookup);
     if (res.data) {
         SCLogDebug("found %p, is_new %s", res.data, BOOL2STR(res.is_new));
         int r;
@@ -893,9 +1118,15 @@ static int ThresholdGetFromHash(struct Thresholds *tctx, const Packet *p, const
             // new threshold, set up
             r = ThresholdSetup(td, te, p->ts, s->id, s->gid, s->rev, p->tenant_id);
         } else {
+            if (pending > 0)
+                ThresholdAddPending(te, p->ts, pending);
             // existing, check/update
             r = ThresholdCheckUpdate(td, te, p, s->id, s->gid, s->rev, pa);
         }
+        if (snap != NULL)
+            *snap = *te;
+        if (found != NULL)
+            *found = true;
 
         (void)THashDecrUsecnt(res.data);
         THashDataUnlock(res.data);
@@ -904,6 +1135,125 @@ static int ThresholdGetFromHash(struct Thresholds *tctx, const Packet *p, const
     return 0; // TODO error?
 }
 
+static int ThresholdGetFromHash(struct Thresholds *tctx, const Packet *p, const Signature *s,
+        const DetectThresholdData *td, PacketAlert *pa)
+{
+    /* fast track for count 1 threshold */
+    if (td->count == 1 && td->type == TYPE_THRESHOLD) {
+        return 1;
+    }
+
+    ThresholdEntry lookup;
+    ThresholdBuildKey(&lookup, p, s, td);
+    return ThresholdUpdateHash(tctx, &lookup, p, s, td, pa, 0, NULL, NULL);
+}
+
+/** \internal
+ *  \brief get the result that all hits get for the rest of the window
+ *
+ *  \param end set to the end of the window
+ *
+ *  \retval ret fixed result or -1 if the result can still change
+ */
+static int ThresholdFixedResult(
+        const DetectThresholdData *td, const ThresholdEntry *te, SCTime_t *end)
+{
+    *end = SCTIME_ADD_SECS(te->tv1, td->seconds);
+    switch (td->type) {
+        case TYPE_LIMIT:
+            if (te->current_count > td->count)
+                return 2;
+            break;
+        case TYPE_DETECTION:
+            if (te->current_count > td->count)
+                return 1;
+            break;
+        case TYPE_RATE:
+            if (te->tv_timeout != 0) {
+                *end = SCTIME_FROM_SECS((uint64_t)te->tv_timeout + td->timeout);
+                return 1;
+            }
+            break;
+    }
+    return -1;
+}
+
+/** \internal
+ *  \brief handle a hit in approximate mode
+ *
+ *  Hits are counted in a thread local entry and only merged into the
+ *  global entry when the count gets close to the rule's count, when
+ *  max_pending hits were held back or after sync_interval seconds. Once
+ *  the result is fixed for the rest of a window, as for a limit that was
+ *  reached, hits are answered locally until the window ends.
+ *
+ *  Below the count the result doesn't depend on the count, so a single
+ *  worker gets the same results as in exact mode. With more workers a
+ *  state change can be seen late by up to the hits held back by the
+ *  others: (workers - 1) * max_pending.
+ */
+static int ThresholdHandleApproximate(DetectEngineThreadCtx *det_ctx, struct Thresholds *tctx,
+        const Packet *p, const Signature *s, const DetectThresholdData *td, PacketAlert *pa)
+{
+    /* both alerts only on the hit that reaches the count, which merged
+     * hits could skip */
+    if (td->type == TYPE_BACKOFF || td->type == TYPE_BOTH ||
+            (td->count == 1 && td->type == TYPE_THRESHOLD)) {
+        return ThresholdGetFromHash(tctx, p, s, td, pa);
+    }
+
+    if (SCTIME_SECS(p->ts) > threshold_local_housekeeping_ts) {
+        ThresholdLocalExpire(tctx, p->ts);
+    }
+
+    ThresholdLocalEntry lookup;
+    ThresholdBuildKey(&lookup.key, p, s, td);
+    ThresholdLocalEntry *le = NULL;
+    if (threshold_local_ht != NULL) {
+        le = HashTableLookup(threshold_local_ht, &lookup, 0);
+    }
+    if (le != NULL && SCTIME_CMP_LTE(p->ts, le->window_end) &&
+            SCTIME_SECS(p->ts) < SCTIME_SECS(le->synced) + tctx->sync_interval) {
+        if (le->ret >= 0) {
+            if (td->type == TYPE_RATE)
+                RateFilterSetAction(pa, td->new_action);
+            StatsIncr(det_ctx->tv, det_ctx->counter_threshold_local);
+            return le->ret;
+        }
+        if (le->pending < tctx->max_pending &&
+                (uint64_t)le->count + le->pending + 1 < td->count) {
+            le->pending++;
+            StatsIncr(det_ctx->tv, det_ctx->counter_threshold_local);
+            /* below the count only limit and rate_filter alert */
+            return (td->type == TYPE_LIMIT || td->type == TYPE_RATE) ? 1 : 0;
+        }
+    }
+
+    ThresholdEntry snap;
+    bool found = false;
+    const int r = ThresholdUpdateHash(
+            tctx, &lookup.key, p, s, td, pa, le ? le->pending : 0, &snap, &found);
+    StatsIncr(det_ctx->tv, det_ctx->counter_threshold_merges);
+    if (det_ctx->threshold_merges != NULL)
+        det_ctx->threshold_merges[s->num]++;
+
+    if (le == NULL && found) {
+        le = ThresholdLocalAdd(&lookup.key);
+    }
+    if (le != NULL) {
+        le->pending = 0;
+        le->synced = p->ts;
+        if (found) {
+            le->count = snap.current_count;
+            le->ret = ThresholdFixedResult(td, &snap, &le->window_end);
+        } else {
+            /* no global entry: merge on the next hit */
+            le->window_end = SCTIME_FROM_SECS(0);
+        }
+    }
+    return r;
+}
+
 /**
  *  \retval 2 silent match (no alert but apply actions)
  *  \retval 1 normal match
@@ -967,7 +1317,10 @@ int PacketAlertThreshold(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx
             }
         }
 
-        ret = ThresholdGetFromHash(&ctx, p, s, td, pa);
+        if (ctx.approximate)
+            ret = ThresholdHandleApproximate(det_ctx, &ctx, p, s, td, pa);
+        else
+            ret = ThresholdGetFromHash(&ctx, p, s, td, pa);
     } else if (td->track == TRACK_DST) {
         if (PacketIsIPv4(p) && (td->type == TYPE_LIMIT || td->type == TYPE_BOTH)) {
             int cache_ret = CheckCache(p, td->track, s->id, s->gid, s->rev);
@@ -976,11 +1329,15 @@ int PacketAlertThreshold(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx
             }
         }
 
-        ret = ThresholdGetFromHash(&ctx, p, s, td, pa);
-    } else if (td->track == TRACK_BOTH) {
-        ret = ThresholdGetFromHash(&ctx, p, s, td, pa);
-    } else if (td->track == TRACK_RULE) {
-        ret = ThresholdGetFromHash(&ctx, p, s, td, pa);
+        if (ctx.approximate)
+            ret = ThresholdHandleApproximate(det_ctx, &ctx, p, s, td, pa);
+        else
+            ret = ThresholdGetFromHash(&ctx, p, s, td, pa);
+    } else if (td->track == TRACK_BOTH || td->track == TRACK_RULE) {
+        if (ctx.approximate)
+            ret = ThresholdHandleApproximate(det_ctx, &ctx, p, s, td, pa);
+        else
+            ret = ThresholdGetFromHash(&ctx, p, s, td, pa);
     } else if (td->track == TRACK_FLOW) {
         if (p->flow) {
             ret = ThresholdHandlePacketFlow(p->flow, p, td, s->id, s->gid, s->rev, pa);
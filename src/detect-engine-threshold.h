@@ -32,6 +32,10 @@ void ThresholdInit(void);
 void ThresholdDestroy(void);
 
 uint32_t ThresholdsExpire(const SCTime_t ts);
+bool ThresholdsApproximate(void);
+void ThresholdsThreadInit(DetectEngineThreadCtx *det_ctx);
+void ThresholdsThreadCleanup(DetectEngineThreadCtx *det_ctx);
+void ThresholdsLogMerges(const DetectEngineCtx *de_ctx);
 
 const DetectThresholdData *SigGetThresholdTypeIter(
         const Signature *, const SigMatchData **, int list);
@@ -2626,6 +2626,12 @@ void DetectEngineCtxFree(DetectEngineCtx *de_ctx)
     if (de_ctx == NULL)
         return;
 
+    ThresholdsLogMerges(de_ctx);
+    if (de_ctx->threshold_merges != NULL) {
+        SCFree(de_ctx->threshold_merges);
+        de_ctx->threshold_merges = NULL;
+    }
+
 #ifdef PROFILE_RULES
     if (de_ctx->profile_ctx != NULL) {
         SCProfilingRuleDestroyCtx(de_ctx->profile_ctx);
@@ -2647,6 +2653,7 @@ void DetectEngineCtxFree(DetectEngineCtx *de_ctx)
      * to be sure look at them again here.
      */
     SigGroupHeadHashFree(de_ctx);
+    SigGroupHeadNonPrefilterHashFree(de_ctx);
     MpmStoreFree(de_ctx);
     DetectParseDupSigHashFree(de_ctx);
     SCSigSignatureOrderingModuleCleanup(de_ctx);
@@ -2946,6 +2953,12 @@ static int DetectEngineCtxLoadConf(DetectEngineCtx *de_ctx)
             de_ctx->guess_applayer = true;
         }
     }
+    int content_filter = 0;
+    if ((ConfGetBool("detect.content-filter", &content_filter)) == 1) {
+        if (content_filter == 1) {
+            de_ctx->content_filter = true;
+        }
+    }
 
     /* parse port grouping priority settings */
 
@@ -3028,6 +3041,16 @@ static int DetectEngineCtxLoadConf(DetectEngineCtx *de_ctx)
             break;
     }
 
+    int prefilter_pcre = 0;
+    if (ConfGetBool("detect.prefilter.pcre", &prefilter_pcre) == 1 && prefilter_pcre == 1) {
+        if (sigmatch_table[DETECT_PCRE].SupportsPrefilter != NULL) {
+            de_ctx->prefilter_pcre = true;
+            SCLogConfig("prefilter engines: pcre for rules without fast pattern");
+        } else {
+            SCLogWarning("detect.prefilter.pcre requires Hyperscan support, ignoring");
+        }
+    }
+
     return 0;
 }
 
@@ -3245,6 +3268,17 @@ static TmEcode DetectEngineThreadCtxInitForMT(ThreadVars *tv, DetectEngineThread
             break;
     }
 
+    /* vlan and livedev are part of the flow key when used for tracking, so
+     * all packets of a flow map to the same tenant. Each mapping update
+     * rebuilds the thread ctxs under a new master version, so the version
+     * tells flows the tenant they cached is stale. */
+    if ((master->tenant_selector == TENANT_SELECTOR_VLAN && g_vlan_mask != 0) ||
+            (master->tenant_selector == TENANT_SELECTOR_LIVEDEV && g_livedev_mask != 0)) {
+        det_ctx->tenant_version = (uint16_t)master->version;
+        if (det_ctx->tenant_version == 0)
+            det_ctx->tenant_version = 1;
+    }
+
     return TM_ECODE_OK;
 error:
     if (map_array != NULL)
@@ -3397,6 +3431,18 @@ TmEcode DetectEngineThreadCtxInit(ThreadVars *tv, void *initdata, void **data)
     det_ctx->counter_alerts = StatsRegisterCounter("detect.alert", tv);
     det_ctx->counter_alerts_overflow = StatsRegisterCounter("detect.alert_queue_overflow", tv);
     det_ctx->counter_alerts_suppressed = StatsRegisterCounter("detect.alerts_suppressed", tv);
+    det_ctx->counter_dataset_lookups = StatsRegisterCounter("detect.datasets.lookups", tv);
+    det_ctx->counter_tx_state_sigs_avg = StatsRegisterAvgCounter("detect.tx_state.sigs_avg", tv);
+    det_ctx->counter_tx_state_sigs_max = StatsRegisterMaxCounter("detect.tx_state.sigs_max", tv);
+    if (ThresholdsApproximate()) {
+        det_ctx->counter_threshold_local = StatsRegisterCounter("detect.thresholds.local", tv);
+        det_ctx->counter_threshold_merges = StatsRegisterCounter("detect.thresholds.merges", tv);
+        ThresholdsThreadInit(det_ctx);
+    }
+    if (det_ctx->de_ctx->content_filter) {
+        det_ctx->counter_content_filter_rejects =
+                StatsRegisterCounter("detect.content_filter_rejects", tv);
+    }
 
     /* Register counter for Lua rule errors. */
     det_ctx->lua_rule_errors = StatsRegisterCounter("detect.lua.errors", tv);
@@ -3471,6 +3517,18 @@ DetectEngineThreadCtx *DetectEngineThreadCtxInitForReload(
     det_ctx->counter_alerts = StatsRegisterCounter("detect.alert", tv);
     det_ctx->counter_alerts_overflow = StatsRegisterCounter("detect.alert_queue_overflow", tv);
     det_ctx->counter_alerts_suppressed = StatsRegisterCounter("detect.alerts_suppressed", tv);
+    det_ctx->counter_dataset_lookups = StatsRegisterCounter("detect.datasets.lookups", tv);
+    det_ctx->counter_tx_state_sigs_avg = StatsRegisterAvgCounter("detect.tx_state.sigs_avg", tv);
+    det_ctx->counter_tx_state_sigs_max = StatsRegisterMaxCounter("detect.tx_state.sigs_max", tv);
+    if (ThresholdsApproximate()) {
+        det_ctx->counter_threshold_local = StatsRegisterCounter("detect.thresholds.local", tv);
+        det_ctx->counter_threshold_merges = StatsRegisterCounter("detect.thresholds.merges", tv);
+        ThresholdsThreadInit(det_ctx);
+    }
+    if (det_ctx->de_ctx->content_filter) {
+        det_ctx->counter_content_filter_rejects =
+                StatsRegisterCounter("detect.content_filter_rejects", tv);
+    }
 #ifdef PROFILING
     uint16_t counter_mpm_list = StatsRegisterAvgCounter("detect.mpm_list", tv);
     uint16_t counter_nonmpm_list = StatsRegisterAvgCounter("detect.nonmpm_list", tv);
@@ -3510,6 +3568,8 @@ static void DetectEngineThreadCtxFree(DetectEngineThreadCtx *det_ctx)
         det_ctx->tenant_array = NULL;
     }
 
+    ThresholdsThreadCleanup(det_ctx);
+
 #ifdef PROFILE_RULES
     SCProfilingRuleThreadCleanup(det_ctx);
 #endif
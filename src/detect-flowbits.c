@@ -992,11 +992,7 @@ static int FlowBitsTestSig06(void)
 
     gv = p->flow->flowvar;
     FAIL_IF_NULL(gv);
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-                result = 1;
-        }
-    }
+    result = FlowBitIsset(p->flow, idx);
     FAIL_IF_NOT(result);
 
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
@@ -1067,11 +1063,7 @@ static int FlowBitsTestSig07(void)
     gv = p->flow->flowvar;
     FAIL_IF_NULL(gv);
 
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-                result = 1;
-        }
-    }
+    result = FlowBitIsset(p->flow, idx);
     FAIL_IF(result);
 
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
@@ -1143,11 +1135,7 @@ static int FlowBitsTestSig08(void)
     gv = p->flow->flowvar;
     FAIL_IF_NULL(gv);
 
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-                result = 1;
-        }
-    }
+    result = FlowBitIsset(p->flow, idx);
     FAIL_IF(result);
 
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
@@ -1671,6 +1671,9 @@ void SigFree(DetectEngineCtx *de_ctx, Signature *s)
         s->init_data->buffers = NULL;
     }
     SigMatchFreeArrays(de_ctx, s, (s->init_data == NULL));
+    if (s->content_filter != NULL) {
+        SCFree(s->content_filter);
+    }
     if (s->init_data) {
         SCFree(s->init_data);
         s->init_data = NULL;
@@ -48,6 +48,8 @@
 #include "util-unittest.h"
 #include "util-print.h"
 #include "util-pool.h"
+#include "util-hash.h"
+#include "util-hash-lookup3.h"
 
 #include "conf.h"
 #include "app-layer.h"
@@ -59,6 +61,15 @@
 #include "app-layer-protos.h"
 #include "app-layer-parser.h"
 #include "util-pages.h"
+#include "util-misc.h"
+
+#ifdef BUILD_HYPERSCAN
+#include "detect-engine-prefilter.h"
+#include "util-prefilter.h"
+#include "util-profiling.h"
+
+#include <hs.h>
+#endif
 
 /* pcre named substring capture supports only 32byte names, A-z0-9 plus _
  * and needs to start with non-numeric. */
@@ -74,21 +85,410 @@ static DetectParseRegex *parse_capture_regex;
 #ifdef PCRE2_HAVE_JIT
 static int pcre2_use_jit = 1;
 #endif
+static uint32_t pcre_jit_stack_max = SC_PCRE_JIT_STACK_MAX_DEFAULT;
+
+/** \brief per thread pcre2 state
+ *
+ *  Instead of match data per rule per thread, all pcre keywords of a
+ *  thread share a single match data, sized for the largest regex seen,
+ *  and one JIT stack. The JIT stack is assigned through per thread match
+ *  contexts, one for each match limit setting. */
+typedef struct DetectPcreThreadArena_ {
+#ifdef PCRE2_HAVE_JIT
+    pcre2_jit_stack *jit_stack;
+#endif
+    /** match contexts for the default [0] and configured [1] limits */
+    pcre2_match_context *context[2];
+    pcre2_match_data *match;
+    /** size of match in ovector pairs */
+    uint32_t match_size;
+#ifdef BUILD_HYPERSCAN
+    /** scratch for the pcre prefilter databases */
+    hs_scratch_t *hs_scratch;
+#endif
+} DetectPcreThreadArena;
+
+static int g_pcre_thread_arena_id = -1;
 
-// TODOpcre2 pcre2_jit_stack_create ?
+#ifdef BUILD_HYPERSCAN
+/* Prototype scratch, grown as pcre prefilter databases are compiled and
+ * cloned into the thread arenas. Protected by g_pcre_hs_scratch_mutex. */
+static hs_scratch_t *g_pcre_hs_scratch_proto = NULL;
+static SCMutex g_pcre_hs_scratch_mutex = SCMUTEX_INITIALIZER;
+#endif
+
+static void DetectPcreSetMatchLimits(pcre2_match_context *context, bool apply_match_limit)
+{
+    if (apply_match_limit) {
+        if (pcre_match_limit >= -1) {
+            pcre2_set_match_limit(context, pcre_match_limit);
+        }
+        if (pcre_match_limit_recursion >= -1) {
+            // pcre2_set_depth_limit unsupported on ubuntu 16.04
+            pcre2_set_recursion_limit(context, pcre_match_limit_recursion);
+        }
+    } else {
+        pcre2_set_match_limit(context, SC_MATCH_LIMIT_DEFAULT);
+        pcre2_set_recursion_limit(context, SC_MATCH_LIMIT_RECURSION_DEFAULT);
+    }
+}
+
+static void DetectPcreThreadArenaFree(void *ctx)
+{
+    DetectPcreThreadArena *arena = ctx;
+    if (arena == NULL)
+        return;
+
+#ifdef BUILD_HYPERSCAN
+    if (arena->hs_scratch != NULL)
+        hs_free_scratch(arena->hs_scratch);
+#endif
+    pcre2_match_data_free(arena->match);
+    for (int i = 0; i < 2; i++) {
+        if (arena->context[i] != NULL)
+            pcre2_match_context_free(arena->context[i]);
+    }
+#ifdef PCRE2_HAVE_JIT
+    if (arena->jit_stack != NULL)
+        pcre2_jit_stack_free(arena->jit_stack);
+#endif
+    SCFree(arena);
+}
+
+static void *DetectPcreThreadArenaInit(void *data)
+{
+    DetectPcreThreadArena *arena = SCCalloc(1, sizeof(*arena));
+    if (unlikely(arena == NULL))
+        return NULL;
+
+#ifdef PCRE2_HAVE_JIT
+    if (pcre2_use_jit) {
+        arena->jit_stack = pcre2_jit_stack_create(
+                MIN(SC_PCRE_JIT_STACK_START, pcre_jit_stack_max), pcre_jit_stack_max, NULL);
+        if (arena->jit_stack == NULL) {
+            SCLogError("pcre2 could not create jit stack");
+            goto error;
+        }
+    }
+#endif
+    for (int i = 0; i < 2; i++) {
+        arena->context[i] = pcre2_match_context_create(NULL);
+        if (arena->context[i] == NULL) {
+            SCLogError("pcre2 could not create match context");
+            goto error;
+        }
+        DetectPcreSetMatchLimits(arena->context[i], i == 1);
+#ifdef PCRE2_HAVE_JIT
+        if (arena->jit_stack != NULL)
+            pcre2_jit_stack_assign(arena->context[i], NULL, arena->jit_stack);
+#endif
+    }
+    arena->match_size = DETECT_PCRE_CAPTURE_MAX + 2;
+    arena->match = pcre2_match_data_create(arena->match_size, NULL);
+    if (arena->match == NULL)
+        goto error;
+#ifdef BUILD_HYPERSCAN
+    SCMutexLock(&g_pcre_hs_scratch_mutex);
+    if (g_pcre_hs_scratch_proto != NULL &&
+            hs_clone_scratch(g_pcre_hs_scratch_proto, &arena->hs_scratch) != HS_SUCCESS) {
+        SCMutexUnlock(&g_pcre_hs_scratch_mutex);
+        SCLogError("could not clone pcre prefilter scratch");
+        goto error;
+    }
+    SCMutexUnlock(&g_pcre_hs_scratch_mutex);
+#endif
+    return arena;
+
+error:
+    DetectPcreThreadArenaFree(arena);
+    return NULL;
+}
+
+/** \internal
+ *  \brief get the thread's match data, grown to fit the regex if needed */
+static inline pcre2_match_data *DetectPcreThreadArenaGetMatch(
+        DetectPcreThreadArena *arena, const DetectPcreData *pd)
+{
+    if (unlikely(pd->ovector_size > arena->match_size)) {
+        pcre2_match_data *match = pcre2_match_data_create(pd->ovector_size, NULL);
+        if (match == NULL)
+            return NULL;
+        pcre2_match_data_free(arena->match);
+        arena->match = match;
+        arena->match_size = pd->ovector_size;
+    }
+    return arena->match;
+}
 
 /* \brief Helper function for using pcre2_match with/without JIT
  */
-static inline int DetectPcreExec(DetectEngineThreadCtx *det_ctx, const DetectPcreData *pd,
+static inline int DetectPcreExec(DetectPcreThreadArena *arena, const DetectPcreData *pd,
         const char *str, const size_t strlen, int start_offset, int options,
         pcre2_match_data *match)
 {
     return pcre2_match(pd->parse_regex.regex, (PCRE2_SPTR8)str, strlen, start_offset, options,
-            match, pd->parse_regex.context);
+            match, arena->context[pd->match_limit]);
+}
+
+/** \brief compiled regex shared between all detect engines
+ *
+ *  Tenants and reloaded engines often load the same rules, so the compiled
+ *  (and JIT'd) code is stored once, keyed on the expression and its compile
+ *  options. */
+typedef struct DetectPcreShared_ {
+    char *re;
+    uint32_t opts;
+    DetectParseRegex parse_regex;
+    /** size of the compiled code incl JIT */
+    size_t memory;
+#ifdef BUILD_HYPERSCAN
+    /** regex can be compiled by hyperscan in prefilter mode */
+    bool hs_compat;
+#endif
+    /** number of DetectPcreData using this regex */
+    uint32_t ref_cnt;
+} DetectPcreShared;
+
+#define PCRE_SHARED_HASH_SIZE 4096
+
+/* Global table of DetectPcreShared. Lookups, inserts and ref_cnt updates are
+ * serialised via g_pcre_shared_mutex. */
+static HashTable *g_pcre_shared_table = NULL;
+static uint32_t g_pcre_shared_cnt = 0;
+static SCMutex g_pcre_shared_mutex = SCMUTEX_INITIALIZER;
+
+static uint32_t DetectPcreSharedHash(HashTable *ht, void *data, uint16_t len)
+{
+    const DetectPcreShared *ps = data;
+    uint32_t hash = hashlittle_safe(ps->re, strlen(ps->re), 0);
+    hash = hashlittle_safe(&ps->opts, sizeof(ps->opts), hash);
+    return hash % ht->array_size;
+}
+
+static char DetectPcreSharedCompare(void *data1, uint16_t len1, void *data2, uint16_t len2)
+{
+    const DetectPcreShared *ps1 = data1;
+    const DetectPcreShared *ps2 = data2;
+    return (ps1->opts == ps2->opts && strcmp(ps1->re, ps2->re) == 0);
+}
+
+static void DetectPcreSharedTableFree(void *data)
+{
+    /* Stub function handed to hash table; actual freeing of DetectPcreShared
+     * structures is done in DetectPcreSharedRelease when the ref_cnt drops to zero. */
+}
+
+static void DetectPcreSharedFree(DetectPcreShared *ps)
+{
+    DetectParseFreeRegex(&ps->parse_regex);
+    SCFree(ps->re);
+    SCFree(ps);
+}
+
+#ifdef BUILD_HYPERSCAN
+/** \internal
+ *  \brief render the hyperscan expression and flags for a regex
+ *
+ *  Hyperscan is used in prefilter mode: it may match more than pcre2,
+ *  but never less. Options that only affect what is captured, or where
+ *  a match starts, are dropped as any pcre2 match is still found.
+ *
+ *  \retval expr expression to be freed by the caller or NULL
+ */
+static char *DetectPcreHSExpression(const DetectPcreShared *ps, unsigned int *flags)
+{
+    unsigned int f = HS_FLAG_PREFILTER | HS_FLAG_SINGLEMATCH;
+    if (ps->opts & PCRE2_CASELESS)
+        f |= HS_FLAG_CASELESS;
+    if (ps->opts & PCRE2_DOTALL)
+        f |= HS_FLAG_DOTALL;
+    if (ps->opts & PCRE2_MULTILINE)
+        f |= HS_FLAG_MULTILINE;
+    *flags = f;
+
+    /* no hyperscan flag for extended syntax, use the inline option */
+    const char *prefix = (ps->opts & PCRE2_EXTENDED) ? "(?x)" : "";
+    size_t len = strlen(prefix) + strlen(ps->re) + 1;
+    char *expr = SCMalloc(len);
+    if (unlikely(expr == NULL))
+        return NULL;
+    snprintf(expr, len, "%s%s", prefix, ps->re);
+    return expr;
+}
+
+/** \internal
+ *  \brief check if hyperscan can compile the regex as a prefilter
+ *
+ *  Regexes that can match an empty buffer are rejected, as they would
+ *  never filter anything.
+ */
+static bool DetectPcreHSCheck(const DetectPcreShared *ps)
+{
+    unsigned int flags = 0;
+    char *expr = DetectPcreHSExpression(ps, &flags);
+    if (expr == NULL)
+        return false;
+
+    hs_expr_info_t *info = NULL;
+    hs_compile_error_t *compile_err = NULL;
+    hs_error_t err = hs_expression_info(expr, flags, &info, &compile_err);
+    if (err != HS_SUCCESS) {
+        SCLogDebug("pcre \"%s\" not supported by hyperscan: %s", ps->re,
+                compile_err ? compile_err->message : "unknown error");
+        hs_free_compile_error(compile_err);
+        SCFree(expr);
+        return false;
+    }
+    const bool ok = info->min_width > 0;
+    SCFree(info);
+    SCFree(expr);
+    return ok;
+}
+#endif
+
+static DetectPcreShared *DetectPcreSharedCompile(
+        DetectEngineCtx *de_ctx, const char *re, uint32_t opts, const char *regexstr)
+{
+    int en;
+    PCRE2_SIZE eo2;
+
+    DetectPcreShared *ps = SCCalloc(1, sizeof(*ps));
+    if (unlikely(ps == NULL))
+        return NULL;
+    ps->re = SCStrdup(re);
+    if (unlikely(ps->re == NULL)) {
+        SCFree(ps);
+        return NULL;
+    }
+    ps->opts = opts;
+
+    ps->parse_regex.regex =
+            pcre2_compile((PCRE2_SPTR8)re, PCRE2_ZERO_TERMINATED, opts, &en, &eo2, NULL);
+    if (ps->parse_regex.regex == NULL && en == 115) { // reference to nonexistent subpattern
+        opts &= ~PCRE2_NO_AUTO_CAPTURE;
+        ps->parse_regex.regex =
+                pcre2_compile((PCRE2_SPTR8)re, PCRE2_ZERO_TERMINATED, opts, &en, &eo2, NULL);
+    }
+    if (ps->parse_regex.regex == NULL)  {
+        PCRE2_UCHAR errbuffer[256];
+        pcre2_get_error_message(en, errbuffer, sizeof(errbuffer));
+        SCLogError("pcre2 compile of \"%s\" failed at "
+                   "offset %d: %s",
+                regexstr, (int)eo2, errbuffer);
+        goto error;
+    }
+
+#ifdef PCRE2_HAVE_JIT
+    if (pcre2_use_jit) {
+        int ret = pcre2_jit_compile(ps->parse_regex.regex, PCRE2_JIT_COMPLETE);
+        if (ret != 0) {
+            /* warning, so we won't print the sig after this. Adding
+             * file and line to the message so the admin can figure
+             * out what sig this is about */
+            SCLogDebug("PCRE2 JIT compiler does not support: %s. "
+                       "Falling back to regular PCRE2 handling (%s:%d)",
+                    regexstr, de_ctx->rule_file, de_ctx->rule_line);
+        }
+    }
+#endif /*PCRE2_HAVE_JIT*/
+
+    size_t size = 0;
+    if (pcre2_pattern_info(ps->parse_regex.regex, PCRE2_INFO_SIZE, &size) == 0)
+        ps->memory += size;
+    size = 0;
+    if (pcre2_pattern_info(ps->parse_regex.regex, PCRE2_INFO_JITSIZE, &size) == 0)
+        ps->memory += size;
+
+#ifdef BUILD_HYPERSCAN
+    ps->hs_compat = DetectPcreHSCheck(ps);
+#endif
+    return ps;
+
+error:
+    DetectPcreSharedFree(ps);
+    return NULL;
+}
+
+/** \internal
+ *  \brief get a compiled regex from the global table or compile and add it
+ *
+ *  Updates the pcre memory accounting of the detect engine.
+ */
+static DetectPcreShared *DetectPcreSharedGet(
+        DetectEngineCtx *de_ctx, const char *re, uint32_t opts, const char *regexstr)
+{
+    DetectPcreShared lookup = { .re = (char *)re, .opts = opts };
+
+    SCMutexLock(&g_pcre_shared_mutex);
+    if (g_pcre_shared_table == NULL) {
+        g_pcre_shared_table = HashTableInit(PCRE_SHARED_HASH_SIZE, DetectPcreSharedHash,
+                DetectPcreSharedCompare, DetectPcreSharedTableFree);
+        if (g_pcre_shared_table == NULL) {
+            SCMutexUnlock(&g_pcre_shared_mutex);
+            return NULL;
+        }
+    }
+
+    DetectPcreShared *ps = HashTableLookup(g_pcre_shared_table, &lookup, 0);
+    if (ps != NULL) {
+        SCLogDebug("reusing compiled regex %p for \"%s\" (ref_cnt=%u)", ps, re, ps->ref_cnt);
+        ps->ref_cnt++;
+        de_ctx->pcre_cnt++;
+        de_ctx->pcre_shared_cnt++;
+        SCMutexUnlock(&g_pcre_shared_mutex);
+        return ps;
+    }
+
+    ps = DetectPcreSharedCompile(de_ctx, re, opts, regexstr);
+    if (ps == NULL) {
+        SCMutexUnlock(&g_pcre_shared_mutex);
+        return NULL;
+    }
+    if (HashTableAdd(g_pcre_shared_table, ps, 0) != 0) {
+        SCMutexUnlock(&g_pcre_shared_mutex);
+        DetectPcreSharedFree(ps);
+        return NULL;
+    }
+    ps->ref_cnt = 1;
+    g_pcre_shared_cnt++;
+    de_ctx->pcre_cnt++;
+    de_ctx->pcre_memory += ps->memory;
+    SCMutexUnlock(&g_pcre_shared_mutex);
+    return ps;
+}
+
+static void DetectPcreSharedRelease(DetectPcreShared *ps)
+{
+    SCMutexLock(&g_pcre_shared_mutex);
+    BUG_ON(ps->ref_cnt == 0);
+    ps->ref_cnt--;
+    if (ps->ref_cnt == 0) {
+        HashTableRemove(g_pcre_shared_table, ps, 0);
+        DetectPcreSharedFree(ps);
+        BUG_ON(g_pcre_shared_cnt == 0);
+        g_pcre_shared_cnt--;
+        if (g_pcre_shared_cnt == 0) {
+            HashTableFree(g_pcre_shared_table);
+            g_pcre_shared_table = NULL;
+#ifdef BUILD_HYPERSCAN
+            SCMutexLock(&g_pcre_hs_scratch_mutex);
+            if (g_pcre_hs_scratch_proto != NULL) {
+                hs_free_scratch(g_pcre_hs_scratch_proto);
+                g_pcre_hs_scratch_proto = NULL;
+            }
+            SCMutexUnlock(&g_pcre_hs_scratch_mutex);
+#endif
+        }
+    }
+    SCMutexUnlock(&g_pcre_shared_mutex);
 }
 
 static int DetectPcreSetup (DetectEngineCtx *, Signature *, const char *);
 static void DetectPcreFree(DetectEngineCtx *, void *);
+#ifdef BUILD_HYPERSCAN
+static bool PrefilterPcreIsPrefilterable(const Signature *s);
+static int PrefilterSetupPcre(DetectEngineCtx *de_ctx, SigGroupHead *sgh);
+#endif
 #ifdef UNITTESTS
 static void DetectPcreRegisterTests(void);
 #endif
@@ -105,6 +505,10 @@ void DetectPcreRegister (void)
     sigmatch_table[DETECT_PCRE].RegisterTests  = DetectPcreRegisterTests;
 #endif
     sigmatch_table[DETECT_PCRE].flags = (SIGMATCH_QUOTES_OPTIONAL|SIGMATCH_HANDLE_NEGATION);
+#ifdef BUILD_HYPERSCAN
+    sigmatch_table[DETECT_PCRE].SupportsPrefilter = PrefilterPcreIsPrefilterable;
+    sigmatch_table[DETECT_PCRE].SetupPrefilter = PrefilterSetupPcre;
+#endif
 
     intmax_t val = 0;
 
@@ -136,6 +540,20 @@ void DetectPcreRegister (void)
         }
     }
 
+    const char *str = NULL;
+    if (ConfGet("pcre.jit-stack-size", &str) == 1 && str != NULL) {
+        if (ParseSizeStringU32(str, &pcre_jit_stack_max) < 0 ||
+                pcre_jit_stack_max < SC_PCRE_JIT_STACK_START) {
+            SCLogError("invalid pcre.jit-stack-size \"%s\", using default", str);
+            pcre_jit_stack_max = SC_PCRE_JIT_STACK_MAX_DEFAULT;
+        } else {
+            SCLogConfig("Using PCRE JIT stack size of: %u", pcre_jit_stack_max);
+        }
+    }
+
+    g_pcre_thread_arena_id = DetectRegisterThreadCtxGlobalFuncs(
+            "pcre", DetectPcreThreadArenaInit, NULL, DetectPcreThreadArenaFree);
+
     parse_regex = DetectSetupPCRE2(PARSE_REGEX, 0);
     if (parse_regex == NULL) {
         FatalError("pcre2 compile failed for parse_regex");
@@ -196,10 +614,15 @@ int DetectPcrePayloadMatch(DetectEngineThreadCtx *det_ctx, const Signature *s,
     }
 
     /* run the actual pcre detection */
-    pcre2_match_data *match =
-            (pcre2_match_data *)DetectThreadCtxGetKeywordThreadCtx(det_ctx, pe->thread_ctx_id);
-
-    ret = DetectPcreExec(det_ctx, pe, (char *)ptr, len, start_offset, 0, match);
+    DetectPcreThreadArena *arena = (DetectPcreThreadArena *)DetectThreadCtxGetGlobalKeywordThreadCtx(
+            det_ctx, g_pcre_thread_arena_id);
+    if (unlikely(arena == NULL))
+        SCReturnInt(0);
+    pcre2_match_data *match = DetectPcreThreadArenaGetMatch(arena, pe);
+    if (unlikely(match == NULL))
+        SCReturnInt(0);
+
+    ret = DetectPcreExec(arena, pe, (char *)ptr, len, start_offset, 0, match);
     SCLogDebug("ret %d (negating %s)", ret, (pe->flags & DETECT_PCRE_NEGATE) ? "set" : "not set");
 
     if (ret == PCRE2_ERROR_NOMATCH) {
@@ -349,8 +772,6 @@ static DetectPcreData *DetectPcreParse (DetectEngineCtx *de_ctx,
         size_t capture_names_size, bool negate, AppProto *alproto)
 {
     pcre2_match_data *match = NULL;
-    int en;
-    PCRE2_SIZE eo2;
     int opts = 0;
     DetectPcreData *pd = NULL;
     char *op = NULL;
@@ -641,54 +1062,16 @@ static DetectPcreData *DetectPcreParse (DetectEngineCtx *de_ctx,
     if (capture_names == NULL || strlen(capture_names) == 0)
         opts |= PCRE2_NO_AUTO_CAPTURE;
 
-    pd->parse_regex.regex =
-            pcre2_compile((PCRE2_SPTR8)re, PCRE2_ZERO_TERMINATED, opts, &en, &eo2, NULL);
-    if (pd->parse_regex.regex == NULL && en == 115) { // reference to nonexistent subpattern
-        opts &= ~PCRE2_NO_AUTO_CAPTURE;
-        pd->parse_regex.regex =
-                pcre2_compile((PCRE2_SPTR8)re, PCRE2_ZERO_TERMINATED, opts, &en, &eo2, NULL);
-    }
-    if (pd->parse_regex.regex == NULL)  {
-        PCRE2_UCHAR errbuffer[256];
-        pcre2_get_error_message(en, errbuffer, sizeof(errbuffer));
-        SCLogError("pcre2 compile of \"%s\" failed at "
-                   "offset %d: %s",
-                regexstr, (int)eo2, errbuffer);
+    pd->shared = DetectPcreSharedGet(de_ctx, re, opts, regexstr);
+    if (pd->shared == NULL)
         goto error;
-    }
-
-#ifdef PCRE2_HAVE_JIT
-    if (pcre2_use_jit) {
-        ret = pcre2_jit_compile(pd->parse_regex.regex, PCRE2_JIT_COMPLETE);
-        if (ret != 0) {
-            /* warning, so we won't print the sig after this. Adding
-             * file and line to the message so the admin can figure
-             * out what sig this is about */
-            SCLogDebug("PCRE2 JIT compiler does not support: %s. "
-                       "Falling back to regular PCRE2 handling (%s:%d)",
-                    regexstr, de_ctx->rule_file, de_ctx->rule_line);
-        }
-    }
-#endif /*PCRE2_HAVE_JIT*/
+    pd->parse_regex = pd->shared->parse_regex;
+    pd->match_limit = apply_match_limit;
 
-    pd->parse_regex.context = pcre2_match_context_create(NULL);
-    if (pd->parse_regex.context == NULL) {
-        SCLogError("pcre2 could not create match context");
+    uint32_t capture_cnt = 0;
+    if (pcre2_pattern_info(pd->parse_regex.regex, PCRE2_INFO_CAPTURECOUNT, &capture_cnt) != 0)
         goto error;
-    }
-
-    if (apply_match_limit) {
-        if (pcre_match_limit >= -1) {
-            pcre2_set_match_limit(pd->parse_regex.context, pcre_match_limit);
-        }
-        if (pcre_match_limit_recursion >= -1) {
-            // pcre2_set_depth_limit unsupported on ubuntu 16.04
-            pcre2_set_recursion_limit(pd->parse_regex.context, pcre_match_limit_recursion);
-        }
-    } else {
-        pcre2_set_match_limit(pd->parse_regex.context, SC_MATCH_LIMIT_DEFAULT);
-        pcre2_set_recursion_limit(pd->parse_regex.context, SC_MATCH_LIMIT_RECURSION_DEFAULT);
-    }
+    pd->ovector_size = capture_cnt + 1;
 
     pcre2_match_data_free(match);
     return pd;
@@ -845,21 +1228,6 @@ error:
     return -1;
 }
 
-static void *DetectPcreThreadInit(void *data)
-{
-    DetectPcreData *pd = (DetectPcreData *)data;
-    pcre2_match_data *match = pcre2_match_data_create_from_pattern(pd->parse_regex.regex, NULL);
-    return match;
-}
-
-static void DetectPcreThreadFree(void *ctx)
-{
-    if (ctx != NULL) {
-        pcre2_match_data *match = (pcre2_match_data *)ctx;
-        pcre2_match_data_free(match);
-    }
-}
-
 static int DetectPcreSetup (DetectEngineCtx *de_ctx, Signature *s, const char *regexstr)
 {
     SCEnter();
@@ -876,11 +1244,6 @@ static int DetectPcreSetup (DetectEngineCtx *de_ctx, Signature *s, const char *r
     if (DetectPcreParseCapture(regexstr, de_ctx, pd, capture_names) < 0)
         goto error;
 
-    pd->thread_ctx_id = DetectRegisterThreadCtxFuncs(
-            de_ctx, "pcre", DetectPcreThreadInit, (void *)pd, DetectPcreThreadFree, 0);
-    if (pd->thread_ctx_id == -1)
-        goto error;
-
     int sm_list = -1;
     if (s->init_data->list != DETECT_SM_LIST_NOTSET) {
         if (parsed_sm_list != DETECT_SM_LIST_NOTSET && parsed_sm_list != s->init_data->list) {
@@ -963,8 +1326,8 @@ static void DetectPcreFree(DetectEngineCtx *de_ctx, void *ptr)
         return;
 
     DetectPcreData *pd = (DetectPcreData *)ptr;
-    DetectParseFreeRegex(&pd->parse_regex);
-    DetectUnregisterThreadCtxFuncs(de_ctx, pd, "pcre");
+    if (pd->shared != NULL)
+        DetectPcreSharedRelease(pd->shared);
 
     for (uint8_t i = 0; i < pd->idx; i++) {
         VarNameStoreUnregister(pd->capids[i], pd->captypes[i]);
@@ -972,6 +1335,283 @@ static void DetectPcreFree(DetectEngineCtx *de_ctx, void *ptr)
     SCFree(pd);
 }
 
+#ifdef BUILD_HYPERSCAN
+/* Prefilter for rules without a fast pattern that have a payload pcre.
+ *
+ * The pcre2 regexes of the rules in a rule group are compiled into a
+ * single hyperscan database in prefilter mode. A rule is added to the
+ * candidate list if its regex matched in the packet payload or in the
+ * reassembled stream chunks. Hyperscan may report false positives, the
+ * regular rule inspection confirms the match with pcre2. */
+
+typedef struct PrefilterPcreExpr_ {
+    const DetectPcreShared *shared;
+    SigIntId *sigs_array;
+    uint32_t sigs_cnt;
+} PrefilterPcreExpr;
+
+typedef struct PrefilterPcreCtx_ {
+    /** NULL if the database could not be compiled. In this case all rules
+     *  are added to the candidate list. */
+    hs_database_t *db;
+    PrefilterPcreExpr *exprs;
+    uint32_t exprs_cnt;
+    /** rules that can't use the database */
+    SigIntId *always_array;
+    uint32_t always_cnt;
+} PrefilterPcreCtx;
+
+struct PrefilterPcreScanData {
+    DetectEngineThreadCtx *det_ctx;
+    const PrefilterPcreCtx *ctx;
+    hs_scratch_t *scratch;
+};
+
+static void PrefilterPcreAddAll(DetectEngineThreadCtx *det_ctx, const PrefilterPcreCtx *ctx)
+{
+    for (uint32_t i = 0; i < ctx->exprs_cnt; i++) {
+        PrefilterAddSids(&det_ctx->pmq, ctx->exprs[i].sigs_array, ctx->exprs[i].sigs_cnt);
+    }
+}
+
+static int PrefilterPcreOnMatch(unsigned int id, unsigned long long from, unsigned long long to,
+        unsigned int flags, void *data)
+{
+    struct PrefilterPcreScanData *sd = data;
+    const PrefilterPcreExpr *e = &sd->ctx->exprs[id];
+    PrefilterAddSids(&sd->det_ctx->pmq, e->sigs_array, e->sigs_cnt);
+    return 0;
+}
+
+static void PrefilterPcreScan(
+        struct PrefilterPcreScanData *sd, const uint8_t *data, const uint32_t data_len)
+{
+    hs_error_t err = hs_scan(sd->ctx->db, (const char *)data, data_len, 0, sd->scratch,
+            PrefilterPcreOnMatch, sd);
+    if (unlikely(err != HS_SUCCESS)) {
+        /* can't tell which rules may match, so let them all be inspected */
+        SCLogDebug("hyperscan returned error %d", err);
+        PrefilterPcreAddAll(sd->det_ctx, sd->ctx);
+    }
+    PREFILTER_PROFILING_ADD_BYTES(sd->det_ctx, data_len);
+}
+
+static int PrefilterPcreStreamFunc(
+        void *cb_data, const uint8_t *data, const uint32_t data_len, const uint64_t _offset)
+{
+    PrefilterPcreScan(cb_data, data, data_len);
+    return 0;
+}
+
+static void PrefilterPcre(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx)
+{
+    const PrefilterPcreCtx *ctx = pectx;
+
+    if (ctx->always_cnt > 0)
+        PrefilterAddSids(&det_ctx->pmq, ctx->always_array, ctx->always_cnt);
+
+    DetectPcreThreadArena *arena =
+            DetectThreadCtxGetGlobalKeywordThreadCtx(det_ctx, g_pcre_thread_arena_id);
+    if (unlikely(ctx->db == NULL || arena == NULL || arena->hs_scratch == NULL)) {
+        PrefilterPcreAddAll(det_ctx, ctx);
+        return;
+    }
+
+    struct PrefilterPcreScanData sd = { det_ctx, ctx, arena->hs_scratch };
+    /* rules inspect the stream chunks and fall back to the packet payload,
+     * so scan both. */
+    if (p->flags & PKT_DETECT_HAS_STREAMDATA) {
+        uint64_t unused;
+        StreamReassembleRaw(p->flow->protoctx, p, PrefilterPcreStreamFunc, &sd, &unused, false);
+    }
+    if (p->payload_len > 0) {
+        PrefilterPcreScan(&sd, p->payload, p->payload_len);
+    }
+}
+
+static void PrefilterPcreFree(void *ptr)
+{
+    PrefilterPcreCtx *ctx = ptr;
+    if (ctx->db != NULL)
+        hs_free_database(ctx->db);
+    for (uint32_t i = 0; i < ctx->exprs_cnt; i++) {
+        SCFree(ctx->exprs[i].sigs_array);
+    }
+    SCFree(ctx->exprs);
+    SCFree(ctx->always_array);
+    SCFree(ctx);
+}
+
+/** \internal
+ *  \brief compile the regexes of the prefilter into a block mode database
+ *
+ *  On success the prototype scratch is grown to fit the database.
+ */
+static int PrefilterPcreCompile(DetectEngineCtx *de_ctx, PrefilterPcreCtx *ctx)
+{
+    int r = -1;
+    char **expressions = SCCalloc(ctx->exprs_cnt, sizeof(char *));
+    unsigned int *flags = SCCalloc(ctx->exprs_cnt, sizeof(unsigned int));
+    unsigned int *ids = SCCalloc(ctx->exprs_cnt, sizeof(unsigned int));
+    if (expressions == NULL || flags == NULL || ids == NULL)
+        goto done;
+
+    for (uint32_t i = 0; i < ctx->exprs_cnt; i++) {
+        expressions[i] = DetectPcreHSExpression(ctx->exprs[i].shared, &flags[i]);
+        if (expressions[i] == NULL)
+            goto done;
+        ids[i] = i;
+    }
+
+    hs_compile_error_t *compile_err = NULL;
+    hs_error_t err = hs_compile_multi((const char *const *)expressions, flags, ids,
+            ctx->exprs_cnt, HS_MODE_BLOCK, NULL, &ctx->db, &compile_err);
+    if (err != HS_SUCCESS) {
+        SCLogWarning("failed to compile pcre prefilter database: %s",
+                compile_err ? compile_err->message : "unknown error");
+        hs_free_compile_error(compile_err);
+        ctx->db = NULL;
+        goto done;
+    }
+
+    SCMutexLock(&g_pcre_hs_scratch_mutex);
+    err = hs_alloc_scratch(ctx->db, &g_pcre_hs_scratch_proto);
+    SCMutexUnlock(&g_pcre_hs_scratch_mutex);
+    if (err != HS_SUCCESS) {
+        SCLogError("failed to allocate pcre prefilter scratch");
+        hs_free_database(ctx->db);
+        ctx->db = NULL;
+        goto done;
+    }
+
+    size_t db_size = 0;
+    if (hs_database_size(ctx->db, &db_size) == HS_SUCCESS)
+        de_ctx->pcre_memory += db_size;
+    r = 0;
+done:
+    if (expressions != NULL) {
+        for (uint32_t i = 0; i < ctx->exprs_cnt; i++) {
+            SCFree(expressions[i]);
+        }
+        SCFree(expressions);
+    }
+    SCFree(flags);
+    SCFree(ids);
+    return r;
+}
+
+static int PrefilterPcreAddSig(PrefilterPcreCtx *ctx, const DetectPcreShared *ps, SigIntId num)
+{
+    PrefilterPcreExpr *e = NULL;
+    for (uint32_t i = 0; i < ctx->exprs_cnt; i++) {
+        if (ctx->exprs[i].shared == ps) {
+            e = &ctx->exprs[i];
+            break;
+        }
+    }
+    if (e == NULL) {
+        e = &ctx->exprs[ctx->exprs_cnt++];
+        e->shared = ps;
+    }
+
+    SigIntId *sigs = SCRealloc(e->sigs_array, (e->sigs_cnt + 1) * sizeof(SigIntId));
+    if (sigs == NULL)
+        return -1;
+    e->sigs_array = sigs;
+    e->sigs_array[e->sigs_cnt++] = num;
+    return 0;
+}
+
+static int PrefilterSetupPcre(DetectEngineCtx *de_ctx, SigGroupHead *sgh)
+{
+    uint32_t cnt = 0;
+    for (uint32_t sig = 0; sig < sgh->init->sig_cnt; sig++) {
+        const Signature *s = sgh->init->match_array[sig];
+        if (s != NULL && s->init_data->prefilter_sm != NULL &&
+                s->init_data->prefilter_sm->type == DETECT_PCRE)
+            cnt++;
+    }
+    if (cnt == 0)
+        return 0;
+
+    PrefilterPcreCtx *ctx = SCCalloc(1, sizeof(*ctx));
+    if (ctx == NULL)
+        return -1;
+    ctx->exprs = SCCalloc(cnt, sizeof(PrefilterPcreExpr));
+    ctx->always_array = SCCalloc(cnt, sizeof(SigIntId));
+    if (ctx->exprs == NULL || ctx->always_array == NULL)
+        goto error;
+
+    for (uint32_t sig = 0; sig < sgh->init->sig_cnt; sig++) {
+        const Signature *s = sgh->init->match_array[sig];
+        if (s == NULL || s->init_data->prefilter_sm == NULL ||
+                s->init_data->prefilter_sm->type != DETECT_PCRE)
+            continue;
+
+        /* the prefilter keyword may have forced a pcre we can't scan for */
+        const DetectPcreData *pd = (const DetectPcreData *)s->init_data->prefilter_sm->ctx;
+        if (!DetectPcreSupportsPrefilter(s, s->init_data->prefilter_sm)) {
+            ctx->always_array[ctx->always_cnt++] = s->num;
+            continue;
+        }
+        if (PrefilterPcreAddSig(ctx, pd->shared, s->num) < 0)
+            goto error;
+    }
+
+    if (ctx->exprs_cnt > 0) {
+        /* on failure the rules are added unconditionally */
+        (void)PrefilterPcreCompile(de_ctx, ctx);
+    }
+
+    SCLogDebug("sgh %u: pcre prefilter with %u regexes, %u rules without prefilter", sgh->id,
+            ctx->exprs_cnt, ctx->always_cnt);
+    return PrefilterAppendPayloadEngine(de_ctx, sgh, PrefilterPcre, ctx, PrefilterPcreFree, "pcre");
+
+error:
+    PrefilterPcreFree(ctx);
+    return -1;
+}
+
+/** \internal
+ *  \brief check if the first payload pcre of a rule can be used as prefilter
+ */
+static bool PrefilterPcreIsPrefilterable(const Signature *s)
+{
+    for (const SigMatch *sm = s->init_data->smlists[DETECT_SM_LIST_PMATCH]; sm != NULL;
+            sm = sm->next) {
+        if (sm->type == DETECT_PCRE)
+            return DetectPcreSupportsPrefilter(s, sm);
+    }
+    return false;
+}
+#endif /* BUILD_HYPERSCAN */
+
+/**
+ *  \brief check if a pcre can be used as prefilter for its rule
+ *
+ *  Only packet payload pcre qualify, and only with Hyperscan. The regex
+ *  needs to be positive and not relative, so that it has to match
+ *  somewhere in the payload or a stream chunk for the rule to match.
+ */
+bool DetectPcreSupportsPrefilter(const Signature *s, const SigMatch *sm)
+{
+#ifdef BUILD_HYPERSCAN
+    if (sm->type != DETECT_PCRE)
+        return false;
+    if (s->init_data->buffer_index != 0 || (s->init_data->init_flags & SIG_FLAG_INIT_STATE_MATCH))
+        return false;
+    if (SigMatchListSMBelongsTo(s, sm) != DETECT_SM_LIST_PMATCH)
+        return false;
+
+    const DetectPcreData *pd = (const DetectPcreData *)sm->ctx;
+    if (pd->flags & (DETECT_PCRE_NEGATE | DETECT_PCRE_RELATIVE))
+        return false;
+    return pd->shared->hs_compat;
+#else
+    return false;
+#endif
+}
+
 #ifdef UNITTESTS /* UNITTESTS */
 #include "detect-engine-alert.h"
 static int g_file_data_buffer_id = 0;
@@ -1980,6 +2620,151 @@ static int DetectPcreParseHttpHost(void)
     PASS;
 }
 
+/**
+ * \test compiled regexes are shared between detect engines
+ */
+static int DetectPcreSharedTest01(void)
+{
+    AppProto alproto = ALPROTO_UNKNOWN;
+    int list = DETECT_SM_LIST_NOTSET;
+    DetectEngineCtx *de_ctx1 = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx1);
+    DetectEngineCtx *de_ctx2 = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx2);
+
+    DetectPcreData *pd1 = DetectPcreParse(de_ctx1, "/ab[cd]+/i", &list, NULL, 0, false, &alproto);
+    FAIL_IF_NULL(pd1);
+    list = DETECT_SM_LIST_NOTSET;
+    DetectPcreData *pd2 = DetectPcreParse(de_ctx2, "/ab[cd]+/i", &list, NULL, 0, false, &alproto);
+    FAIL_IF_NULL(pd2);
+    FAIL_IF_NOT(pd1->parse_regex.regex == pd2->parse_regex.regex);
+    FAIL_IF_NOT(pd1->shared->ref_cnt == 2);
+    FAIL_IF_NOT(de_ctx2->pcre_shared_cnt == 1);
+
+    /* different options, different code */
+    list = DETECT_SM_LIST_NOTSET;
+    DetectPcreData *pd3 = DetectPcreParse(de_ctx2, "/ab[cd]+/", &list, NULL, 0, false, &alproto);
+    FAIL_IF_NULL(pd3);
+    FAIL_IF(pd3->parse_regex.regex == pd1->parse_regex.regex);
+    FAIL_IF_NOT(de_ctx2->pcre_cnt == 2);
+    FAIL_IF_NOT(de_ctx2->pcre_shared_cnt == 1);
+
+    DetectPcreFree(de_ctx1, pd1);
+    FAIL_IF_NOT(pd2->shared->ref_cnt == 1);
+    DetectPcreFree(de_ctx2, pd2);
+    DetectPcreFree(de_ctx2, pd3);
+
+    DetectEngineCtxFree(de_ctx1);
+    DetectEngineCtxFree(de_ctx2);
+    PASS;
+}
+
+/**
+ * \test per thread match data grows to fit regexes with many groups
+ */
+static int DetectPcreThreadArenaTest01(void)
+{
+    AppProto alproto = ALPROTO_UNKNOWN;
+    int list = DETECT_SM_LIST_NOTSET;
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+
+    DetectPcreData *pd = DetectPcreParse(de_ctx,
+            "/(a)(b)(c)(d)(e)(f)(g)(h)(i)(j)(k)(l)\\12/", &list, NULL, 0, false, &alproto);
+    FAIL_IF_NULL(pd);
+    FAIL_IF_NOT(pd->ovector_size == 13);
+
+    DetectPcreThreadArena *arena = DetectPcreThreadArenaInit(NULL);
+    FAIL_IF_NULL(arena);
+    FAIL_IF_NOT(arena->match_size < pd->ovector_size);
+    pcre2_match_data *match = DetectPcreThreadArenaGetMatch(arena, pd);
+    FAIL_IF_NULL(match);
+    FAIL_IF_NOT(arena->match_size == pd->ovector_size);
+
+    const char *str = "abcdefghijkll";
+    int ret = DetectPcreExec(arena, pd, str, strlen(str), 0, 0, match);
+    FAIL_IF_NOT(ret == 13);
+
+    DetectPcreThreadArenaFree(arena);
+    DetectPcreFree(de_ctx, pd);
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
+#ifdef BUILD_HYPERSCAN
+/** \test pcre only rule using the pcre prefilter */
+static int DetectPcrePrefilterTest01(void)
+{
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    memset(&th_v, 0, sizeof(th_v));
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->prefilter_pcre = true;
+
+    Signature *s1 = DetectEngineAppendSig(
+            de_ctx, "alert tcp any any -> any any (pcre:\"/ab+c/\"; sid:1;)");
+    FAIL_IF_NULL(s1);
+    Signature *s2 = DetectEngineAppendSig(
+            de_ctx, "alert tcp any any -> any any (pcre:!\"/xyz/\"; sid:2;)");
+    FAIL_IF_NULL(s2);
+    SigGroupBuild(de_ctx);
+    FAIL_IF_NOT(s1->flags & SIG_FLAG_PREFILTER);
+    FAIL_IF(s2->flags & SIG_FLAG_PREFILTER);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    uint8_t buf1[] = "xxabbbcyy";
+    Packet *p1 = UTHBuildPacket(buf1, sizeof(buf1) - 1, IPPROTO_TCP);
+    FAIL_IF_NULL(p1);
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p1);
+    FAIL_IF_NOT(PacketAlertCheck(p1, 1));
+    FAIL_IF_NOT(PacketAlertCheck(p1, 2));
+
+    uint8_t buf2[] = "xxacyz";
+    Packet *p2 = UTHBuildPacket(buf2, sizeof(buf2) - 1, IPPROTO_TCP);
+    FAIL_IF_NULL(p2);
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p2);
+    FAIL_IF(PacketAlertCheck(p2, 1));
+    FAIL_IF_NOT(PacketAlertCheck(p2, 2));
+
+    UTHFreePackets(&p1, 1);
+    UTHFreePackets(&p2, 1);
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
+/** \test the prefilter keyword checks the pcre it applies to */
+static int DetectPcrePrefilterTest02(void)
+{
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    /* negated last pcre */
+    Signature *s = DetectEngineAppendSig(de_ctx,
+            "alert tcp any any -> any any (pcre:\"/foo/\"; pcre:!\"/bar/\"; prefilter; sid:1;)");
+    FAIL_IF_NOT_NULL(s);
+    /* relative last pcre */
+    s = DetectEngineAppendSig(de_ctx,
+            "alert tcp any any -> any any (pcre:\"/foo/\"; pcre:\"/bar/R\"; prefilter; sid:2;)");
+    FAIL_IF_NOT_NULL(s);
+    /* the negated pcre isn't the prefilter one */
+    s = DetectEngineAppendSig(de_ctx,
+            "alert tcp any any -> any any (pcre:!\"/bar/\"; pcre:\"/foo/\"; prefilter; sid:3;)");
+    FAIL_IF_NULL(s);
+    FAIL_IF_NULL(s->init_data->prefilter_sm);
+    const DetectPcreData *pd = (const DetectPcreData *)s->init_data->prefilter_sm->ctx;
+    FAIL_IF(pd->flags & DETECT_PCRE_NEGATE);
+    FAIL_IF_NOT(DetectPcreSupportsPrefilter(s, s->init_data->prefilter_sm));
+
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+#endif
+
 /**
  * \brief Test parsing of capture extension
  */
@@ -2062,5 +2847,11 @@ static void DetectPcreRegisterTests(void)
 
     UtRegisterTest("DetectPcreParseHttpHost", DetectPcreParseHttpHost);
     UtRegisterTest("DetectPcreParseCaptureTest", DetectPcreParseCaptureTest);
+    UtRegisterTest("DetectPcreSharedTest01", DetectPcreSharedTest01);
+    UtRegisterTest("DetectPcreThreadArenaTest01", DetectPcreThreadArenaTest01);
+#ifdef BUILD_HYPERSCAN
+    UtRegisterTest("DetectPcrePrefilterTest01", DetectPcrePrefilterTest01);
+    UtRegisterTest("DetectPcrePrefilterTest02", DetectPcrePrefilterTest02);
+#endif
 }
 #endif /* UNITTESTS */
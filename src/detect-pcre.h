@@ -39,9 +39,18 @@
 #define SC_MATCH_LIMIT_DEFAULT           3500
 #define SC_MATCH_LIMIT_RECURSION_DEFAULT 1500
 
+#define SC_PCRE_JIT_STACK_START          (32 * 1024)
+#define SC_PCRE_JIT_STACK_MAX_DEFAULT    (512 * 1024)
+
+struct DetectPcreShared_;
+
 typedef struct DetectPcreData_ {
     DetectParseRegex parse_regex;
-    int thread_ctx_id;
+    /** compiled regex shared between detect engines, owns parse_regex */
+    struct DetectPcreShared_ *shared;
+    /** ovector pairs needed in the match data: capture count + 1 */
+    uint32_t ovector_size;
+    bool match_limit;
 
     uint16_t flags;
     uint8_t idx;
@@ -55,6 +64,8 @@ int DetectPcrePayloadMatch(DetectEngineThreadCtx *,
         const Signature *, const SigMatchData *,
         Packet *, Flow *, const uint8_t *, uint32_t);
 
+bool DetectPcreSupportsPrefilter(const Signature *s, const SigMatch *sm);
+
 void DetectPcreRegister (void);
 
 #endif /* SURICATA_DETECT_PCRE_H */
@@ -29,6 +29,7 @@
 #include "detect.h"
 #include "detect-parse.h"
 #include "detect-content.h"
+#include "detect-pcre.h"
 #include "detect-prefilter.h"
 #include "util-debug.h"
 
@@ -87,6 +88,18 @@ static int DetectPrefilterSetup (DetectEngineCtx *de_ctx, Signature *s, const ch
             SCReturnInt(-1);
         }
         cd->flags |= DETECT_CONTENT_FAST_PATTERN;
+    } else if (sm->type == DETECT_PCRE) {
+        const DetectPcreData *pd = (const DetectPcreData *)sm->ctx;
+        if (pd->flags & (DETECT_PCRE_NEGATE | DETECT_PCRE_RELATIVE)) {
+            SCLogError("prefilter; cannot be used with negated or relative pcre");
+            SCReturnInt(-1);
+        }
+        if (!DetectPcreSupportsPrefilter(s, sm)) {
+            SCLogError("prefilter is not supported for pcre in this context");
+            SCReturnInt(-1);
+        }
+        s->flags |= SIG_FLAG_PREFILTER;
+        de_ctx->sm_types_prefilter[DETECT_PCRE] = true;
     } else {
         if (sigmatch_table[sm->type].SupportsPrefilter == NULL) {
             SCLogError("prefilter is not supported for %s", sigmatch_table[sm->type].name);
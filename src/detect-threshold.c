@@ -393,6 +393,7 @@ error:
 #include "util-hashlist.h"
 #include "packet.h"
 #include "action-globals.h"
+#include "conf.h"
 
 /**
  * \test ThresholdTestParse01 is a test for a valid threshold options
@@ -1716,6 +1717,149 @@ static int DetectThresholdTestSig14(void)
     PASS;
 }
 
+/**
+ * \test limit in approximate mode: a single thread gets the same alerts as
+ *       in exact mode, with most hits handled locally.
+ */
+static int DetectThresholdTestApproximate01(void)
+{
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx;
+    int alerts = 0;
+
+    ConfCreateContextBackup();
+    ConfInit();
+    FAIL_IF_NOT(ConfSet("detect.thresholds.approximate.enabled", "yes"));
+    ThresholdInit();
+    FAIL_IF_NOT(ThresholdsApproximate());
+
+    memset(&th_v, 0, sizeof(th_v));
+    Packet *p = UTHBuildPacketReal((uint8_t *)"A", 1, IPPROTO_TCP, "1.1.1.1", "2.2.2.2", 1024, 80);
+    FAIL_IF_NULL(p);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    Signature *s = DetectEngineAppendSig(de_ctx,
+            "alert tcp any any -> any 80 (msg:\"Threshold limit\"; content:\"A\"; "
+            "threshold: type limit, track by_rule, count 5, seconds 60; sid:1;)");
+    FAIL_IF_NULL(s);
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    for (int i = 0; i < 8; i++) {
+        SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+        alerts += PacketAlertCheck(p, 1);
+    }
+    FAIL_IF_NOT(alerts == 5);
+
+    /* first hit, reaching the count and going over it */
+    FAIL_IF_NULL(det_ctx->threshold_merges);
+    FAIL_IF_NOT(det_ctx->threshold_merges[s->num] == 3);
+
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    FAIL_IF_NULL(de_ctx->threshold_merges);
+    FAIL_IF_NOT(de_ctx->threshold_merges[s->num] == 3);
+    DetectEngineCtxFree(de_ctx);
+    UTHFreePackets(&p, 1);
+    ThresholdDestroy();
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+
+typedef struct ThresholdTestWorker_ {
+    ThreadVars tv;
+    DetectEngineCtx *de_ctx;
+    DetectEngineThreadCtx *det_ctx;
+    Packet *p;
+    /** time of the first hits, the second ones are a second later */
+    uint64_t start;
+    int hits[2];
+    int alerts[2];
+} ThresholdTestWorker;
+
+static void *ThresholdTestWorkerRun(void *data)
+{
+    ThresholdTestWorker *w = data;
+    for (int sec = 0; sec < 2; sec++) {
+        w->p->ts = SCTIME_FROM_SECS(w->start + sec);
+        for (int i = 0; i < w->hits[sec]; i++) {
+            SigMatchSignatures(&w->tv, w->de_ctx, w->det_ctx, w->p);
+            w->alerts[0] += PacketAlertCheck(w->p, 1);
+            w->alerts[1] += PacketAlertCheck(w->p, 2);
+        }
+    }
+    ThresholdCacheThreadFree();
+    return NULL;
+}
+
+/**
+ * \test approximate mode with two workers: hits held back by both are
+ *       merged into the global count, and type both still alerts once.
+ */
+static int DetectThresholdTestApproximate02(void)
+{
+    ConfCreateContextBackup();
+    ConfInit();
+    FAIL_IF_NOT(ConfSet("detect.thresholds.approximate.enabled", "yes"));
+    ThresholdInit();
+    FAIL_IF_NOT(ThresholdsApproximate());
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    Signature *s = DetectEngineAppendSig(de_ctx,
+            "alert tcp any any -> any 80 (content:\"A\"; "
+            "threshold: type threshold, track by_rule, count 10, seconds 60; sid:1;)");
+    FAIL_IF_NULL(s);
+    s = DetectEngineAppendSig(de_ctx, "alert tcp any any -> any 80 (content:\"A\"; "
+                                      "threshold: type both, track by_rule, count 5, seconds 60; "
+                                      "sid:2;)");
+    FAIL_IF_NULL(s);
+    SigGroupBuild(de_ctx);
+
+    ThresholdTestWorker w[2];
+    memset(&w, 0, sizeof(w));
+    for (int i = 0; i < 2; i++) {
+        w[i].de_ctx = de_ctx;
+        DetectEngineThreadCtxInit(&w[i].tv, (void *)de_ctx, (void *)&w[i].det_ctx);
+        w[i].p = UTHBuildPacketReal(
+                (uint8_t *)"A", 1, IPPROTO_TCP, "1.1.1.1", "2.2.2.2", 1024, 80);
+        FAIL_IF_NULL(w[i].p);
+        w[i].start = 1000 + i;
+        /* most hits are held back and merged a second later */
+        w[i].hits[0] = 4;
+        w[i].hits[1] = 1;
+    }
+
+    /* one worker after the other, each in its own thread */
+    for (int i = 0; i < 2; i++) {
+        pthread_t t;
+        FAIL_IF(pthread_create(&t, NULL, ThresholdTestWorkerRun, &w[i]) != 0);
+        pthread_join(t, NULL);
+    }
+
+    /* the 10th hit overall, the second worker's last one */
+    FAIL_IF_NOT(w[0].alerts[0] == 0);
+    FAIL_IF_NOT(w[1].alerts[0] == 1);
+    /* the 5th hit overall, the first worker's last one */
+    FAIL_IF_NOT(w[0].alerts[1] == 1);
+    FAIL_IF_NOT(w[1].alerts[1] == 0);
+
+    for (int i = 0; i < 2; i++) {
+        DetectEngineThreadCtxDeinit(&w[i].tv, (void *)w[i].det_ctx);
+        UTHFreePackets(&w[i].p, 1);
+    }
+    DetectEngineCtxFree(de_ctx);
+    ThresholdDestroy();
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+
 static void ThresholdRegisterTests(void)
 {
     UtRegisterTest("ThresholdTestParse01", ThresholdTestParse01);
@@ -1741,6 +1885,8 @@ static void ThresholdRegisterTests(void)
     UtRegisterTest("DetectThresholdTestSig12", DetectThresholdTestSig12);
     UtRegisterTest("DetectThresholdTestSig13", DetectThresholdTestSig13);
     UtRegisterTest("DetectThresholdTestSig14", DetectThresholdTestSig14);
+    UtRegisterTest("DetectThresholdTestApproximate01", DetectThresholdTestApproximate01);
+    UtRegisterTest("DetectThresholdTestApproximate02", DetectThresholdTestApproximate02);
 }
 #endif /* UNITTESTS */
 
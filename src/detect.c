@@ -29,6 +29,7 @@
 #include "decode.h"
 #include "packet.h"
 #include "flow.h"
+#include "flow-bit.h"
 #include "stream-tcp.h"
 #include "app-layer.h"
 #include "app-layer-parser.h"
@@ -415,9 +416,11 @@ DetectPrefilterSetNonPrefilterList(const Packet *p, DetectEngineThreadCtx *det_c
     if ((p->proto == IPPROTO_TCP) && PacketIsTCP(p) && (PacketGetTCP(p)->th_flags & TH_SYN)) {
         det_ctx->non_pf_store_ptr = scratch->sgh->non_pf_syn_store_array;
         det_ctx->non_pf_store_cnt = scratch->sgh->non_pf_syn_store_cnt;
+        det_ctx->non_pf_syn = true;
     } else {
         det_ctx->non_pf_store_ptr = scratch->sgh->non_pf_other_store_array;
         det_ctx->non_pf_store_cnt = scratch->sgh->non_pf_other_store_cnt;
+        det_ctx->non_pf_syn = false;
     }
     SCLogDebug("sgh non_pf ptr %p cnt %u (syn %p/%u, other %p/%u)",
             det_ctx->non_pf_store_ptr, det_ctx->non_pf_store_cnt,
@@ -605,7 +608,7 @@ static inline bool DetectRunInspectRuleHeader(const Packet *p, const Flow *f, co
         DEBUG_VALIDATE_BUG_ON(f == NULL);
 
         /* no flowvars? skip this sig */
-        const bool fv = f->flowvar != NULL;
+        const bool fv = f->flowvar != NULL || FlowHasFlowBits(f);
         if (fv == false) {
             SCLogDebug("skipping sig as the flow has no flowvars and sig "
                     "has SIG_FLAG_REQUIRE_FLOWVAR flag set.");
@@ -869,6 +872,7 @@ static DetectRunScratchpad DetectRunSetup(
     det_ctx->base64_decoded_len = 0;
     det_ctx->raw_stream_progress = 0;
     det_ctx->match_array_cnt = 0;
+    det_ctx->content_filter_buf = NULL;
 
     det_ctx->alert_queue_size = 0;
     p->alerts.drop.action = 0;
@@ -911,12 +915,16 @@ static DetectRunScratchpad DetectRunSetup(
             /* first time we inspect flow with this de_ctx, reset */
             pflow->flags &= ~FLOW_SGH_TOSERVER;
             pflow->flags &= ~FLOW_SGH_TOCLIENT;
+            /* the ip-only rules of the new de_ctx haven't seen this flow */
+            pflow->flags &= ~(FLOW_TOSERVER_IPONLY_SET | FLOW_TOCLIENT_IPONLY_SET);
             pflow->sgh_toserver = NULL;
             pflow->sgh_toclient = NULL;
 
             pflow->de_ctx_version = de_ctx->version;
             GenericVarFree(pflow->flowvar);
             pflow->flowvar = NULL;
+            FlowBitsFree(pflow->flowbits);
+            pflow->flowbits = NULL;
 
             DetectEngineStateResetTxs(pflow);
         }
@@ -1038,27 +1046,6 @@ static int RuleMatchCandidateTxArrayExpand(DetectEngineThreadCtx *det_ctx, const
     return 1;
 }
 
-/** \internal
- *  \brief sort helper for sorting match candidates by id: ascending
- *
- *  The id field is set from Signature::num, so we sort the candidates to match the signature
- *  sort order (ascending), where candidates that have flags go first.
- */
-static int
-DetectRunTxSortHelper(const void *a, const void *b)
-{
-    const RuleMatchCandidateTx *s0 = a;
-    const RuleMatchCandidateTx *s1 = b;
-    if (s1->id == s0->id) {
-        if (s1->flags && !s0->flags)
-            return 1;
-        else if (!s1->flags && s0->flags)
-            return -1;
-        return 0;
-    } else
-        return s0->id > s1->id ? 1 : -1;
-}
-
 #if 0
 #define TRACE_SID_TXS(sid,txs,...)          \
     do {                                    \
@@ -1413,7 +1400,7 @@ static inline void RuleMatchCandidateMergeStateRules(
                 // take the element from tx_candidates before merge
                 det_ctx->tx_candidates[k].s = det_ctx->tx_candidates[j].s;
                 det_ctx->tx_candidates[k].id = det_ctx->tx_candidates[j].id;
-                det_ctx->tx_candidates[k].flags = det_ctx->tx_candidates[j].flags;
+                det_ctx->tx_candidates[k].state_idx = det_ctx->tx_candidates[j].state_idx;
                 det_ctx->tx_candidates[k].stream_reset = det_ctx->tx_candidates[j].stream_reset;
                 continue;
             }
@@ -1423,7 +1410,7 @@ static inline void RuleMatchCandidateMergeStateRules(
         // take the element from match_array
         det_ctx->tx_candidates[k].s = s;
         det_ctx->tx_candidates[k].id = s->num;
-        det_ctx->tx_candidates[k].flags = NULL;
+        det_ctx->tx_candidates[k].state_idx = DE_STATE_IDX_NONE;
         det_ctx->tx_candidates[k].stream_reset = 0;
     }
     // Even if k > 0 or j > 0, the loop is over. (Note that j == k now)
@@ -1467,7 +1454,6 @@ static void DetectRunTx(ThreadVars *tv,
         }
         tx_id_min = tx.tx_id + 1; // next look for cur + 1
 
-        bool do_sort = false; // do we need to sort the tx candidate list?
         uint32_t array_idx = 0;
         uint32_t total_rules = det_ctx->match_array_cnt;
         total_rules += (tx.de_state ? tx.de_state->cnt : 0);
@@ -1491,7 +1477,7 @@ static void DetectRunTx(ThreadVars *tv,
                 const SigIntId id = s->num;
                 det_ctx->tx_candidates[array_idx].s = s;
                 det_ctx->tx_candidates[array_idx].id = id;
-                det_ctx->tx_candidates[array_idx].flags = NULL;
+                det_ctx->tx_candidates[array_idx].state_idx = DE_STATE_IDX_NONE;
                 det_ctx->tx_candidates[array_idx].stream_reset = 0;
                 array_idx++;
             }
@@ -1521,39 +1507,41 @@ static void DetectRunTx(ThreadVars *tv,
                 tx.de_state->flags &= ~DETECT_ENGINE_STATE_FLAG_FILE_NEW;
             }
 
-            SigIntId state_cnt = 0;
-            DeStateStore *tx_store = tx.de_state->head;
-            for (; tx_store != NULL; tx_store = tx_store->next) {
-                SCLogDebug("tx_store %p", tx_store);
-
-                SigIntId store_cnt = 0;
-                for (store_cnt = 0;
-                        store_cnt < DE_STATE_CHUNK_SIZE && state_cnt < tx.de_state->cnt;
-                        store_cnt++, state_cnt++)
-                {
-                    DeStateStoreItem *item = &tx_store->store[store_cnt];
-                    SCLogDebug("rule id %u, inspect_flags %u", item->sid, item->flags);
-                    if (have_new_file && (item->flags & DE_STATE_FLAG_FILE_INSPECT)) {
-                        /* remove part of the state. File inspect engine will now
-                         * be able to run again */
-                        item->flags &= ~(DE_STATE_FLAG_SIG_CANT_MATCH|DE_STATE_FLAG_FULL_INSPECT|DE_STATE_FLAG_FILE_INSPECT);
-                        SCLogDebug("rule id %u, post file reset inspect_flags %u", item->sid, item->flags);
-                    }
-                    det_ctx->tx_candidates[array_idx].s = de_ctx->sig_array[item->sid];
-                    det_ctx->tx_candidates[array_idx].id = item->sid;
-                    det_ctx->tx_candidates[array_idx].flags = &item->flags;
-                    det_ctx->tx_candidates[array_idx].stream_reset = 0;
-                    array_idx++;
+            /* both the candidates and the store are sorted by id, so merge
+             * them from the back. Stored state goes before a candidate with
+             * the same id. */
+            DeStateStoreSort(tx.de_state);
+            const SigIntId state_cnt = tx.de_state->cnt;
+            StatsAddUI64(tv, det_ctx->counter_tx_state_sigs_avg, state_cnt);
+            StatsSetUI64(tv, det_ctx->counter_tx_state_sigs_max, state_cnt);
+
+            uint32_t j = old;
+            uint32_t k = old + state_cnt;
+            for (SigIntId n = state_cnt; n > 0;) {
+                k--;
+                if (j > 0 && det_ctx->tx_candidates[j - 1].id >= tx.de_state->items[n - 1].sid) {
+                    j--;
+                    det_ctx->tx_candidates[k] = det_ctx->tx_candidates[j];
+                    continue;
+                }
+                n--;
+                DeStateStoreItem *item = &tx.de_state->items[n];
+                SCLogDebug("rule id %u, inspect_flags %u", item->sid, item->flags);
+                if (have_new_file && (item->flags & DE_STATE_FLAG_FILE_INSPECT)) {
+                    /* remove part of the state. File inspect engine will now
+                     * be able to run again */
+                    item->flags &= ~(DE_STATE_FLAG_SIG_CANT_MATCH|DE_STATE_FLAG_FULL_INSPECT|DE_STATE_FLAG_FILE_INSPECT);
+                    SCLogDebug("rule id %u, post file reset inspect_flags %u", item->sid, item->flags);
                 }
+                det_ctx->tx_candidates[k].s = de_ctx->sig_array[item->sid];
+                det_ctx->tx_candidates[k].id = item->sid;
+                det_ctx->tx_candidates[k].state_idx = n;
+                det_ctx->tx_candidates[k].stream_reset = 0;
             }
-            do_sort |= (old && old != array_idx); // sort if continue list adds sids
+            array_idx += state_cnt;
             SCLogDebug("%p/%" PRIu64 " rules added from 'continue' list: %u", tx.tx_ptr, tx.tx_id,
                     array_idx - old);
         }
-        if (do_sort) {
-            qsort(det_ctx->tx_candidates, array_idx, sizeof(RuleMatchCandidateTx),
-                    DetectRunTxSortHelper);
-        }
 
 #ifdef PROFILING
         if (array_idx >= de_ctx->profile_match_logging_threshold)
@@ -1567,14 +1555,16 @@ static void DetectRunTx(ThreadVars *tv,
         for (uint32_t i = 0; i < array_idx; i++) {
             RuleMatchCandidateTx *can = &det_ctx->tx_candidates[i];
             const Signature *s = det_ctx->tx_candidates[i].s;
-            SCLogDebug("%u: sid %u flags %p", i, s->id, can->flags);
+            SCLogDebug("%u: sid %u state_idx %u", i, s->id, can->state_idx);
         }
 #endif
         /* run rules: inspect the match candidates */
         for (uint32_t i = 0; i < array_idx; i++) {
             RuleMatchCandidateTx *can = &det_ctx->tx_candidates[i];
             const Signature *s = det_ctx->tx_candidates[i].s;
-            uint32_t *inspect_flags = det_ctx->tx_candidates[i].flags;
+            uint32_t *inspect_flags = can->state_idx != DE_STATE_IDX_NONE
+                                              ? &tx.de_state->items[can->state_idx].flags
+                                              : NULL;
 
             /* deduplicate: rules_array is sorted, but not deduplicated:
              * both mpm and stored state could give us the same sid.
@@ -1722,7 +1712,7 @@ static void DetectRunFrames(ThreadVars *tv, DetectEngineCtx *de_ctx, DetectEngin
                 const SigIntId id = s->num;
                 det_ctx->tx_candidates[array_idx].s = s;
                 det_ctx->tx_candidates[array_idx].id = id;
-                det_ctx->tx_candidates[array_idx].flags = NULL;
+                det_ctx->tx_candidates[array_idx].state_idx = DE_STATE_IDX_NONE;
                 det_ctx->tx_candidates[array_idx].stream_reset = 0;
                 array_idx++;
             }
@@ -1736,7 +1726,7 @@ static void DetectRunFrames(ThreadVars *tv, DetectEngineCtx *de_ctx, DetectEngin
                 const SigIntId id = s->num;
                 det_ctx->tx_candidates[array_idx].s = s;
                 det_ctx->tx_candidates[array_idx].id = id;
-                det_ctx->tx_candidates[array_idx].flags = NULL;
+                det_ctx->tx_candidates[array_idx].state_idx = DE_STATE_IDX_NONE;
                 det_ctx->tx_candidates[array_idx].stream_reset = 0;
                 array_idx++;
 
@@ -1890,8 +1880,19 @@ TmEcode Detect(ThreadVars *tv, Packet *p, void *data)
     if (det_ctx->mt_det_ctxs_cnt > 0 && det_ctx->TenantGetId != NULL)
     {
         uint32_t tenant_id = p->tenant_id;
-        if (tenant_id == 0)
-            tenant_id = det_ctx->TenantGetId(det_ctx, p);
+        if (tenant_id == 0) {
+            Flow *f = p->flow;
+            if (f != NULL && det_ctx->tenant_version != 0 &&
+                    f->tenant_version == det_ctx->tenant_version) {
+                tenant_id = f->tenant_id;
+            } else {
+                tenant_id = det_ctx->TenantGetId(det_ctx, p);
+                if (f != NULL && det_ctx->tenant_version != 0) {
+                    f->tenant_id = tenant_id;
+                    f->tenant_version = det_ctx->tenant_version;
+                }
+            }
+        }
         if (tenant_id > 0 && tenant_id < det_ctx->mt_det_ctxs_cnt) {
             p->tenant_id = tenant_id;
             det_ctx = GetTenantById(det_ctx->mt_det_ctxs_hash, tenant_id);
@@ -39,6 +39,7 @@
 #include "util-hashlist.h"
 #include "util-radix4-tree.h"
 #include "util-radix6-tree.h"
+#include "util-lpm.h"
 #include "util-file.h"
 #include "reputation.h"
 
@@ -599,6 +600,19 @@ typedef struct SignatureInitData_ {
     uint32_t max_content_list_id;
 } SignatureInitData;
 
+/** size in bits of the per buffer bigram map used by the content filter */
+#define DETECT_CONTENT_FILTER_MAP_BITS 4096
+/** max number of bigrams checked by a signature's content filter */
+#define DETECT_CONTENT_FILTER_MAX      8
+
+/** \brief bigrams of the payload contents that must be present in the
+ *         buffer for the signature to be able to match. Checked against
+ *         the buffer bigram map before the full content inspection. */
+typedef struct SigContentFilter_ {
+    uint8_t cnt;
+    uint16_t bits[DETECT_CONTENT_FILTER_MAX];
+} SigContentFilter;
+
 /** \brief Signature container */
 typedef struct Signature_ {
     uint32_t flags;
@@ -658,6 +672,9 @@ typedef struct Signature_ {
     /* memory is still owned by the sm_lists/sm_arrays entry */
     const struct DetectFilestoreData_ *filestore_ctx;
 
+    /** optional filter checked before payload content inspection */
+    SigContentFilter *content_filter;
+
     char *msg;
 
     /** classification message */
@@ -771,6 +788,11 @@ typedef struct DetectEngineIPOnlyCtx_ {
     SCRadix4Tree tree_ipv4src, tree_ipv4dst;
     SCRadix6Tree tree_ipv6src, tree_ipv6dst;
 
+    /* Lookup tables compiled from the trees. NULL if a tree is empty or
+     * too large for a table, then the tree is used. */
+    SCLpm *lpm_ipv4src, *lpm_ipv4dst;
+    SCLpm *lpm_ipv6src, *lpm_ipv6dst;
+
     /* Used to build the radix trees */
     IPOnlyCIDRItem *ip_src, *ip_dst;
     uint32_t max_idx;
@@ -878,6 +900,9 @@ typedef struct DetectEngineCtx_ {
     HashListTable *mpm_hash_table;
     HashListTable *pattern_hash_table;
 
+    /* non prefilter arrays shared between sgh's */
+    HashListTable *non_pf_store_hash_table;
+
     /* hash table used to cull out duplicate sigs */
     HashListTable *dup_sig_hash_table;
 
@@ -892,6 +917,13 @@ typedef struct DetectEngineCtx_ {
     /* force app-layer tx finding for alerts with signatures not having app-layer keywords */
     bool guess_applayer;
 
+    /* check the signature content filter before payload inspection */
+    bool content_filter;
+
+    /* threshold approximate mode: merges per rule, indexed by Signature::num.
+     * Filled in from the detect threads when they are freed. */
+    uint64_t *threshold_merges;
+
     /* registration id for per thread ctx for the filemagic/file.magic keywords */
     int filemagic_thread_ctx_id;
 
@@ -977,6 +1009,10 @@ typedef struct DetectEngineCtx_ {
     /** are we using just mpm or also other prefilters */
     enum DetectEnginePrefilterSetting prefilter_setting;
 
+    /** use the pcre prefilter for pcre only rules, even if prefilter_setting
+     *  is DETECT_PREFILTER_MPM */
+    bool prefilter_pcre;
+
     HashListTable *dport_hash_table;
 
     DetectPort *tcp_priorityports;
@@ -1050,6 +1086,12 @@ typedef struct DetectEngineCtx_ {
 
     /* number of signatures using filestore, limited as u16 */
     uint16_t filestore_cnt;
+
+    /* pcre usage for the memory report. Compiled expressions are shared
+     * with other engines (tenants, reloads) through a global table. */
+    uint32_t pcre_cnt;
+    uint32_t pcre_shared_cnt;
+    uint64_t pcre_memory;
 } DetectEngineCtx;
 
 /* Engine groups profiles (low, medium, high, custom) */
@@ -1080,7 +1122,9 @@ typedef struct SignatureNonPrefilterStore_ {
 /** array of TX inspect rule candidates */
 typedef struct RuleMatchCandidateTx {
     SigIntId id;            /**< internal signature id */
-    uint32_t *flags;        /**< inspect flags ptr */
+    /** index of the sig's item in the tx's stored state, DE_STATE_IDX_NONE
+     *  if it has none. An index as the store may grow during inspection. */
+    uint32_t state_idx;
     union {
         struct {
             bool stream_stored;
@@ -1117,7 +1161,14 @@ typedef struct DetectEngineThreadCtx_ {
     struct DetectEngineTenantMapping_ *tenant_array;
     uint32_t tenant_array_size;
 
+    /** threshold approximate mode: merges per rule, indexed by
+     *  Signature::num */
+    uint64_t *threshold_merges;
+
     uint32_t (*TenantGetId)(const void *, const Packet *p);
+    /** version of the tenant mapping, 0 if the selector key is not part of
+     *  the flow tracking so the tenant can't be cached in the flow */
+    uint16_t tenant_version;
 
     /* detection engine variables */
 
@@ -1137,6 +1188,12 @@ typedef struct DetectEngineThreadCtx_ {
     /* byte_* values */
     uint64_t *byte_values;
 
+    /* bigram map of the buffer the content filter was last evaluated on.
+     * Built on first use for each packet. */
+    const uint8_t *content_filter_buf;
+    uint32_t content_filter_buf_len;
+    uint64_t content_filter_map[DETECT_CONTENT_FILTER_MAP_BITS / 64];
+
     uint8_t *base64_decoded;
     int base64_decoded_len;
     int base64_decoded_len_max;
@@ -1150,6 +1207,16 @@ typedef struct DetectEngineThreadCtx_ {
     uint16_t counter_alerts_overflow;
     /** id for suppressed alerts counter */
     uint16_t counter_alerts_suppressed;
+    /** id for content filter rejects counter */
+    uint16_t counter_content_filter_rejects;
+    /** id for dataset lookups counter */
+    uint16_t counter_dataset_lookups;
+    /** ids for threshold approximate mode counters */
+    uint16_t counter_threshold_local;
+    uint16_t counter_threshold_merges;
+    /** ids for the stored state sigs per tx counters */
+    uint16_t counter_tx_state_sigs_avg;
+    uint16_t counter_tx_state_sigs_max;
 #ifdef PROFILING
     uint16_t counter_mpm_list;
     uint16_t counter_nonmpm_list;
@@ -1200,6 +1267,9 @@ typedef struct DetectEngineThreadCtx_ {
 
     SignatureNonPrefilterStore *non_pf_store_ptr;
     uint32_t non_pf_store_cnt;
+    /** non_pf_store_ptr is the SYN list. The SYN and other lists can be
+     *  the same array, so the pointer doesn't tell. */
+    bool non_pf_syn;
 
     MpmThreadCtx mtc; /**< thread ctx for the mpm */
     PrefilterRuleStore pmq;
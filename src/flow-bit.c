@@ -43,42 +43,52 @@
 #include "util-unittest.h"
 
 /* get the flowbit with idx from the flow */
-static FlowBit *FlowBitGet(Flow *f, uint32_t idx)
+static bool FlowBitGet(const Flow *f, uint32_t idx)
 {
-    GenericVar *gv = f->flowvar;
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-            return (FlowBit *)gv;
-        }
-    }
-
-    return NULL;
+    const FlowBits *fb = f->flowbits;
+    if (fb == NULL || idx / 64 >= fb->words)
+        return false;
+    return (fb->bits[idx / 64] & BIT_U64(idx % 64)) != 0;
 }
 
-/* add a flowbit to the flow */
 static void FlowBitAdd(Flow *f, uint32_t idx)
 {
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb == NULL) {
-        fb = SCMalloc(sizeof(FlowBit));
-        if (unlikely(fb == NULL))
+    FlowBits *fb = f->flowbits;
+    const uint32_t need = idx / 64 + 1;
+    if (fb == NULL || need > fb->words) {
+        const uint32_t old = fb ? fb->words : 0;
+        uint32_t words = MAX(old * 2, 2);
+        while (words < need)
+            words *= 2;
+
+        FlowBits *nfb = SCRealloc(fb, sizeof(FlowBits) + words * sizeof(uint64_t));
+        if (unlikely(nfb == NULL))
             return;
+        if (fb == NULL)
+            nfb->cnt = 0;
+        memset(&nfb->bits[old], 0, (words - old) * sizeof(uint64_t));
+        nfb->words = words;
+        f->flowbits = fb = nfb;
+    }
 
-        fb->type = DETECT_FLOWBITS;
-        fb->idx = idx;
-        fb->next = NULL;
-        GenericVarAppend(&f->flowvar, (GenericVar *)fb);
+    const uint64_t bit = BIT_U64(idx % 64);
+    if ((fb->bits[idx / 64] & bit) == 0) {
+        fb->bits[idx / 64] |= bit;
+        fb->cnt++;
     }
 }
 
 static void FlowBitRemove(Flow *f, uint32_t idx)
 {
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb == NULL)
+    FlowBits *fb = f->flowbits;
+    if (fb == NULL || idx / 64 >= fb->words)
         return;
 
-    GenericVarRemove(&f->flowvar, (GenericVar *)fb);
-    FlowBitFree(fb);
+    const uint64_t bit = BIT_U64(idx % 64);
+    if (fb->bits[idx / 64] & bit) {
+        fb->bits[idx / 64] &= ~bit;
+        fb->cnt--;
+    }
 }
 
 void FlowBitSet(Flow *f, uint32_t idx)
@@ -93,8 +103,7 @@ void FlowBitUnset(Flow *f, uint32_t idx)
 
 void FlowBitToggle(Flow *f, uint32_t idx)
 {
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb != NULL) {
+    if (FlowBitGet(f, idx)) {
         FlowBitRemove(f, idx);
     } else {
         FlowBitAdd(f, idx);
@@ -103,29 +112,36 @@ void FlowBitToggle(Flow *f, uint32_t idx)
 
 int FlowBitIsset(Flow *f, uint32_t idx)
 {
-    int r = 0;
-
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb != NULL) {
-        r = 1;
-    }
-
-    return r;
+    return FlowBitGet(f, idx) ? 1 : 0;
 }
 
 int FlowBitIsnotset(Flow *f, uint32_t idx)
 {
-    int r = 0;
+    return FlowBitGet(f, idx) ? 0 : 1;
+}
 
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb == NULL) {
-        r = 1;
+/**
+ * \brief get the lowest set flowbit id >= idx
+ *
+ * \retval id or 0 if there is none. Flowbit ids start at 1.
+ */
+uint32_t FlowBitNext(const Flow *f, uint32_t idx)
+{
+    const FlowBits *fb = f->flowbits;
+    if (fb == NULL || fb->cnt == 0)
+        return 0;
+
+    for (uint32_t w = idx / 64; w < fb->words; w++) {
+        uint64_t word = fb->bits[w];
+        if (w == idx / 64)
+            word &= ~0ULL << (idx % 64);
+        if (word != 0)
+            return w * 64 + (uint32_t)__builtin_ctzll(word);
     }
-
-    return r;
+    return 0;
 }
 
-void FlowBitFree(FlowBit *fb)
+void FlowBitsFree(FlowBits *fb)
 {
     if (fb == NULL)
         return;
@@ -133,8 +149,6 @@ void FlowBitFree(FlowBit *fb)
     SCFree(fb);
 }
 
-
-/* TESTS */
 #ifdef UNITTESTS
 static int FlowBitTest01 (void)
 {
@@ -143,10 +157,9 @@ static int FlowBitTest01 (void)
 
     FlowBitAdd(&f, 0);
 
-    FlowBit *fb = FlowBitGet(&f, 0);
-    FAIL_IF_NULL(fb);
+    FAIL_IF_NOT(FlowBitGet(&f, 0));
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -155,10 +168,9 @@ static int FlowBitTest02 (void)
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBit *fb = FlowBitGet(&f, 0);
-    FAIL_IF_NOT_NULL(fb);
+    FAIL_IF(FlowBitGet(&f, 0));
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -169,15 +181,13 @@ static int FlowBitTest03 (void)
 
     FlowBitAdd(&f, 0);
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    FAIL_IF_NULL(fb);
+    FAIL_IF_NOT(FlowBitGet(&f, 0));
 
     FlowBitRemove(&f, 0);
 
-    fb = FlowBitGet(&f, 0);
-    FAIL_IF_NOT_NULL(fb);
+    FAIL_IF(FlowBitGet(&f, 0));
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -191,10 +201,9 @@ static int FlowBitTest04 (void)
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f, 0);
-    FAIL_IF_NULL(fb);
+    FAIL_IF_NOT(FlowBitGet(&f, 0));
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -208,10 +217,9 @@ static int FlowBitTest05 (void)
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f, 1);
-    FAIL_IF_NULL(fb);
+    FAIL_IF_NOT(FlowBitGet(&f, 1));
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -225,10 +233,9 @@ static int FlowBitTest06 (void)
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f, 2);
-    FAIL_IF_NULL(fb);
+    FAIL_IF_NOT(FlowBitGet(&f, 2));
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -242,10 +249,9 @@ static int FlowBitTest07 (void)
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f, 3);
-    FAIL_IF_NULL(fb);
+    FAIL_IF_NOT(FlowBitGet(&f, 3));
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -259,15 +265,13 @@ static int FlowBitTest08 (void)
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    FAIL_IF_NULL(fb);
+    FAIL_IF_NOT(FlowBitGet(&f, 0));
 
     FlowBitRemove(&f,0);
 
-    fb = FlowBitGet(&f, 0);
-    FAIL_IF_NOT_NULL(fb);
+    FAIL_IF(FlowBitGet(&f, 0));
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -281,15 +285,13 @@ static int FlowBitTest09 (void)
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,1);
-    FAIL_IF_NULL(fb);
+    FAIL_IF_NOT(FlowBitGet(&f, 1));
 
     FlowBitRemove(&f,1);
 
-    fb = FlowBitGet(&f, 1);
-    FAIL_IF_NOT_NULL(fb);
+    FAIL_IF(FlowBitGet(&f, 1));
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -303,15 +305,13 @@ static int FlowBitTest10 (void)
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,2);
-    FAIL_IF_NULL(fb);
+    FAIL_IF_NOT(FlowBitGet(&f, 2));
 
     FlowBitRemove(&f,2);
 
-    fb = FlowBitGet(&f, 2);
-    FAIL_IF_NOT_NULL(fb);
+    FAIL_IF(FlowBitGet(&f, 2));
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -325,15 +325,45 @@ static int FlowBitTest11 (void)
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,3);
-    FAIL_IF_NULL(fb);
+    FAIL_IF_NOT(FlowBitGet(&f, 3));
 
     FlowBitRemove(&f,3);
 
-    fb = FlowBitGet(&f, 3);
-    FAIL_IF_NOT_NULL(fb);
+    FAIL_IF(FlowBitGet(&f, 3));
+
+    FlowBitsFree(f.flowbits);
+    PASS;
+}
+
+/** \test growing the bitmap, toggle and iteration */
+static int FlowBitTest12(void)
+{
+    Flow f;
+    memset(&f, 0, sizeof(Flow));
 
-    GenericVarFree(f.flowvar);
+    FlowBitSet(&f, 5);
+    FlowBitSet(&f, 1000);
+    FAIL_IF_NOT(f.flowbits->words * 64 > 1000);
+    FAIL_IF_NOT(FlowBitIsset(&f, 5));
+    FAIL_IF_NOT(FlowBitIsset(&f, 1000));
+    FAIL_IF_NOT(FlowBitIsnotset(&f, 999));
+    FAIL_IF_NOT(FlowBitIsnotset(&f, 100000));
+
+    FlowBitToggle(&f, 64);
+    FAIL_IF_NOT(FlowBitIsset(&f, 64));
+    FAIL_IF_NOT(f.flowbits->cnt == 3);
+
+    FAIL_IF_NOT(FlowBitNext(&f, 0) == 5);
+    FAIL_IF_NOT(FlowBitNext(&f, 6) == 64);
+    FAIL_IF_NOT(FlowBitNext(&f, 65) == 1000);
+    FAIL_IF_NOT(FlowBitNext(&f, 1001) == 0);
+
+    FlowBitToggle(&f, 64);
+    FlowBitUnset(&f, 5);
+    FlowBitUnset(&f, 1000);
+    FAIL_IF(FlowHasFlowBits(&f));
+
+    FlowBitsFree(f.flowbits);
     PASS;
 }
 
@@ -353,6 +383,7 @@ void FlowBitRegisterTests(void)
     UtRegisterTest("FlowBitTest09", FlowBitTest09);
     UtRegisterTest("FlowBitTest10", FlowBitTest10);
     UtRegisterTest("FlowBitTest11", FlowBitTest11);
+    UtRegisterTest("FlowBitTest12", FlowBitTest12);
 #endif /* UNITTESTS */
 }
 
@@ -27,16 +27,19 @@
 #include "flow.h"
 #include "util-var.h"
 
-typedef struct FlowBit_ {
-    uint8_t type; /* type, DETECT_FLOWBITS in this case */
-    uint8_t pad[3];
-    uint32_t idx; /* name idx */
-    GenericVar *next; /* right now just implement this as a list,
-                       * in the long run we have think of something
-                       * faster. */
-} FlowBit;
+/** \brief flowbits of a flow
+ *
+ *  Flowbit ids are dense, so they index the bitmap directly. It's
+ *  allocated on the first set and grown to fit the highest id set. */
+typedef struct FlowBits_ {
+    /** size of bits in 64 bit words */
+    uint32_t words;
+    /** number of bits set */
+    uint32_t cnt;
+    uint64_t bits[];
+} FlowBits;
 
-void FlowBitFree(FlowBit *);
+void FlowBitsFree(FlowBits *);
 void FlowBitRegisterTests(void);
 
 void FlowBitSet(Flow *, uint32_t);
@@ -44,4 +47,11 @@ void FlowBitUnset(Flow *, uint32_t);
 void FlowBitToggle(Flow *, uint32_t);
 int FlowBitIsset(Flow *, uint32_t);
 int FlowBitIsnotset(Flow *, uint32_t);
+uint32_t FlowBitNext(const Flow *, uint32_t);
+
+/** \brief check if any flowbit is set on the flow */
+static inline bool FlowHasFlowBits(const Flow *f)
+{
+    return f->flowbits != NULL && f->flowbits->cnt > 0;
+}
 #endif /* SURICATA_FLOW_BIT_H */
@@ -39,6 +39,7 @@
 #include "flow-timeout.h"
 #include "flow-spare-pool.h"
 #include "flow-callbacks.h"
+#include "decode-sll.h"
 #include "app-layer-parser.h"
 
 #include "util-time.h"
@@ -46,6 +47,7 @@
 #include "util-device.h"
 
 #include "util-hash-lookup3.h"
+#include "util-unittest.h"
 
 #include "conf.h"
 #include "output.h"
@@ -60,7 +62,7 @@ FlowBucket *flow_hash;
 SC_ATOMIC_EXTERN(unsigned int, flow_prune_idx);
 SC_ATOMIC_EXTERN(unsigned int, flow_flags);
 
-static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv, const SCTime_t ts);
+static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv, const uint32_t sec);
 
 /** \brief compare two raw ipv6 addrs
  *
@@ -297,6 +299,151 @@ static inline uint32_t FlowGetHash(const Packet *p)
     return hash;
 }
 
+/** \brief set sorted ports for FlowGetRawHash, or fixed values if the
+ *         protocol has no ports or the header is incomplete */
+static inline void FlowGetRawHashPorts(
+        const uint8_t proto, const uint8_t *l4, const uint32_t l4_len, uint16_t ports[2])
+{
+    if (l4 != NULL && l4_len >= 4 &&
+            (proto == IPPROTO_TCP || proto == IPPROTO_UDP || proto == IPPROTO_SCTP)) {
+        const uint16_t sp = (uint16_t)(l4[0] << 8 | l4[1]);
+        const uint16_t dp = (uint16_t)(l4[2] << 8 | l4[3]);
+        const int pi = (sp > dp);
+        ports[1 - pi] = sp;
+        ports[pi] = dp;
+    } else {
+        ports[0] = 0xfeed;
+        ports[1] = 0xbeef;
+    }
+}
+
+/**
+ * \brief calculate the flow hash of an undecoded packet
+ *
+ * Only parses the link layer, up to 2 vlan tags and the IP header, so
+ * capture methods can spread packets over threads that do the decoding.
+ * Like FlowGetHash it's symmetric, so both directions of a flow get the
+ * same hash, but the values are not the same as FlowGetHash returns.
+ *
+ * Ports are only used for unfragmented TCP, UDP and SCTP packets, other
+ * packets are hashed on their addresses and protocol. Packets that can't
+ * be parsed get hash 0.
+ *
+ * \param datalink link type of the packet
+ * \param pkt packet data
+ * \param len length of the packet data
+ */
+uint32_t FlowGetRawHash(const int datalink, const uint8_t *pkt, const uint32_t len)
+{
+    uint32_t offset = 0;
+    uint16_t vlan_id[VLAN_MAX_LAYERS] = { 0 };
+
+    switch (datalink) {
+        case LINKTYPE_ETHERNET: {
+            if (len < ETHERNET_HEADER_LEN)
+                return 0;
+            uint16_t type = (uint16_t)(pkt[12] << 8 | pkt[13]);
+            offset = ETHERNET_HEADER_LEN;
+            for (uint8_t v = 0; v < 2 && (type == ETHERNET_TYPE_VLAN ||
+                                                 type == ETHERNET_TYPE_8021AD ||
+                                                 type == ETHERNET_TYPE_8021QINQ);
+                    v++) {
+                if (len < offset + 4)
+                    return 0;
+                vlan_id[v] = (uint16_t)((pkt[offset] << 8 | pkt[offset + 1]) & 0x0fff) &
+                             g_vlan_mask;
+                type = (uint16_t)(pkt[offset + 2] << 8 | pkt[offset + 3]);
+                offset += 4;
+            }
+            if (type != ETHERNET_TYPE_IP && type != ETHERNET_TYPE_IPV6)
+                return 0;
+            break;
+        }
+        case LINKTYPE_LINUX_SLL: {
+            if (len < SLL_HEADER_LEN)
+                return 0;
+            const uint16_t type = (uint16_t)(pkt[14] << 8 | pkt[15]);
+            if (type != ETHERNET_TYPE_IP && type != ETHERNET_TYPE_IPV6)
+                return 0;
+            offset = SLL_HEADER_LEN;
+            break;
+        }
+        case LINKTYPE_NULL:
+            offset = 4;
+            break;
+        case LINKTYPE_RAW:
+        case LINKTYPE_RAW2:
+        case LINKTYPE_IPV4:
+        case LINKTYPE_IPV6:
+            break;
+        default:
+            return 0;
+    }
+    if (len <= offset)
+        return 0;
+
+    const uint8_t *ip = pkt + offset;
+    const uint32_t ip_len = len - offset;
+    uint8_t proto = 0;
+    const uint8_t *l4 = NULL;
+    uint32_t l4_len = 0;
+
+    if ((ip[0] >> 4) == 4) {
+        if (ip_len < IPV4_HEADER_LEN)
+            return 0;
+        const uint32_t hlen = (ip[0] & 0x0f) << 2;
+        if (hlen < IPV4_HEADER_LEN || hlen > ip_len)
+            return 0;
+
+        FlowHashKey4 fhk = { .pad[0] = 0 };
+        uint32_t src, dst;
+        memcpy(&src, ip + 12, sizeof(src));
+        memcpy(&dst, ip + 16, sizeof(dst));
+        const int ai = (src > dst);
+        fhk.addrs[1 - ai] = src;
+        fhk.addrs[ai] = dst;
+
+        proto = ip[9];
+        /* more fragments flag or a fragment offset */
+        const bool frag = ((ip[6] << 8 | ip[7]) & 0x3fff) != 0;
+        if (!frag) {
+            l4 = ip + hlen;
+            l4_len = ip_len - hlen;
+        }
+        FlowGetRawHashPorts(proto, l4, l4_len, fhk.ports);
+        fhk.proto = proto;
+        memcpy(fhk.vlan_id, vlan_id, sizeof(fhk.vlan_id));
+        return hashword(fhk.u32, ARRAY_SIZE(fhk.u32), flow_config.hash_rand);
+
+    } else if ((ip[0] >> 4) == 6) {
+        if (ip_len < IPV6_HEADER_LEN)
+            return 0;
+
+        FlowHashKey6 fhk = { .pad[0] = 0 };
+        uint32_t src[4], dst[4];
+        memcpy(src, ip + 8, sizeof(src));
+        memcpy(dst, ip + 24, sizeof(dst));
+        if (FlowHashRawAddressIPv6GtU32(src, dst)) {
+            memcpy(fhk.src, src, sizeof(fhk.src));
+            memcpy(fhk.dst, dst, sizeof(fhk.dst));
+        } else {
+            memcpy(fhk.src, dst, sizeof(fhk.src));
+            memcpy(fhk.dst, src, sizeof(fhk.dst));
+        }
+
+        /* extension headers are not followed, so packets with them
+         * are hashed on their addresses only */
+        proto = ip[6];
+        l4 = ip + IPV6_HEADER_LEN;
+        l4_len = ip_len - IPV6_HEADER_LEN;
+        FlowGetRawHashPorts(proto, l4, l4_len, fhk.ports);
+        fhk.proto = proto;
+        memcpy(fhk.vlan_id, vlan_id, sizeof(fhk.vlan_id));
+        return hashword(fhk.u32, ARRAY_SIZE(fhk.u32), flow_config.hash_rand);
+    }
+    return 0;
+}
+
 /**
  * Basic hashing function for FlowKey
  *
@@ -609,13 +756,14 @@ static inline Flow *FlowSpareSync(ThreadVars *tv, FlowLookupStruct *fls,
     Flow *f = NULL;
     bool spare_sync = false;
     if (emerg) {
-        if ((uint32_t)SCTIME_SECS(p->ts) > fls->emerg_spare_sync_stamp) {
+        const uint32_t sec = FlowGetTimeoutBase(p->ts);
+        if (sec > fls->emerg_spare_sync_stamp) {
             fls->spare_queue = FlowSpareGetFromPool(); /* local empty, (re)populate and try again */
             spare_sync = true;
             f = FlowQueuePrivateGetFromTop(&fls->spare_queue);
             if (f == NULL) {
                 /* wait till next full sec before retrying */
-                fls->emerg_spare_sync_stamp = (uint32_t)SCTIME_SECS(p->ts);
+                fls->emerg_spare_sync_stamp = sec;
             }
         }
     } else {
@@ -704,7 +852,7 @@ static Flow *FlowGetNew(ThreadVars *tv, FlowLookupStruct *fls, Packet *p)
                 FlowWakeupFlowManagerThread();
             }
 
-            f = FlowGetUsedFlow(tv, fls->dtv, p->ts);
+            f = FlowGetUsedFlow(tv, fls->dtv, FlowGetTimeoutBase(p->ts));
             if (f == NULL) {
                 NoFlowHandleIPS(tv, fls, p);
 #ifdef UNITTESTS
@@ -900,13 +1048,14 @@ Flow *FlowGetFlowFromHash(ThreadVars *tv, FlowLookupStruct *fls, Packet *p, Flow
 
     const bool emerg = (SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY) != 0;
     const uint32_t fb_nextts = !emerg ? SC_ATOMIC_GET(fb->next_ts) : 0;
+    /* same time base as the flow's timeout_at */
+    const uint32_t sec = FlowGetTimeoutBase(p->ts);
     /* ok, we have a flow in the bucket. Let's find out if it is our flow */
     Flow *prev_f = NULL; /* previous flow */
     f = fb->head;
     do {
         Flow *next_f = NULL;
-        const bool timedout = (fb_nextts < (uint32_t)SCTIME_SECS(p->ts) &&
-                               FlowIsTimedOut(f, (uint32_t)SCTIME_SECS(p->ts), emerg));
+        const bool timedout = (fb_nextts < sec && FlowIsTimedOut(f, sec, emerg));
         if (timedout) {
             FLOWLOCK_WRLOCK(f);
             next_f = f->next;
@@ -1039,6 +1188,16 @@ static Flow *FlowGetExistingFlowFromHash(FlowKey *key, const uint32_t hash)
     return NULL;
 }
 
+/** \brief Look for existing Flow using a FlowKey
+ *
+ *  \param key Pointer to FlowKey build using flow to look for
+ *  \retval f *LOCKED* flow or NULL
+ */
+Flow *FlowGetExistingFlowFromFlowKey(FlowKey *key)
+{
+    return FlowGetExistingFlowFromHash(key, FlowKeyGetHash(key));
+}
+
 /** \brief Get or create a Flow using a FlowKey
  *
  * Hash retrieval function for flows. Looks up the hash bucket containing the
@@ -1127,26 +1286,27 @@ static inline uint32_t GetUsedAtomicUpdate(const uint32_t val)
 /** \internal
  *  \brief check if flow has just seen an update.
  */
-static inline bool StillAlive(const Flow *f, const SCTime_t ts)
+static inline bool StillAlive(const Flow *f, const uint32_t sec)
 {
+    const uint32_t age = sec - FlowGetTimeoutBase(f->lastts);
     switch (f->flow_state) {
         case FLOW_STATE_NEW:
-            if (SCTIME_SECS(ts) - SCTIME_SECS(f->lastts) <= 1) {
+            if (age <= 1) {
                 return true;
             }
             break;
         case FLOW_STATE_ESTABLISHED:
-            if (SCTIME_SECS(ts) - SCTIME_SECS(f->lastts) <= 5) {
+            if (age <= 5) {
                 return true;
             }
             break;
         case FLOW_STATE_CLOSED:
-            if (SCTIME_SECS(ts) - SCTIME_SECS(f->lastts) <= 3) {
+            if (age <= 3) {
                 return true;
             }
             break;
         default:
-            if (SCTIME_SECS(ts) - SCTIME_SECS(f->lastts) < 30) {
+            if (age < 30) {
                 return true;
             }
             break;
@@ -1176,10 +1336,11 @@ static inline bool StillAlive(const Flow *f, const SCTime_t ts)
  *
  *  \param tv thread vars
  *  \param dtv decode thread vars (for flow log api thread data)
+ *  \param sec current time in seconds, see FlowGetTimeoutBase
  *
  *  \retval f flow or NULL
  */
-static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv, const SCTime_t ts)
+static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv, const uint32_t sec)
 {
     uint32_t idx = GetUsedAtomicUpdate(FLOW_GET_NEW_TRIES) % flow_config.hash_size;
     uint32_t tried = 0;
@@ -1214,7 +1375,7 @@ static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv, const SCTime
             continue;
         }
 
-        if (StillAlive(f, ts)) {
+        if (StillAlive(f, sec)) {
             STATSADDUI64(counter_flow_get_used_eval_reject, 1);
             FBLOCK_UNLOCK(fb);
             FLOWLOCK_UNLOCK(f);
@@ -1255,3 +1416,91 @@ static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv, const SCTime
     STATSADDUI64(counter_flow_get_used_failed, 1);
     return NULL;
 }
+
+#ifdef UNITTESTS
+/** \test raw hash is the same for both directions and ignores ports of
+ *        fragments */
+static int FlowGetRawHashTest01(void)
+{
+    uint8_t pkt[] = {
+        /* ethernet */
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x00, 0x01, 0x02, 0x03, 0x04, 0x06, 0x08, 0x00,
+        /* ipv4 */
+        0x45, 0x00, 0x00, 0x28, 0x00, 0x01, 0x00, 0x00, 0x40, 0x06, 0x00, 0x00, 0x0a, 0x00,
+        0x00, 0x01, 0x0a, 0x00, 0x00, 0x02,
+        /* tcp */
+        0x04, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x50, 0x02,
+        0x20, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    const uint32_t hash = FlowGetRawHash(LINKTYPE_ETHERNET, pkt, sizeof(pkt));
+
+    /* swap addresses and ports */
+    uint8_t rev[sizeof(pkt)];
+    memcpy(rev, pkt, sizeof(pkt));
+    memcpy(rev + 26, pkt + 30, 4);
+    memcpy(rev + 30, pkt + 26, 4);
+    memcpy(rev + 34, pkt + 36, 2);
+    memcpy(rev + 36, pkt + 34, 2);
+    FAIL_IF_NOT(FlowGetRawHash(LINKTYPE_ETHERNET, rev, sizeof(rev)) == hash);
+
+    /* other source port */
+    rev[34] = 0x05;
+    FAIL_IF(FlowGetRawHash(LINKTYPE_ETHERNET, rev, sizeof(rev)) == hash);
+
+    /* as raw ip */
+    FAIL_IF_NOT(FlowGetRawHash(LINKTYPE_RAW, pkt + 14, sizeof(pkt) - 14) == hash);
+
+    /* fragments only use the addresses */
+    pkt[20] = 0x20;
+    const uint32_t frag = FlowGetRawHash(LINKTYPE_ETHERNET, pkt, sizeof(pkt));
+    pkt[34] = 0x05;
+    FAIL_IF_NOT(FlowGetRawHash(LINKTYPE_ETHERNET, pkt, sizeof(pkt)) == frag);
+
+    /* truncated or unknown */
+    FAIL_IF_NOT(FlowGetRawHash(LINKTYPE_ETHERNET, pkt, 20) == 0);
+    FAIL_IF_NOT(FlowGetRawHash(LINKTYPE_PPP, pkt, sizeof(pkt)) == 0);
+    pkt[12] = 0x08;
+    pkt[13] = 0x06;
+    FAIL_IF_NOT(FlowGetRawHash(LINKTYPE_ETHERNET, pkt, sizeof(pkt)) == 0);
+    PASS;
+}
+
+/** \test raw hash of a vlan tagged ipv6 packet */
+static int FlowGetRawHashTest02(void)
+{
+    uint8_t pkt[] = {
+        /* ethernet */
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x00, 0x01, 0x02, 0x03, 0x04, 0x06, 0x81, 0x00,
+        /* vlan 10 */
+        0x00, 0x0a, 0x86, 0xdd,
+        /* ipv6, udp */
+        0x60, 0x00, 0x00, 0x00, 0x00, 0x08, 0x11, 0x40, 0x20, 0x01, 0x0d, 0xb8, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x20, 0x01, 0x0d, 0xb8,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+        /* udp */
+        0x30, 0x39, 0x00, 0x35, 0x00, 0x08, 0x00, 0x00
+    };
+    const uint32_t hash = FlowGetRawHash(LINKTYPE_ETHERNET, pkt, sizeof(pkt));
+    FAIL_IF(hash == 0);
+
+    uint8_t rev[sizeof(pkt)];
+    memcpy(rev, pkt, sizeof(pkt));
+    memcpy(rev + 26, pkt + 42, 16);
+    memcpy(rev + 42, pkt + 26, 16);
+    memcpy(rev + 58, pkt + 60, 2);
+    memcpy(rev + 60, pkt + 58, 2);
+    FAIL_IF_NOT(FlowGetRawHash(LINKTYPE_ETHERNET, rev, sizeof(rev)) == hash);
+
+    /* truncated tag */
+    FAIL_IF_NOT(FlowGetRawHash(LINKTYPE_ETHERNET, pkt, 16) == 0);
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void FlowHashRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("FlowGetRawHashTest01", FlowGetRawHashTest01);
+    UtRegisterTest("FlowGetRawHashTest02", FlowGetRawHashTest02);
+#endif
+}
@@ -114,6 +114,7 @@ typedef struct FlowTimeoutCounters_ {
     uint32_t flows_checked;
     uint32_t flows_notimeout;
     uint32_t flows_timeout;
+    uint32_t flows_timeout_late;
     uint32_t flows_removed;
     uint32_t flows_aside;
     uint32_t flows_aside_needs_work;
@@ -358,6 +359,11 @@ static void FlowManagerHashRowTimeout(FlowManagerTimeoutThread *td, Flow *f, SCT
         f->flow_end_flags |= FLOW_END_FLAG_TIMEOUT;
 
         counters->flows_timeout++;
+        /* timed out more than the allowed skew after it should have */
+        if (flow_config.timeout_max_skew != 0 &&
+                SCTIME_SECS(ts) > (uint64_t)f->timeout_at + flow_config.timeout_max_skew) {
+            counters->flows_timeout_late++;
+        }
 
         RemoveFromHash(f, prev_f);
 
@@ -629,6 +635,7 @@ typedef struct FlowCounters_ {
     uint16_t flow_mgr_flows_checked;
     uint16_t flow_mgr_flows_notimeout;
     uint16_t flow_mgr_flows_timeout;
+    uint16_t flow_mgr_flows_timeout_late;
     uint16_t flow_mgr_flows_aside;
     uint16_t flow_mgr_flows_aside_needs_work;
 
@@ -667,6 +674,7 @@ static void FlowCountersInit(ThreadVars *t, FlowCounters *fc)
     fc->flow_mgr_flows_checked = StatsRegisterCounter("flow.mgr.flows_checked", t);
     fc->flow_mgr_flows_notimeout = StatsRegisterCounter("flow.mgr.flows_notimeout", t);
     fc->flow_mgr_flows_timeout = StatsRegisterCounter("flow.mgr.flows_timeout", t);
+    fc->flow_mgr_flows_timeout_late = StatsRegisterCounter("flow.mgr.flows_timeout_late", t);
     fc->flow_mgr_flows_aside = StatsRegisterCounter("flow.mgr.flows_evicted", t);
     fc->flow_mgr_flows_aside_needs_work = StatsRegisterCounter("flow.mgr.flows_evicted_needs_work", t);
 
@@ -685,6 +693,8 @@ static void FlowCountersUpdate(
     StatsAddUI64(th_v, ftd->cnt.flow_mgr_flows_notimeout, (uint64_t)counters->flows_notimeout);
 
     StatsAddUI64(th_v, ftd->cnt.flow_mgr_flows_timeout, (uint64_t)counters->flows_timeout);
+    StatsAddUI64(
+            th_v, ftd->cnt.flow_mgr_flows_timeout_late, (uint64_t)counters->flows_timeout_late);
     StatsAddUI64(th_v, ftd->cnt.flow_mgr_flows_aside, (uint64_t)counters->flows_aside);
     StatsAddUI64(th_v, ftd->cnt.flow_mgr_flows_aside_needs_work,
             (uint64_t)counters->flows_aside_needs_work);
@@ -851,7 +861,7 @@ static TmEcode FlowManager(ThreadVars *th_v, void *thread_data)
 
             /* try to time out flows */
             // clang-format off
-            FlowTimeoutCounters counters = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, };
+            FlowTimeoutCounters counters = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, };
             // clang-format on
 
             if (emerg) {
@@ -101,6 +101,28 @@ SC_ATOMIC_EXTERN(uint64_t, flow_memuse);
 typedef FlowProtoTimeout *FlowProtoTimeoutPtr;
 SC_ATOMIC_EXTERN(FlowProtoTimeoutPtr, flow_timeouts);
 
+/** \brief get the time in seconds a flow timeout is counted from
+ *
+ *  Normally this is the packet time. In live mode a packet time that is
+ *  more than flow.max-timeout-skew away from the system clock, like a
+ *  hardware timestamp from an unsynchronized NIC clock or a packet that
+ *  sat in the capture ring during a burst, is replaced by the coarse
+ *  system time. Otherwise the flow manager, which uses the system clock,
+ *  would time the flow out much too late or too early.
+ */
+static inline uint32_t FlowGetTimeoutBase(const SCTime_t ts)
+{
+    const uint32_t secs = (uint32_t)SCTIME_SECS(ts);
+    const uint32_t skew = flow_config.timeout_max_skew;
+    if (skew == 0 || !TimeModeIsLive())
+        return secs;
+
+    const uint32_t now = (uint32_t)SCTIME_SECS(TimeGetCoarse());
+    if (secs > now + skew || secs + skew < now)
+        return now;
+    return secs;
+}
+
 static inline uint32_t FlowGetFlowTimeoutDirect(
         const FlowProtoTimeoutPtr flow_timeouts,
         const enum FlowState state, const uint8_t protomap)
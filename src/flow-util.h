@@ -25,6 +25,7 @@
 #define SURICATA_FLOW_UTIL_H
 
 #include "flow.h"
+#include "flow-bit.h"
 #include "stream-tcp-private.h"
 
 #define RESET_COUNTERS(f)                                                                          \
@@ -47,6 +48,7 @@
         (f)->next = NULL;                                                                          \
         (f)->flow_state = 0;                                                                       \
         (f)->tenant_id = 0;                                                                        \
+        (f)->tenant_version = 0;                                                                   \
         (f)->parent_id = 0;                                                                        \
         (f)->probing_parser_toserver_alproto_masks = 0;                                            \
         (f)->probing_parser_toclient_alproto_masks = 0;                                            \
@@ -70,6 +72,7 @@
         (f)->sgh_toserver = NULL;                                                                  \
         (f)->sgh_toclient = NULL;                                                                  \
         (f)->flowvar = NULL;                                                                       \
+        (f)->flowbits = NULL;                                                                      \
         RESET_COUNTERS((f));                                                                       \
     } while (0)
 
@@ -92,6 +95,7 @@
         (f)->timeout_policy = 0;                                                                   \
         (f)->flow_state = 0;                                                                       \
         (f)->tenant_id = 0;                                                                        \
+        (f)->tenant_version = 0;                                                                   \
         (f)->parent_id = 0;                                                                        \
         (f)->probing_parser_toserver_alproto_masks = 0;                                            \
         (f)->probing_parser_toclient_alproto_masks = 0;                                            \
@@ -115,6 +119,8 @@
         (f)->sgh_toclient = NULL;                                                                  \
         GenericVarFree((f)->flowvar);                                                              \
         (f)->flowvar = NULL;                                                                       \
+        FlowBitsFree((f)->flowbits);                                                               \
+        (f)->flowbits = NULL;                                                                      \
         RESET_COUNTERS((f));                                                                       \
     } while (0)
 
@@ -124,6 +130,7 @@
                                                                                                    \
         FLOWLOCK_DESTROY((f));                                                                     \
         GenericVarFree((f)->flowvar);                                                              \
+        FlowBitsFree((f)->flowbits);                                                               \
     } while (0)
 
 /** \brief check if a memory alloc would fit in the memcap
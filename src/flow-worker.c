@@ -41,6 +41,7 @@
 #include "stream-tcp.h"
 #include "app-layer.h"
 #include "detect-engine.h"
+#include "detect-engine-state.h"
 #include "output.h"
 #include "app-layer-parser.h"
 #include "app-layer-frames.h"
@@ -320,6 +321,7 @@ static TmEcode FlowWorkerThreadDeinit(ThreadVars *tv, void *data)
         DetectEngineThreadCtxDeinit(tv, detect_thread);
         SC_ATOMIC_SET(fw->detect_thread, NULL);
     }
+    DetectEngineStateThreadCleanup();
 
     /* Free output. */
     OutputLoggerThreadDeinit(tv, fw->output_thread);
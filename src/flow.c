@@ -397,7 +397,7 @@ void FlowHandlePacketUpdate(Flow *f, Packet *p, ThreadVars *tv, DecodeThreadVars
         /* update the last seen timestamp of this flow */
         if (SCTIME_CMP_GT(p->ts, f->lastts)) {
             f->lastts = p->ts;
-            const uint32_t timeout_at = (uint32_t)SCTIME_SECS(f->lastts) + f->timeout_policy;
+            const uint32_t timeout_at = FlowGetTimeoutBase(f->lastts) + f->timeout_policy;
             if (timeout_at != f->timeout_at) {
                 f->timeout_at = timeout_at;
             }
@@ -563,6 +563,18 @@ void FlowInitConfig(bool quiet)
         flow_config.emergency_recovery = FLOW_DEFAULT_EMERGENCY_RECOVERY;
     }
 
+    flow_config.timeout_max_skew = 0;
+    const char *skew_val;
+    if (ConfGet("flow.max-timeout-skew", &skew_val) == 1 && skew_val != NULL) {
+        uint64_t skew = SCParseTimeSizeString(skew_val);
+        if (skew > UINT16_MAX) {
+            SCLogError("flow.max-timeout-skew %s is too large, disabling it", skew_val);
+        } else {
+            flow_config.timeout_max_skew = (uint32_t)skew;
+            SCLogConfig("flow timeouts allow a packet time skew of %us", (uint32_t)skew);
+        }
+    }
+
     /* Check if we have memcap and hash_size defined at config */
     const char *conf_val;
     uint32_t configval = 0;
@@ -1169,7 +1181,7 @@ void FlowUpdateState(Flow *f, const enum FlowState s)
         const uint32_t timeout_policy = FlowGetTimeoutPolicy(f);
         if (timeout_policy != f->timeout_policy) {
             f->timeout_policy = timeout_policy;
-            const uint32_t timeout_at = (uint32_t)SCTIME_SECS(f->lastts) + timeout_policy;
+            const uint32_t timeout_at = FlowGetTimeoutBase(f->lastts) + timeout_policy;
             if (timeout_at != f->timeout_at)
                 f->timeout_at = timeout_at;
         }
@@ -1439,6 +1451,91 @@ static int FlowTest09 (void)
     return result;
 }
 
+/**
+ *  \test   Test that packet times too far from the system clock don't
+ *          set the flow timeout in live mode.
+ */
+static int FlowTest10(void)
+{
+    const uint32_t skew = flow_config.timeout_max_skew;
+    const bool live = TimeModeIsLive();
+    flow_config.timeout_max_skew = 10;
+    TimeModeSetLive();
+
+    const uint32_t now = (uint32_t)SCTIME_SECS(TimeGetCoarse());
+    /* within the skew the packet time is used, outside of it the system time */
+    const uint32_t ahead = FlowGetTimeoutBase(SCTIME_FROM_SECS(now + 5));
+    const uint32_t behind = FlowGetTimeoutBase(SCTIME_FROM_SECS(now - 5));
+    const uint32_t far_ahead = FlowGetTimeoutBase(SCTIME_FROM_SECS(now + 3600));
+    const uint32_t far_behind = FlowGetTimeoutBase(SCTIME_FROM_SECS(now - 3600));
+    flow_config.timeout_max_skew = 0;
+    const uint32_t disabled = FlowGetTimeoutBase(SCTIME_FROM_SECS(now + 3600));
+
+    TimeModeSetOffline();
+    flow_config.timeout_max_skew = 10;
+    const uint32_t offline = FlowGetTimeoutBase(SCTIME_FROM_SECS(now + 3600));
+    flow_config.timeout_max_skew = skew;
+    if (live)
+        TimeModeSetLive();
+
+    FAIL_IF_NOT(ahead == now + 5);
+    FAIL_IF_NOT(behind == now - 5);
+    FAIL_IF_NOT(far_ahead - now <= 1);
+    FAIL_IF_NOT(far_behind - now <= 1);
+    FAIL_IF_NOT(disabled == now + 3600);
+    FAIL_IF_NOT(offline == now + 3600);
+    PASS;
+}
+
+/**
+ *  \test   Test that in live mode a packet time far ahead of the system
+ *          clock doesn't time out the flow on its next packet.
+ */
+static int FlowTest11(void)
+{
+    const bool live = TimeModeIsLive();
+    FlowInitConfig(FLOW_QUIET);
+    FlowConfig backup;
+    memcpy(&backup, &flow_config, sizeof(FlowConfig));
+    flow_config.timeout_max_skew = 10;
+    TimeModeSetLive();
+
+    FlowLookupStruct fls;
+    memset(&fls, 0, sizeof(fls));
+    const uint32_t now = (uint32_t)SCTIME_SECS(TimeGetCoarse());
+    uint8_t payload[] = "Payload";
+
+    Packet *p1 = UTHBuildPacket(payload, sizeof(payload), IPPROTO_TCP);
+    FAIL_IF_NULL(p1);
+    p1->ts = SCTIME_FROM_SECS(now + 3600);
+    FlowHandlePacket(NULL, &fls, p1);
+    Flow *f = p1->flow;
+    FAIL_IF_NULL(f);
+    FLOWLOCK_UNLOCK(f);
+    /* the timeout is counted from the system clock */
+    FAIL_IF(f->timeout_at > now + 1 + f->timeout_policy);
+
+    Packet *p2 = UTHBuildPacket(payload, sizeof(payload), IPPROTO_TCP);
+    FAIL_IF_NULL(p2);
+    p2->ts = SCTIME_FROM_SECS(now + 3601);
+    FlowHandlePacket(NULL, &fls, p2);
+    FAIL_IF_NOT(p2->flow == f);
+    FLOWLOCK_UNLOCK(f);
+    FAIL_IF_NOT(fls.work_queue.len == 0);
+
+    UTHFreePacket(p1);
+    UTHFreePacket(p2);
+    Flow *fq;
+    while ((fq = FlowQueuePrivateGetFromTop(&fls.spare_queue))) {
+        FlowFree(fq);
+    }
+    memcpy(&flow_config, &backup, sizeof(FlowConfig));
+    FlowShutdown();
+    if (!live)
+        TimeModeSetOffline();
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 /**
@@ -1456,6 +1553,9 @@ void FlowRegisterTests (void)
                    FlowTest08);
     UtRegisterTest("FlowTest09 -- Test flow Allocations when it reach memcap",
                    FlowTest09);
+    UtRegisterTest("FlowTest10 -- Packet time skew in live mode", FlowTest10);
+    UtRegisterTest("FlowTest11 -- Test flow timeout with packet time ahead of the clock",
+            FlowTest11);
 
     RegisterFlowStorageTests();
 #endif /* UNITTESTS */
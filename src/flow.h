@@ -299,6 +299,10 @@ typedef struct FlowCnf_
 
     uint32_t emergency_recovery;
 
+    /** max seconds a packet timestamp may differ from the system clock
+     *  before flow timeouts use the system clock instead, 0 to disable */
+    uint32_t timeout_max_skew;
+
     enum ExceptionPolicy memcap_policy;
 
     SC_ATOMIC_DECLARE(uint64_t, memcap);
@@ -416,6 +420,10 @@ typedef struct Flow_
 
     FlowStateType flow_state;
 
+    /** tenant mapping version tenant_id was selected with, 0 if it wasn't
+     *  selected from a mapping the flow can cache. */
+    uint16_t tenant_version;
+
     /** flow tenant id, used to setup flow timeout and stream pseudo
      *  packets with the correct tenant id set */
     uint32_t tenant_id;
@@ -489,6 +497,8 @@ typedef struct Flow_
 
     /* pointer to the var list */
     GenericVar *flowvar;
+    /** flowbits, NULL until the first is set */
+    struct FlowBits_ *flowbits;
 
     struct FlowBucket_ *fb;
 
@@ -48,6 +48,7 @@
 #include "output-json-netflow.h"
 
 #include "stream-tcp-private.h"
+#include "flow-storage.h"
 
 static JsonBuilder *CreateEveHeaderFromNetFlow(const Flow *f, int dir)
 {
@@ -182,8 +183,16 @@ static void NetFlowLogEveToServer(JsonBuilder *js, Flow *f)
 
     jb_open_object(js, "netflow");
 
-    jb_set_uint(js, "pkts", f->todstpktcnt);
-    jb_set_uint(js, "bytes", f->todstbytecnt);
+    uint64_t pkts = f->todstpktcnt;
+    uint64_t bytes = f->todstbytecnt;
+    /* add what the capture method handled for bypassed flows */
+    FlowBypassInfo *fc = FlowGetStorageById(f, GetFlowBypassInfoID());
+    if (fc) {
+        pkts += fc->todstpktcnt;
+        bytes += fc->todstbytecnt;
+    }
+    jb_set_uint(js, "pkts", pkts);
+    jb_set_uint(js, "bytes", bytes);
 
     char timebuf1[64], timebuf2[64];
 
@@ -226,8 +235,16 @@ static void NetFlowLogEveToClient(JsonBuilder *js, Flow *f)
 
     jb_open_object(js, "netflow");
 
-    jb_set_uint(js, "pkts", f->tosrcpktcnt);
-    jb_set_uint(js, "bytes", f->tosrcbytecnt);
+    uint64_t pkts = f->tosrcpktcnt;
+    uint64_t bytes = f->tosrcbytecnt;
+    /* add what the capture method handled for bypassed flows */
+    FlowBypassInfo *fc = FlowGetStorageById(f, GetFlowBypassInfoID());
+    if (fc) {
+        pkts += fc->tosrcpktcnt;
+        bytes += fc->tosrcbytecnt;
+    }
+    jb_set_uint(js, "pkts", pkts);
+    jb_set_uint(js, "bytes", bytes);
 
     char timebuf1[64], timebuf2[64];
 
@@ -240,7 +240,7 @@ static bool SCStringHasPrefix(const char *s, const char *prefix)
 
 static void EveAddFlowVars(const Flow *f, JsonBuilder *js_root, JsonBuilder **js_traffic)
 {
-    if (f == NULL || f->flowvar == NULL) {
+    if (f == NULL || (f->flowvar == NULL && !FlowHasFlowBits(f))) {
         return;
     }
     JsonBuilder *js_flowvars = NULL;
@@ -305,38 +305,37 @@ static void EveAddFlowVars(const Flow *f, JsonBuilder *js_root, JsonBuilder **js
                 }
 
             }
-        } else if (gv->type == DETECT_FLOWBITS) {
-            FlowBit *fb = (FlowBit *)gv;
-            const char *varname = VarNameStoreLookupById(fb->idx,
-                    VAR_TYPE_FLOW_BIT);
-            if (varname) {
-                if (SCStringHasPrefix(varname, TRAFFIC_ID_PREFIX)) {
-                    if (js_traffic_id == NULL) {
-                        js_traffic_id = jb_new_array();
-                        if (unlikely(js_traffic_id == NULL)) {
-                            break;
-                        }
-                    }
-                    jb_append_string(js_traffic_id, &varname[traffic_id_prefix_len]);
-                } else if (SCStringHasPrefix(varname, TRAFFIC_LABEL_PREFIX)) {
-                    if (js_traffic_label == NULL) {
-                        js_traffic_label = jb_new_array();
-                        if (unlikely(js_traffic_label == NULL)) {
-                            break;
-                        }
+        }
+        gv = gv->next;
+    }
+    for (uint32_t idx = FlowBitNext(f, 0); idx != 0; idx = FlowBitNext(f, idx + 1)) {
+        const char *varname = VarNameStoreLookupById(idx, VAR_TYPE_FLOW_BIT);
+        if (varname) {
+            if (SCStringHasPrefix(varname, TRAFFIC_ID_PREFIX)) {
+                if (js_traffic_id == NULL) {
+                    js_traffic_id = jb_new_array();
+                    if (unlikely(js_traffic_id == NULL)) {
+                        break;
                     }
-                    jb_append_string(js_traffic_label, &varname[traffic_label_prefix_len]);
-                } else {
-                    if (js_flowbits == NULL) {
-                        js_flowbits = jb_new_array();
-                        if (unlikely(js_flowbits == NULL))
-                            break;
+                }
+                jb_append_string(js_traffic_id, &varname[traffic_id_prefix_len]);
+            } else if (SCStringHasPrefix(varname, TRAFFIC_LABEL_PREFIX)) {
+                if (js_traffic_label == NULL) {
+                    js_traffic_label = jb_new_array();
+                    if (unlikely(js_traffic_label == NULL)) {
+                        break;
                     }
-                    jb_append_string(js_flowbits, varname);
                 }
+                jb_append_string(js_traffic_label, &varname[traffic_label_prefix_len]);
+            } else {
+                if (js_flowbits == NULL) {
+                    js_flowbits = jb_new_array();
+                    if (unlikely(js_flowbits == NULL))
+                        break;
+                }
+                jb_append_string(js_flowbits, varname);
             }
         }
-        gv = gv->next;
     }
     if (js_flowbits) {
         jb_close(js_flowbits);
@@ -374,10 +373,11 @@ static void EveAddFlowVars(const Flow *f, JsonBuilder *js_root, JsonBuilder **js
 
 void EveAddMetadata(const Packet *p, const Flow *f, JsonBuilder *js)
 {
-    if ((p && p->pktvar) || (f && f->flowvar)) {
+    const bool flow_vars = f && (f->flowvar || FlowHasFlowBits(f));
+    if ((p && p->pktvar) || flow_vars) {
         JsonBuilder *js_vars = jb_new_object();
         if (js_vars) {
-            if (f && f->flowvar) {
+            if (flow_vars) {
                 JsonBuilder *js_traffic = NULL;
                 EveAddFlowVars(f, js_vars, &js_traffic);
                 if (js_traffic != NULL) {
@@ -63,7 +63,7 @@ bool PacketCheckAction(const Packet *p, const uint8_t a)
 void PacketInit(Packet *p)
 {
     SCSpinInit(&p->persistent.tunnel_lock, 0);
-    p->alerts.alerts = PacketAlertCreate();
+    /* alerts array is allocated when the first alert is added */
     p->livedev = NULL;
 }
 
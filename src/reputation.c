@@ -113,7 +113,10 @@ static void SRepCIDRAddNetblock(SRepCIDRTree *cidr_ctx, char *ip, int cat, uint8
 static int8_t SRepCIDRGetIPv4IPRep(SRepCIDRTree *cidr_ctx, uint8_t *ipv4_addr, uint8_t cat)
 {
     void *user_data = NULL;
-    (void)SCRadix4TreeFindBestMatch(&cidr_ctx->srep_ipv4_tree[cat], ipv4_addr, &user_data);
+    if (cidr_ctx->srep_ipv4_lpm[cat] != NULL)
+        user_data = SCLpmLookup(cidr_ctx->srep_ipv4_lpm[cat], ipv4_addr);
+    else
+        (void)SCRadix4TreeFindBestMatch(&cidr_ctx->srep_ipv4_tree[cat], ipv4_addr, &user_data);
     if (user_data == NULL)
         return -1;
 
@@ -124,7 +127,10 @@ static int8_t SRepCIDRGetIPv4IPRep(SRepCIDRTree *cidr_ctx, uint8_t *ipv4_addr, u
 static int8_t SRepCIDRGetIPv6IPRep(SRepCIDRTree *cidr_ctx, uint8_t *ipv6_addr, uint8_t cat)
 {
     void *user_data = NULL;
-    (void)SCRadix6TreeFindBestMatch(&cidr_ctx->srep_ipv6_tree[cat], ipv6_addr, &user_data);
+    if (cidr_ctx->srep_ipv6_lpm[cat] != NULL)
+        user_data = SCLpmLookup(cidr_ctx->srep_ipv6_lpm[cat], ipv6_addr);
+    else
+        (void)SCRadix6TreeFindBestMatch(&cidr_ctx->srep_ipv6_tree[cat], ipv6_addr, &user_data);
     if (user_data == NULL)
         return -1;
 
@@ -156,6 +162,21 @@ int8_t SRepCIDRGetIPRepDst(SRepCIDRTree *cidr_ctx, Packet *p, uint8_t cat, uint3
     return rep;
 }
 
+/** \brief compile the loaded trees into lookup tables
+ *
+ *  Empty trees and trees too large for a table keep using the tree. */
+static void SRepCIDRBuildLookupTables(SRepCIDRTree *cidr_ctx)
+{
+    uint64_t memory = 0;
+    for (int i = 0; i < SREP_MAX_CATS; i++) {
+        cidr_ctx->srep_ipv4_lpm[i] = SCLpmBuildIPv4(&cidr_ctx->srep_ipv4_tree[i]);
+        cidr_ctx->srep_ipv6_lpm[i] = SCLpmBuildIPv6(&cidr_ctx->srep_ipv6_tree[i]);
+        memory += SCLpmMemoryUse(cidr_ctx->srep_ipv4_lpm[i]) +
+                  SCLpmMemoryUse(cidr_ctx->srep_ipv6_lpm[i]);
+    }
+    SCLogConfig("reputation lookup tables use %" PRIu64 " bytes", memory);
+}
+
 /** \brief Increment effective reputation version after
  *         a rule/reputation reload is complete. */
 void SRepReloadComplete(void)
@@ -635,6 +656,7 @@ int SRepInit(DetectEngineCtx *de_ctx)
             }
         }
     }
+    SRepCIDRBuildLookupTables(cidr_ctx);
 
     /* Set effective rep version.
      * On live reload we will handle this after de_ctx has been swapped */
@@ -650,6 +672,8 @@ void SRepDestroy(DetectEngineCtx *de_ctx)
 {
     if (de_ctx->srepCIDR_ctx != NULL) {
         for (int i = 0; i < SREP_MAX_CATS; i++) {
+            SCLpmFree(de_ctx->srepCIDR_ctx->srep_ipv4_lpm[i]);
+            SCLpmFree(de_ctx->srepCIDR_ctx->srep_ipv6_lpm[i]);
             SCRadix4TreeRelease(&de_ctx->srepCIDR_ctx->srep_ipv4_tree[i], &iprep_radix4_config);
             SCRadix6TreeRelease(&de_ctx->srepCIDR_ctx->srep_ipv6_tree[i], &iprep_radix6_config);
         }
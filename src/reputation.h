@@ -29,6 +29,7 @@
 #include "host.h"
 #include "util-radix4-tree.h"
 #include "util-radix6-tree.h"
+#include "util-lpm.h"
 
 #define SREP_MAX_CATS 60
 #define SREP_MAX_VAL 127
@@ -36,6 +37,10 @@
 typedef struct SRepCIDRTree_ {
     SCRadix4Tree srep_ipv4_tree[SREP_MAX_CATS];
     SCRadix6Tree srep_ipv6_tree[SREP_MAX_CATS];
+    /** lookup tables compiled from the trees after loading, NULL means
+     *  the tree is used */
+    SCLpm *srep_ipv4_lpm[SREP_MAX_CATS];
+    SCLpm *srep_ipv6_lpm[SREP_MAX_CATS];
 } SRepCIDRTree;
 
 typedef struct SReputation_ {
@@ -162,6 +162,33 @@ static void AFPDerefConfig(void *conf)
 
 /* if cluster id is not set, assign it automagically, uniq value per
  * interface. */
+#if defined(HAVE_PACKET_EBPF) && defined(HAVE_BPF_MAP_LOOKUP_BATCH)
+/** \internal
+ *  \brief have the bypass manager refresh the bypassed flow counters
+ *
+ *  The refresh walks the tables of all devices, so it's registered once.
+ */
+static void AFPRegisterBypassRefresh(const char *iface, const struct ebpf_timeout_config *config)
+{
+    static bool registered = false;
+    if (registered)
+        return;
+    struct ebpf_timeout_config *ebt = SCCalloc(1, sizeof(struct ebpf_timeout_config));
+    if (ebt == NULL) {
+        SCLogError("%s: flow bypass alloc error", iface);
+        return;
+    }
+    memcpy(ebt, config, sizeof(struct ebpf_timeout_config));
+    if (BypassedFlowManagerRegisterCheckFunc(EBPFCheckBypassedFlowRefresh, NULL, (void *)ebt) !=
+            0) {
+        SCFree(ebt);
+        return;
+    }
+    RunModeEnablesBypassManager();
+    registered = true;
+}
+#endif
+
 static int cluster_id_auto = 1;
 
 /**
@@ -476,6 +503,9 @@ static void *ParseAFPConfig(const char *iface)
             SCLogConfig("%s: using bypass kernel functionality for AF_PACKET", aconf->iface);
             aconf->flags |= AFP_BYPASS;
             BypassedFlowManagerRegisterUpdateFunc(EBPFUpdateFlow, NULL);
+#ifdef HAVE_BPF_MAP_LOOKUP_BATCH
+            AFPRegisterBypassRefresh(iface, &aconf->ebpf_t_config);
+#endif
 #else
             SCLogError("%s: bypass set but eBPF support is not built-in", iface);
 #endif
@@ -550,6 +580,11 @@ static void *ParseAFPConfig(const char *iface)
                 aconf->ebpf_t_config.cpus_count = 1;
             }
         }
+#ifdef HAVE_BPF_MAP_LOOKUP_BATCH
+        if (aconf->flags & AFP_XDPBYPASS) {
+            AFPRegisterBypassRefresh(iface, &aconf->ebpf_t_config);
+        }
+#endif
 #endif
     }
 
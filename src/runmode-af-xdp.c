@@ -258,6 +258,22 @@ static void *ParseAFXDPConfig(const char *iface)
         }
     }
 
+    /* one UMEM for all queues of the interface */
+    if (ConfGetChildValueBoolWithDefault(if_root, if_default, "shared-umem", &conf_val) == 1) {
+        aconf->shared_umem = conf_val != 0;
+    }
+
+    /* frames larger than a UMEM frame, like jumbo frames, are received
+     * in multiple buffers */
+    if (ConfGetChildValueBoolWithDefault(if_root, if_default, "multi-buffer", &conf_val) == 1 &&
+            conf_val) {
+#ifdef XDP_USE_SG
+        aconf->bind_flags |= XDP_USE_SG;
+#else
+        SCLogWarning("%s: multi-buffer is not supported by this build", aconf->iface);
+#endif
+    }
+
     /* Busy polling options */
     if (ConfGetChildValueBoolWithDefault(if_root, if_default, "enable-busy-poll", &conf_val) == 1) {
         if (conf_val == 0) {
@@ -45,6 +45,14 @@ void RunModeFilePcapRegister(void)
             "Multi-threaded pcap file mode. Packets from each flow are assigned to a consistent "
             "detection thread",
             RunModeFilePcapAutoFp, NULL);
+    RunModeRegisterNewRunMode(RUNMODE_PCAP_FILE, "autofp-raw",
+            "Multi-threaded pcap file mode. The reader only hashes the packets to assign "
+            "them to detection threads, which decode them",
+            RunModeFilePcapAutoFpRaw, NULL);
+    RunModeRegisterNewRunMode(RUNMODE_PCAP_FILE, "workers",
+            "Workers pcap file mode, each thread reads its share of the files of a "
+            "directory and does all processing for them",
+            RunModeFilePcapWorkers, NULL);
 }
 
 /**
@@ -101,7 +109,7 @@ int RunModeFilePcapSingle(void)
 }
 
 /**
- * \brief RunModeFilePcapAutoFp set up the following thread packet handlers:
+ * \brief FilePcapAutoFp set up the following thread packet handlers:
  *        - Receive thread (from pcap file)
  *        - Decode thread
  *        - Stream thread
@@ -112,10 +120,14 @@ int RunModeFilePcapSingle(void)
  *        By default the threads will use the first cpu available
  *        except the Detection threads if we have more than one cpu.
  *
+ * \param raw if true the receive thread doesn't decode, but assigns
+ *        packets to threads by FlowGetRawHash. Decoding is then done
+ *        by the detect threads.
+ *
  * \retval 0 If all goes well. (If any problem is detected the engine will
  *           exit()).
  */
-int RunModeFilePcapAutoFp(void)
+static int FilePcapAutoFp(const bool raw)
 {
     SCEnter();
     char tname[TM_THREAD_NAME_MAX];
@@ -133,6 +145,7 @@ int RunModeFilePcapAutoFp(void)
     TimeModeSetOffline();
 
     PcapFileGlobalInit();
+    PcapFileSetRawFlowHash(raw);
 
     /* Available cpus */
     uint16_t ncpus = UtilCpuGetNumProcessorsOnline();
@@ -175,11 +188,13 @@ int RunModeFilePcapAutoFp(void)
     }
     TmSlotSetFuncAppend(tv_receivepcap, tm_module, file);
 
-    tm_module = TmModuleGetByName("DecodePcapFile");
-    if (tm_module == NULL) {
-        FatalError("TmModuleGetByName DecodePcap failed");
+    if (!raw) {
+        tm_module = TmModuleGetByName("DecodePcapFile");
+        if (tm_module == NULL) {
+            FatalError("TmModuleGetByName DecodePcap failed");
+        }
+        TmSlotSetFuncAppend(tv_receivepcap, tm_module, NULL);
     }
-    TmSlotSetFuncAppend(tv_receivepcap, tm_module, NULL);
 
     TmThreadSetCPU(tv_receivepcap, RECEIVE_CPU_SET);
 
@@ -203,6 +218,14 @@ int RunModeFilePcapAutoFp(void)
             FatalError("TmThreadsCreate failed");
         }
 
+        if (raw) {
+            tm_module = TmModuleGetByName("DecodePcapFile");
+            if (tm_module == NULL) {
+                FatalError("TmModuleGetByName DecodePcap failed");
+            }
+            TmSlotSetFuncAppend(tv_detect_ncpu, tm_module, NULL);
+        }
+
         tm_module = TmModuleGetByName("FlowWorker");
         if (tm_module == NULL) {
             FatalError("TmModuleGetByName for FlowWorker failed");
@@ -225,3 +248,106 @@ int RunModeFilePcapAutoFp(void)
 
     return 0;
 }
+
+int RunModeFilePcapAutoFp(void)
+{
+    return FilePcapAutoFp(false);
+}
+
+/**
+ * \brief RunModeFilePcapAutoFpRaw is like RunModeFilePcapAutoFp, but the
+ *        receive thread only reads the packets and hashes them by flow. The
+ *        detect threads decode them, so decoding scales with the threads.
+ *        Packets of a flow still go to a single thread, in order.
+ */
+int RunModeFilePcapAutoFpRaw(void)
+{
+    return FilePcapAutoFp(true);
+}
+
+/**
+ * \brief RunModeFilePcapWorkers sets up a number of threads that each read,
+ *        decode and inspect a part of the files of a directory.
+ *
+ * Files are assigned to threads by a hash of their name, so each file is
+ * read by exactly one thread. This only makes sense if the files hold
+ * independent traffic, as packets of a flow spread over files handled
+ * by different threads are not ordered. A single file is read by a
+ * single thread.
+ *
+ * \retval 0 If all goes well. (If any problem is detected the engine will
+ *           exit()).
+ */
+int RunModeFilePcapWorkers(void)
+{
+    SCEnter();
+    char tname[TM_THREAD_NAME_MAX];
+
+    const char *file = NULL;
+    if (ConfGet("pcap-file.file", &file) == 0) {
+        FatalError("Failed retrieving pcap-file from Conf");
+    }
+
+    TimeModeSetOffline();
+
+    PcapFileGlobalInit();
+
+    int thread_max = 1;
+    DIR *directory = opendir(file);
+    if (directory != NULL) {
+        closedir(directory);
+
+        thread_max = TmThreadGetNbThreads(WORKER_CPU_SET);
+        if (thread_max == 0)
+            thread_max = UtilCpuGetNumProcessorsOnline();
+        if (thread_max < 1)
+            thread_max = 1;
+        if (thread_max > 1024)
+            thread_max = 1024;
+    }
+    PcapFileSetReaders((uint16_t)thread_max);
+    SCLogInfo("using %d pcap file reader threads", thread_max);
+    if (thread_max > 1) {
+        SCLogWarning("pcap-file workers runmode: packets of a flow spread over files read by "
+                     "different threads are not processed in order, e.g. with rotated pcap "
+                     "files. Use the autofp runmode for such files.");
+    }
+
+    for (uint16_t thread = 0; thread < (uint16_t)thread_max; thread++) {
+        snprintf(tname, sizeof(tname), "%s#%02d", thread_name_workers, thread + 1);
+
+        ThreadVars *tv = TmThreadCreatePacketHandler(tname,
+                "packetpool", "packetpool",
+                "packetpool", "packetpool",
+                "pktacqloop");
+        if (tv == NULL) {
+            FatalError("threading setup failed");
+        }
+
+        TmModule *tm_module = TmModuleGetByName("ReceivePcapFile");
+        if (tm_module == NULL) {
+            FatalError("TmModuleGetByName failed for ReceivePcap");
+        }
+        TmSlotSetFuncAppend(tv, tm_module, file);
+
+        tm_module = TmModuleGetByName("DecodePcapFile");
+        if (tm_module == NULL) {
+            FatalError("TmModuleGetByName DecodePcap failed");
+        }
+        TmSlotSetFuncAppend(tv, tm_module, NULL);
+
+        tm_module = TmModuleGetByName("FlowWorker");
+        if (tm_module == NULL) {
+            FatalError("TmModuleGetByName for FlowWorker failed");
+        }
+        TmSlotSetFuncAppend(tv, tm_module, NULL);
+
+        TmThreadSetCPU(tv, WORKER_CPU_SET);
+
+        if (TmThreadSpawn(tv) != TM_ECODE_OK) {
+            FatalError("TmThreadSpawn failed");
+        }
+    }
+
+    return 0;
+}
@@ -25,6 +25,8 @@
 
 int RunModeFilePcapSingle(void);
 int RunModeFilePcapAutoFp(void);
+int RunModeFilePcapAutoFpRaw(void);
+int RunModeFilePcapWorkers(void);
 void RunModeFilePcapRegister(void);
 const char *RunModeFilePcapGetDefaultMode(void);
 
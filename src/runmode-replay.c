@@ -0,0 +1,131 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "suricata-common.h"
+#include "tm-threads.h"
+#include "conf.h"
+#include "runmodes.h"
+#include "runmode-replay.h"
+#include "source-replay.h"
+
+#include "util-byte.h"
+#include "util-debug.h"
+#include "util-time.h"
+#include "util-cpu.h"
+#include "util-affinity.h"
+
+const char *RunModeReplayGetDefaultMode(void)
+{
+    return "workers";
+}
+
+void RunModeReplayRegister(void)
+{
+    RunModeRegisterNewRunMode(RUNMODE_REPLAY, "workers",
+            "Workers replay mode, each thread replays the flows of the file hashed to it "
+            "and does all processing for them",
+            RunModeReplayWorkers, NULL);
+}
+
+/** \internal
+ *  \brief number of workers from replay.threads, the worker cpu set or
+ *         the number of cpus */
+static uint16_t RunModeReplayGetThreads(void)
+{
+    const char *threads = NULL;
+    uint16_t thread_max = 0;
+    if (ConfGet("replay.threads", &threads) == 1 && strcmp(threads, "auto") != 0) {
+        if (StringParseUint16(&thread_max, 10, 0, threads) < 0 || thread_max == 0) {
+            FatalError("invalid replay.threads value '%s'", threads);
+        }
+        return thread_max;
+    }
+
+    thread_max = TmThreadGetNbThreads(WORKER_CPU_SET);
+    if (thread_max == 0)
+        thread_max = UtilCpuGetNumProcessorsOnline();
+    if (thread_max < 1)
+        thread_max = 1;
+    if (thread_max > 1024)
+        thread_max = 1024;
+    return thread_max;
+}
+
+/**
+ * \brief RunModeReplayWorkers loads a pcap file into memory and sets up
+ *        a number of threads that each replay, decode and inspect the
+ *        flows assigned to them.
+ *
+ * \retval 0 If all goes well. (If any problem is detected the engine will
+ *           exit()).
+ */
+int RunModeReplayWorkers(void)
+{
+    SCEnter();
+    char tname[TM_THREAD_NAME_MAX];
+
+    const char *file = NULL;
+    if (ConfGet("replay.file", &file) == 0) {
+        FatalError("Failed retrieving replay.file from Conf");
+    }
+
+    TimeModeSetOffline();
+
+    const uint16_t thread_max = RunModeReplayGetThreads();
+    if (ReplayGlobalInit(file, thread_max) != 0) {
+        FatalError("unable to load %s for replay", file);
+    }
+    SCLogInfo("using %u replay threads", thread_max);
+
+    for (uint16_t thread = 0; thread < thread_max; thread++) {
+        snprintf(tname, sizeof(tname), "%s#%02d", thread_name_workers, thread + 1);
+
+        ThreadVars *tv = TmThreadCreatePacketHandler(tname,
+                "packetpool", "packetpool",
+                "packetpool", "packetpool",
+                "pktacqloop");
+        if (tv == NULL) {
+            FatalError("threading setup failed");
+        }
+
+        TmModule *tm_module = TmModuleGetByName("ReceiveReplay");
+        if (tm_module == NULL) {
+            FatalError("TmModuleGetByName failed for ReceiveReplay");
+        }
+        TmSlotSetFuncAppend(tv, tm_module, NULL);
+
+        tm_module = TmModuleGetByName("DecodeReplay");
+        if (tm_module == NULL) {
+            FatalError("TmModuleGetByName DecodeReplay failed");
+        }
+        TmSlotSetFuncAppend(tv, tm_module, NULL);
+
+        tm_module = TmModuleGetByName("FlowWorker");
+        if (tm_module == NULL) {
+            FatalError("TmModuleGetByName for FlowWorker failed");
+        }
+        TmSlotSetFuncAppend(tv, tm_module, NULL);
+
+        TmThreadSetCPU(tv, WORKER_CPU_SET);
+
+        if (TmThreadSpawn(tv) != TM_ECODE_OK) {
+            FatalError("TmThreadSpawn failed");
+        }
+    }
+
+    return 0;
+}
@@ -40,6 +40,7 @@
 #include "detect-engine-tag.h"
 #include "detect-fast-pattern.h"
 #include "flow.h"
+#include "flow-hash.h"
 #include "flow-timeout.h"
 #include "flow-manager.h"
 #include "flow-var.h"
@@ -66,6 +67,10 @@
 #include "util-action.h"
 #include "util-radix4-tree.h"
 #include "util-radix6-tree.h"
+#include "util-lpm.h"
+#include "util-mphf.h"
+#include "util-epoch.h"
+#include "util-thash.h"
 #include "util-host-os-info.h"
 #include "util-cidr.h"
 #include "util-unittest-helper.h"
@@ -122,6 +127,8 @@
 #ifdef WINDIVERT
 #include "source-windivert.h"
 #endif
+#include "source-pcap-file-mmap.h"
+#include "source-replay.h"
 
 #endif /* UNITTESTS */
 
@@ -169,11 +176,16 @@ static void RegisterUnittests(void)
     ConfYamlRegisterTests();
     TmqhFlowRegisterTests();
     FlowRegisterTests();
+    FlowHashRegisterTests();
     HostRegisterUnittests();
     IPPairRegisterUnittests();
     SCSigRegisterSignatureOrderingTests();
     SCRadix4RegisterTests();
     SCRadix6RegisterTests();
+    SCLpmRegisterTests();
+    SCMphfRegisterTests();
+    SCEpochRegisterTests();
+    THashRegisterTests();
     DefragRegisterTests();
     SigGroupHeadRegisterTests();
     SCHInfoRegisterTests();
@@ -211,6 +223,8 @@ static void RegisterUnittests(void)
 #ifdef WINDIVERT
     SourceWinDivertRegisterTests();
 #endif
+    PcapFileMmapRegisterTests();
+    ReplayRegisterTests();
     SCProtoNameRegisterTests();
     UtilCIDRTests();
     OutputJsonStatsRegisterTests();
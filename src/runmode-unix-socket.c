@@ -751,6 +751,11 @@ TmEcode UnixSocketDatasetClear(json_t *cmd, json_t *answer, void *data)
         return TM_ECODE_FAILED;
     }
 
+    if (set->hash == NULL) {
+        json_object_set_new(answer, "message", json_string("set is read-only"));
+        return TM_ECODE_FAILED;
+    }
+
     THashCleanup(set->hash);
 
     json_object_set_new(answer, "message", json_string("dataset cleared"));
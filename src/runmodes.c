@@ -34,6 +34,7 @@
 #include "runmode-dpdk.h"
 #include "runmode-erf-dag.h"
 #include "runmode-erf-file.h"
+#include "runmode-replay.h"
 #include "runmode-ipfw.h"
 #include "runmode-netmap.h"
 #include "runmode-nflog.h"
@@ -130,6 +131,8 @@ static const char *RunModeTranslateModeToName(int runmode)
             return "IPFW";
         case RUNMODE_ERF_FILE:
             return "ERF_FILE";
+        case RUNMODE_REPLAY:
+            return "REPLAY";
         case RUNMODE_DAG:
             return "ERF_DAG";
         case RUNMODE_UNITTEST:
@@ -222,6 +225,7 @@ void RunModeRegisterRunModes(void)
     RunModeIpsNFQRegister();
     RunModeIpsIPFWRegister();
     RunModeErfFileRegister();
+    RunModeReplayRegister();
     RunModeErfDagRegister();
     RunModeIdsAFPRegister();
     RunModeIdsAFXDPRegister();
@@ -314,6 +318,9 @@ static const char *RunModeGetConfOrDefault(int capture_mode, const char *capture
             case RUNMODE_ERF_FILE:
                 custom_mode = RunModeErfFileGetDefaultMode();
                 break;
+            case RUNMODE_REPLAY:
+                custom_mode = RunModeReplayGetDefaultMode();
+                break;
             case RUNMODE_DAG:
                 custom_mode = RunModeErfDagGetDefaultMode();
                 break;
@@ -529,6 +536,7 @@ bool IsRunModeSystem(enum RunModes run_mode_to_check)
     switch (run_mode_to_check) {
         case RUNMODE_PCAP_FILE:
         case RUNMODE_ERF_FILE:
+        case RUNMODE_REPLAY:
         case RUNMODE_ENGINE_ANALYSIS:
             return false;
             break;
@@ -543,6 +551,7 @@ bool IsRunModeOffline(enum RunModes run_mode_to_check)
         case RUNMODE_CONF_TEST:
         case RUNMODE_PCAP_FILE:
         case RUNMODE_ERF_FILE:
+        case RUNMODE_REPLAY:
         case RUNMODE_ENGINE_ANALYSIS:
         case RUNMODE_UNIX_SOCKET:
             return true;
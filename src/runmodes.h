@@ -37,6 +37,7 @@ enum RunModes {
     RUNMODE_AFXDP_DEV,
     RUNMODE_NETMAP,
     RUNMODE_DPDK,
+    RUNMODE_REPLAY,
     RUNMODE_UNITTEST,
     RUNMODE_UNIX_SOCKET,
     RUNMODE_WINDIVERT,
@@ -58,6 +59,7 @@ enum RunModes {
     RUNMODE_CHANGE_SERVICE_PARAMS,
 #endif
     RUNMODE_DUMP_FEATURES,
+    RUNMODE_DATASET_COMPILE,
     RUNMODE_MAX,
 };
 
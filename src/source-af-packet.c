@@ -173,6 +173,9 @@ TmEcode NoAFPSupportExit(ThreadVars *tv, const void *initdata, void **data)
 
 #define POLL_TIMEOUT 100
 
+/* packets of a TPACKET_V3 block that are set up before processing them */
+#define AFP_V3_BATCH_SIZE 32
+
 /* kernel flags defined for RX ring tp_status */
 #ifndef TP_STATUS_KERNEL
 #define TP_STATUS_KERNEL 0
@@ -298,6 +301,8 @@ typedef struct AFPThreadVars_
     uint16_t capture_afp_poll_data;
     uint16_t capture_afp_poll_err;
     uint16_t capture_afp_send_err;
+    uint16_t capture_afp_block_pkts;
+    uint16_t capture_afp_block_hold;
 
     uint64_t send_errors_logged; /**< snapshot of send errors logged. */
 
@@ -958,11 +963,15 @@ static inline void AFPFlushBlock(struct tpacket_block_desc *pbd)
     pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
 }
 
-static inline int AFPParsePacketV3(AFPThreadVars *ptv, struct tpacket_block_desc *pbd, struct tpacket3_hdr *ppd)
+/** \internal
+ *  \brief setup a packet pointing to a frame of a TPACKET_V3 block
+ *  \retval p packet or NULL if none could be allocated
+ */
+static inline Packet *AFPSetupPacketV3(AFPThreadVars *ptv, struct tpacket3_hdr *ppd)
 {
     Packet *p = PacketGetFromQueueOrAlloc();
     if (p == NULL) {
-        SCReturnInt(AFP_SURI_FAILURE);
+        return NULL;
     }
     PKT_SET_SRC(p, PKT_SRC_WIRE);
 
@@ -1008,39 +1017,56 @@ static inline int AFPParsePacketV3(AFPThreadVars *ptv, struct tpacket_block_desc
         }
     }
 
-    if (TmThreadsSlotProcessPkt(ptv->tv, ptv->slot, p) != TM_ECODE_OK) {
-        SCReturnInt(AFP_SURI_FAILURE);
-    }
-
-    SCReturnInt(AFP_READ_OK);
+    return p;
 }
 
+/** \internal
+ *  \brief process the packets of a block
+ *
+ *  Packets are set up in batches of AFP_V3_BATCH_SIZE before they are run
+ *  through the pipeline, so the frame headers of a batch are walked in one
+ *  go and the data of the next packet is prefetched while the current one
+ *  is processed. The block is only returned to the kernel by the caller,
+ *  after all its packets are done.
+ */
 static inline int AFPWalkBlock(AFPThreadVars *ptv, struct tpacket_block_desc *pbd)
 {
     const int num_pkts = pbd->hdr.bh1.num_pkts;
     uint8_t *ppd = (uint8_t *)pbd + pbd->hdr.bh1.offset_to_first_pkt;
-
-    for (int i = 0; i < num_pkts; ++i) {
-        const struct sockaddr_ll *sll =
-                (const struct sockaddr_ll *)(ppd + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
-        if (unlikely(AFPShouldIgnoreFrame(ptv, sll))) {
-            ppd = ppd + ((struct tpacket3_hdr *)ppd)->tp_next_offset;
-            continue;
-        }
-        int ret = AFPParsePacketV3(ptv, pbd, (struct tpacket3_hdr *)ppd);
-        switch (ret) {
-            case AFP_READ_OK:
-                break;
-            case AFP_SURI_FAILURE:
+    Packet *batch[AFP_V3_BATCH_SIZE];
+
+    StatsAddUI64(ptv->tv, ptv->capture_afp_block_pkts, (uint64_t)num_pkts);
+
+    for (int i = 0; i < num_pkts;) {
+        int cnt = 0;
+        for (; i < num_pkts && cnt < AFP_V3_BATCH_SIZE; i++) {
+            struct tpacket3_hdr *h3 = (struct tpacket3_hdr *)ppd;
+            ppd = ppd + h3->tp_next_offset;
+            if (i + 1 < num_pkts)
+                __builtin_prefetch(ppd);
+
+            const struct sockaddr_ll *sll =
+                    (const struct sockaddr_ll *)((uint8_t *)h3 +
+                                                 TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+            if (unlikely(AFPShouldIgnoreFrame(ptv, sll))) {
+                continue;
+            }
+            Packet *p = AFPSetupPacketV3(ptv, h3);
+            if (p == NULL) {
                 /* Internal error but let's just continue and
-                 * treat thenext packet */
-                break;
-            case AFP_READ_FAILURE:
-                SCReturnInt(AFP_READ_FAILURE);
-            default:
-                SCReturnInt(ret);
+                 * treat the next packet */
+                continue;
+            }
+            batch[cnt++] = p;
+        }
+
+        for (int j = 0; j < cnt; j++) {
+            if (j + 1 < cnt)
+                __builtin_prefetch(GET_PKT_DATA(batch[j + 1]));
+            /* on an internal error the packet is released by the
+             * pipeline, continue with the next one */
+            (void)TmThreadsSlotProcessPkt(ptv->tv, ptv->slot, batch[j]);
         }
-        ppd = ppd + ((struct tpacket3_hdr *)ppd)->tp_next_offset;
     }
 
     SCReturnInt(AFP_READ_OK);
@@ -1074,13 +1100,14 @@ static int AFPReadFromRingV3(AFPThreadVars *ptv)
             SCReturnInt(AFP_READ_OK);
         }
 
+        const uint64_t hold_start = UtilCpuGetTicks();
         int ret = AFPWalkBlock(ptv, pbd);
+        AFPFlushBlock(pbd);
+        StatsAddUI64(ptv->tv, ptv->capture_afp_block_hold, UtilCpuGetTicks() - hold_start);
         if (unlikely(ret != AFP_READ_OK)) {
-            AFPFlushBlock(pbd);
             SCReturnInt(ret);
         }
 
-        AFPFlushBlock(pbd);
         ptv->frame_offset = (ptv->frame_offset + 1) % ptv->req.v3.tp_block_nr;
         /* return to maintenance task after one loop on the ring */
         if (ptv->frame_offset == 0) {
@@ -2580,6 +2607,12 @@ TmEcode ReceiveAFPThreadInit(ThreadVars *tv, const void *initdata, void **data)
     ptv->capture_afp_poll_data = StatsRegisterCounter("capture.afpacket.poll_data", ptv->tv);
     ptv->capture_afp_poll_err = StatsRegisterCounter("capture.afpacket.poll_errors", ptv->tv);
     ptv->capture_afp_send_err = StatsRegisterCounter("capture.afpacket.send_errors", ptv->tv);
+    if (ptv->flags & AFP_TPACKET_V3) {
+        ptv->capture_afp_block_pkts =
+                StatsRegisterAvgCounter("capture.afpacket.block_packets_avg", ptv->tv);
+        ptv->capture_afp_block_hold =
+                StatsRegisterAvgCounter("capture.afpacket.block_hold_ticks_avg", ptv->tv);
+    }
 #endif
 
     ptv->copy_mode = afpconfig->copy_mode;
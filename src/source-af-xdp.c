@@ -129,6 +129,28 @@ struct XskInitProtect {
     SC_ATOMIC_DECLARE(uint8_t, queue_num);
 } xsk_protect;
 
+/**
+ * \brief UMEM shared by the sockets of all queues of an interface
+ *
+ * Each thread uses its own MEM_BYTES area of the UMEM and has its own fill
+ * and completion rings, as the kernel needs them per queue.
+ */
+typedef struct AFXDPSharedUmem_ {
+    char iface[AFXDP_IFACE_NAME_LENGTH];
+    void *buf;
+    uint64_t size;
+    struct xsk_umem *umem;
+    /* rings the UMEM was created with, libxdp hands them to the first socket */
+    struct xsk_ring_prod fq;
+    struct xsk_ring_cons cq;
+    uint32_t users;
+    uint32_t next_area;
+    struct AFXDPSharedUmem_ *next;
+} AFXDPSharedUmem;
+
+/* protected by xsk_protect.queue_protect */
+static AFXDPSharedUmem *shared_umems = NULL;
+
 struct UmemInfo {
     void *buf;
     struct xsk_umem *umem;
@@ -136,6 +158,10 @@ struct UmemInfo {
     struct xsk_ring_cons cq;
     struct xsk_umem_config cfg;
     int mmap_alignment_flag;
+    /* set if the UMEM is shared with the other queues of the interface */
+    AFXDPSharedUmem *shared;
+    /* offset of the area of this thread in the UMEM */
+    uint64_t base;
 };
 
 struct QueueAssignment {
@@ -153,6 +179,7 @@ struct XskSockInfo {
 
     /* Configuration items */
     struct xsk_socket_config cfg;
+    bool shared_umem;
     bool enable_busy_poll;
     uint32_t busy_poll_time;
     uint32_t busy_poll_budget;
@@ -185,6 +212,14 @@ typedef struct AFXDPThreadVars_ {
     /* Handle state */
     uint8_t afxdp_state;
 
+    /* packet spanning multiple frames that is being assembled */
+    struct {
+        Packet *p;
+        uint32_t len;
+        /* drop the frames until the end of the current packet */
+        bool drop;
+    } mb;
+
     /* Stats parameters */
     uint64_t pkts;
     uint64_t bytes;
@@ -196,6 +231,7 @@ typedef struct AFXDPThreadVars_ {
     uint16_t capture_afxdp_empty_reads;
     uint16_t capture_afxdp_failed_reads;
     uint16_t capture_afxdp_acquire_pkt_failed;
+    uint16_t capture_afxdp_multi_buffer_pkts;
 } AFXDPThreadVars;
 
 static TmEcode ReceiveAFXDPThreadInit(ThreadVars *, const void *, void **);
@@ -303,8 +339,89 @@ static void AFXDPAllThreadsRunning(AFXDPThreadVars *ptv)
     SCMutexUnlock(&xsk_protect.queue_protect);
 }
 
+/**
+ * \brief Get an area of the shared UMEM of the interface, creating the
+ *        UMEM for the first thread.
+ */
+static TmEcode AcquireSharedBuffer(AFXDPThreadVars *ptv)
+{
+    SCMutexLock(&xsk_protect.queue_protect);
+    AFXDPSharedUmem *su = shared_umems;
+    while (su != NULL && strcmp(su->iface, ptv->iface) != 0) {
+        su = su->next;
+    }
+
+    if (su == NULL) {
+        su = SCCalloc(1, sizeof(*su));
+        if (su == NULL) {
+            SCMutexUnlock(&xsk_protect.queue_protect);
+            SCReturnInt(TM_ECODE_FAILED);
+        }
+        strlcpy(su->iface, ptv->iface, sizeof(su->iface));
+        su->size = (uint64_t)MEM_BYTES * ptv->threads;
+
+        int mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS | ptv->umem.mmap_alignment_flag;
+        su->buf = mmap(NULL, su->size, PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
+        if (su->buf == MAP_FAILED) {
+            SCLogError("mmap: failed to acquire memory");
+            SCFree(su);
+            SCMutexUnlock(&xsk_protect.queue_protect);
+            SCReturnInt(TM_ECODE_FAILED);
+        }
+        if (xsk_umem__create(&su->umem, su->buf, su->size, &su->fq, &su->cq, &ptv->umem.cfg)) {
+            SCLogError("failed to create umem: %s", strerror(errno));
+            munmap(su->buf, su->size);
+            SCFree(su);
+            SCMutexUnlock(&xsk_protect.queue_protect);
+            SCReturnInt(TM_ECODE_FAILED);
+        }
+        su->next = shared_umems;
+        shared_umems = su;
+    }
+
+    if (su->next_area == (uint32_t)ptv->threads) {
+        SCLogError("%s: no free area left in the shared umem", ptv->iface);
+        SCMutexUnlock(&xsk_protect.queue_protect);
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+    ptv->umem.base = (uint64_t)MEM_BYTES * su->next_area++;
+    ptv->umem.buf = su->buf;
+    ptv->umem.umem = su->umem;
+    ptv->umem.shared = su;
+    su->users++;
+    SCMutexUnlock(&xsk_protect.queue_protect);
+    SCReturnInt(TM_ECODE_OK);
+}
+
+static void ReleaseSharedBuffer(AFXDPThreadVars *ptv)
+{
+    AFXDPSharedUmem *su = ptv->umem.shared;
+
+    SCMutexLock(&xsk_protect.queue_protect);
+    if (--su->users == 0) {
+        AFXDPSharedUmem **prev = &shared_umems;
+        while (*prev != su) {
+            prev = &(*prev)->next;
+        }
+        *prev = su->next;
+
+        xsk_umem__delete(su->umem);
+        munmap(su->buf, su->size);
+        SCFree(su);
+    }
+    SCMutexUnlock(&xsk_protect.queue_protect);
+
+    ptv->umem.shared = NULL;
+    ptv->umem.umem = NULL;
+    ptv->umem.buf = NULL;
+}
+
 static TmEcode AcquireBuffer(AFXDPThreadVars *ptv)
 {
+    if (ptv->xsk.shared_umem) {
+        return AcquireSharedBuffer(ptv);
+    }
+
     int mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS | ptv->umem.mmap_alignment_flag;
     ptv->umem.buf = mmap(NULL, MEM_BYTES, PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
 
@@ -318,6 +435,11 @@ static TmEcode AcquireBuffer(AFXDPThreadVars *ptv)
 
 static TmEcode ConfigureXSKUmem(AFXDPThreadVars *ptv)
 {
+    /* shared UMEM is created once per interface */
+    if (ptv->umem.shared != NULL) {
+        SCReturnInt(TM_ECODE_OK);
+    }
+
     if (xsk_umem__create(&ptv->umem.umem, ptv->umem.buf, MEM_BYTES, &ptv->umem.fq, &ptv->umem.cq,
                 &ptv->umem.cfg)) {
         SCLogError("failed to create umem: %s", strerror(errno));
@@ -338,7 +460,7 @@ static TmEcode InitFillRing(AFXDPThreadVars *ptv, const uint32_t cnt)
     }
 
     for (uint32_t i = 0; i < cnt; i++) {
-        *xsk_ring_prod__fill_addr(&ptv->umem.fq, idx_fq++) = i * FRAME_SIZE;
+        *xsk_ring_prod__fill_addr(&ptv->umem.fq, idx_fq++) = ptv->umem.base + i * FRAME_SIZE;
     }
 
     xsk_ring_prod__submit(&ptv->umem.fq, cnt);
@@ -436,9 +558,18 @@ static TmEcode OpenXSKSocket(AFXDPThreadVars *ptv)
         SCReturnInt(TM_ECODE_FAILED);
     }
 
-    if ((ret = xsk_socket__create(&ptv->xsk.xsk, ptv->livedev->dev, ptv->xsk.queue.queue_num,
-                 ptv->umem.umem, &ptv->xsk.rx, &ptv->xsk.tx, &ptv->xsk.cfg))) {
+    if (ptv->umem.shared != NULL) {
+        /* the socket gets its own fill and completion rings */
+        ret = xsk_socket__create_shared(&ptv->xsk.xsk, ptv->livedev->dev,
+                ptv->xsk.queue.queue_num, ptv->umem.umem, &ptv->xsk.rx, &ptv->xsk.tx,
+                &ptv->umem.fq, &ptv->umem.cq, &ptv->xsk.cfg);
+    } else {
+        ret = xsk_socket__create(&ptv->xsk.xsk, ptv->livedev->dev, ptv->xsk.queue.queue_num,
+                ptv->umem.umem, &ptv->xsk.rx, &ptv->xsk.tx, &ptv->xsk.cfg);
+    }
+    if (ret) {
         SCLogError("Failed to create socket: %s", strerror(-ret));
+        SCMutexUnlock(&xsk_protect.queue_protect);
         SCReturnInt(TM_ECODE_FAILED);
     }
     SCLogDebug("bind to %s on queue %u", ptv->iface, ptv->xsk.queue.queue_num);
@@ -454,6 +585,16 @@ static TmEcode OpenXSKSocket(AFXDPThreadVars *ptv)
     SCReturnInt(TM_ECODE_OK);
 }
 
+static void AFXDPDropPartialPacket(AFXDPThreadVars *ptv)
+{
+    if (ptv->mb.p != NULL) {
+        TmqhOutputPacketpool(ptv->tv, ptv->mb.p);
+        ptv->mb.p = NULL;
+    }
+    ptv->mb.len = 0;
+    ptv->mb.drop = false;
+}
+
 static void AFXDPCloseSocket(AFXDPThreadVars *ptv)
 {
     if (ptv->xsk.xsk) {
@@ -461,13 +602,17 @@ static void AFXDPCloseSocket(AFXDPThreadVars *ptv)
         ptv->xsk.xsk = NULL;
     }
 
-    if (ptv->umem.umem) {
+    /* shared UMEM stays until the last thread is done with it */
+    if (ptv->umem.umem && ptv->umem.shared == NULL) {
         xsk_umem__delete(ptv->umem.umem);
         ptv->umem.umem = NULL;
     }
 
     memset(&ptv->umem.fq, 0, sizeof(struct xsk_ring_prod));
     memset(&ptv->umem.cq, 0, sizeof(struct xsk_ring_cons));
+
+    /* frames of a packet being assembled may not come back */
+    AFXDPDropPartialPacket(ptv);
 }
 
 static TmEcode AFXDPSocketCreation(AFXDPThreadVars *ptv)
@@ -476,8 +621,10 @@ static TmEcode AFXDPSocketCreation(AFXDPThreadVars *ptv)
         SCReturnInt(TM_ECODE_FAILED);
     }
 
-    if (InitFillRing(ptv, NUM_FRAMES * 2) != TM_ECODE_OK) {
-        SCReturnInt(TM_ECODE_FAILED);
+    if (ptv->umem.shared == NULL) {
+        if (InitFillRing(ptv, NUM_FRAMES * 2) != TM_ECODE_OK) {
+            SCReturnInt(TM_ECODE_FAILED);
+        }
     }
 
     /* Open AF_XDP socket */
@@ -485,6 +632,13 @@ static TmEcode AFXDPSocketCreation(AFXDPThreadVars *ptv)
         SCReturnInt(TM_ECODE_FAILED);
     }
 
+    /* with a shared UMEM the fill ring of the socket only exists now */
+    if (ptv->umem.shared != NULL) {
+        if (InitFillRing(ptv, NUM_FRAMES * 2) != TM_ECODE_OK) {
+            SCReturnInt(TM_ECODE_FAILED);
+        }
+    }
+
     if (ConfigureBusyPolling(ptv) != TM_ECODE_OK) {
         SCLogWarning("Failed to configure busy polling"
                      " performance may be reduced.");
@@ -551,6 +705,90 @@ static void AFXDPReleasePacket(Packet *p)
     PacketFreeOrRelease(p);
 }
 
+/**
+ * \brief Handle a frame of the RX ring
+ *
+ * A packet that fits in a single frame points into the UMEM and the frame
+ * is returned through the fill ring when the packet is released. Frames
+ * of a multi-buffer packet are copied into the packet and returned right
+ * away.
+ *
+ * \param fq_idx fill ring entry reserved for this frame
+ */
+static TmEcode AFXDPProcessFrame(AFXDPThreadVars *ptv, const struct xdp_desc *desc,
+        const struct timeval *ts, const uint32_t fq_idx)
+{
+    const uint64_t orig = xsk_umem__extract_addr(desc->addr);
+    const uint64_t addr = xsk_umem__add_offset_to_addr(desc->addr);
+    const uint32_t len = desc->len;
+    uint8_t *pkt_data = xsk_umem__get_data(ptv->umem.buf, addr);
+#ifdef XDP_PKT_CONTD
+    const bool contd = (desc->options & XDP_PKT_CONTD) != 0;
+#else
+    const bool contd = false;
+#endif
+    const bool multi_buffer = contd || ptv->mb.p != NULL || ptv->mb.drop;
+
+    ptv->bytes += len;
+    /* count packets, not frames */
+    if (!contd)
+        ptv->pkts++;
+
+    Packet *p = ptv->mb.p;
+    if (p == NULL && !ptv->mb.drop) {
+        p = PacketGetFromQueueOrAlloc();
+        if (unlikely(p == NULL)) {
+            StatsIncr(ptv->tv, ptv->capture_afxdp_acquire_pkt_failed);
+        } else {
+            PKT_SET_SRC(p, PKT_SRC_WIRE);
+            p->datalink = LINKTYPE_ETHERNET;
+            p->livedev = ptv->livedev;
+            p->flags |= PKT_IGNORE_CHECKSUM;
+            p->ts = SCTIME_FROM_TIMEVAL(ts);
+        }
+    }
+
+    if (!multi_buffer) {
+        if (unlikely(p == NULL)) {
+            *xsk_ring_prod__fill_addr(&ptv->umem.fq, fq_idx) = orig;
+            SCReturnInt(TM_ECODE_OK);
+        }
+        p->ReleasePacket = AFXDPReleasePacket;
+        p->afxdp_v.fq_idx = fq_idx;
+        p->afxdp_v.orig = orig;
+        p->afxdp_v.fq = &ptv->umem.fq;
+        PacketSetData(p, pkt_data, len);
+    } else {
+        if (p != NULL && PacketCopyDataOffset(p, ptv->mb.len, pkt_data, len) != 0) {
+            TmqhOutputPacketpool(ptv->tv, p);
+            p = NULL;
+        }
+        *xsk_ring_prod__fill_addr(&ptv->umem.fq, fq_idx) = orig;
+
+        if (p == NULL) {
+            /* drop the rest of the frames of this packet */
+            ptv->mb.p = NULL;
+            ptv->mb.len = 0;
+            ptv->mb.drop = contd;
+            SCReturnInt(TM_ECODE_OK);
+        }
+        ptv->mb.len += len;
+        if (contd) {
+            ptv->mb.p = p;
+            SCReturnInt(TM_ECODE_OK);
+        }
+        SET_PKT_LEN(p, ptv->mb.len);
+        ptv->mb.p = NULL;
+        ptv->mb.len = 0;
+        StatsIncr(ptv->tv, ptv->capture_afxdp_multi_buffer_pkts);
+    }
+
+    if (TmThreadsSlotProcessPkt(ptv->tv, ptv->slot, p) != TM_ECODE_OK) {
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+    SCReturnInt(TM_ECODE_OK);
+}
+
 static inline int DumpStatsEverySecond(AFXDPThreadVars *ptv, time_t *last_dump)
 {
     int stats_dumped = 0;
@@ -646,6 +884,9 @@ static TmEcode ReceiveAFXDPThreadInit(ThreadVars *tv, const void *initdata, void
     ptv->umem.cfg.frame_headroom = XSK_UMEM__DEFAULT_FRAME_HEADROOM;
     ptv->umem.cfg.flags = afxdpconfig->mem_alignment;
 
+    /* sockets of all queues use one UMEM */
+    ptv->xsk.shared_umem = afxdpconfig->shared_umem;
+
     /* Use hugepages if unaligned chunk mode */
     if (ptv->umem.cfg.flags == XDP_UMEM_UNALIGNED_CHUNK_FLAG) {
         ptv->umem.mmap_alignment_flag = MAP_HUGETLB;
@@ -668,6 +909,8 @@ static TmEcode ReceiveAFXDPThreadInit(ThreadVars *tv, const void *initdata, void
     ptv->capture_afxdp_failed_reads = StatsRegisterCounter("capture.afxdp.failed_reads", ptv->tv);
     ptv->capture_afxdp_acquire_pkt_failed =
             StatsRegisterCounter("capture.afxdp.acquire_pkt_failed", ptv->tv);
+    ptv->capture_afxdp_multi_buffer_pkts =
+            StatsRegisterCounter("capture.afxdp.multi_buffer_packets", ptv->tv);
 
     /* Reserve memory for umem  */
     if (AcquireBuffer(ptv) != TM_ECODE_OK) {
@@ -692,7 +935,6 @@ static TmEcode ReceiveAFXDPLoop(ThreadVars *tv, void *data, void *slot)
 {
     SCEnter();
 
-    Packet *p;
     time_t last_dump = 0;
     struct timeval ts;
     uint32_t idx_rx = 0, idx_fq = 0, rcvd;
@@ -775,39 +1017,9 @@ static TmEcode ReceiveAFXDPLoop(ThreadVars *tv, void *data, void *slot)
         }
 
         gettimeofday(&ts, NULL);
-        ptv->pkts += rcvd;
         for (uint32_t i = 0; i < rcvd; i++) {
-            p = PacketGetFromQueueOrAlloc();
-            if (unlikely(p == NULL)) {
-                StatsIncr(ptv->tv, ptv->capture_afxdp_acquire_pkt_failed);
-                continue;
-            }
-
-            PKT_SET_SRC(p, PKT_SRC_WIRE);
-            p->datalink = LINKTYPE_ETHERNET;
-            p->livedev = ptv->livedev;
-            p->ReleasePacket = AFXDPReleasePacket;
-            p->flags |= PKT_IGNORE_CHECKSUM;
-
-            p->ts = SCTIME_FROM_TIMEVAL(&ts);
-
-            uint64_t addr = xsk_ring_cons__rx_desc(&ptv->xsk.rx, idx_rx)->addr;
-            uint32_t len = xsk_ring_cons__rx_desc(&ptv->xsk.rx, idx_rx++)->len;
-            uint64_t orig = xsk_umem__extract_addr(addr);
-            addr = xsk_umem__add_offset_to_addr(addr);
-
-            uint8_t *pkt_data = xsk_umem__get_data(ptv->umem.buf, addr);
-
-            ptv->bytes += len;
-
-            p->afxdp_v.fq_idx = idx_fq++;
-            p->afxdp_v.orig = orig;
-            p->afxdp_v.fq = &ptv->umem.fq;
-
-            PacketSetData(p, pkt_data, len);
-
-            if (TmThreadsSlotProcessPkt(ptv->tv, ptv->slot, p) != TM_ECODE_OK) {
-                TmqhOutputPacketpool(ptv->tv, p);
+            const struct xdp_desc *desc = xsk_ring_cons__rx_desc(&ptv->xsk.rx, idx_rx++);
+            if (AFXDPProcessFrame(ptv, desc, &ts, idx_fq++) != TM_ECODE_OK) {
                 SCReturnInt(EXIT_FAILURE);
             }
         }
@@ -881,11 +1093,17 @@ static TmEcode ReceiveAFXDPThreadDeinit(ThreadVars *tv, void *data)
         ptv->xsk.xsk = NULL;
     }
 
-    if (ptv->umem.umem) {
-        xsk_umem__delete(ptv->umem.umem);
-        ptv->umem.umem = NULL;
+    AFXDPDropPartialPacket(ptv);
+
+    if (ptv->umem.shared != NULL) {
+        ReleaseSharedBuffer(ptv);
+    } else {
+        if (ptv->umem.umem) {
+            xsk_umem__delete(ptv->umem.umem);
+            ptv->umem.umem = NULL;
+        }
+        munmap(ptv->umem.buf, MEM_BYTES);
     }
-    munmap(ptv->umem.buf, MEM_BYTES);
 
     SCFree(ptv);
     SCReturnInt(TM_ECODE_OK);
@@ -36,6 +36,8 @@ typedef struct AFXDPIfaceConfig {
     uint32_t mode;
     uint32_t bind_flags;
     int mem_alignment;
+    /* use one UMEM for the sockets of all queues */
+    bool shared_umem;
     bool enable_busy_poll;
     uint32_t busy_poll_time;
     uint32_t busy_poll_budget;
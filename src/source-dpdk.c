@@ -98,8 +98,27 @@ TmEcode NoDPDKSupportExit(ThreadVars *tv, const void *initdata, void **data)
 #define MINIMUM_SLEEP_TIME_US        1U
 #define STANDARD_SLEEP_TIME_US       100U
 #define MAX_EPOLL_TIMEOUT_MS         500U
+// max time a packet waits in the TX buffer while the thread keeps receiving
+#define TX_FLUSH_TIMEOUT_US 100U
 static rte_spinlock_t intr_lock[RTE_MAX_ETHPORTS];
 
+/**
+ * \brief Per thread buffer of packets to be sent to the peer port in TAP
+ *        and IPS mode, so they go out in bursts instead of one by one.
+ */
+typedef struct DPDKTxBuffer_ {
+    struct rte_eth_dev_tx_buffer *buf;
+    uint16_t port_id;
+    uint16_t queue_id;
+    /* tsc of the first packet added to the empty buffer */
+    uint64_t first_tsc;
+    uint64_t flush_tsc;
+    /* counters */
+    uint64_t batches;
+    uint64_t batch_pkts;
+    uint64_t drops;
+} DPDKTxBuffer;
+
 /**
  * \brief Structure to hold thread specific variables.
  */
@@ -118,11 +137,15 @@ typedef struct DPDKThreadVars_ {
     uint16_t capture_dpdk_rx_no_mbufs;
     uint16_t capture_dpdk_ierrors;
     uint16_t capture_dpdk_tx_errs;
+    uint16_t capture_dpdk_tx_batches;
+    uint16_t capture_dpdk_tx_batch_pkts;
+    uint16_t capture_dpdk_tx_drops;
     unsigned int flags;
     int threads;
     /* for IPS */
     DpdkCopyModeEnum copy_mode;
     uint16_t out_port_id;
+    DPDKTxBuffer *tx_buffer;
     /* Entry in the peers_list */
 
     uint64_t bytes;
@@ -298,11 +321,101 @@ static inline void DPDKDumpCounters(DPDKThreadVars *ptv)
     } else {
         StatsSetUI64(ptv->tv, ptv->capture_dpdk_packets, ptv->pkts);
     }
+
+    if (ptv->tx_buffer != NULL) {
+        StatsSetUI64(ptv->tv, ptv->capture_dpdk_tx_batches, ptv->tx_buffer->batches);
+        StatsSetUI64(ptv->tv, ptv->capture_dpdk_tx_batch_pkts, ptv->tx_buffer->batch_pkts);
+        StatsSetUI64(ptv->tv, ptv->capture_dpdk_tx_drops, ptv->tx_buffer->drops);
+    }
+}
+
+/**
+ * \brief Called for the packets of a burst the NIC didn't accept
+ */
+static void DPDKTxBufferError(struct rte_mbuf **unsent, uint16_t count, void *userdata)
+{
+    DPDKTxBuffer *txb = (DPDKTxBuffer *)userdata;
+    // sometimes a repeated transmit can help to send out the packets
+    rte_delay_us(DPDK_BURST_TX_WAIT_US);
+    uint16_t sent = rte_eth_tx_burst(txb->port_id, txb->queue_id, unsent, count);
+    if (unlikely(sent < count)) {
+        SCLogDebug("Unable to transmit %u packets on port %u queue %u", count - sent,
+                txb->port_id, txb->queue_id);
+        txb->drops += count - sent;
+        for (uint16_t i = sent; i < count; i++) {
+            rte_pktmbuf_free(unsent[i]);
+        }
+    }
+}
+
+static DPDKTxBuffer *DPDKTxBufferAlloc(
+        uint16_t port_id, uint16_t queue_id, int32_t socket_id, uint16_t size)
+{
+    DPDKTxBuffer *txb = SCCalloc(1, sizeof(*txb));
+    if (txb == NULL)
+        return NULL;
+    txb->buf = rte_zmalloc_socket("tx_buffer", RTE_ETH_TX_BUFFER_SIZE(size), 0, socket_id);
+    if (txb->buf == NULL) {
+        SCFree(txb);
+        return NULL;
+    }
+    rte_eth_tx_buffer_init(txb->buf, size);
+    rte_eth_tx_buffer_set_err_callback(txb->buf, DPDKTxBufferError, txb);
+    txb->port_id = port_id;
+    txb->queue_id = queue_id;
+    txb->flush_tsc = rte_get_tsc_hz() * TX_FLUSH_TIMEOUT_US / US_PER_S;
+    return txb;
+}
+
+/**
+ * \brief Free the buffer, dropping packets that are still in it
+ */
+static void DPDKTxBufferFree(DPDKTxBuffer *txb)
+{
+    if (txb == NULL)
+        return;
+    for (uint16_t i = 0; i < txb->buf->length; i++) {
+        rte_pktmbuf_free(txb->buf->pkts[i]);
+    }
+    rte_free(txb->buf);
+    SCFree(txb);
+}
+
+static inline void DPDKTxBufferAdd(DPDKTxBuffer *txb, struct rte_mbuf *mbuf)
+{
+    if (txb->buf->length == 0)
+        txb->first_tsc = rte_get_tsc_cycles();
+    if (txb->buf->length + 1 == txb->buf->size) {
+        // the buffer gets full, so rte_eth_tx_buffer sends it out
+        txb->batches++;
+        txb->batch_pkts += txb->buf->size;
+    }
+    rte_eth_tx_buffer(txb->port_id, txb->queue_id, txb->buf, mbuf);
+}
+
+static inline void DPDKTxBufferFlush(DPDKTxBuffer *txb)
+{
+    if (txb->buf->length == 0)
+        return;
+    txb->batches++;
+    txb->batch_pkts += txb->buf->length;
+    rte_eth_tx_buffer_flush(txb->port_id, txb->queue_id, txb->buf);
+}
+
+/**
+ * \brief Send out the buffered packets if the thread is idle or the
+ *        oldest one waited long enough
+ */
+static inline void DPDKTxBufferFlushTimeout(DPDKTxBuffer *txb, const bool idle)
+{
+    if (txb == NULL || txb->buf->length == 0)
+        return;
+    if (idle || rte_get_tsc_cycles() - txb->first_tsc >= txb->flush_tsc)
+        DPDKTxBufferFlush(txb);
 }
 
 static void DPDKReleasePacket(Packet *p)
 {
-    int retval;
     /* Need to be in copy mode and need to detect early release
        where Ethernet header could not be set (and pseudo packet)
        When enabling promiscuous mode on Intel cards, 2 ICMPv6 packets are generated.
@@ -314,23 +427,9 @@ static void DPDKReleasePacket(Packet *p)
 #endif
     ) {
         BUG_ON(PKT_IS_PSEUDOPKT(p));
-        retval =
-                rte_eth_tx_burst(p->dpdk_v.out_port_id, p->dpdk_v.out_queue_id, &p->dpdk_v.mbuf, 1);
-        // rte_eth_tx_burst can return only 0 (failure) or 1 (success) because we are only
-        // transmitting burst of size 1 and the function rte_eth_tx_burst returns number of
-        // successfully sent packets.
-        if (unlikely(retval < 1)) {
-            // sometimes a repeated transmit can help to send out the packet
-            rte_delay_us(DPDK_BURST_TX_WAIT_US);
-            retval = rte_eth_tx_burst(
-                    p->dpdk_v.out_port_id, p->dpdk_v.out_queue_id, &p->dpdk_v.mbuf, 1);
-            if (unlikely(retval < 1)) {
-                SCLogDebug("Unable to transmit the packet on port %u queue %u",
-                        p->dpdk_v.out_port_id, p->dpdk_v.out_queue_id);
-                rte_pktmbuf_free(p->dpdk_v.mbuf);
-                p->dpdk_v.mbuf = NULL;
-            }
-        }
+        // the mbuf is owned by the buffer now, it's sent or freed on the next flush
+        DPDKTxBufferAdd(p->dpdk_v.tx_buffer, p->dpdk_v.mbuf);
+        p->dpdk_v.mbuf = NULL;
     } else {
         rte_pktmbuf_free(p->dpdk_v.mbuf);
         p->dpdk_v.mbuf = NULL;
@@ -424,6 +523,7 @@ static inline Packet *PacketInitFromMbuf(DPDKThreadVars *ptv, struct rte_mbuf *m
     p->dpdk_v.copy_mode = ptv->copy_mode;
     p->dpdk_v.out_port_id = ptv->out_port_id;
     p->dpdk_v.out_queue_id = ptv->queue_id;
+    p->dpdk_v.tx_buffer = ptv->tx_buffer;
     p->livedev = ptv->livedev;
 
     if (ptv->checksum_mode == CHECKSUM_VALIDATION_DISABLE) {
@@ -476,6 +576,9 @@ static inline void DPDKSegmentedMbufWarning(struct rte_mbuf *mbuf)
 static void HandleShutdown(DPDKThreadVars *ptv)
 {
     SCLogDebug("Stopping Suricata!");
+    // send out what we have before the peer port gets stopped
+    if (ptv->tx_buffer != NULL)
+        DPDKTxBufferFlush(ptv->tx_buffer);
     SC_ATOMIC_ADD(ptv->workers_sync->worker_checked_in, 1);
     while (SC_ATOMIC_GET(ptv->workers_sync->worker_checked_in) < ptv->workers_sync->worker_cnt) {
         rte_delay_us(10);
@@ -527,6 +630,7 @@ static TmEcode ReceiveDPDKLoop(ThreadVars *tv, void *data, void *slot)
 
         uint16_t nb_rx =
                 rte_eth_rx_burst(ptv->port_id, ptv->queue_id, ptv->received_mbufs, BURST_SIZE);
+        DPDKTxBufferFlushTimeout(ptv->tx_buffer, nb_rx == 0);
         if (RXPacketCountHeuristic(tv, ptv, nb_rx)) {
             continue;
         }
@@ -592,6 +696,13 @@ static TmEcode ReceiveDPDKThreadInit(ThreadVars *tv, const void *initdata, void
     ptv->capture_dpdk_imissed = StatsRegisterCounter("capture.dpdk.imissed", ptv->tv);
     ptv->capture_dpdk_rx_no_mbufs = StatsRegisterCounter("capture.dpdk.no_mbufs", ptv->tv);
     ptv->capture_dpdk_ierrors = StatsRegisterCounter("capture.dpdk.ierrors", ptv->tv);
+    if (dpdk_config->copy_mode == DPDK_COPY_MODE_TAP ||
+            dpdk_config->copy_mode == DPDK_COPY_MODE_IPS) {
+        ptv->capture_dpdk_tx_batches = StatsRegisterCounter("capture.dpdk.tx_batches", ptv->tv);
+        ptv->capture_dpdk_tx_batch_pkts =
+                StatsRegisterCounter("capture.dpdk.tx_batch_packets", ptv->tv);
+        ptv->capture_dpdk_tx_drops = StatsRegisterCounter("capture.dpdk.tx_drops", ptv->tv);
+    }
 
     ptv->copy_mode = dpdk_config->copy_mode;
     ptv->checksum_mode = dpdk_config->checksum_mode;
@@ -617,6 +728,15 @@ static TmEcode ReceiveDPDKThreadInit(ThreadVars *tv, const void *initdata, void
     uint16_t queue_id = SC_ATOMIC_ADD(dpdk_config->queue_id, 1);
     ptv->queue_id = queue_id;
 
+    if (ptv->copy_mode == DPDK_COPY_MODE_TAP || ptv->copy_mode == DPDK_COPY_MODE_IPS) {
+        ptv->tx_buffer =
+                DPDKTxBufferAlloc(ptv->out_port_id, queue_id, ptv->port_socket_id, BURST_SIZE);
+        if (ptv->tx_buffer == NULL) {
+            SCLogError("%s: unable to allocate TX buffer", dpdk_config->iface);
+            goto fail;
+        }
+    }
+
     // the last thread starts the device
     if (queue_id == dpdk_config->threads - 1) {
         retval = rte_eth_dev_start(ptv->port_id);
@@ -658,8 +778,10 @@ static TmEcode ReceiveDPDKThreadInit(ThreadVars *tv, const void *initdata, void
 fail:
     if (dpdk_config != NULL)
         dpdk_config->DerefFunc(dpdk_config);
-    if (ptv != NULL)
+    if (ptv != NULL) {
+        DPDKTxBufferFree(ptv->tx_buffer);
         SCFree(ptv);
+    }
     SCReturnInt(TM_ECODE_FAILED);
 }
 
@@ -765,6 +887,7 @@ static TmEcode ReceiveDPDKThreadDeinit(ThreadVars *tv, void *data)
 
     ptv->pkt_mempool = NULL; // MP is released when device is closed
 
+    DPDKTxBufferFree(ptv->tx_buffer);
     SCFree(ptv);
     SCReturnInt(TM_ECODE_OK);
 }
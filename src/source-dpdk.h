@@ -92,6 +92,8 @@ typedef struct DPDKIfaceConfig_ {
  */
 typedef struct DPDKPacketVars_ {
     struct rte_mbuf *mbuf;
+    /** TX buffer of the thread in TAP and IPS mode */
+    struct DPDKTxBuffer_ *tx_buffer;
     uint16_t out_port_id;
     uint16_t out_queue_id;
     uint8_t copy_mode;
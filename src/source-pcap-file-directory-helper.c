@@ -29,6 +29,7 @@
 #include "util-mem.h"
 #include "util-time.h"
 #include "util-path.h"
+#include "util-hash-lookup3.h"
 #include "source-pcap-file.h"
 
 static void GetTime(struct timespec *tm);
@@ -313,6 +314,12 @@ TmEcode PcapDirectoryPopulateBuffer(PcapFileDirectoryVars *pv,
             strcmp(dir->d_name, "..") == 0) {
             continue;
         }
+        if (pv->readers > 1 &&
+                hashlittle_safe(dir->d_name, strlen(dir->d_name), 0) % pv->readers !=
+                        pv->reader_id) {
+            SCLogDebug("Skipping %s, handled by another reader", dir->d_name);
+            continue;
+        }
 
         char pathbuff[PATH_MAX] = {0};
 
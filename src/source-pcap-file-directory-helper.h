@@ -47,6 +47,9 @@ typedef struct PcapFileDirectoryVars_
     uint8_t cur_dir_depth;
     time_t delay;
     time_t poll_interval;
+    /** files are split up between this many readers by their name */
+    uint16_t readers;
+    uint16_t reader_id;
 
     TAILQ_HEAD(PendingFiles, PendingFile_) directory_content;
 
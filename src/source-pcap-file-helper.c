@@ -30,10 +30,14 @@
 #include "util-profiling.h"
 #include "source-pcap-file.h"
 #include "util-exception-policy.h"
+#include "flow-hash.h"
 
 extern uint32_t max_pending_packets;
 extern PcapFileGlobalVars pcap_g;
 
+/** snaplen for compiling the bpf used with the mmap reader, libpcap's max */
+#define PCAP_FILE_BPF_SNAPLEN 262144
+
 static void PcapFileCallbackLoop(char *user, struct pcap_pkthdr *h, u_char *pkt);
 
 void CleanupPcapFileFileVars(PcapFileFileVars *pfv)
@@ -43,6 +47,14 @@ void CleanupPcapFileFileVars(PcapFileFileVars *pfv)
             pcap_close(pfv->pcap_handle);
             pfv->pcap_handle = NULL;
         }
+        if (pfv->mmap != NULL) {
+            PcapFileMmapReaderClose(pfv->mmap);
+            pfv->mmap = NULL;
+        }
+        if (pfv->filter_set) {
+            pcap_freecode(&pfv->filter);
+            pfv->filter_set = false;
+        }
         if (pfv->filename != NULL) {
             if (pfv->shared != NULL && pfv->shared->should_delete) {
                 SCLogDebug("Deleting pcap file %s", pfv->filename);
@@ -58,17 +70,25 @@ void CleanupPcapFileFileVars(PcapFileFileVars *pfv)
     }
 }
 
-void PcapFileCallbackLoop(char *user, struct pcap_pkthdr *h, u_char *pkt)
+static void PcapFileMmapReleasePacket(Packet *p)
+{
+    PcapFileMmap *m = p->pcap_v.map;
+    p->pcap_v.map = NULL;
+    PacketFreeOrRelease(p);
+    PcapFileMmapDeref(m);
+}
+
+static void PcapFileProcessPacket(
+        PcapFileFileVars *ptv, const struct timeval *ts, const uint8_t *pkt, uint32_t caplen)
 {
     SCEnter();
 #ifdef DEBUG
-    if (unlikely((pcap_g.cnt + 1ULL) == g_eps_pcap_packet_loss)) {
+    if (unlikely((SC_ATOMIC_GET(pcap_g.cnt) + 1ULL) == g_eps_pcap_packet_loss)) {
         SCLogNotice("skipping packet %" PRIu64, g_eps_pcap_packet_loss);
-        pcap_g.cnt++;
+        SC_ATOMIC_ADD(pcap_g.cnt, 1);
         SCReturn;
     }
 #endif
-    PcapFileFileVars *ptv = (PcapFileFileVars *)user;
     Packet *p = PacketGetFromQueueOrAlloc();
 
     if (unlikely(p == NULL)) {
@@ -77,16 +97,26 @@ void PcapFileCallbackLoop(char *user, struct pcap_pkthdr *h, u_char *pkt)
     PACKET_PROFILING_TMM_START(p, TMM_RECEIVEPCAPFILE);
 
     PKT_SET_SRC(p, PKT_SRC_WIRE);
-    p->ts = SCTIME_FROM_TIMEVAL_UNTRUSTED(&h->ts);
+    p->ts = SCTIME_FROM_TIMEVAL_UNTRUSTED(ts);
     SCLogDebug("p->ts.tv_sec %" PRIuMAX "", (uintmax_t)SCTIME_SECS(p->ts));
     p->datalink = ptv->datalink;
-    p->pcap_cnt = ++pcap_g.cnt;
+    p->pcap_cnt = SC_ATOMIC_ADD(pcap_g.cnt, 1) + 1;
 
     p->pcap_v.tenant_id = ptv->shared->tenant_id;
     ptv->shared->pkts++;
-    ptv->shared->bytes += h->caplen;
-
-    if (unlikely(PacketCopyData(p, pkt, h->caplen))) {
+    ptv->shared->bytes += caplen;
+
+    if (ptv->mmap != NULL) {
+        /* point into the mapping, which stays until the packet is released */
+        if (unlikely(PacketSetData(p, pkt, caplen))) {
+            TmqhOutputPacketpool(ptv->shared->tv, p);
+            PACKET_PROFILING_TMM_END(p, TMM_RECEIVEPCAPFILE);
+            SCReturn;
+        }
+        p->pcap_v.map = PcapFileMmapReaderGetMap(ptv->mmap);
+        PcapFileMmapRef(p->pcap_v.map);
+        p->ReleasePacket = PcapFileMmapReleasePacket;
+    } else if (unlikely(PacketCopyData(p, pkt, caplen))) {
         TmqhOutputPacketpool(ptv->shared->tv, p);
         PACKET_PROFILING_TMM_END(p, TMM_RECEIVEPCAPFILE);
         SCReturn;
@@ -103,23 +133,126 @@ void PcapFileCallbackLoop(char *user, struct pcap_pkthdr *h, u_char *pkt)
         }
     }
 
+    if (pcap_g.raw_flow_hash) {
+        p->flow_hash = FlowGetRawHash(p->datalink, GET_PKT_DATA(p), GET_PKT_LEN(p));
+        p->flags |= PKT_HAS_RAW_FLOW_HASH;
+    }
+
     PACKET_PROFILING_TMM_END(p, TMM_RECEIVEPCAPFILE);
 
     if (TmThreadsSlotProcessPkt(ptv->shared->tv, ptv->shared->slot, p) != TM_ECODE_OK) {
-        pcap_breakloop(ptv->pcap_handle);
+        if (ptv->pcap_handle != NULL)
+            pcap_breakloop(ptv->pcap_handle);
         ptv->shared->cb_result = TM_ECODE_FAILED;
     }
 
     SCReturn;
 }
 
+void PcapFileCallbackLoop(char *user, struct pcap_pkthdr *h, u_char *pkt)
+{
+    PcapFileFileVars *ptv = (PcapFileFileVars *)user;
+    /* timestamp in h may not be 'struct timeval' */
+    struct timeval ts = { .tv_sec = h->ts.tv_sec, .tv_usec = h->ts.tv_usec };
+    PcapFileProcessPacket(ptv, &ts, pkt, h->caplen);
+}
+
+/** \internal
+ *  \brief get the next record from the mmap reader that passes the bpf
+ *  \retval 1 record, 0 end of file, -1 error
+ */
+static int PcapFileMmapNext(PcapFileFileVars *ptv, PcapFileMmapRecord *rec)
+{
+    int r;
+    while ((r = PcapFileMmapReaderNext(ptv->mmap, rec)) == 1) {
+        if (!ptv->filter_set)
+            break;
+        struct pcap_pkthdr h;
+        h.ts.tv_sec = rec->ts.tv_sec;
+        h.ts.tv_usec = rec->ts.tv_usec;
+        h.caplen = rec->caplen;
+        h.len = rec->len;
+        if (pcap_offline_filter(&ptv->filter, &h, rec->data) != 0)
+            break;
+    }
+    return r;
+}
+
 char pcap_filename[PATH_MAX] = "unknown";
+/** file of the reader thread when there are multiple readers */
+static thread_local char pcap_filename_thread[PATH_MAX] = "";
 
+/**
+ *  \brief get the file being read
+ *
+ *  With multiple readers each reader thread processes its own packets,
+ *  so the file of the calling thread is returned. Other threads get
+ *  "unknown" then.
+ */
 const char *PcapFileGetFilename(void)
 {
+    if (pcap_filename_thread[0] != '\0')
+        return pcap_filename_thread;
     return pcap_filename;
 }
 
+static void PcapFileSetFilename(const char *filename)
+{
+    if (pcap_g.readers > 1) {
+        strlcpy(pcap_filename_thread, filename, sizeof(pcap_filename_thread));
+    } else {
+        strlcpy(pcap_filename, filename, sizeof(pcap_filename));
+    }
+}
+
+static TmEcode PcapFileDispatchMmap(PcapFileFileVars *ptv)
+{
+    SCEnter();
+
+    /* initialize all the thread's initial timestamp */
+    if (likely(ptv->first_rec.data != NULL)) {
+        TmThreadsInitThreadsTimestamp(SCTIME_FROM_TIMEVAL(&ptv->first_pkt_ts));
+        PcapFileProcessPacket(ptv, &ptv->first_rec.ts, ptv->first_rec.data, ptv->first_rec.caplen);
+        ptv->first_rec.data = NULL;
+    }
+
+    TmEcode loop_result = TM_ECODE_OK;
+    PcapFileSetFilename(ptv->filename);
+
+    while (loop_result == TM_ECODE_OK) {
+        if (suricata_ctl_flags & SURICATA_STOP) {
+            SCReturnInt(TM_ECODE_OK);
+        }
+
+        /* make sure we have at least one packet in the packet pool, to prevent
+         * us from alloc'ing packets at line rate */
+        PacketPoolWait();
+
+        /* same batch size as used with pcap_dispatch */
+        for (int i = 0; i < 64 && loop_result == TM_ECODE_OK; i++) {
+            PcapFileMmapRecord rec;
+            const int r = PcapFileMmapNext(ptv, &rec);
+            if (unlikely(r < 0)) {
+                SCLogError("error reading %s", ptv->filename);
+                loop_result = TM_ECODE_DONE;
+            } else if (unlikely(r == 0)) {
+                SCLogInfo("pcap file %s end of file reached", ptv->filename);
+                ptv->shared->files++;
+                loop_result = TM_ECODE_DONE;
+            } else {
+                PcapFileProcessPacket(ptv, &rec.ts, rec.data, rec.caplen);
+                if (ptv->shared->cb_result == TM_ECODE_FAILED) {
+                    SCLogError("Pcap callback PcapFileCallbackLoop failed for %s", ptv->filename);
+                    loop_result = TM_ECODE_FAILED;
+                }
+            }
+        }
+        StatsSyncCountersIfSignalled(ptv->shared->tv);
+    }
+
+    SCReturnInt(loop_result);
+}
+
 /**
  *  \brief Main PCAP file reading Loop function
  */
@@ -127,6 +260,10 @@ TmEcode PcapFileDispatch(PcapFileFileVars *ptv)
 {
     SCEnter();
 
+    if (ptv->mmap != NULL) {
+        SCReturnInt(PcapFileDispatchMmap(ptv));
+    }
+
     /* initialize all the thread's initial timestamp */
     if (likely(ptv->first_pkt_hdr != NULL)) {
         TmThreadsInitThreadsTimestamp(SCTIME_FROM_TIMEVAL(&ptv->first_pkt_ts));
@@ -138,7 +275,7 @@ TmEcode PcapFileDispatch(PcapFileFileVars *ptv)
 
     int packet_q_len = 64;
     TmEcode loop_result = TM_ECODE_OK;
-    strlcpy(pcap_filename, ptv->filename, sizeof(pcap_filename));
+    PcapFileSetFilename(ptv->filename);
 
     while (loop_result == TM_ECODE_OK) {
         if (suricata_ctl_flags & SURICATA_STOP) {
@@ -193,6 +330,43 @@ static bool PeekFirstPacketTimestamp(PcapFileFileVars *pfv)
     return true;
 }
 
+/** \internal
+ *  \brief set up a file opened by the mmap reader
+ */
+static TmEcode InitPcapFileMmap(PcapFileFileVars *pfv)
+{
+    pfv->datalink = PcapFileMmapReaderDatalink(pfv->mmap);
+    SCLogDebug("datalink %" PRId32 "", pfv->datalink);
+
+    if (pfv->shared != NULL && pfv->shared->bpf_string != NULL) {
+        SCLogInfo("using bpf-filter \"%s\"", pfv->shared->bpf_string);
+
+        pcap_t *dead = pcap_open_dead(pfv->datalink, PCAP_FILE_BPF_SNAPLEN);
+        if (dead == NULL) {
+            SCLogError("failed to set up bpf compilation for %s", pfv->filename);
+            SCReturnInt(TM_ECODE_FAILED);
+        }
+        if (pcap_compile(dead, &pfv->filter, pfv->shared->bpf_string, 1, 0) < 0) {
+            SCLogError("bpf compilation error %s for %s", pcap_geterr(dead), pfv->filename);
+            pcap_close(dead);
+            SCReturnInt(TM_ECODE_FAILED);
+        }
+        pcap_close(dead);
+        pfv->filter_set = true;
+    }
+    DatalinkSetGlobalType(pfv->datalink);
+
+    if (PcapFileMmapNext(pfv, &pfv->first_rec) != 1) {
+        SCLogError("failed to get first packet timestamp of %s", pfv->filename);
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+    pfv->first_pkt_ts = pfv->first_rec.ts;
+
+    DecoderFunc UnusedFnPtr;
+    TmEcode validated = ValidateLinkType(pfv->datalink, &UnusedFnPtr);
+    SCReturnInt(validated);
+}
+
 TmEcode InitPcapFile(PcapFileFileVars *pfv)
 {
     char errbuf[PCAP_ERRBUF_SIZE] = "";
@@ -202,6 +376,14 @@ TmEcode InitPcapFile(PcapFileFileVars *pfv)
         SCReturnInt(TM_ECODE_FAILED);
     }
 
+    if (pcap_g.mmap) {
+        pfv->mmap = PcapFileMmapReaderOpen(pfv->filename);
+        if (pfv->mmap != NULL) {
+            SCReturnInt(InitPcapFileMmap(pfv));
+        }
+        SCLogDebug("reading %s with libpcap", pfv->filename);
+    }
+
     pfv->pcap_handle = pcap_open_offline(pfv->filename, errbuf);
     if (pfv->pcap_handle == NULL) {
         SCLogError("%s", errbuf);
@@ -23,16 +23,26 @@
 
 #include "suricata-common.h"
 #include "tm-threads.h"
+#include "source-pcap-file-mmap.h"
 
 #ifndef SURICATA_SOURCE_PCAP_FILE_HELPER_H
 #define SURICATA_SOURCE_PCAP_FILE_HELPER_H
 
 typedef struct PcapFileGlobalVars_ {
-    uint64_t cnt; /** packet counter */
+    SC_ATOMIC_DECLARE(uint64_t, cnt); /** packet counter */
     ChecksumValidationMode conf_checksum_mode;
     ChecksumValidationMode checksum_mode;
     SC_ATOMIC_DECLARE(unsigned int, invalid_checksums);
     uint32_t read_buffer_size;
+    /** read files through a mapping instead of libpcap */
+    bool mmap;
+    /** set the flow hash of packets before decoding, so decoding can be
+     *  spread over threads */
+    bool raw_flow_hash;
+    /** number of reader threads splitting up a directory */
+    uint16_t readers;
+    SC_ATOMIC_DECLARE(uint16_t, reader_ids);
+    SC_ATOMIC_DECLARE(uint16_t, readers_active);
 } PcapFileGlobalVars;
 
 /**
@@ -82,6 +92,12 @@ typedef struct PcapFileFileVars_
     struct pcap_pkthdr *first_pkt_hdr;
     struct timeval first_pkt_ts;
 
+    /** mmap reader, NULL if the file is read by libpcap */
+    PcapFileMmapReader *mmap;
+    PcapFileMmapRecord first_rec;
+    /** bpf filter is compiled for use with the mmap reader */
+    bool filter_set;
+
     /** flex array member for the libc io read buffer. Size controlled by
      * PcapFileGlobalVars::read_buffer_size. */
 #if defined(HAVE_SETVBUF) && defined(OS_LINUX)
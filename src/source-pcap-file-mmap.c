@@ -0,0 +1,548 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Reader for pcap and pcapng files that maps the file, so packets can
+ * point into the file instead of getting copied.
+ *
+ * Only the common formats are handled: pcap with micro or nanosecond
+ * timestamps and pcapng with a single link type, in either byte order.
+ * For anything else PcapFileMmapReaderOpen returns NULL and the caller
+ * should fall back to libpcap.
+ */
+
+#include "suricata-common.h"
+#include "source-pcap-file-mmap.h"
+#include "util-byte.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+
+#define PCAP_MAGIC      0xa1b2c3d4
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+
+#define PCAPNG_BLOCK_SHB       0x0a0d0d0a
+#define PCAPNG_BLOCK_IDB       1
+#define PCAPNG_BLOCK_PB        2
+#define PCAPNG_BLOCK_SPB       3
+#define PCAPNG_BLOCK_EPB       6
+#define PCAPNG_BYTE_ORDER      0x1a2b3c4d
+#define PCAPNG_OPT_IF_TSRESOL  9
+#define PCAPNG_OPT_IF_TSOFFSET 14
+
+#define PCAP_FILE_MMAP_MAX_IFACES 64
+/** libpcap rejects records larger than this, unless the snaplen is larger */
+#define PCAP_FILE_MMAP_MAX_CAPLEN 262144
+/** window the kernel is asked to read ahead */
+#define PCAP_FILE_MMAP_READAHEAD (16 * 1024 * 1024)
+
+typedef struct PcapngIface_ {
+    /** timestamp units per second */
+    uint64_t units;
+    int64_t ts_offset;
+    uint32_t snaplen;
+} PcapngIface;
+
+struct PcapFileMmapReader_ {
+    PcapFileMmap *map;
+    const uint8_t *data;
+    uint64_t size;
+    uint64_t offset;
+    uint64_t readahead;
+
+    bool pcapng;
+    bool swapped;
+    /** pcap: nanosecond timestamps */
+    bool nsec;
+    int datalink;
+    uint32_t snaplen;
+
+    /** pcapng: interfaces of the current section */
+    uint32_t iface_cnt;
+    PcapngIface ifaces[PCAP_FILE_MMAP_MAX_IFACES];
+};
+
+static inline uint16_t ReadU16(const PcapFileMmapReader *r, const uint8_t *ptr)
+{
+    uint16_t v;
+    memcpy(&v, ptr, sizeof(v));
+    return r->swapped ? SCByteSwap16(v) : v;
+}
+
+static inline uint32_t ReadU32(const PcapFileMmapReader *r, const uint8_t *ptr)
+{
+    uint32_t v;
+    memcpy(&v, ptr, sizeof(v));
+    return r->swapped ? SCByteSwap32(v) : v;
+}
+
+static inline uint64_t ReadU64(const PcapFileMmapReader *r, const uint8_t *ptr)
+{
+    uint64_t v;
+    memcpy(&v, ptr, sizeof(v));
+    return r->swapped ? SCByteSwap64(v) : v;
+}
+
+static bool CaplenValid(const uint32_t caplen, const uint32_t snaplen)
+{
+    return caplen <= MAX(snaplen, PCAP_FILE_MMAP_MAX_CAPLEN);
+}
+
+/** \internal
+ *  \brief convert a pcapng timestamp in units per second */
+static void PcapngTimestamp(const PcapngIface *iface, const uint64_t ts, struct timeval *tv)
+{
+    uint64_t secs = ts / iface->units;
+    const uint64_t frac = ts % iface->units;
+    uint64_t usecs;
+    if (iface->units >= 1000000 && iface->units % 1000000 == 0) {
+        usecs = frac / (iface->units / 1000000);
+    } else if (iface->units < 1000000 && 1000000 % iface->units == 0) {
+        usecs = frac * (1000000 / iface->units);
+    } else {
+        usecs = (uint64_t)((double)frac * 1000000.0 / (double)iface->units);
+    }
+    secs += (uint64_t)iface->ts_offset;
+    tv->tv_sec = (time_t)secs;
+    tv->tv_usec = (suseconds_t)usecs;
+}
+
+/** \internal
+ *  \brief parse the options of an interface description block */
+static bool PcapngParseIfaceOptions(
+        const PcapFileMmapReader *r, const uint8_t *opt, const uint8_t *end, PcapngIface *iface)
+{
+    while (end - opt >= 4) {
+        const uint16_t code = ReadU16(r, opt);
+        const uint16_t len = ReadU16(r, opt + 2);
+        opt += 4;
+        if (code == 0)
+            break;
+        if (len > end - opt)
+            return false;
+        if (code == PCAPNG_OPT_IF_TSRESOL && len == 1) {
+            const uint8_t resol = opt[0];
+            const uint8_t exp = resol & 0x7f;
+            if (resol & 0x80) {
+                if (exp > 63)
+                    return false;
+                iface->units = 1ULL << exp;
+            } else {
+                if (exp > 19)
+                    return false;
+                iface->units = 1;
+                for (uint8_t i = 0; i < exp; i++)
+                    iface->units *= 10;
+            }
+        } else if (code == PCAPNG_OPT_IF_TSOFFSET && len == 8) {
+            iface->ts_offset = (int64_t)ReadU64(r, opt);
+        }
+        opt += (len + 3) & ~3;
+    }
+    return true;
+}
+
+/** \internal
+ *  \brief handle a pcapng block
+ *
+ *  \retval 1 packet, rec is set
+ *  \retval 2 other block
+ *  \retval 0 end of file
+ *  \retval -1 error
+ */
+static int PcapngNextBlock(PcapFileMmapReader *r, PcapFileMmapRecord *rec)
+{
+    const uint64_t left = r->size - r->offset;
+    if (left == 0)
+        return 0;
+    if (left < 12)
+        return -1;
+
+    const uint8_t *block = r->data + r->offset;
+    uint32_t type;
+    memcpy(&type, block, sizeof(type));
+    if (type == PCAPNG_BLOCK_SHB) {
+        /* a new section may use another byte order */
+        uint32_t magic;
+        memcpy(&magic, block + 8, sizeof(magic));
+        if (magic == PCAPNG_BYTE_ORDER)
+            r->swapped = false;
+        else if (magic == SCByteSwap32(PCAPNG_BYTE_ORDER))
+            r->swapped = true;
+        else
+            return -1;
+        r->iface_cnt = 0;
+    } else {
+        type = ReadU32(r, block);
+    }
+
+    const uint32_t block_len = ReadU32(r, block + 4);
+    if (block_len < 12 || block_len % 4 != 0 || block_len > left)
+        return -1;
+    if (ReadU32(r, block + block_len - 4) != block_len)
+        return -1;
+    r->offset += block_len;
+
+    const uint8_t *body = block + 8;
+    const uint32_t body_len = block_len - 12;
+    const uint8_t *body_end = body + body_len;
+
+    switch (type) {
+        case PCAPNG_BLOCK_IDB: {
+            if (body_len < 8)
+                return -1;
+            const int linktype = ReadU16(r, body);
+            if (r->datalink == -1) {
+                r->datalink = linktype;
+            } else if (linktype != r->datalink) {
+                SCLogError("pcapng files with multiple link types are not supported");
+                return -1;
+            }
+            if (r->iface_cnt == PCAP_FILE_MMAP_MAX_IFACES) {
+                SCLogError("pcapng file has too many interfaces");
+                return -1;
+            }
+            PcapngIface *iface = &r->ifaces[r->iface_cnt];
+            memset(iface, 0, sizeof(*iface));
+            iface->units = 1000000;
+            iface->snaplen = ReadU32(r, body + 4);
+            if (!PcapngParseIfaceOptions(r, body + 8, body_end, iface))
+                return -1;
+            r->iface_cnt++;
+            return 2;
+        }
+        case PCAPNG_BLOCK_EPB:
+        case PCAPNG_BLOCK_PB: {
+            if (body_len < 20)
+                return -1;
+            const uint32_t id = type == PCAPNG_BLOCK_EPB ? ReadU32(r, body) : ReadU16(r, body);
+            if (id >= r->iface_cnt)
+                return -1;
+            const PcapngIface *iface = &r->ifaces[id];
+            const uint64_t ts = ((uint64_t)ReadU32(r, body + 4) << 32) | ReadU32(r, body + 8);
+            rec->caplen = ReadU32(r, body + 12);
+            rec->len = ReadU32(r, body + 16);
+            if (rec->caplen > body_len - 20 || !CaplenValid(rec->caplen, iface->snaplen))
+                return -1;
+            rec->data = body + 20;
+            PcapngTimestamp(iface, ts, &rec->ts);
+            return 1;
+        }
+        case PCAPNG_BLOCK_SPB: {
+            if (body_len < 4 || r->iface_cnt == 0)
+                return -1;
+            const PcapngIface *iface = &r->ifaces[0];
+            rec->len = ReadU32(r, body);
+            rec->caplen = MIN(rec->len, body_len - 4);
+            if (iface->snaplen > 0)
+                rec->caplen = MIN(rec->caplen, iface->snaplen);
+            rec->data = body + 4;
+            /* simple packet blocks have no timestamp */
+            memset(&rec->ts, 0, sizeof(rec->ts));
+            return 1;
+        }
+        default:
+            return 2;
+    }
+}
+
+static int PcapNextRecord(PcapFileMmapReader *r, PcapFileMmapRecord *rec)
+{
+    const uint64_t left = r->size - r->offset;
+    if (left == 0)
+        return 0;
+    if (left < 16) {
+        SCLogError("truncated pcap record header");
+        return -1;
+    }
+    const uint8_t *hdr = r->data + r->offset;
+    rec->ts.tv_sec = (time_t)ReadU32(r, hdr);
+    const uint32_t frac = ReadU32(r, hdr + 4);
+    rec->ts.tv_usec = (suseconds_t)(r->nsec ? frac / 1000 : frac);
+    rec->caplen = ReadU32(r, hdr + 8);
+    rec->len = ReadU32(r, hdr + 12);
+    if (!CaplenValid(rec->caplen, r->snaplen)) {
+        SCLogError("bogus pcap record length %u", rec->caplen);
+        return -1;
+    }
+    if (rec->caplen > left - 16) {
+        SCLogError("truncated pcap record");
+        return -1;
+    }
+    rec->data = hdr + 16;
+    r->offset += 16 + rec->caplen;
+    return 1;
+}
+
+/**
+ * \brief get the next packet
+ *
+ * \retval 1 packet, rec is set
+ * \retval 0 end of file
+ * \retval -1 error
+ */
+int PcapFileMmapReaderNext(PcapFileMmapReader *r, PcapFileMmapRecord *rec)
+{
+    int ret;
+    if (r->pcapng) {
+        while ((ret = PcapngNextBlock(r, rec)) == 2)
+            ;
+        if (ret < 0)
+            SCLogError("corrupt pcapng block at offset %" PRIu64, r->offset);
+    } else {
+        ret = PcapNextRecord(r, rec);
+    }
+
+#if defined(HAVE_SYS_MMAN_H) && defined(MADV_WILLNEED)
+    if (r->map != NULL && r->offset >= r->readahead && r->readahead < r->size) {
+        const uint64_t start = r->readahead;
+        const uint64_t len = MIN(PCAP_FILE_MMAP_READAHEAD, r->size - start);
+        (void)madvise(r->map->base + start, len, MADV_WILLNEED);
+        r->readahead = start + len;
+    }
+#endif
+    return ret;
+}
+
+/** \internal
+ *  \brief check the file header and set up the reader
+ *
+ *  \retval true if the format is handled
+ */
+static bool PcapFileMmapReaderInit(PcapFileMmapReader *r, const uint8_t *data, const uint64_t size)
+{
+    r->data = data;
+    r->size = size;
+    r->datalink = -1;
+    if (size < 24)
+        return false;
+
+    uint32_t magic;
+    memcpy(&magic, data, sizeof(magic));
+    if (magic == PCAPNG_BLOCK_SHB) {
+        r->pcapng = true;
+        /* the first interface description sets the datalink */
+        while (r->datalink == -1) {
+            PcapFileMmapRecord rec;
+            if (PcapngNextBlock(r, &rec) != 2)
+                return false;
+        }
+        return true;
+    }
+
+    if (magic == PCAP_MAGIC || magic == PCAP_MAGIC_NSEC) {
+        r->swapped = false;
+    } else if (magic == SCByteSwap32(PCAP_MAGIC) || magic == SCByteSwap32(PCAP_MAGIC_NSEC)) {
+        r->swapped = true;
+    } else {
+        return false;
+    }
+    r->nsec = ReadU32(r, data) == PCAP_MAGIC_NSEC;
+    r->snaplen = ReadU32(r, data + 16);
+    /* upper bits hold the FCS length */
+    r->datalink = (int)(ReadU32(r, data + 20) & 0x03ffffff);
+    r->offset = 24;
+    return true;
+}
+
+/**
+ * \brief map a pcap file
+ *
+ * \retval r reader or NULL if the file can't be mapped or isn't in a
+ *           format handled here
+ */
+PcapFileMmapReader *PcapFileMmapReaderOpen(const char *filename)
+{
+#ifdef HAVE_SYS_MMAN_H
+    PcapFileMmapReader *r = NULL;
+    PcapFileMmap *m = NULL;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+            (uint64_t)st.st_size > SIZE_MAX)
+        goto error;
+
+    r = SCCalloc(1, sizeof(*r));
+    m = SCCalloc(1, sizeof(*m));
+    if (r == NULL || m == NULL)
+        goto error;
+    m->size = (size_t)st.st_size;
+    /* private and writable, as decoders may touch the packet data */
+    void *base = mmap(NULL, m->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+        SCLogDebug("mmap '%s' failed: %s", filename, strerror(errno));
+        goto error;
+    }
+    close(fd);
+    fd = -1;
+    m->base = base;
+    SC_ATOMIC_INIT(m->refcnt);
+    SC_ATOMIC_SET(m->refcnt, 1);
+    r->map = m;
+    m = NULL;
+#ifdef MADV_SEQUENTIAL
+    (void)madvise(r->map->base, r->map->size, MADV_SEQUENTIAL);
+#endif
+
+    if (!PcapFileMmapReaderInit(r, r->map->base, r->map->size)) {
+        SCLogDebug("'%s' is not in a format handled by the mmap reader", filename);
+        PcapFileMmapReaderClose(r);
+        return NULL;
+    }
+    return r;
+error:
+    if (fd >= 0)
+        close(fd);
+    if (m != NULL)
+        SCFree(m);
+    if (r != NULL)
+        SCFree(r);
+    return NULL;
+#else
+    return NULL;
+#endif
+}
+
+int PcapFileMmapReaderDatalink(const PcapFileMmapReader *r)
+{
+    return r->datalink;
+}
+
+PcapFileMmap *PcapFileMmapReaderGetMap(PcapFileMmapReader *r)
+{
+    return r->map;
+}
+
+void PcapFileMmapReaderClose(PcapFileMmapReader *r)
+{
+    if (r == NULL)
+        return;
+    if (r->map != NULL)
+        PcapFileMmapDeref(r->map);
+    SCFree(r);
+}
+
+void PcapFileMmapRef(PcapFileMmap *m)
+{
+    SC_ATOMIC_ADD(m->refcnt, 1);
+}
+
+void PcapFileMmapDeref(PcapFileMmap *m)
+{
+    if (SC_ATOMIC_SUB(m->refcnt, 1) != 1)
+        return;
+#ifdef HAVE_SYS_MMAN_H
+    munmap(m->base, m->size);
+#endif
+    SCFree(m);
+}
+
+#ifdef UNITTESTS
+
+static int PcapFileMmapTest01(void)
+{
+    /* little endian pcap, nanosecond timestamps, ethernet */
+    static const uint8_t file[] = {
+        0x4d, 0x3c, 0xb2, 0xa1, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0xff, 0xff, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+        /* record: 10s 2500ns, 4 bytes of 60 */
+        0x0a, 0x00, 0x00, 0x00, 0xc4, 0x09, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x3c, 0x00, 0x00,
+        0x00, 0xde, 0xad, 0xbe, 0xef,
+        /* truncated record */
+        0x0b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00,
+        0x00, 0x01 };
+    PcapFileMmapReader *r = SCCalloc(1, sizeof(*r));
+    FAIL_IF_NULL(r);
+    FAIL_IF_NOT(PcapFileMmapReaderInit(r, file, sizeof(file)));
+    FAIL_IF_NOT(PcapFileMmapReaderDatalink(r) == 1);
+
+    PcapFileMmapRecord rec;
+    FAIL_IF_NOT(PcapFileMmapReaderNext(r, &rec) == 1);
+    FAIL_IF_NOT(rec.ts.tv_sec == 10);
+    FAIL_IF_NOT(rec.ts.tv_usec == 2);
+    FAIL_IF_NOT(rec.caplen == 4);
+    FAIL_IF_NOT(rec.len == 60);
+    FAIL_IF_NOT(rec.data == file + 40);
+    FAIL_IF_NOT(PcapFileMmapReaderNext(r, &rec) == -1);
+
+    PcapFileMmapReaderClose(r);
+    PASS;
+}
+
+static int PcapFileMmapTest02(void)
+{
+    /* big endian pcapng, one interface with millisecond resolution */
+    static const uint8_t file[] = {
+        /* section header */
+        0x0a, 0x0d, 0x0d, 0x0a, 0x00, 0x00, 0x00, 0x1c, 0x1a, 0x2b, 0x3c, 0x4d, 0x00, 0x01, 0x00,
+        0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x1c,
+        /* interface description, linktype 1, if_tsresol 3 */
+        0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x20, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x09, 0x00, 0x01, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x20,
+        /* unknown block */
+        0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x0c,
+        /* enhanced packet, iface 0, ts 12345ms, 3 of 3 bytes */
+        0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x30, 0x39, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x03, 0xaa, 0xbb,
+        0xcc, 0x00, 0x00, 0x00, 0x00, 0x24,
+        /* enhanced packet for an unknown interface */
+        0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x20 };
+    PcapFileMmapReader *r = SCCalloc(1, sizeof(*r));
+    FAIL_IF_NULL(r);
+    FAIL_IF_NOT(PcapFileMmapReaderInit(r, file, sizeof(file)));
+    FAIL_IF_NOT(PcapFileMmapReaderDatalink(r) == 1);
+
+    PcapFileMmapRecord rec;
+    FAIL_IF_NOT(PcapFileMmapReaderNext(r, &rec) == 1);
+    FAIL_IF_NOT(rec.ts.tv_sec == 12);
+    FAIL_IF_NOT(rec.ts.tv_usec == 345000);
+    FAIL_IF_NOT(rec.caplen == 3);
+    FAIL_IF_NOT(rec.data[0] == 0xaa && rec.data[2] == 0xcc);
+    FAIL_IF_NOT(PcapFileMmapReaderNext(r, &rec) == -1);
+
+    PcapFileMmapReaderClose(r);
+    PASS;
+}
+
+static int PcapFileMmapTest03(void)
+{
+    /* gzip header: not handled, libpcap gets to report it */
+    static const uint8_t file[32] = { 0x1f, 0x8b, 0x08 };
+    PcapFileMmapReader *r = SCCalloc(1, sizeof(*r));
+    FAIL_IF_NULL(r);
+    FAIL_IF(PcapFileMmapReaderInit(r, file, sizeof(file)));
+    PcapFileMmapReaderClose(r);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void PcapFileMmapRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("PcapFileMmapTest01", PcapFileMmapTest01);
+    UtRegisterTest("PcapFileMmapTest02", PcapFileMmapTest02);
+    UtRegisterTest("PcapFileMmapTest03", PcapFileMmapTest03);
+#endif
+}
@@ -0,0 +1,56 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Reader for pcap and pcapng files that maps the file, so packets can
+ * point into the file instead of getting copied.
+ */
+
+#ifndef SURICATA_SOURCE_PCAP_FILE_MMAP_H
+#define SURICATA_SOURCE_PCAP_FILE_MMAP_H
+
+/** mapping of a pcap file. Packets point into it, so it's only unmapped
+ *  when the reader and all packets released their reference. */
+typedef struct PcapFileMmap_ {
+    SC_ATOMIC_DECLARE(uint32_t, refcnt);
+    uint8_t *base;
+    size_t size;
+} PcapFileMmap;
+
+typedef struct PcapFileMmapRecord_ {
+    struct timeval ts;
+    const uint8_t *data;
+    uint32_t caplen;
+    uint32_t len;
+} PcapFileMmapRecord;
+
+typedef struct PcapFileMmapReader_ PcapFileMmapReader;
+
+PcapFileMmapReader *PcapFileMmapReaderOpen(const char *filename);
+int PcapFileMmapReaderNext(PcapFileMmapReader *r, PcapFileMmapRecord *rec);
+int PcapFileMmapReaderDatalink(const PcapFileMmapReader *r);
+PcapFileMmap *PcapFileMmapReaderGetMap(PcapFileMmapReader *r);
+void PcapFileMmapReaderClose(PcapFileMmapReader *r);
+
+void PcapFileMmapRef(PcapFileMmap *m);
+void PcapFileMmapDeref(PcapFileMmap *m);
+
+void PcapFileMmapRegisterTests(void);
+
+#endif /* SURICATA_SOURCE_PCAP_FILE_MMAP_H */
@@ -144,7 +144,21 @@ void TmModuleDecodePcapFileRegister (void)
 void PcapFileGlobalInit(void)
 {
     memset(&pcap_g, 0x00, sizeof(pcap_g));
+    SC_ATOMIC_INIT(pcap_g.cnt);
     SC_ATOMIC_INIT(pcap_g.invalid_checksums);
+    SC_ATOMIC_INIT(pcap_g.reader_ids);
+    SC_ATOMIC_INIT(pcap_g.readers_active);
+    pcap_g.readers = 1;
+
+    int mmap = 0;
+    if (ConfGetBool("pcap-file.mmap", &mmap) == 1 && mmap == 1) {
+#ifdef HAVE_SYS_MMAN_H
+        SCLogConfig("pcap-file: reading files through mmap");
+        pcap_g.mmap = true;
+#else
+        SCLogWarning("pcap-file.mmap is not supported on this platform");
+#endif
+    }
 
 #if defined(HAVE_SETVBUF) && defined(OS_LINUX)
     pcap_g.read_buffer_size = PCAP_FILE_BUFFER_SIZE_DEFAULT;
@@ -166,13 +180,36 @@ void PcapFileGlobalInit(void)
 #endif
 }
 
+/**
+ * \brief set the number of reader threads that split up a directory
+ *
+ * Each reader processes the files whose name hashes to its id.
+ */
+void PcapFileSetReaders(uint16_t readers)
+{
+    pcap_g.readers = readers;
+    SC_ATOMIC_SET(pcap_g.readers_active, readers);
+}
+
+/**
+ * \brief have the reader set the flow hash of the packets, for runmodes
+ *        that decode after distributing packets over threads.
+ */
+void PcapFileSetRawFlowHash(bool enable)
+{
+    pcap_g.raw_flow_hash = enable;
+}
+
 TmEcode PcapFileExit(TmEcode status, struct timespec *last_processed)
 {
     if(RunModeUnixSocketIsActive()) {
         status = UnixSocketPcapFile(status, last_processed);
         SCReturnInt(status);
     } else {
-        EngineStop();
+        /* the last reader to finish stops the engine */
+        if (pcap_g.readers <= 1 || SC_ATOMIC_SUB(pcap_g.readers_active, 1) == 1) {
+            EngineStop();
+        }
         SCReturnInt(status);
     }
 }
@@ -364,6 +401,13 @@ TmEcode ReceivePcapFileThreadInit(ThreadVars *tv, const void *initdata, void **d
             }
         }
 
+        pv->readers = pcap_g.readers;
+        pv->reader_id = SC_ATOMIC_ADD(pcap_g.reader_ids, 1);
+        if (pv->readers > 1) {
+            SCLogInfo("reader %u of %u for directory %s", pv->reader_id + 1, pv->readers,
+                    pv->filename);
+        }
+
         pv->shared = &ptv->shared;
         pv->directory = directory;
         TAILQ_INIT(&pv->directory_content);
@@ -398,9 +442,9 @@ void ReceivePcapFileThreadExitStats(ThreadVars *tv, void *data)
         PcapFileThreadVars *ptv = (PcapFileThreadVars *)data;
 
         if (pcap_g.conf_checksum_mode == CHECKSUM_VALIDATION_AUTO &&
-            pcap_g.cnt < CHECKSUM_SAMPLE_COUNT &&
+            SC_ATOMIC_GET(pcap_g.cnt) < CHECKSUM_SAMPLE_COUNT &&
             SC_ATOMIC_GET(pcap_g.invalid_checksums)) {
-            uint64_t chrate = pcap_g.cnt / SC_ATOMIC_GET(pcap_g.invalid_checksums);
+            uint64_t chrate = SC_ATOMIC_GET(pcap_g.cnt) / SC_ATOMIC_GET(pcap_g.invalid_checksums);
             if (chrate < CHECKSUM_INVALID_RATIO)
                 SCLogWarning("1/%" PRIu64 "th of packets have an invalid checksum,"
                              " consider setting pcap-file.checksum-checks variable to no"
@@ -30,5 +30,7 @@ void TmModuleDecodePcapFileRegister (void);
 void PcapIncreaseInvalidChecksum(void);
 
 void PcapFileGlobalInit(void);
+void PcapFileSetReaders(uint16_t readers);
+void PcapFileSetRawFlowHash(bool enable);
 
 #endif /* SURICATA_SOURCE_PCAP_FILE_H */
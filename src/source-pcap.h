@@ -35,6 +35,8 @@ void PcapTranslateIPToDevice(char *pcap_dev, size_t len);
 typedef struct PcapPacketVars_
 {
     uint32_t tenant_id;
+    /** pcap file mapping the packet data points into, if any */
+    struct PcapFileMmap_ *map;
 } PcapPacketVars;
 
 /** needs to be able to contain Windows adapter id's, so
@@ -0,0 +1,722 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * In memory replay of a pcap file.
+ *
+ * The file is loaded once into a single buffer, optionally backed by
+ * hugepages. Records are assigned to the worker threads by a symmetric
+ * hash of their flow, like RSS on a NIC, and every worker replays its
+ * share as fast as possible or at a multiple of the capture rate. As
+ * nothing is read from disk or the network while replaying, this measures
+ * what the pipeline itself can handle per core.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+#include "conf.h"
+#include "decode.h"
+#include "flow-hash.h"
+#include "source-pcap-file-helper.h"
+#include "source-replay.h"
+#include "tm-threads.h"
+#include "tmqh-packetpool.h"
+#include "util-debug.h"
+#include "util-profiling.h"
+#include "util-time.h"
+#include "util-unittest.h"
+
+/** packets replayed between packet pool and stats checks */
+#define REPLAY_BATCH_SIZE 64
+
+/** size of a hugepage, used to round the buffer size */
+#define REPLAY_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct ReplayRecord_ {
+    /** capture timestamp in microseconds */
+    uint64_t ts;
+    /** offset of the packet data in the buffer */
+    uint64_t offset;
+    uint32_t caplen;
+} ReplayRecord;
+
+typedef struct ReplayRing_ {
+    /** packet data of all records, back to back */
+    uint8_t *data;
+    size_t data_size;
+    size_t data_len;
+    bool data_mapped;
+
+    ReplayRecord *records;
+    uint32_t cnt;
+    uint32_t size;
+
+    int datalink;
+    uint64_t first_ts;
+    uint64_t last_ts;
+
+    /** indexes of the records each worker replays, in file order */
+    uint32_t **worker_records;
+    uint32_t *worker_cnt;
+    uint16_t workers;
+} ReplayRing;
+
+typedef struct ReplayGlobalVars_ {
+    ReplayRing *ring;
+    /** 0 for as fast as possible, otherwise multiple of the capture rate */
+    double speed;
+    /** passes over the file, 0 to replay until stopped */
+    uint32_t loops;
+    bool checksum_checks;
+    SC_ATOMIC_DECLARE(uint16_t, worker_ids);
+    /** workers still replaying, the last one stops the engine */
+    SC_ATOMIC_DECLARE(uint16_t, workers_active);
+    /** workers not deinitialized yet, the last one frees the ring */
+    SC_ATOMIC_DECLARE(uint16_t, workers_alive);
+} ReplayGlobalVars;
+
+typedef struct ReplayThreadVars_ {
+    ThreadVars *tv;
+    TmSlot *slot;
+    uint16_t id;
+
+    uint64_t pkts;
+    uint64_t bytes;
+    /** records skipped as they don't fit in a packet */
+    uint64_t skipped;
+    /** monotonic time the replay started at and how long it took */
+    uint64_t start_ns;
+    uint64_t elapsed_ns;
+} ReplayThreadVars;
+
+static ReplayGlobalVars replay_g;
+
+static TmEcode ReceiveReplayLoop(ThreadVars *, void *, void *);
+static TmEcode ReceiveReplayThreadInit(ThreadVars *, const void *, void **);
+static void ReceiveReplayThreadExitStats(ThreadVars *, void *);
+static TmEcode ReceiveReplayThreadDeinit(ThreadVars *, void *);
+
+static TmEcode DecodeReplay(ThreadVars *, Packet *, void *);
+static TmEcode DecodeReplayThreadInit(ThreadVars *, const void *, void **);
+static TmEcode DecodeReplayThreadDeinit(ThreadVars *tv, void *data);
+
+void TmModuleReceiveReplayRegister(void)
+{
+    tmm_modules[TMM_RECEIVEREPLAY].name = "ReceiveReplay";
+    tmm_modules[TMM_RECEIVEREPLAY].ThreadInit = ReceiveReplayThreadInit;
+    tmm_modules[TMM_RECEIVEREPLAY].Func = NULL;
+    tmm_modules[TMM_RECEIVEREPLAY].PktAcqLoop = ReceiveReplayLoop;
+    tmm_modules[TMM_RECEIVEREPLAY].PktAcqBreakLoop = NULL;
+    tmm_modules[TMM_RECEIVEREPLAY].ThreadExitPrintStats = ReceiveReplayThreadExitStats;
+    tmm_modules[TMM_RECEIVEREPLAY].ThreadDeinit = ReceiveReplayThreadDeinit;
+    tmm_modules[TMM_RECEIVEREPLAY].cap_flags = 0;
+    tmm_modules[TMM_RECEIVEREPLAY].flags = TM_FLAG_RECEIVE_TM;
+}
+
+void TmModuleDecodeReplayRegister(void)
+{
+    tmm_modules[TMM_DECODEREPLAY].name = "DecodeReplay";
+    tmm_modules[TMM_DECODEREPLAY].ThreadInit = DecodeReplayThreadInit;
+    tmm_modules[TMM_DECODEREPLAY].Func = DecodeReplay;
+    tmm_modules[TMM_DECODEREPLAY].ThreadExitPrintStats = NULL;
+    tmm_modules[TMM_DECODEREPLAY].ThreadDeinit = DecodeReplayThreadDeinit;
+    tmm_modules[TMM_DECODEREPLAY].cap_flags = 0;
+    tmm_modules[TMM_DECODEREPLAY].flags = TM_FLAG_DECODE_TM;
+}
+
+static uint64_t ReplayGetMonotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/** \internal
+ *  \brief allocate a ring with room for size bytes of packet data
+ */
+static ReplayRing *ReplayRingAlloc(size_t size, const bool hugepages)
+{
+    ReplayRing *r = SCCalloc(1, sizeof(*r));
+    if (r == NULL)
+        return NULL;
+
+#ifdef HAVE_SYS_MMAN_H
+#ifdef MAP_HUGETLB
+    if (hugepages) {
+        const size_t hsize =
+                (size + REPLAY_HUGEPAGE_SIZE - 1) / REPLAY_HUGEPAGE_SIZE * REPLAY_HUGEPAGE_SIZE;
+        void *base = mmap(NULL, hsize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) {
+            r->data = base;
+            r->data_size = hsize;
+            r->data_mapped = true;
+            return r;
+        }
+        SCLogConfig("replay: no hugepages available (%s), using regular pages", strerror(errno));
+    }
+#endif
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+        if (hugepages)
+            (void)madvise(base, size, MADV_HUGEPAGE);
+#endif
+        r->data = base;
+        r->data_size = size;
+        r->data_mapped = true;
+        return r;
+    }
+#endif
+    r->data = SCMalloc(size);
+    if (r->data == NULL) {
+        SCFree(r);
+        return NULL;
+    }
+    r->data_size = size;
+    return r;
+}
+
+static void ReplayRingFree(ReplayRing *r)
+{
+    if (r == NULL)
+        return;
+    if (r->worker_records != NULL) {
+        for (uint16_t w = 0; w < r->workers; w++) {
+            if (r->worker_records[w] != NULL)
+                SCFree(r->worker_records[w]);
+        }
+        SCFree(r->worker_records);
+    }
+    if (r->worker_cnt != NULL)
+        SCFree(r->worker_cnt);
+    if (r->records != NULL)
+        SCFree(r->records);
+#ifdef HAVE_SYS_MMAN_H
+    if (r->data_mapped) {
+        munmap(r->data, r->data_size);
+    } else
+#endif
+    {
+        SCFree(r->data);
+    }
+    SCFree(r);
+}
+
+/** \internal
+ *  \brief copy a packet into the ring
+ *
+ *  \param ts capture timestamp in microseconds
+ *
+ *  \retval 0 ok, -1 out of memory or buffer space
+ */
+static int ReplayRingAdd(
+        ReplayRing *r, const uint64_t ts, const uint8_t *pkt, const uint32_t caplen)
+{
+    if (caplen > r->data_size - r->data_len)
+        return -1;
+    if (r->cnt == r->size) {
+        if (r->size == UINT32_MAX)
+            return -1;
+        const uint32_t size = r->size ? (uint32_t)MIN((uint64_t)r->size * 2, UINT32_MAX) : 1024;
+        ReplayRecord *records = SCRealloc(r->records, (size_t)size * sizeof(ReplayRecord));
+        if (records == NULL)
+            return -1;
+        r->records = records;
+        r->size = size;
+    }
+
+    ReplayRecord *rec = &r->records[r->cnt];
+    rec->ts = ts;
+    rec->offset = r->data_len;
+    rec->caplen = caplen;
+    memcpy(r->data + r->data_len, pkt, caplen);
+    r->data_len += caplen;
+
+    /* captures aren't always in time order, so track the range rather
+     * than the first and last record */
+    if (r->cnt == 0) {
+        r->first_ts = r->last_ts = ts;
+    } else if (ts < r->first_ts) {
+        r->first_ts = ts;
+    } else if (ts > r->last_ts) {
+        r->last_ts = ts;
+    }
+    r->cnt++;
+    return 0;
+}
+
+/** \internal
+ *  \brief assign the records to workers by the hash of their flow
+ *
+ *  Both directions of a flow hash the same, so a flow is always replayed
+ *  by a single worker.
+ */
+static int ReplayRingPartition(ReplayRing *r, const uint16_t workers)
+{
+    uint16_t *assigned = SCMalloc(MAX(r->cnt, 1) * sizeof(uint16_t));
+    r->worker_records = SCCalloc(workers, sizeof(uint32_t *));
+    r->worker_cnt = SCCalloc(workers, sizeof(uint32_t));
+    if (assigned == NULL || r->worker_records == NULL || r->worker_cnt == NULL)
+        goto error;
+    r->workers = workers;
+
+    for (uint32_t i = 0; i < r->cnt; i++) {
+        const ReplayRecord *rec = &r->records[i];
+        const uint32_t hash = FlowGetRawHash(r->datalink, r->data + rec->offset, rec->caplen);
+        assigned[i] = (uint16_t)(hash % workers);
+        r->worker_cnt[assigned[i]]++;
+    }
+    for (uint16_t w = 0; w < workers; w++) {
+        r->worker_records[w] = SCMalloc(MAX(r->worker_cnt[w], 1) * sizeof(uint32_t));
+        if (r->worker_records[w] == NULL)
+            goto error;
+        r->worker_cnt[w] = 0;
+    }
+    for (uint32_t i = 0; i < r->cnt; i++) {
+        const uint16_t w = assigned[i];
+        r->worker_records[w][r->worker_cnt[w]++] = i;
+    }
+    SCFree(assigned);
+    return 0;
+
+error:
+    if (assigned != NULL)
+        SCFree(assigned);
+    return -1;
+}
+
+/** \internal
+ *  \brief load all packets of a pcap file into a ring
+ */
+static ReplayRing *ReplayRingLoad(const char *filename, const bool hugepages)
+{
+    char errbuf[PCAP_ERRBUF_SIZE] = "";
+    struct stat st;
+    if (stat(filename, &st) != 0) {
+        SCLogError("replay: unable to open %s: %s", filename, strerror(errno));
+        return NULL;
+    }
+
+    pcap_t *pcap = pcap_open_offline(filename, errbuf);
+    if (pcap == NULL) {
+        SCLogError("replay: unable to open %s: %s", filename, errbuf);
+        return NULL;
+    }
+
+    /* the packet data can't be larger than the file */
+    ReplayRing *r = ReplayRingAlloc(MAX((size_t)st.st_size, 1), hugepages);
+    if (r == NULL) {
+        SCLogError("replay: unable to allocate %" PRIuMAX " bytes for %s", (uintmax_t)st.st_size,
+                filename);
+        pcap_close(pcap);
+        return NULL;
+    }
+    r->datalink = pcap_datalink(pcap);
+
+    struct pcap_pkthdr *h;
+    const u_char *pkt;
+    int res;
+    while ((res = pcap_next_ex(pcap, &h, &pkt)) == 1) {
+        const uint64_t ts =
+                (uint64_t)MAX(h->ts.tv_sec, 0) * 1000000 + (uint64_t)MAX(h->ts.tv_usec, 0);
+        if (ReplayRingAdd(r, ts, pkt, h->caplen) != 0) {
+            SCLogError("replay: unable to load %s: out of memory", filename);
+            goto error;
+        }
+    }
+    if (res == -1) {
+        SCLogError("replay: error reading %s: %s", filename, pcap_geterr(pcap));
+        goto error;
+    }
+    pcap_close(pcap);
+    return r;
+
+error:
+    pcap_close(pcap);
+    ReplayRingFree(r);
+    return NULL;
+}
+
+/**
+ * \brief load a pcap file for replay by a number of workers
+ *
+ * Has to be called by the runmode before the workers are spawned.
+ *
+ * \retval 0 ok, -1 error
+ */
+int ReplayGlobalInit(const char *filename, uint16_t workers)
+{
+    memset(&replay_g, 0, sizeof(replay_g));
+    SC_ATOMIC_INIT(replay_g.worker_ids);
+    SC_ATOMIC_INIT(replay_g.workers_active);
+    SC_ATOMIC_INIT(replay_g.workers_alive);
+    replay_g.loops = 1;
+
+    double speed = 0;
+    if (ConfGetDouble("replay.speed", &speed) == 1) {
+        if (speed < 0) {
+            SCLogError("replay.speed can't be negative");
+            return -1;
+        }
+        replay_g.speed = speed;
+    }
+    intmax_t loops = 0;
+    if (ConfGetInt("replay.loops", &loops) == 1) {
+        if (loops < 0 || loops > UINT32_MAX) {
+            SCLogError("invalid replay.loops value %" PRIdMAX, loops);
+            return -1;
+        }
+        replay_g.loops = (uint32_t)loops;
+    }
+    int hugepages = 1;
+    (void)ConfGetBool("replay.hugepages", &hugepages);
+    int checksum_checks = 0;
+    (void)ConfGetBool("replay.checksum-checks", &checksum_checks);
+    replay_g.checksum_checks = checksum_checks == 1;
+
+    const uint64_t start = ReplayGetMonotonicNs();
+    ReplayRing *r = ReplayRingLoad(filename, hugepages == 1);
+    if (r == NULL)
+        return -1;
+    if (ReplayRingPartition(r, workers) != 0) {
+        SCLogError("replay: unable to assign packets to %u workers", workers);
+        ReplayRingFree(r);
+        return -1;
+    }
+    SCLogInfo("replay: loaded %u packets, %" PRIuMAX " bytes from %s in %" PRIu64 "ms", r->cnt,
+            (uintmax_t)r->data_len, filename, (ReplayGetMonotonicNs() - start) / 1000000);
+    for (uint16_t w = 0; w < workers; w++) {
+        SCLogConfig("replay: worker %u replays %u packets", w + 1, r->worker_cnt[w]);
+    }
+
+    replay_g.ring = r;
+    SC_ATOMIC_SET(replay_g.workers_active, workers);
+    SC_ATOMIC_SET(replay_g.workers_alive, workers);
+    return 0;
+}
+
+/** \internal
+ *  \brief wait until a packet is due at the configured speed
+ *
+ *  \param offset time of the packet since the start of the replay, in
+ *                microseconds of capture time
+ */
+static inline void ReplayPace(const ReplayThreadVars *ptv, const uint64_t offset)
+{
+    const uint64_t due = (uint64_t)((double)offset * 1000.0 / replay_g.speed);
+    const uint64_t now = ReplayGetMonotonicNs() - ptv->start_ns;
+    if (due > now + 1000) {
+        SleepUsec((due - now) / 1000);
+    }
+}
+
+static inline TmEcode ReplayProcessRecord(
+        ReplayThreadVars *ptv, const ReplayRing *r, const ReplayRecord *rec, const uint64_t ts)
+{
+    Packet *p = PacketGetFromQueueOrAlloc();
+    if (unlikely(p == NULL)) {
+        SCLogError("Failed to allocate a packet.");
+        return TM_ECODE_FAILED;
+    }
+    PACKET_PROFILING_TMM_START(p, TMM_RECEIVEREPLAY);
+
+    PKT_SET_SRC(p, PKT_SRC_WIRE);
+    p->ts = SCTIME_ADD_USECS(SCTIME_FROM_SECS(ts / 1000000), ts % 1000000);
+    p->datalink = r->datalink;
+
+    /* copy like a capture method filling its buffers would. This also
+     * keeps the ring unmodified for the next pass */
+    if (unlikely(PacketCopyData(p, r->data + rec->offset, rec->caplen))) {
+        /* skip it, like pcap file does */
+        ptv->skipped++;
+        PACKET_PROFILING_TMM_END(p, TMM_RECEIVEREPLAY);
+        TmqhOutputPacketpool(ptv->tv, p);
+        return TM_ECODE_OK;
+    }
+    if (!replay_g.checksum_checks) {
+        p->flags |= PKT_IGNORE_CHECKSUM;
+    }
+    ptv->pkts++;
+    ptv->bytes += rec->caplen;
+
+    PACKET_PROFILING_TMM_END(p, TMM_RECEIVEREPLAY);
+
+    return TmThreadsSlotProcessPkt(ptv->tv, ptv->slot, p);
+}
+
+/**
+ * \brief replay loop
+ *
+ * Every pass shifts the timestamps by the duration of the file, so time
+ * keeps moving forward over the passes.
+ */
+static TmEcode ReceiveReplayLoop(ThreadVars *tv, void *data, void *slot)
+{
+    SCEnter();
+    ReplayThreadVars *ptv = (ReplayThreadVars *)data;
+    const ReplayRing *r = replay_g.ring;
+    const uint32_t *records = r->worker_records[ptv->id];
+    const uint32_t cnt = r->worker_cnt[ptv->id];
+    /* keep the first packet of a pass after the last one of the previous */
+    const uint64_t span = r->last_ts - r->first_ts + 1000000;
+    TmEcode result = TM_ECODE_DONE;
+
+    ptv->slot = ((TmSlot *)slot)->slot_next;
+
+    TmThreadsSetFlag(tv, THV_RUNNING);
+
+    if (ptv->id == 0 && r->cnt > 0) {
+        TmThreadsInitThreadsTimestamp(
+                SCTIME_ADD_USECS(SCTIME_FROM_SECS(r->first_ts / 1000000), r->first_ts % 1000000));
+    }
+
+    ptv->start_ns = ReplayGetMonotonicNs();
+    for (uint32_t loop = 0; replay_g.loops == 0 || loop < replay_g.loops; loop++) {
+        const uint64_t shift = (uint64_t)loop * span;
+        uint32_t i = 0;
+        while (i < cnt) {
+            if (suricata_ctl_flags & SURICATA_STOP) {
+                result = TM_ECODE_OK;
+                goto end;
+            }
+
+            /* make sure we have at least one packet in the packet pool, to
+             * prevent us from alloc'ing packets at line rate */
+            PacketPoolWait();
+
+            const uint32_t batch_end = MIN(cnt, i + REPLAY_BATCH_SIZE);
+            for (; i < batch_end; i++) {
+                const ReplayRecord *rec = &r->records[records[i]];
+                if (replay_g.speed > 0) {
+                    ReplayPace(ptv, rec->ts - r->first_ts + shift);
+                }
+                if (ReplayProcessRecord(ptv, r, rec, rec->ts + shift) != TM_ECODE_OK) {
+                    result = TM_ECODE_FAILED;
+                    goto end;
+                }
+            }
+            StatsSyncCountersIfSignalled(tv);
+        }
+        if (cnt == 0)
+            break;
+    }
+
+end:
+    ptv->elapsed_ns = ReplayGetMonotonicNs() - ptv->start_ns;
+    /* the last worker to finish stops the engine */
+    if (result == TM_ECODE_FAILED || SC_ATOMIC_SUB(replay_g.workers_active, 1) == 1) {
+        EngineStop();
+    }
+    SCReturnInt(result);
+}
+
+static TmEcode ReceiveReplayThreadInit(ThreadVars *tv, const void *initdata, void **data)
+{
+    SCEnter();
+    if (replay_g.ring == NULL) {
+        SCLogError("replay: no packets loaded");
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+
+    ReplayThreadVars *ptv = SCCalloc(1, sizeof(ReplayThreadVars));
+    if (unlikely(ptv == NULL))
+        SCReturnInt(TM_ECODE_FAILED);
+    ptv->tv = tv;
+    ptv->id = SC_ATOMIC_ADD(replay_g.worker_ids, 1);
+    if (ptv->id >= replay_g.ring->workers) {
+        SCLogError("replay: more threads than the %u workers the packets were assigned to",
+                replay_g.ring->workers);
+        SCFree(ptv);
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+
+    *data = (void *)ptv;
+    SCReturnInt(TM_ECODE_OK);
+}
+
+static void ReceiveReplayThreadExitStats(ThreadVars *tv, void *data)
+{
+    ReplayThreadVars *ptv = (ReplayThreadVars *)data;
+    const double secs = (double)ptv->elapsed_ns / 1000000000.0;
+    const double pps = secs > 0 ? (double)ptv->pkts / secs : 0;
+    const double mbps = secs > 0 ? (double)ptv->bytes * 8 / secs / 1000000.0 : 0;
+    SCLogNotice("replayed %" PRIu64 " packets, %" PRIu64 " bytes in %.3fs: %.0f pps, %.1f Mbps",
+            ptv->pkts, ptv->bytes, secs, pps, mbps);
+    if (ptv->skipped > 0) {
+        SCLogWarning("skipped %" PRIu64 " packets that don't fit in a packet buffer",
+                ptv->skipped);
+    }
+}
+
+static TmEcode ReceiveReplayThreadDeinit(ThreadVars *tv, void *data)
+{
+    SCFree(data);
+    /* packets hold copies of the data, so the ring can go when the last
+     * worker is done */
+    if (SC_ATOMIC_SUB(replay_g.workers_alive, 1) == 1) {
+        ReplayRingFree(replay_g.ring);
+        replay_g.ring = NULL;
+    }
+    SCReturnInt(TM_ECODE_OK);
+}
+
+static TmEcode DecodeReplay(ThreadVars *tv, Packet *p, void *data)
+{
+    SCEnter();
+    DecodeThreadVars *dtv = (DecodeThreadVars *)data;
+
+    BUG_ON(PKT_IS_PSEUDOPKT(p));
+
+    /* update counters */
+    DecodeUpdatePacketCounters(tv, dtv, p);
+
+    DecoderFunc decoder;
+    if (ValidateLinkType(p->datalink, &decoder) != TM_ECODE_OK) {
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+    decoder(tv, dtv, p, GET_PKT_DATA(p), GET_PKT_LEN(p));
+
+    PacketDecodeFinalize(tv, dtv, p);
+
+    SCReturnInt(TM_ECODE_OK);
+}
+
+static TmEcode DecodeReplayThreadInit(ThreadVars *tv, const void *initdata, void **data)
+{
+    SCEnter();
+    DecodeThreadVars *dtv = DecodeThreadVarsAlloc(tv);
+    if (dtv == NULL)
+        SCReturnInt(TM_ECODE_FAILED);
+
+    DecodeRegisterPerfCounters(dtv, tv);
+
+    *data = (void *)dtv;
+
+    SCReturnInt(TM_ECODE_OK);
+}
+
+static TmEcode DecodeReplayThreadDeinit(ThreadVars *tv, void *data)
+{
+    if (data != NULL)
+        DecodeThreadVarsFree(tv, data);
+    SCReturnInt(TM_ECODE_OK);
+}
+
+#ifdef UNITTESTS
+
+/** \test both directions of a flow are replayed by the same worker */
+static int ReplayRingTest01(void)
+{
+    uint8_t pkt[] = {
+        /* ethernet */
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x00, 0x01, 0x02, 0x03, 0x04, 0x06, 0x08, 0x00,
+        /* ipv4 */
+        0x45, 0x00, 0x00, 0x28, 0x00, 0x01, 0x00, 0x00, 0x40, 0x06, 0x00, 0x00, 0x0a, 0x00,
+        0x00, 0x01, 0x0a, 0x00, 0x00, 0x02,
+        /* tcp */
+        0x04, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x50, 0x02,
+        0x20, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    uint8_t rev[sizeof(pkt)];
+    memcpy(rev, pkt, sizeof(pkt));
+    memcpy(rev + 26, pkt + 30, 4);
+    memcpy(rev + 30, pkt + 26, 4);
+    memcpy(rev + 34, pkt + 36, 2);
+    memcpy(rev + 36, pkt + 34, 2);
+
+    ReplayRing *r = ReplayRingAlloc(64 * sizeof(pkt), false);
+    FAIL_IF_NULL(r);
+    r->datalink = LINKTYPE_ETHERNET;
+    /* 32 flows, each with a packet in both directions */
+    for (uint8_t i = 0; i < 32; i++) {
+        pkt[35] = rev[37] = i;
+        FAIL_IF(ReplayRingAdd(r, 1000 + i, pkt, sizeof(pkt)) != 0);
+        FAIL_IF(ReplayRingAdd(r, 2000 + i, rev, sizeof(rev)) != 0);
+    }
+    /* full */
+    FAIL_IF(ReplayRingAdd(r, 3000, pkt, 1) == 0);
+    FAIL_IF_NOT(r->cnt == 64);
+    FAIL_IF_NOT(r->first_ts == 1000);
+    FAIL_IF_NOT(r->last_ts == 2031);
+    FAIL_IF(memcmp(r->data + r->records[63].offset, rev, sizeof(rev)) != 0);
+
+    FAIL_IF(ReplayRingPartition(r, 4) != 0);
+    uint32_t total = 0;
+    uint16_t used = 0;
+    for (uint16_t w = 0; w < 4; w++) {
+        total += r->worker_cnt[w];
+        used += r->worker_cnt[w] > 0;
+        for (uint32_t i = 0; i < r->worker_cnt[w]; i++) {
+            const uint32_t idx = r->worker_records[w][i];
+            /* file order */
+            if (i > 0)
+                FAIL_IF_NOT(idx > r->worker_records[w][i - 1]);
+            /* the reply of the flow is with the same worker */
+            if (idx % 2 == 0) {
+                FAIL_IF_NOT(i + 1 < r->worker_cnt[w]);
+                bool found = false;
+                for (uint32_t j = i + 1; j < r->worker_cnt[w]; j++) {
+                    if (r->worker_records[w][j] == idx + 1)
+                        found = true;
+                }
+                FAIL_IF_NOT(found);
+            }
+        }
+    }
+    FAIL_IF_NOT(total == 64);
+    FAIL_IF(used < 2);
+
+    ReplayRingFree(r);
+    PASS;
+}
+
+/** \test records out of time order keep the ring range at the earliest
+ *        and latest record, so no pace offset is negative */
+static int ReplayRingTest02(void)
+{
+    const uint8_t pkt[64] = { 0 };
+
+    ReplayRing *r = ReplayRingAlloc(4 * sizeof(pkt), false);
+    FAIL_IF_NULL(r);
+    FAIL_IF(ReplayRingAdd(r, 2000, pkt, sizeof(pkt)) != 0);
+    FAIL_IF(ReplayRingAdd(r, 1000, pkt, sizeof(pkt)) != 0);
+    FAIL_IF(ReplayRingAdd(r, 3000, pkt, sizeof(pkt)) != 0);
+    FAIL_IF(ReplayRingAdd(r, 1500, pkt, sizeof(pkt)) != 0);
+    FAIL_IF_NOT(r->cnt == 4);
+    FAIL_IF_NOT(r->first_ts == 1000);
+    FAIL_IF_NOT(r->last_ts == 3000);
+    for (uint32_t i = 0; i < r->cnt; i++) {
+        FAIL_IF(r->records[i].ts < r->first_ts);
+        FAIL_IF(r->records[i].ts - r->first_ts > r->last_ts - r->first_ts);
+    }
+
+    ReplayRingFree(r);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void ReplayRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("ReplayRingTest01", ReplayRingTest01);
+    UtRegisterTest("ReplayRingTest02", ReplayRingTest02);
+#endif
+}
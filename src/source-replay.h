@@ -0,0 +1,35 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * In memory replay of a pcap file, to benchmark the engine without
+ * capture hardware.
+ */
+
+#ifndef SURICATA_SOURCE_REPLAY_H
+#define SURICATA_SOURCE_REPLAY_H
+
+void TmModuleReceiveReplayRegister(void);
+void TmModuleDecodeReplayRegister(void);
+
+int ReplayGlobalInit(const char *filename, uint16_t workers);
+
+void ReplayRegisterTests(void);
+
+#endif /* SURICATA_SOURCE_REPLAY_H */
@@ -94,6 +94,7 @@
 #include "source-pcap-file.h"
 #include "source-pcap-file-helper.h"
 #include "source-erf-file.h"
+#include "source-replay.h"
 #include "source-erf-dag.h"
 #include "source-af-packet.h"
 #include "source-af-xdp.h"
@@ -627,6 +628,8 @@ static void PrintUsage(const char *progname)
     printf("\t--dump-config                        : show the running configuration\n");
     printf("\t--dump-features                      : display provided features\n");
     printf("\t--build-info                         : display build information\n");
+    printf("\t--dataset-compile <type>,<in>,<out>  : compile a dataset file into the memory "
+           "mapped binary format and exit\n");
     printf("\t--pcap[=<dev>]                       : run in pcap mode, no value select interfaces from suricata.yaml\n");
     printf("\t--pcap-file-continuous               : when running in pcap mode with a directory, continue checking directory for pcaps until interrupted\n");
     printf("\t--pcap-file-delete                   : when running in replay mode (-r with directory or file), will delete pcap files that have been processed when done\n");
@@ -661,6 +664,7 @@ static void PrintUsage(const char *progname)
     printf("\t--group <group>                      : run suricata as this group after init\n");
 #endif /* HAVE_LIBCAP_NG */
     printf("\t--erf-in <path>                      : process an ERF file\n");
+    printf("\t--replay <path>                      : replay a pcap file from memory\n");
 #ifdef HAVE_DAG
     printf("\t--dag <dagX:Y>                       : process ERF records from DAG interface X, stream Y\n");
 #endif
@@ -924,6 +928,9 @@ void RegisterAllModules(void)
     /* dag file */
     TmModuleReceiveErfFileRegister();
     TmModuleDecodeErfFileRegister();
+    /* in memory replay */
+    TmModuleReceiveReplayRegister();
+    TmModuleDecodeReplayRegister();
     /* dag live */
     TmModuleReceiveErfDagRegister();
     TmModuleDecodeErfDagRegister();
@@ -1083,6 +1090,7 @@ static void SCInstanceInit(SCInstance *suri, const char *progname)
     suri->regex_arg = NULL;
 
     suri->keyword_info = NULL;
+    suri->dataset_compile = NULL;
     suri->runmode_custom_mode = NULL;
 #ifndef OS_WIN32
     suri->user_name = NULL;
@@ -1382,8 +1390,10 @@ TmEcode SCParseCommandLine(int argc, char **argv)
         {"user", required_argument, 0, 0},
         {"group", required_argument, 0, 0},
         {"erf-in", required_argument, 0, 0},
+        {"replay", required_argument, 0, 0},
         {"dag", required_argument, 0, 0},
         {"build-info", 0, &build_info, 1},
+        {"dataset-compile", required_argument, 0, 0},
         {"data-dir", required_argument, 0, 0},
 #ifdef WINDIVERT
         {"windivert", required_argument, 0, 0},
@@ -1635,6 +1645,18 @@ TmEcode SCParseCommandLine(int argc, char **argv)
                     SCLogError("failed to set erf-file.file");
                     return TM_ECODE_FAILED;
                 }
+            } else if (strcmp((long_opts[option_index]).name, "replay") == 0) {
+                if (suri->run_mode == RUNMODE_UNKNOWN) {
+                    suri->run_mode = RUNMODE_REPLAY;
+                } else {
+                    SCLogError("more than one run mode has been specified");
+                    PrintUsage(argv[0]);
+                    return TM_ECODE_FAILED;
+                }
+                if (ConfSetFinal("replay.file", optarg) != 1) {
+                    SCLogError("failed to set replay.file");
+                    return TM_ECODE_FAILED;
+                }
             } else if (strcmp((long_opts[option_index]).name, "dag") == 0) {
 #ifdef HAVE_DAG
                 if (suri->run_mode == RUNMODE_UNKNOWN) {
@@ -1672,6 +1694,10 @@ TmEcode SCParseCommandLine(int argc, char **argv)
             } else if (strcmp((long_opts[option_index]).name, "build-info") == 0) {
                 suri->run_mode = RUNMODE_PRINT_BUILDINFO;
                 return TM_ECODE_OK;
+            } else if (strcmp((long_opts[option_index]).name, "dataset-compile") == 0) {
+                suri->dataset_compile = optarg;
+                suri->run_mode = RUNMODE_DATASET_COMPILE;
+                return TM_ECODE_OK;
             } else if (strcmp((long_opts[option_index]).name, "windivert-forward") == 0) {
 #ifdef WINDIVERT
                 if (suri->run_mode == RUNMODE_UNKNOWN) {
@@ -2216,6 +2242,9 @@ void PreRunInit(const int runmode)
         return;
 
     StatsInit();
+#if defined(PROFILING) || defined(PROFILE_RULES)
+    SCProfilingHwGlobalInit();
+#endif
 #ifdef PROFILE_RULES
     SCProfilingRulesGlobalInit();
 #endif
@@ -2326,6 +2355,8 @@ int SCStartInternalRunMode(int argc, char **argv)
         case RUNMODE_PRINT_BUILDINFO:
             PrintBuildInfo();
             return TM_ECODE_DONE;
+        case RUNMODE_DATASET_COMPILE:
+            return DatasetsCompile(suri->dataset_compile) == 0 ? TM_ECODE_DONE : TM_ECODE_FAILED;
         case RUNMODE_PRINT_USAGE:
             PrintUsage(argv[0]);
             return TM_ECODE_DONE;
@@ -65,6 +65,37 @@ static int TestDetectAlertPacketApplySignatureActions02(void)
     PASS;
 }
 
+/**
+ * \brief Tests that the alerts array is only allocated once the packet alerts
+ *        and is kept when the packet is recycled
+ */
+static int TestDetectAlertPacketAlertsLazyAlloc01(void)
+{
+    uint8_t payload[] = "Hi all!";
+    uint16_t length = sizeof(payload) - 1;
+    Packet *p = UTHBuildPacketReal(
+            (uint8_t *)payload, length, IPPROTO_TCP, "192.168.1.5", "192.168.1.1", 41424, 80);
+    FAIL_IF_NULL(p);
+    FAIL_IF_NOT_NULL(p->alerts.alerts);
+
+    const char sig[] = "alert tcp any any -> any any (content:\"nomatch\"; sid:1;)";
+    FAIL_IF(UTHPacketMatchSig(p, sig) == 1);
+    FAIL_IF_NOT_NULL(p->alerts.alerts);
+
+    const char sig2[] = "alert tcp any any -> any any (content:\"Hi all\"; sid:2;)";
+    FAIL_IF(UTHPacketMatchSig(p, sig2) == 0);
+    FAIL_IF_NULL(p->alerts.alerts);
+    FAIL_IF_NOT(p->alerts.cnt == 1);
+
+    PacketAlert *alerts = p->alerts.alerts;
+    PacketRecycle(p);
+    FAIL_IF_NOT(p->alerts.cnt == 0);
+    FAIL_IF_NOT(p->alerts.alerts == alerts);
+
+    UTHFreePackets(&p, 1);
+    PASS;
+}
+
 /**
  * \brief Registers Detect Engine Alert unit tests
  */
@@ -74,4 +105,6 @@ void DetectEngineAlertRegisterTests(void)
             TestDetectAlertPacketApplySignatureActions01);
     UtRegisterTest("TestDetectAlertPacketApplySignatureActions02",
             TestDetectAlertPacketApplySignatureActions02);
+    UtRegisterTest(
+            "TestDetectAlertPacketAlertsLazyAlloc01", TestDetectAlertPacketAlertsLazyAlloc01);
 }
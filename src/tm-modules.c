@@ -190,6 +190,8 @@ const char * TmModuleTmmIdToString(TmmId id)
         CASE_CODE (TMM_RECEIVEIPFW);
         CASE_CODE (TMM_RECEIVEERFFILE);
         CASE_CODE (TMM_DECODEERFFILE);
+        CASE_CODE(TMM_RECEIVEREPLAY);
+        CASE_CODE(TMM_DECODEREPLAY);
         CASE_CODE (TMM_RECEIVEERFDAG);
         CASE_CODE(TMM_DECODEERFDAG);
         CASE_CODE (TMM_RECEIVEAFP);
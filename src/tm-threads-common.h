@@ -47,6 +47,8 @@ typedef enum {
     TMM_RECEIVEIPFW,
     TMM_RECEIVEERFFILE,
     TMM_DECODEERFFILE,
+    TMM_RECEIVEREPLAY,
+    TMM_DECODEREPLAY,
     TMM_RECEIVEERFDAG,
     TMM_DECODEERFDAG,
     TMM_RECEIVEAFP,
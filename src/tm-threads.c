@@ -469,6 +469,7 @@ static void *TmThreadsSlotVar(void *td)
                 if (p != NULL) {
                     p->flags |= PKT_PSEUDO_STREAM_END;
                     PKT_SET_SRC(p, PKT_SRC_CAPTURE_TIMEOUT);
+                    p->ts = TimeGetCoarse();
                 }
             }
         }
@@ -222,6 +222,8 @@ static inline void TmThreadsCaptureInjectPacket(ThreadVars *tv, Packet *p)
     if (p != NULL) {
         p->flags |= PKT_PSEUDO_STREAM_END;
         PKT_SET_SRC(p, PKT_SRC_CAPTURE_TIMEOUT);
+        /* the capture is idle, so there is no packet time to go by */
+        p->ts = TimeGetCoarse();
         if (TmThreadsSlotProcessPkt(tv, tv->tm_flowworker, p) != TM_ECODE_OK) {
             TmqhOutputPacketpool(tv, p);
         }
@@ -217,12 +217,25 @@ void TmqhOutputFlowFreeCtx(void *ctx)
     SCFree(fctx);
 }
 
+/** \internal
+ *  \brief check if the packet is assigned by its flow hash
+ *
+ *  A raw flow hash of 0 means the packet couldn't be parsed before
+ *  decoding. Those are spread round robin instead of all going to the
+ *  first queue. */
+static inline bool TmqhFlowUseHash(const Packet *p)
+{
+    if (p->flags & PKT_HAS_RAW_FLOW_HASH)
+        return p->flow_hash != 0;
+    return (p->flags & PKT_WANTS_FLOW) != 0;
+}
+
 void TmqhOutputFlowHash(ThreadVars *tv, Packet *p)
 {
     uint32_t qid;
     TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
 
-    if (p->flags & PKT_WANTS_FLOW) {
+    if (TmqhFlowUseHash(p)) {
         uint32_t hash = p->flow_hash;
         qid = hash % ctx->size;
     } else {
@@ -248,10 +261,14 @@ void TmqhOutputFlowHash(ThreadVars *tv, Packet *p)
 void TmqhOutputFlowIPPair(ThreadVars *tv, Packet *p)
 {
     uint32_t addr_hash = 0;
+    uint32_t qid;
 
     TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
 
-    if (p->src.family == AF_INET6) {
+    if (p->flags & PKT_HAS_RAW_FLOW_HASH) {
+        /* addresses are not decoded yet */
+        addr_hash = p->flow_hash;
+    } else if (p->src.family == AF_INET6) {
         for (int i = 0; i < 4; i++) {
             addr_hash += p->src.addr_data32[i] + p->dst.addr_data32[i];
         }
@@ -259,7 +276,14 @@ void TmqhOutputFlowIPPair(ThreadVars *tv, Packet *p)
         addr_hash = p->src.addr_data32[0] + p->dst.addr_data32[0];
     }
 
-    uint32_t qid = addr_hash % ctx->size;
+    if (!(p->flags & PKT_HAS_RAW_FLOW_HASH) || p->flow_hash != 0) {
+        qid = addr_hash % ctx->size;
+    } else {
+        qid = ctx->last++;
+
+        if (ctx->last == ctx->size)
+            ctx->last = 0;
+    }
     PacketQueue *q = ctx->queues[qid].q;
     SCMutexLock(&q->mutex_q);
     PacketEnqueue(q, p);
@@ -272,8 +296,9 @@ static void TmqhOutputFlowFTPHash(ThreadVars *tv, Packet *p)
     uint32_t qid;
     TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
 
-    if (p->flags & PKT_WANTS_FLOW) {
+    if (TmqhFlowUseHash(p)) {
         uint32_t hash = p->flow_hash;
+        /* undecoded packets are never TCP here, so they use the raw hash */
         if (PacketIsTCP(p) && ((p->sp >= 1024 && p->dp >= 1024) || p->dp == 21 || p->sp == 21 ||
                                       p->dp == 20 || p->sp == 20)) {
             hash = FlowGetIpPairProtoHash(p);
@@ -391,6 +416,41 @@ static int TmqhOutputFlowSetupCtxTest03(void)
     PASS;
 }
 
+/** \test packets without a raw flow hash are spread round robin */
+static int TmqhOutputFlowHashTest01(void)
+{
+    TmqResetQueues();
+
+    void *ctx = TmqhOutputFlowSetupCtx("queue1,queue2");
+    FAIL_IF_NULL(ctx);
+    TmqhFlowCtx *fctx = (TmqhFlowCtx *)ctx;
+    FAIL_IF_NOT(fctx->size == 2);
+
+    ThreadVars tv;
+    memset(&tv, 0, sizeof(tv));
+    tv.outctx = ctx;
+
+    for (int i = 0; i < 4; i++) {
+        Packet *p = PacketGetFromAlloc();
+        FAIL_IF_NULL(p);
+        p->flags |= PKT_HAS_RAW_FLOW_HASH;
+        p->flow_hash = 0;
+        TmqhOutputFlowHash(&tv, p);
+    }
+    FAIL_IF_NOT(fctx->queues[0].q->len == 2);
+    FAIL_IF_NOT(fctx->queues[1].q->len == 2);
+
+    for (int i = 0; i < 2; i++) {
+        Packet *p;
+        while ((p = PacketDequeue(fctx->queues[i].q)) != NULL) {
+            PacketFree(p);
+        }
+    }
+    TmqhOutputFlowFreeCtx(fctx);
+    TmqResetQueues();
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void TmqhFlowRegisterTests(void)
@@ -402,5 +462,6 @@ void TmqhFlowRegisterTests(void)
                    TmqhOutputFlowSetupCtxTest02);
     UtRegisterTest("TmqhOutputFlowSetupCtxTest03",
                    TmqhOutputFlowSetupCtxTest03);
+    UtRegisterTest("TmqhOutputFlowHashTest01", TmqhOutputFlowHashTest01);
 #endif
 }
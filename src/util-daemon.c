@@ -181,6 +181,9 @@ int CheckValidDaemonModes (int daemon, int mode)
             case RUNMODE_PCAP_FILE:
                 SCLogError("ERROR: pcap offline mode cannot run as daemon");
                 return 0;
+            case RUNMODE_REPLAY:
+                SCLogError("ERROR: replay mode cannot run as daemon");
+                return 0;
             case RUNMODE_UNITTEST:
                 SCLogError("ERROR: unittests cannot run as daemon");
                 return 0;
@@ -31,9 +31,11 @@
 #ifdef HAVE_DPDK_BOND
 #include <rte_eth_bond.h>
 #endif
+#include <rte_cycles.h>
 #include <rte_launch.h>
 #include <rte_lcore.h>
 #include <rte_log.h>
+#include <rte_malloc.h>
 #include <rte_mempool.h>
 #include <rte_mbuf.h>
 #include <rte_flow.h>
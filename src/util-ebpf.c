@@ -50,6 +50,7 @@
 #include "flow.h"
 #include "flow-hash.h"
 #include "tm-threads.h"
+#include "util-validate.h"
 
 #include <bpf/libbpf.h>
 #include <bpf/bpf.h>
@@ -602,22 +603,33 @@ static bool EBPFBypassCheckHalfFlow(Flow *f, FlowBypassInfo *fc,
     int i;
     uint64_t pkts_cnt = 0;
     uint64_t bytes_cnt = 0;
-    /* We use a per CPU structure so we will get a array of values. But if nr_cpus
-     * is 1 then we have a global hash. */
-    BPF_DECLARE_PERCPU(struct pair, values_array, eb->cpus_count);
-    memset(values_array, 0, sizeof(values_array));
-    int res = bpf_map_lookup_elem(eb->mapfd, key, values_array);
-    if (res < 0) {
-        SCLogDebug("errno: (%d) %s", errno, strerror(errno));
-        return false;
-    }
-    for (i = 0; i < eb->cpus_count; i++) {
-        /* let's start accumulating value so we can compute the counters */
-        SCLogDebug("%d: Adding pkts %lu bytes %lu", i,
-                BPF_PERCPU(values_array, i).packets,
-                BPF_PERCPU(values_array, i).bytes);
-        pkts_cnt += BPF_PERCPU(values_array, i).packets;
-        bytes_cnt += BPF_PERCPU(values_array, i).bytes;
+    const uint64_t prev_pkts_cnt = index == 0 ? fc->todstpktcnt : fc->tosrcpktcnt;
+    const bool refreshed = eb->refreshed[index];
+    eb->refreshed[index] = false;
+    if (refreshed && eb->pkts[index] != prev_pkts_cnt) {
+        /* the last table walk already saw new packets, so the flow is
+         * alive. An idle half is still checked with the kernel below as
+         * packets may have come in since that walk. */
+        pkts_cnt = eb->pkts[index];
+        bytes_cnt = eb->bytes[index];
+    } else {
+        /* We use a per CPU structure so we will get a array of values. But if nr_cpus
+         * is 1 then we have a global hash. */
+        BPF_DECLARE_PERCPU(struct pair, values_array, eb->cpus_count);
+        memset(values_array, 0, sizeof(values_array));
+        int res = bpf_map_lookup_elem(eb->mapfd, key, values_array);
+        if (res < 0) {
+            SCLogDebug("errno: (%d) %s", errno, strerror(errno));
+            return false;
+        }
+        for (i = 0; i < eb->cpus_count; i++) {
+            /* let's start accumulating value so we can compute the counters */
+            SCLogDebug("%d: Adding pkts %lu bytes %lu", i,
+                    BPF_PERCPU(values_array, i).packets,
+                    BPF_PERCPU(values_array, i).bytes);
+            pkts_cnt += BPF_PERCPU(values_array, i).packets;
+            bytes_cnt += BPF_PERCPU(values_array, i).bytes;
+        }
     }
     if (index == 0) {
         if (pkts_cnt != fc->todstpktcnt) {
@@ -671,95 +683,247 @@ typedef bool (*OpFlowForKey)(struct flows_stats * flowstats, LiveDevice*dev, voi
                             uint64_t pkts_cnt, uint64_t bytes_cnt,
                             int mapfd, int cpus_count);
 
-/**
- * Bypassed flows iterator for IPv4
+typedef void (*EBPFKeyToFlowKey)(const void *key, FlowKey *flow_key,
+                                 const struct ebpf_timeout_config *tcfg);
+
+static void EBPFFlowV4KeyToFlowKey(const void *key, FlowKey *flow_key,
+                                   const struct ebpf_timeout_config *tcfg)
+{
+    const struct flowv4_keys *k = key;
+    if (tcfg->mode == AFP_MODE_XDP_BYPASS) {
+        flow_key->sp = ntohs(k->port16[0]);
+        flow_key->dp = ntohs(k->port16[1]);
+        flow_key->src.addr_data32[0] = k->src;
+        flow_key->dst.addr_data32[0] = k->dst;
+    } else {
+        flow_key->sp = k->port16[0];
+        flow_key->dp = k->port16[1];
+        flow_key->src.addr_data32[0] = ntohl(k->src);
+        flow_key->dst.addr_data32[0] = ntohl(k->dst);
+    }
+    flow_key->src.family = AF_INET;
+    flow_key->src.addr_data32[1] = 0;
+    flow_key->src.addr_data32[2] = 0;
+    flow_key->src.addr_data32[3] = 0;
+    flow_key->dst.family = AF_INET;
+    flow_key->dst.addr_data32[1] = 0;
+    flow_key->dst.addr_data32[2] = 0;
+    flow_key->dst.addr_data32[3] = 0;
+    flow_key->vlan_id[0] = k->vlan0;
+    flow_key->vlan_id[1] = k->vlan1;
+    flow_key->vlan_id[2] = k->vlan2;
+    if (k->ip_proto == 1) {
+        flow_key->proto = IPPROTO_TCP;
+    } else {
+        flow_key->proto = IPPROTO_UDP;
+    }
+}
+
+static void EBPFFlowV6KeyToFlowKey(const void *key, FlowKey *flow_key,
+                                   const struct ebpf_timeout_config *tcfg)
+{
+    const struct flowv6_keys *k = key;
+    flow_key->src.family = AF_INET6;
+    flow_key->dst.family = AF_INET6;
+    if (tcfg->mode == AFP_MODE_XDP_BYPASS) {
+        flow_key->sp = ntohs(k->port16[0]);
+        flow_key->dp = ntohs(k->port16[1]);
+        for (int i = 0; i < 4; i++) {
+            flow_key->src.addr_data32[i] = k->src[i];
+            flow_key->dst.addr_data32[i] = k->dst[i];
+        }
+    } else {
+        flow_key->sp = k->port16[0];
+        flow_key->dp = k->port16[1];
+        for (int i = 0; i < 4; i++) {
+            flow_key->src.addr_data32[i] = ntohl(k->src[i]);
+            flow_key->dst.addr_data32[i] = ntohl(k->dst[i]);
+        }
+    }
+    flow_key->vlan_id[0] = k->vlan0;
+    flow_key->vlan_id[1] = k->vlan1;
+    flow_key->vlan_id[2] = k->vlan2;
+    if (k->ip_proto == 1) {
+        flow_key->proto = IPPROTO_TCP;
+    } else {
+        flow_key->proto = IPPROTO_UDP;
+    }
+}
+
+/** \internal
+ *  \brief run the callback on a flow table entry
+ *
+ *  \param values per CPU counters of the entry
  *
- * This function iterates on all the flows of the IPv4 table
- * running a callback function on each flow.
+ *  \retval true if the entry is dead and has to be removed from the table
  */
-static int EBPFForEachFlowV4Table(ThreadVars *th_v, LiveDevice *dev, const char *name,
-                                  struct timespec *ctime,
-                                  struct ebpf_timeout_config *tcfg,
-                                  OpFlowForKey EBPFOpFlowForKey
-                                  )
+static bool EBPFFlowTableEntry(struct flows_stats *flowstats, LiveDevice *dev, void *key,
+        size_t skey, const struct pair *values, struct timespec *ctime,
+        struct ebpf_timeout_config *tcfg, int mapfd, EBPFKeyToFlowKey KeyToFlowKey,
+        OpFlowForKey EBPFOpFlowForKey)
 {
-    struct flows_stats flowstats = { 0, 0, 0};
-    int mapfd = EBPFGetMapFDByName(dev->dev, name);
-    if (mapfd == -1)
-        return -1;
+    uint64_t pkts_cnt = 0;
+    uint64_t bytes_cnt = 0;
+    for (int i = 0; i < tcfg->cpus_count; i++) {
+        /* let's start accumulating value so we can compute the counters */
+        SCLogDebug("%d: Adding pkts %lu bytes %lu", i, values[i].packets, values[i].bytes);
+        pkts_cnt += values[i].packets;
+        bytes_cnt += values[i].bytes;
+    }
+    /* Get the corresponding Flow in the Flow table to compare and update
+     * its counters and lastseen if needed */
+    FlowKey flow_key;
+    KeyToFlowKey(key, &flow_key, tcfg);
+    flow_key.recursion_level = 0;
+    flow_key.livedev_id = dev->id;
+    return EBPFOpFlowForKey(flowstats, dev, key, skey, &flow_key, ctime, pkts_cnt, bytes_cnt,
+            mapfd, tcfg->cpus_count);
+}
+
+#ifdef HAVE_BPF_MAP_LOOKUP_BATCH
+/** number of entries fetched from a flow table per syscall */
+#define EBPF_FLOW_TABLE_BATCH_SIZE 256
+
+/** \internal
+ *  \brief delete a set of keys from a map
+ *
+ *  \param keys array of count keys of skey bytes
+ */
+static void EBPFDeleteKeys(int mapfd, uint8_t *keys, size_t skey, uint32_t count)
+{
+    uint32_t i = 0;
+#ifdef HAVE_BPF_MAP_DELETE_BATCH
+    uint32_t deleted = count;
+    if (bpf_map_delete_batch(mapfd, keys, &deleted, NULL) == 0) {
+        return;
+    }
+    /* the batch stops at the first key that can't be deleted, for example
+     * because the kernel evicted it already, so handle the rest one by one */
+    i = deleted + 1;
+#endif
+    for (; i < count; i++) {
+        EBPFDeleteKey(mapfd, keys + i * skey);
+    }
+}
 
-    struct flowv4_keys key = {}, next_key;
+/** \internal
+ *  \brief walk a flow table fetching and deleting entries in batches
+ *
+ *  \retval -1 if the kernel doesn't support batch operations on the map
+ *  \retval 0 if no dead flows were found or the thread got killed
+ *  \retval 1 if dead flows were found
+ */
+static int EBPFForEachFlowTableBatch(ThreadVars *th_v, LiveDevice *dev, int mapfd, size_t skey,
+        struct timespec *ctime, struct ebpf_timeout_config *tcfg, EBPFKeyToFlowKey KeyToFlowKey,
+        OpFlowForKey EBPFOpFlowForKey, struct flows_stats *flowstats, uint64_t *hash_cnt)
+{
     int found = 0;
-    unsigned int i;
-    uint64_t hash_cnt = 0;
+    const uint32_t batch_size = EBPF_FLOW_TABLE_BATCH_SIZE;
+    /* per CPU values are laid out like BPF_DECLARE_PERCPU, struct pair
+     * is already 8 bytes aligned */
+    struct pair *values = SCCalloc((size_t)batch_size * tcfg->cpus_count, sizeof(struct pair));
+    uint8_t *keys = SCCalloc(batch_size, skey);
+    uint8_t *dead_keys = SCCalloc(batch_size, skey);
+    /* the batch position token is map specific, a key sized buffer fits
+     * all hash types */
+    uint8_t *batch = SCCalloc(1, skey);
+    if (values == NULL || keys == NULL || dead_keys == NULL || batch == NULL) {
+        found = -1;
+        goto end;
+    }
 
-    if (tcfg->cpus_count == 0) {
-        return 0;
+    void *in_batch = NULL;
+    bool done = false;
+    while (!done) {
+        uint32_t count = batch_size;
+        int res = bpf_map_lookup_batch(mapfd, in_batch, batch, keys, values, &count, NULL);
+        if (res < 0) {
+            if (errno != ENOENT) {
+                if (in_batch == NULL) {
+                    SCLogDebug("no batch support: (%d) %s", errno, strerror(errno));
+                    found = -1;
+                    goto end;
+                }
+                SCLogWarning("Unable to walk bypass table: %s (%d)", strerror(errno), errno);
+                break;
+            }
+            /* ENOENT: end of table, count holds the last entries */
+            done = true;
+        }
+        in_batch = batch;
+        *hash_cnt += count;
+
+        uint32_t dead_cnt = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (EBPFFlowTableEntry(flowstats, dev, keys + i * skey, skey,
+                        values + (size_t)i * tcfg->cpus_count, ctime, tcfg, mapfd,
+                        KeyToFlowKey, EBPFOpFlowForKey)) {
+                memcpy(dead_keys + dead_cnt * skey, keys + i * skey, skey);
+                dead_cnt++;
+            }
+        }
+        if (dead_cnt > 0) {
+            EBPFDeleteKeys(mapfd, dead_keys, skey, dead_cnt);
+            found = 1;
+        }
+
+        if (TmThreadsCheckFlag(th_v, THV_KILL)) {
+            found = 0;
+            goto end;
+        }
     }
 
+end:
+    if (values)
+        SCFree(values);
+    if (keys)
+        SCFree(keys);
+    if (dead_keys)
+        SCFree(dead_keys);
+    if (batch)
+        SCFree(batch);
+    return found;
+}
+#endif /* HAVE_BPF_MAP_LOOKUP_BATCH */
+
+/** \internal
+ *  \brief walk a flow table one key at a time
+ *
+ *  \retval 0 if no dead flows were found or the thread got killed
+ *  \retval 1 if dead flows were found
+ */
+static int EBPFForEachFlowTableKey(ThreadVars *th_v, LiveDevice *dev, int mapfd, size_t skey,
+        struct timespec *ctime, struct ebpf_timeout_config *tcfg, EBPFKeyToFlowKey KeyToFlowKey,
+        OpFlowForKey EBPFOpFlowForKey, struct flows_stats *flowstats, uint64_t *hash_cnt)
+{
+    /* fits both flowv4_keys and flowv6_keys */
+    uint8_t key[sizeof(struct flowv6_keys)];
+    uint8_t next_key[sizeof(struct flowv6_keys)];
+    DEBUG_VALIDATE_BUG_ON(skey > sizeof(key));
+    bool first = true;
     bool dead_flow = false;
-    while (bpf_map_get_next_key(mapfd, &key, &next_key) == 0) {
-        uint64_t bytes_cnt = 0;
-        uint64_t pkts_cnt = 0;
-        hash_cnt++;
+    int found = 0;
+
+    while (bpf_map_get_next_key(mapfd, first ? NULL : key, next_key) == 0) {
+        (*hash_cnt)++;
         if (dead_flow) {
-            EBPFDeleteKey(mapfd, &key);
+            EBPFDeleteKey(mapfd, key);
             dead_flow = false;
         }
+        first = false;
         /* We use a per CPU structure so we will get a array of values. But if nr_cpus
          * is 1 then we have a global hash. */
         BPF_DECLARE_PERCPU(struct pair, values_array, tcfg->cpus_count);
         memset(values_array, 0, sizeof(values_array));
-        int res = bpf_map_lookup_elem(mapfd, &next_key, values_array);
+        int res = bpf_map_lookup_elem(mapfd, next_key, values_array);
         if (res < 0) {
-            SCLogDebug("no entry in v4 table for %d -> %d", key.port16[0], key.port16[1]);
             SCLogDebug("errno: (%d) %s", errno, strerror(errno));
-            key = next_key;
+            memcpy(key, next_key, skey);
             continue;
         }
-        for (i = 0; i < tcfg->cpus_count; i++) {
-            /* let's start accumulating value so we can compute the counters */
-            SCLogDebug("%d: Adding pkts %lu bytes %lu", i,
-                       BPF_PERCPU(values_array, i).packets,
-                       BPF_PERCPU(values_array, i).bytes);
-            pkts_cnt += BPF_PERCPU(values_array, i).packets;
-            bytes_cnt += BPF_PERCPU(values_array, i).bytes;
-        }
-        /* Get the corresponding Flow in the Flow table to compare and update
-         * its counters and lastseen if needed */
-        FlowKey flow_key;
-        if (tcfg->mode == AFP_MODE_XDP_BYPASS) {
-            flow_key.sp = ntohs(next_key.port16[0]);
-            flow_key.dp = ntohs(next_key.port16[1]);
-            flow_key.src.addr_data32[0] = next_key.src;
-            flow_key.dst.addr_data32[0] = next_key.dst;
-        } else {
-            flow_key.sp = next_key.port16[0];
-            flow_key.dp = next_key.port16[1];
-            flow_key.src.addr_data32[0] = ntohl(next_key.src);
-            flow_key.dst.addr_data32[0] = ntohl(next_key.dst);
-        }
-        flow_key.src.family = AF_INET;
-        flow_key.src.addr_data32[1] = 0;
-        flow_key.src.addr_data32[2] = 0;
-        flow_key.src.addr_data32[3] = 0;
-        flow_key.dst.family = AF_INET;
-        flow_key.dst.addr_data32[1] = 0;
-        flow_key.dst.addr_data32[2] = 0;
-        flow_key.dst.addr_data32[3] = 0;
-        flow_key.vlan_id[0] = next_key.vlan0;
-        flow_key.vlan_id[1] = next_key.vlan1;
-        flow_key.vlan_id[2] = next_key.vlan2;
-        if (next_key.ip_proto == 1) {
-            flow_key.proto = IPPROTO_TCP;
-        } else {
-            flow_key.proto = IPPROTO_UDP;
-        }
-        flow_key.recursion_level = 0;
-        flow_key.livedev_id = dev->id;
-        dead_flow = EBPFOpFlowForKey(&flowstats, dev, &next_key, sizeof(next_key), &flow_key,
-                                     ctime, pkts_cnt, bytes_cnt,
-                                     mapfd, tcfg->cpus_count);
+        dead_flow = EBPFFlowTableEntry(flowstats, dev, next_key, skey,
+                (const struct pair *)values_array, ctime, tcfg, mapfd, KeyToFlowKey,
+                EBPFOpFlowForKey);
         if (dead_flow) {
             found = 1;
         }
@@ -768,152 +932,139 @@ static int EBPFForEachFlowV4Table(ThreadVars *th_v, LiveDevice *dev, const char
             return 0;
         }
 
-        key = next_key;
+        memcpy(key, next_key, skey);
     }
     if (dead_flow) {
-        EBPFDeleteKey(mapfd, &key);
+        EBPFDeleteKey(mapfd, key);
         found = 1;
     }
-    SC_ATOMIC_ADD(dev->bypassed, flowstats.packets);
-
-    LiveDevAddBypassStats(dev, flowstats.count, AF_INET);
-    SCLogInfo("IPv4 bypassed flow table size: %" PRIu64, hash_cnt);
-
     return found;
 }
 
 /**
- * Bypassed flows iterator for IPv6
+ * Bypassed flows iterator
  *
- * This function iterates on all the flows of the IPv4 table
- * running a callback function on each flow.
+ * This function iterates on all the flows of a flow table running a
+ * callback function on each flow. When libbpf and the kernel support it,
+ * the table is read and cleaned up in batches instead of with a few
+ * syscalls per entry.
  */
-static int EBPFForEachFlowV6Table(ThreadVars *th_v,
-                                  LiveDevice *dev, const char *name,
-                                  struct timespec *ctime,
-                                  struct ebpf_timeout_config *tcfg,
-                                  OpFlowForKey EBPFOpFlowForKey
-                                  )
+static int EBPFForEachFlowTable(ThreadVars *th_v, LiveDevice *dev, const char *name,
+        struct timespec *ctime, struct ebpf_timeout_config *tcfg, size_t skey, int family,
+        EBPFKeyToFlowKey KeyToFlowKey, OpFlowForKey EBPFOpFlowForKey)
 {
-    struct flows_stats flowstats = { 0, 0, 0};
+    struct flows_stats flowstats = { 0, 0, 0 };
     int mapfd = EBPFGetMapFDByName(dev->dev, name);
     if (mapfd == -1)
         return -1;
 
-    struct flowv6_keys key = {}, next_key;
-    int found = 0;
-    unsigned int i;
-    uint64_t hash_cnt = 0;
-
     if (tcfg->cpus_count == 0) {
         SCLogWarning("CPU count should not be 0");
         return 0;
     }
 
-    uint64_t pkts_cnt = 0;
-    while (bpf_map_get_next_key(mapfd, &key, &next_key) == 0) {
-        uint64_t bytes_cnt = 0;
-        hash_cnt++;
-        if (pkts_cnt > 0) {
-            EBPFDeleteKey(mapfd, &key);
-        }
-        pkts_cnt = 0;
-        /* We use a per CPU structure so we will get a array of values. But if nr_cpus
-         * is 1 then we have a global hash. */
-        BPF_DECLARE_PERCPU(struct pair, values_array, tcfg->cpus_count);
-        memset(values_array, 0, sizeof(values_array));
-        int res = bpf_map_lookup_elem(mapfd, &next_key, values_array);
-        if (res < 0) {
-            SCLogDebug("no entry in v4 table for %d -> %d", key.port16[0], key.port16[1]);
-            key = next_key;
-            continue;
-        }
-        for (i = 0; i < tcfg->cpus_count; i++) {
-            /* let's start accumulating value so we can compute the counters */
-            SCLogDebug("%d: Adding pkts %lu bytes %lu", i,
-                       BPF_PERCPU(values_array, i).packets,
-                       BPF_PERCPU(values_array, i).bytes);
-            pkts_cnt += BPF_PERCPU(values_array, i).packets;
-            bytes_cnt += BPF_PERCPU(values_array, i).bytes;
-        }
-        /* Get the corresponding Flow in the Flow table to compare and update
-         * its counters  and lastseen if needed */
-        FlowKey flow_key;
-        if (tcfg->mode == AFP_MODE_XDP_BYPASS) {
-            flow_key.sp = ntohs(next_key.port16[0]);
-            flow_key.dp = ntohs(next_key.port16[1]);
-            flow_key.src.family = AF_INET6;
-            flow_key.src.addr_data32[0] = next_key.src[0];
-            flow_key.src.addr_data32[1] = next_key.src[1];
-            flow_key.src.addr_data32[2] = next_key.src[2];
-            flow_key.src.addr_data32[3] = next_key.src[3];
-            flow_key.dst.family = AF_INET6;
-            flow_key.dst.addr_data32[0] = next_key.dst[0];
-            flow_key.dst.addr_data32[1] = next_key.dst[1];
-            flow_key.dst.addr_data32[2] = next_key.dst[2];
-            flow_key.dst.addr_data32[3] = next_key.dst[3];
-        } else {
-            flow_key.sp = next_key.port16[0];
-            flow_key.dp = next_key.port16[1];
-            flow_key.src.family = AF_INET6;
-            flow_key.src.addr_data32[0] = ntohl(next_key.src[0]);
-            flow_key.src.addr_data32[1] = ntohl(next_key.src[1]);
-            flow_key.src.addr_data32[2] = ntohl(next_key.src[2]);
-            flow_key.src.addr_data32[3] = ntohl(next_key.src[3]);
-            flow_key.dst.family = AF_INET6;
-            flow_key.dst.addr_data32[0] = ntohl(next_key.dst[0]);
-            flow_key.dst.addr_data32[1] = ntohl(next_key.dst[1]);
-            flow_key.dst.addr_data32[2] = ntohl(next_key.dst[2]);
-            flow_key.dst.addr_data32[3] = ntohl(next_key.dst[3]);
-        }
-        flow_key.vlan_id[0] = next_key.vlan0;
-        flow_key.vlan_id[1] = next_key.vlan1;
-        flow_key.vlan_id[2] = next_key.vlan2;
-        if (next_key.ip_proto == 1) {
-            flow_key.proto = IPPROTO_TCP;
-        } else {
-            flow_key.proto = IPPROTO_UDP;
-        }
-        flow_key.recursion_level = 0;
-        flow_key.livedev_id = dev->id;
-        pkts_cnt = EBPFOpFlowForKey(&flowstats, dev, &next_key, sizeof(next_key), &flow_key,
-                                    ctime, pkts_cnt, bytes_cnt,
-                                    mapfd, tcfg->cpus_count);
-        if (pkts_cnt > 0) {
-            found = 1;
-        }
-
-        if (TmThreadsCheckFlag(th_v, THV_KILL)) {
-            return 0;
-        }
-
-        key = next_key;
+    uint64_t hash_cnt = 0;
+    int found = -1;
+#ifdef HAVE_BPF_MAP_LOOKUP_BATCH
+    found = EBPFForEachFlowTableBatch(th_v, dev, mapfd, skey, ctime, tcfg, KeyToFlowKey,
+            EBPFOpFlowForKey, &flowstats, &hash_cnt);
+#endif
+    if (found == -1) {
+        found = EBPFForEachFlowTableKey(th_v, dev, mapfd, skey, ctime, tcfg, KeyToFlowKey,
+                EBPFOpFlowForKey, &flowstats, &hash_cnt);
     }
-    if (pkts_cnt > 0) {
-        EBPFDeleteKey(mapfd, &key);
-        found = 1;
+    if (TmThreadsCheckFlag(th_v, THV_KILL)) {
+        return 0;
     }
     SC_ATOMIC_ADD(dev->bypassed, flowstats.packets);
 
-    LiveDevAddBypassStats(dev, flowstats.count, AF_INET6);
-    SCLogInfo("IPv6 bypassed flow table size: %" PRIu64, hash_cnt);
+    LiveDevAddBypassStats(dev, flowstats.count, family);
+    SCLogInfo("IPv%d bypassed flow table size: %" PRIu64, family == AF_INET ? 4 : 6, hash_cnt);
+
     return found;
 }
 
-
 int EBPFCheckBypassedFlowCreate(ThreadVars *th_v, struct timespec *curtime, void *data)
 {
     LiveDevice *ldev = NULL, *ndev;
     struct ebpf_timeout_config *cfg = (struct ebpf_timeout_config *)data;
     while(LiveDeviceForEach(&ldev, &ndev)) {
-        EBPFForEachFlowV4Table(th_v, ldev, "flow_table_v4",
-                curtime,
-                cfg, EBPFCreateFlowForKey);
-        EBPFForEachFlowV6Table(th_v, ldev, "flow_table_v6",
-                curtime,
-                cfg, EBPFCreateFlowForKey);
+        EBPFForEachFlowTable(th_v, ldev, "flow_table_v4", curtime, cfg,
+                sizeof(struct flowv4_keys), AF_INET, EBPFFlowV4KeyToFlowKey,
+                EBPFCreateFlowForKey);
+        EBPFForEachFlowTable(th_v, ldev, "flow_table_v6", curtime, cfg,
+                sizeof(struct flowv6_keys), AF_INET6, EBPFFlowV6KeyToFlowKey,
+                EBPFCreateFlowForKey);
+    }
+
+    return 0;
+}
+
+#ifdef HAVE_BPF_MAP_LOOKUP_BATCH
+/** \internal
+ *  \brief store the counters of a flow table entry in its bypassed flow
+ *
+ *  Entries without a flow are left to the LRU eviction of the table.
+ *
+ *  \retval false (entries are never removed here)
+ */
+static bool EBPFRefreshFlowForKey(struct flows_stats *flowstats, LiveDevice *dev, void *key,
+        size_t skey, FlowKey *flow_key, struct timespec *ctime, uint64_t pkts_cnt,
+        uint64_t bytes_cnt, int mapfd, int cpus_count)
+{
+    Flow *f = FlowGetExistingFlowFromFlowKey(flow_key);
+    if (f == NULL)
+        return false;
+
+    FlowBypassInfo *fc = FlowGetStorageById(f, GetFlowBypassInfoID());
+    if (fc && fc->BypassUpdate == EBPFBypassUpdate && fc->bypass_data) {
+        EBPFBypassData *eb = (EBPFBypassData *)fc->bypass_data;
+        for (int i = 0; i < 2; i++) {
+            if (eb->key[i] && memcmp(eb->key[i], key, skey) == 0) {
+                eb->pkts[i] = pkts_cnt;
+                eb->bytes[i] = bytes_cnt;
+                eb->refreshed[i] = true;
+                break;
+            }
+        }
     }
+    FLOWLOCK_UNLOCK(f);
+    return false;
+}
+#endif /* HAVE_BPF_MAP_LOOKUP_BATCH */
 
+/**
+ * Refresh the counters of the bypassed flows
+ *
+ * The flow tables are read in batches and the counters are stored in the
+ * bypassed flows, so the timeout check of the flow manager doesn't have
+ * to look up the keys of active flows one by one.
+ */
+int EBPFCheckBypassedFlowRefresh(ThreadVars *th_v, struct flows_stats *bypassstats,
+        struct timespec *curtime, void *data)
+{
+#ifdef HAVE_BPF_MAP_LOOKUP_BATCH
+    LiveDevice *ldev = NULL, *ndev;
+    struct ebpf_timeout_config *cfg = (struct ebpf_timeout_config *)data;
+    if (cfg->cpus_count == 0)
+        return 0;
+    while (LiveDeviceForEach(&ldev, &ndev)) {
+        struct flows_stats flowstats = { 0, 0, 0 };
+        uint64_t hash_cnt = 0;
+        int mapfd = EBPFGetMapFDByName(ldev->dev, "flow_table_v4");
+        if (mapfd != -1) {
+            EBPFForEachFlowTableBatch(th_v, ldev, mapfd, sizeof(struct flowv4_keys), curtime,
+                    cfg, EBPFFlowV4KeyToFlowKey, EBPFRefreshFlowForKey, &flowstats, &hash_cnt);
+        }
+        mapfd = EBPFGetMapFDByName(ldev->dev, "flow_table_v6");
+        if (mapfd != -1) {
+            EBPFForEachFlowTableBatch(th_v, ldev, mapfd, sizeof(struct flowv6_keys), curtime,
+                    cfg, EBPFFlowV6KeyToFlowKey, EBPFRefreshFlowForKey, &flowstats, &hash_cnt);
+        }
+        if (TmThreadsCheckFlag(th_v, THV_KILL))
+            break;
+    }
+#endif
     return 0;
 }
 
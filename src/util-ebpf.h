@@ -70,6 +70,10 @@ typedef struct EBPFBypassData_ {
     void *key[2];
     int mapfd;
     int cpus_count;
+    /* counters of each key as seen by the last batched table walk */
+    uint64_t pkts[2];
+    uint64_t bytes[2];
+    bool refreshed[2];
 } EBPFBypassData;
 
 #define EBPF_SOCKET_FILTER  (1<<0)
@@ -83,6 +87,8 @@ int EBPFLoadFile(const char *iface, const char *path, const char * section,
 int EBPFSetupXDP(const char *iface, int fd, uint8_t flags);
 
 int EBPFCheckBypassedFlowCreate(ThreadVars *th_v, struct timespec *curtime, void *data);
+int EBPFCheckBypassedFlowRefresh(ThreadVars *th_v, struct flows_stats *bypassstats,
+        struct timespec *curtime, void *data);
 
 void EBPFRegisterExtension(void);
 
@@ -0,0 +1,163 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Epoch based reclamation.
+ *
+ * Each thread that reads gets a slot, on its own cache line, holding the
+ * global epoch it entered its read section in, or 0 when it's outside of
+ * one. Slots are never freed, so a thread that exited just leaves an idle
+ * slot behind.
+ *
+ * Memory unlinked before SCEpochAdvance returned E can't be reached by
+ * readers that entered after that, so it can be freed once no slot holds
+ * an epoch <= E.
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+#include "util-validate.h"
+#include "util-epoch.h"
+
+typedef struct SCEpochSlot_ {
+    /** epoch the thread entered its read section in, 0 if not reading */
+    SC_ATOMIC_DECLARE(uint64_t, epoch);
+    struct SCEpochSlot_ *next;
+} __attribute__((aligned(CLS))) SCEpochSlot;
+
+/* epoch 0 means idle, so the global epoch starts at 1 */
+static SC_ATOMIC_DECL_AND_INIT_WITH_VAL(uint64_t, epoch_global, 1);
+static SCEpochSlot *epoch_slots = NULL;
+static SCMutex epoch_slots_lock = SCMUTEX_INITIALIZER;
+
+static thread_local SCEpochSlot *epoch_slot = NULL;
+static thread_local uint32_t epoch_depth = 0;
+
+static SCEpochSlot *EpochSlotGet(void)
+{
+    if (likely(epoch_slot != NULL))
+        return epoch_slot;
+
+    SCEpochSlot *slot = SCMallocAligned(sizeof(*slot), CLS);
+    if (slot == NULL) {
+        FatalError("failed to allocate epoch slot");
+    }
+    memset(slot, 0, sizeof(*slot));
+    SC_ATOMIC_INIT(slot->epoch);
+
+    SCMutexLock(&epoch_slots_lock);
+    slot->next = epoch_slots;
+    epoch_slots = slot;
+    SCMutexUnlock(&epoch_slots_lock);
+
+    epoch_slot = slot;
+    return slot;
+}
+
+/**
+ * \brief start a read section
+ *
+ * Sections may be nested, only the outer one is tracked.
+ */
+void SCEpochEnter(void)
+{
+    if (epoch_depth++ > 0)
+        return;
+
+    SCEpochSlot *slot = EpochSlotGet();
+    uint64_t e;
+    do {
+        /* publish the epoch, then verify it's still current so a writer
+         * that advanced meanwhile can't miss this reader */
+        e = SC_ATOMIC_GET(epoch_global);
+        SC_ATOMIC_SET(slot->epoch, e);
+    } while (SC_ATOMIC_GET(epoch_global) != e);
+}
+
+void SCEpochExit(void)
+{
+    DEBUG_VALIDATE_BUG_ON(epoch_depth == 0);
+    if (--epoch_depth > 0)
+        return;
+    SC_ATOMIC_SET(epoch_slot->epoch, 0);
+}
+
+/**
+ * \brief start a new epoch
+ *
+ * \retval epoch that ended. Memory unlinked before this call can be freed
+ *         when SCEpochPassed returns true for it.
+ */
+uint64_t SCEpochAdvance(void)
+{
+    return SC_ATOMIC_ADD(epoch_global, 1);
+}
+
+/**
+ * \brief check if all read sections that started in or before an epoch
+ *        are done
+ */
+bool SCEpochPassed(const uint64_t epoch)
+{
+    bool passed = true;
+    SCMutexLock(&epoch_slots_lock);
+    for (SCEpochSlot *slot = epoch_slots; slot != NULL; slot = slot->next) {
+        const uint64_t e = SC_ATOMIC_GET(slot->epoch);
+        if (e != 0 && e <= epoch) {
+            passed = false;
+            break;
+        }
+    }
+    SCMutexUnlock(&epoch_slots_lock);
+    return passed;
+}
+
+#ifdef UNITTESTS
+
+static int SCEpochTest01(void)
+{
+    const uint64_t e = SCEpochAdvance();
+    FAIL_IF_NOT(SCEpochPassed(e));
+
+    SCEpochEnter();
+    /* this thread entered after the advance */
+    FAIL_IF_NOT(SCEpochPassed(e));
+    const uint64_t e2 = SCEpochAdvance();
+    FAIL_IF(SCEpochPassed(e2));
+
+    /* nested sections keep the outer epoch */
+    SCEpochEnter();
+    SCEpochExit();
+    FAIL_IF(SCEpochPassed(e2));
+
+    SCEpochExit();
+    FAIL_IF_NOT(SCEpochPassed(e2));
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void SCEpochRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SCEpochTest01", SCEpochTest01);
+#endif
+}
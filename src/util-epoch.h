@@ -0,0 +1,39 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Epoch based reclamation for data structures with lockless readers.
+ *
+ * Readers wrap their access in SCEpochEnter / SCEpochExit, which only
+ * write to a slot owned by the calling thread. A writer that unlinked
+ * memory calls SCEpochAdvance and may free the memory once
+ * SCEpochPassed returns true for the returned epoch.
+ */
+
+#ifndef SURICATA_UTIL_EPOCH_H
+#define SURICATA_UTIL_EPOCH_H
+
+void SCEpochEnter(void);
+void SCEpochExit(void);
+uint64_t SCEpochAdvance(void);
+bool SCEpochPassed(const uint64_t epoch);
+
+void SCEpochRegisterTests(void);
+
+#endif /* SURICATA_UTIL_EPOCH_H */
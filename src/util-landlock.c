@@ -194,9 +194,11 @@ void LandlockSandboxing(SCInstance *suri)
         LandlockSandboxingAddRule(ruleset, ConfigGetDataDirectory(),
                 _LANDLOCK_SURI_ACCESS_FS_WRITE | _LANDLOCK_ACCESS_FS_READ);
     }
-    if (suri->run_mode == RUNMODE_PCAP_FILE) {
+    if (suri->run_mode == RUNMODE_PCAP_FILE || suri->run_mode == RUNMODE_REPLAY) {
         const char *pcap_file;
-        if (ConfGet("pcap-file.file", &pcap_file) == 1) {
+        const char *conf_key =
+                suri->run_mode == RUNMODE_REPLAY ? "replay.file" : "pcap-file.file";
+        if (ConfGet(conf_key, &pcap_file) == 1) {
             char *file_name = SCStrdup(pcap_file);
             if (file_name != NULL) {
                 struct stat statbuf;
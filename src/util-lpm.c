@@ -0,0 +1,490 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Read-only longest prefix match tables compiled from the radix trees.
+ *
+ * The prefixes of a tree are inserted shortest first using controlled
+ * prefix expansion: a prefix fills all the entries it covers at the level
+ * it ends in, and a longer prefix that needs a child chunk below an entry
+ * starts that chunk as a copy of the entry. Since shorter prefixes are
+ * always inserted first, a range that is filled never contains a child.
+ */
+
+#include "suricata-common.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+#include "util-lpm.h"
+
+/** prefix count from which an IPv4 table uses a 24 bit root */
+#define LPM_DIR24_MIN_PREFIXES 65536
+/** per table memory limit. If reached the caller keeps using the tree. */
+#define LPM_MAX_MEMORY (512ULL * 1024 * 1024)
+/** the shifted chunk index must fit in an entry */
+#define LPM_MAX_CHUNKS (SC_LPM_CHILD >> SC_LPM_STRIDE_BITS)
+
+typedef struct LpmPrefix_ {
+    uint8_t addr[16];
+    uint8_t netmask;
+    void *user;
+} LpmPrefix;
+
+typedef struct LpmPrefixList_ {
+    LpmPrefix *prefixes;
+    uint32_t cnt;
+    uint32_t size;
+} LpmPrefixList;
+
+static int LpmPrefixListAdd(
+        LpmPrefixList *l, const uint8_t *addr, const uint8_t addr_len, uint8_t netmask, void *user)
+{
+    if (l->cnt == l->size) {
+        const uint32_t new_size = l->size ? l->size * 2 : 256;
+        void *ptmp = SCRealloc(l->prefixes, new_size * sizeof(LpmPrefix));
+        if (ptmp == NULL)
+            return -1;
+        l->prefixes = ptmp;
+        l->size = new_size;
+    }
+
+    LpmPrefix *p = &l->prefixes[l->cnt++];
+    memset(p, 0, sizeof(*p));
+    /* mask the address, the node prefix may hold more bits than the netmask */
+    for (uint8_t i = 0; i < addr_len && netmask > i * 8; i++) {
+        const uint8_t bits = netmask - i * 8;
+        p->addr[i] = bits >= 8 ? addr[i] : (uint8_t)(addr[i] & (0xff << (8 - bits)));
+    }
+    p->netmask = netmask;
+    p->user = user;
+    return 0;
+}
+
+static int LpmCollectIPv4(const SCRadix4Node *node, void *user_data, const uint8_t netmask, void *data)
+{
+    return LpmPrefixListAdd(data, node->prefix_stream, 4, netmask, user_data);
+}
+
+static int LpmCollectIPv6(const SCRadix6Node *node, void *user_data, const uint8_t netmask, void *data)
+{
+    return LpmPrefixListAdd(data, node->prefix_stream, 16, netmask, user_data);
+}
+
+static int LpmPrefixCompare(const void *a, const void *b)
+{
+    const LpmPrefix *pa = a;
+    const LpmPrefix *pb = b;
+    return (int)pa->netmask - (int)pb->netmask;
+}
+
+static inline uint32_t LpmRootIndex(const SCLpm *lpm, const uint8_t *addr)
+{
+    uint32_t idx = ((uint32_t)addr[0] << 8) | addr[1];
+    if (lpm->root_bits == 24)
+        idx = (idx << 8) | addr[2];
+    return idx;
+}
+
+static inline uint32_t LpmNibble(const uint8_t *addr, const uint32_t bit)
+{
+    const uint8_t b = addr[bit >> 3];
+    return (bit & 4) ? (b & 0x0f) : (b >> 4);
+}
+
+static uint64_t LpmMemory(const SCLpm *lpm, const uint32_t chunks)
+{
+    return (BIT_U64(lpm->root_bits) * sizeof(uint32_t)) +
+           ((uint64_t)chunks * SC_LPM_CHUNK_SIZE * sizeof(uint32_t)) +
+           ((uint64_t)lpm->values_cnt * sizeof(void *));
+}
+
+static int LpmNewChunk(SCLpm *lpm, uint32_t *chunks_size, const uint32_t fill, uint32_t *chunk)
+{
+    if (lpm->chunks_cnt == *chunks_size) {
+        const uint32_t new_size = *chunks_size ? *chunks_size * 2 : 1024;
+        if (new_size > LPM_MAX_CHUNKS || LpmMemory(lpm, new_size) > LPM_MAX_MEMORY)
+            return -1;
+        void *ptmp = SCRealloc(lpm->chunks, new_size * SC_LPM_CHUNK_SIZE * sizeof(uint32_t));
+        if (ptmp == NULL)
+            return -1;
+        lpm->chunks = ptmp;
+        *chunks_size = new_size;
+    }
+
+    const uint32_t c = lpm->chunks_cnt++;
+    uint32_t *entries = &lpm->chunks[c << SC_LPM_STRIDE_BITS];
+    for (uint32_t i = 0; i < SC_LPM_CHUNK_SIZE; i++) {
+        entries[i] = fill;
+    }
+    *chunk = c;
+    return 0;
+}
+
+static inline uint32_t *LpmEntry(SCLpm *lpm, const bool in_root, const uint32_t pos)
+{
+    return in_root ? &lpm->root[pos] : &lpm->chunks[pos];
+}
+
+static int LpmInsert(SCLpm *lpm, uint32_t *chunks_size, const LpmPrefix *p, const uint32_t v)
+{
+    const uint32_t idx = LpmRootIndex(lpm, p->addr);
+    if (p->netmask <= lpm->root_bits) {
+        const uint32_t cnt = 1U << (lpm->root_bits - p->netmask);
+        for (uint32_t i = 0; i < cnt; i++) {
+            lpm->root[idx + i] = v;
+        }
+        return 0;
+    }
+
+    /* chunk growth may move the chunks, so track the parent entry by
+     * position instead of by pointer */
+    bool in_root = true;
+    uint32_t pos = idx;
+    uint32_t bit = lpm->root_bits;
+    while (1) {
+        uint32_t e = *LpmEntry(lpm, in_root, pos);
+        if (!(e & SC_LPM_CHILD)) {
+            uint32_t c;
+            if (LpmNewChunk(lpm, chunks_size, e, &c) < 0)
+                return -1;
+            e = SC_LPM_CHILD | c;
+            *LpmEntry(lpm, in_root, pos) = e;
+        }
+
+        const uint32_t base = (e & ~SC_LPM_CHILD) << SC_LPM_STRIDE_BITS;
+        const uint32_t n = LpmNibble(p->addr, bit);
+        if (p->netmask <= bit + SC_LPM_STRIDE_BITS) {
+            const uint32_t cnt = 1U << (bit + SC_LPM_STRIDE_BITS - p->netmask);
+            for (uint32_t i = 0; i < cnt; i++) {
+                lpm->chunks[base + n + i] = v;
+            }
+            return 0;
+        }
+        in_root = false;
+        pos = base + n;
+        bit += SC_LPM_STRIDE_BITS;
+    }
+}
+
+void SCLpmFree(SCLpm *lpm)
+{
+    if (lpm == NULL)
+        return;
+    SCFree(lpm->root);
+    if (lpm->chunks != NULL)
+        SCFreeAligned(lpm->chunks);
+    SCFree(lpm->values);
+    SCFree(lpm);
+}
+
+static SCLpm *LpmBuild(LpmPrefixList *l, const uint8_t addr_len)
+{
+    qsort(l->prefixes, l->cnt, sizeof(LpmPrefix), LpmPrefixCompare);
+
+    SCLpm *lpm = SCCalloc(1, sizeof(*lpm));
+    if (lpm == NULL)
+        return NULL;
+    lpm->addr_len = addr_len;
+    lpm->root_bits = (addr_len == 4 && l->cnt >= LPM_DIR24_MIN_PREFIXES) ? 24 : 16;
+    lpm->values_cnt = l->cnt;
+
+    lpm->root = SCCalloc(BIT_U32(lpm->root_bits), sizeof(uint32_t));
+    lpm->values = SCCalloc(l->cnt, sizeof(void *));
+    if (lpm->root == NULL || lpm->values == NULL)
+        goto error;
+
+    uint32_t chunks_size = 0;
+    for (uint32_t i = 0; i < l->cnt; i++) {
+        lpm->values[i] = l->prefixes[i].user;
+        if (LpmInsert(lpm, &chunks_size, &l->prefixes[i], i + 1) < 0)
+            goto error;
+    }
+
+    /* move the chunks to cache line aligned memory of the final size */
+    if (lpm->chunks_cnt > 0) {
+        const size_t size = (size_t)lpm->chunks_cnt * SC_LPM_CHUNK_SIZE * sizeof(uint32_t);
+        uint32_t *chunks = SCMallocAligned(size, CLS);
+        if (chunks == NULL)
+            goto error;
+        memcpy(chunks, lpm->chunks, size);
+        SCFree(lpm->chunks);
+        lpm->chunks = chunks;
+    }
+
+    SCLogDebug("lpm: %u prefixes, %u chunks, %" PRIu64 " bytes", l->cnt, lpm->chunks_cnt,
+            SCLpmMemoryUse(lpm));
+    return lpm;
+
+error:
+    /* chunks are not aligned yet */
+    SCFree(lpm->chunks);
+    lpm->chunks = NULL;
+    SCLpmFree(lpm);
+    return NULL;
+}
+
+/**
+ * \brief Compile a lookup table from an IPv4 radix tree
+ *
+ * The table references the user data of the tree, so it has to be freed
+ * before the tree is released. The tree can't be modified afterwards.
+ *
+ * \retval lpm table or NULL if the tree is empty or the table would be
+ *             too large, in which case the tree should be used instead
+ */
+SCLpm *SCLpmBuildIPv4(const SCRadix4Tree *tree)
+{
+    LpmPrefixList l = { NULL, 0, 0 };
+    SCLpm *lpm = NULL;
+    if (SCRadix4ForEachNode(tree, LpmCollectIPv4, &l) == 0 && l.cnt > 0)
+        lpm = LpmBuild(&l, 4);
+    SCFree(l.prefixes);
+    return lpm;
+}
+
+/**
+ * \brief Compile a lookup table from an IPv6 radix tree
+ *
+ * \see SCLpmBuildIPv4
+ */
+SCLpm *SCLpmBuildIPv6(const SCRadix6Tree *tree)
+{
+    LpmPrefixList l = { NULL, 0, 0 };
+    SCLpm *lpm = NULL;
+    if (SCRadix6ForEachNode(tree, LpmCollectIPv6, &l) == 0 && l.cnt > 0)
+        lpm = LpmBuild(&l, 16);
+    SCFree(l.prefixes);
+    return lpm;
+}
+
+uint64_t SCLpmMemoryUse(const SCLpm *lpm)
+{
+    if (lpm == NULL)
+        return 0;
+    return LpmMemory(lpm, lpm->chunks_cnt);
+}
+
+#ifdef UNITTESTS
+
+static const SCRadix4Config ut_lpm_radix4_config = { NULL, NULL };
+static const SCRadix6Config ut_lpm_radix6_config = { NULL, NULL };
+
+static uint32_t LpmTestRandom(uint64_t *state)
+{
+    /* xorshift64, deterministic across runs */
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return (uint32_t)(x >> 32);
+}
+
+static int LpmTestIPv4(const SCRadix4Tree *tree, const SCLpm *lpm, const char *str)
+{
+    struct in_addr a;
+    if (inet_pton(AF_INET, str, &a) <= 0)
+        return 0;
+    void *user_data = NULL;
+    (void)SCRadix4TreeFindBestMatch(tree, (uint8_t *)&a, &user_data);
+    return SCLpmLookup(lpm, (uint8_t *)&a) == user_data;
+}
+
+static int SCLpmTest01(void)
+{
+    SCRadix4Tree tree = SCRadix4TreeInitialize();
+    int u[6];
+
+    FAIL_IF_NOT(SCRadix4AddKeyIPV4String(&tree, &ut_lpm_radix4_config, "10.0.0.0/8", &u[0]));
+    FAIL_IF_NOT(SCRadix4AddKeyIPV4String(&tree, &ut_lpm_radix4_config, "10.1.0.0/16", &u[1]));
+    FAIL_IF_NOT(SCRadix4AddKeyIPV4String(&tree, &ut_lpm_radix4_config, "10.1.2.0/24", &u[2]));
+    FAIL_IF_NOT(SCRadix4AddKeyIPV4String(&tree, &ut_lpm_radix4_config, "10.1.2.3", &u[3]));
+    FAIL_IF_NOT(SCRadix4AddKeyIPV4String(&tree, &ut_lpm_radix4_config, "192.168.1.128/25", &u[4]));
+    FAIL_IF_NOT(SCRadix4AddKeyIPV4String(&tree, &ut_lpm_radix4_config, "10.1.2.0/30", &u[5]));
+
+    SCLpm *lpm = SCLpmBuildIPv4(&tree);
+    FAIL_IF_NULL(lpm);
+    FAIL_IF_NOT(lpm->root_bits == 16);
+
+    struct in_addr a;
+    inet_pton(AF_INET, "10.1.2.3", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[3]);
+    inet_pton(AF_INET, "10.1.2.2", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[5]);
+    inet_pton(AF_INET, "10.1.2.4", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[2]);
+    inet_pton(AF_INET, "10.1.3.4", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[1]);
+    inet_pton(AF_INET, "10.2.3.4", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[0]);
+    inet_pton(AF_INET, "192.168.1.200", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[4]);
+    inet_pton(AF_INET, "192.168.1.100", &a);
+    FAIL_IF_NOT_NULL(SCLpmLookup(lpm, (uint8_t *)&a));
+    inet_pton(AF_INET, "11.0.0.1", &a);
+    FAIL_IF_NOT_NULL(SCLpmLookup(lpm, (uint8_t *)&a));
+
+    /* a default route covers everything not covered by a longer prefix */
+    FAIL_IF_NOT(SCRadix4AddKeyIPV4String(&tree, &ut_lpm_radix4_config, "0.0.0.0/0", &u[0]));
+    SCLpm *lpm2 = SCLpmBuildIPv4(&tree);
+    FAIL_IF_NULL(lpm2);
+    FAIL_IF_NOT(LpmTestIPv4(&tree, lpm2, "11.0.0.1"));
+    FAIL_IF_NOT(LpmTestIPv4(&tree, lpm2, "192.168.1.100"));
+    FAIL_IF_NOT(LpmTestIPv4(&tree, lpm2, "10.1.2.3"));
+
+    SCLpmFree(lpm);
+    SCLpmFree(lpm2);
+    SCRadix4TreeRelease(&tree, &ut_lpm_radix4_config);
+    PASS;
+}
+
+static int SCLpmTest02(void)
+{
+    SCRadix6Tree tree = SCRadix6TreeInitialize();
+    int u[4];
+
+    FAIL_IF_NOT(SCRadix6AddKeyIPV6String(&tree, &ut_lpm_radix6_config, "2001:db8::/32", &u[0]));
+    FAIL_IF_NOT(
+            SCRadix6AddKeyIPV6String(&tree, &ut_lpm_radix6_config, "2001:db8:1::/48", &u[1]));
+    FAIL_IF_NOT(SCRadix6AddKeyIPV6String(
+            &tree, &ut_lpm_radix6_config, "2001:db8:1:2::/63", &u[2]));
+    FAIL_IF_NOT(SCRadix6AddKeyIPV6String(&tree, &ut_lpm_radix6_config, "2001:db8:1::1", &u[3]));
+
+    SCLpm *lpm = SCLpmBuildIPv6(&tree);
+    FAIL_IF_NULL(lpm);
+
+    struct in6_addr a;
+    inet_pton(AF_INET6, "2001:db8:1::1", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[3]);
+    inet_pton(AF_INET6, "2001:db8:1::2", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[1]);
+    inet_pton(AF_INET6, "2001:db8:1:3::1", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[2]);
+    inet_pton(AF_INET6, "2001:db8:1:4::1", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[1]);
+    inet_pton(AF_INET6, "2001:db8:2::1", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == &u[0]);
+    inet_pton(AF_INET6, "2001:db9::1", &a);
+    FAIL_IF_NOT_NULL(SCLpmLookup(lpm, (uint8_t *)&a));
+
+    SCLpmFree(lpm);
+    SCRadix6TreeRelease(&tree, &ut_lpm_radix6_config);
+    PASS;
+}
+
+/** \test random IPv4 prefixes, compare table and tree lookups. With
+ *        enough prefixes the table uses the 24 bit root. */
+static int SCLpmTest03(void)
+{
+    /* some of the random prefixes are duplicates, so add some margin */
+    static const uint32_t counts[] = { 1000, LPM_DIR24_MIN_PREFIXES + 8192 };
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+    for (size_t c = 0; c < ARRAY_SIZE(counts); c++) {
+        SCRadix4Tree tree = SCRadix4TreeInitialize();
+        uint32_t *keys = SCCalloc(counts[c], sizeof(uint32_t));
+        FAIL_IF_NULL(keys);
+
+        for (uint32_t i = 0; i < counts[c]; i++) {
+            keys[i] = LpmTestRandom(&state);
+            /* mostly hosts and /24s like a reputation list */
+            const uint32_t r = LpmTestRandom(&state) % 8;
+            const uint8_t netmask =
+                    r < 5 ? 32 : (r < 7 ? 24 : (uint8_t)(8 + LpmTestRandom(&state) % 16));
+            (void)SCRadix4AddKeyIPV4Netblock(&tree, &ut_lpm_radix4_config, (uint8_t *)&keys[i],
+                    netmask, &keys[i]);
+        }
+
+        SCLpm *lpm = SCLpmBuildIPv4(&tree);
+        FAIL_IF_NULL(lpm);
+        FAIL_IF_NOT(lpm->root_bits == (c == 0 ? 16 : 24));
+
+        for (uint32_t i = 0; i < 4 * counts[c]; i++) {
+            /* half the lookups near a prefix: flip bits in its last byte */
+            uint32_t addr = LpmTestRandom(&state);
+            if (i & 1) {
+                uint8_t *b = (uint8_t *)&addr;
+                const uint8_t flip = b[3];
+                addr = keys[addr % counts[c]];
+                b[3] ^= flip;
+            }
+            void *user_data = NULL;
+            (void)SCRadix4TreeFindBestMatch(&tree, (uint8_t *)&addr, &user_data);
+            FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&addr) == user_data);
+        }
+
+        SCLpmFree(lpm);
+        SCRadix4TreeRelease(&tree, &ut_lpm_radix4_config);
+        SCFree(keys);
+    }
+    PASS;
+}
+
+/** \test random IPv6 prefixes, compare table and tree lookups */
+static int SCLpmTest04(void)
+{
+    uint64_t state = 0x2545f4914f6cdd1dULL;
+    SCRadix6Tree tree = SCRadix6TreeInitialize();
+    const uint32_t cnt = 1000;
+    uint8_t(*keys)[16] = SCCalloc(cnt, 16);
+    FAIL_IF_NULL(keys);
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        for (int j = 0; j < 16; j += 4) {
+            uint32_t r = LpmTestRandom(&state);
+            memcpy(&keys[i][j], &r, 4);
+        }
+        /* keep the prefixes in one /16 to share chunks */
+        keys[i][0] = 0x20;
+        keys[i][1] = 0x01;
+        const uint8_t netmask = (uint8_t)(16 + LpmTestRandom(&state) % 113);
+        (void)SCRadix6AddKeyIPV6Netblock(
+                &tree, &ut_lpm_radix6_config, keys[i], netmask, keys[i]);
+    }
+
+    SCLpm *lpm = SCLpmBuildIPv6(&tree);
+    FAIL_IF_NULL(lpm);
+
+    for (uint32_t i = 0; i < 4 * cnt; i++) {
+        uint8_t addr[16];
+        memcpy(addr, keys[LpmTestRandom(&state) % cnt], sizeof(addr));
+        /* randomize the tail */
+        const uint32_t r = LpmTestRandom(&state);
+        addr[8 + r % 8] ^= (uint8_t)(r >> 8);
+        void *user_data = NULL;
+        (void)SCRadix6TreeFindBestMatch(&tree, addr, &user_data);
+        FAIL_IF_NOT(SCLpmLookup(lpm, addr) == user_data);
+    }
+
+    SCLpmFree(lpm);
+    SCRadix6TreeRelease(&tree, &ut_lpm_radix6_config);
+    SCFree(keys);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void SCLpmRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SCLpmTest01", SCLpmTest01);
+    UtRegisterTest("SCLpmTest02", SCLpmTest02);
+    UtRegisterTest("SCLpmTest03", SCLpmTest03);
+    UtRegisterTest("SCLpmTest04", SCLpmTest04);
+#endif
+}
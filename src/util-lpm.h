@@ -0,0 +1,93 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Read-only longest prefix match tables compiled from the radix trees.
+ *
+ * The table is a multibit trie: a directly indexed root of 16 or 24 bits
+ * followed by 4 bit stride chunks of 16 entries, so every chunk is a
+ * single cache line. An IPv4 lookup in a table with a 24 bit root (the
+ * DIR-24-8 layout) takes at most 3 dependent loads.
+ */
+
+#ifndef SURICATA_UTIL_LPM_H
+#define SURICATA_UTIL_LPM_H
+
+#include "util-radix4-tree.h"
+#include "util-radix6-tree.h"
+
+#define SC_LPM_STRIDE_BITS 4
+#define SC_LPM_CHUNK_SIZE  (1U << SC_LPM_STRIDE_BITS)
+/** entry flag: entry holds a chunk index instead of a value index */
+#define SC_LPM_CHILD BIT_U32(31)
+
+typedef struct SCLpm_ {
+    /** number of address bits used to index the root: 16 or 24 */
+    uint8_t root_bits;
+    /** address length in bytes: 4 or 16 */
+    uint8_t addr_len;
+
+    /** root table of 1 << root_bits entries. An entry is 0 for no match,
+     *  SC_LPM_CHILD | chunk index for a child chunk or value index + 1. */
+    uint32_t *root;
+    /** chunks of SC_LPM_CHUNK_SIZE entries, cache line aligned */
+    uint32_t *chunks;
+    uint32_t chunks_cnt;
+
+    /** user data of the radix tree, not owned by the table */
+    void **values;
+    uint32_t values_cnt;
+} SCLpm;
+
+SCLpm *SCLpmBuildIPv4(const SCRadix4Tree *tree);
+SCLpm *SCLpmBuildIPv6(const SCRadix6Tree *tree);
+void SCLpmFree(SCLpm *lpm);
+uint64_t SCLpmMemoryUse(const SCLpm *lpm);
+
+/**
+ * \brief Find the user data of the longest prefix matching an address
+ *
+ * \param lpm  table
+ * \param addr address in network byte order, 4 or 16 bytes matching the
+ *             tree the table was built from
+ *
+ * \retval user data or NULL if no prefix matches
+ */
+static inline void *SCLpmLookup(const SCLpm *lpm, const uint8_t *addr)
+{
+    uint32_t idx = ((uint32_t)addr[0] << 8) | addr[1];
+    uint32_t nibble = 4;
+    if (lpm->root_bits == 24) {
+        idx = (idx << 8) | addr[2];
+        nibble = 6;
+    }
+
+    uint32_t e = lpm->root[idx];
+    while (e & SC_LPM_CHILD) {
+        const uint8_t b = addr[nibble >> 1];
+        const uint32_t n = (nibble & 1) ? (b & 0x0f) : (b >> 4);
+        e = lpm->chunks[((e & ~SC_LPM_CHILD) << SC_LPM_STRIDE_BITS) | n];
+        nibble++;
+    }
+    return e ? lpm->values[e - 1] : NULL;
+}
+
+void SCLpmRegisterTests(void);
+
+#endif /* SURICATA_UTIL_LPM_H */
@@ -0,0 +1,294 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * BBHash minimal perfect hash.
+ *
+ * Level i is a bit array of gamma * keys left bits. Every key left sets
+ * its bit at position hash_i(key); keys that share a position are marked
+ * as colliding, their bit is cleared and they move on to the next level.
+ * A lookup walks the levels until it finds a set bit. For a key that is
+ * not part of the set the returned index is that of some other key, so
+ * callers need to verify the key stored at the index.
+ */
+
+#include "suricata-common.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+#include "util-mphf.h"
+
+/** bits per key and level. 2 gives about 3.7 bits per key in total and a
+ *  lookup averages less than 2 levels. */
+#define MPHF_GAMMA 2
+/** words per rank sample */
+#define MPHF_RANK_WORDS 8
+
+static inline uint64_t MphfMix(uint64_t x)
+{
+    /* splitmix64 finalizer */
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint64_t MphfPosition(const uint64_t hash, const uint32_t level, const uint64_t size)
+{
+    return MphfMix(hash + (uint64_t)(level + 1) * 0x9e3779b97f4a7c15ULL) % size;
+}
+
+static inline bool MphfBitIsSet(const uint64_t *bits, const uint64_t bit)
+{
+    return (bits[bit >> 6] & (1ULL << (bit & 63))) != 0;
+}
+
+/**
+ * \brief hash a key for use with SCMphfBuild and SCMphfLookup
+ */
+uint64_t SCMphfHash(const uint8_t *key, const uint32_t key_len)
+{
+    uint64_t h = MphfMix(0x9e3779b97f4a7c15ULL ^ key_len);
+    uint32_t left = key_len;
+    while (left >= 8) {
+        uint64_t v;
+        memcpy(&v, key, sizeof(v));
+        h = MphfMix(h ^ v);
+        key += 8;
+        left -= 8;
+    }
+    if (left > 0) {
+        uint64_t v = 0;
+        memcpy(&v, key, left);
+        h = MphfMix(h ^ v);
+    }
+    return h;
+}
+
+/**
+ * \brief build the function over a set of unique key hashes
+ *
+ * \retval mphf or NULL on error. Duplicate hashes can't be separated, so
+ *         they make the build fail once all levels are used.
+ */
+SCMphf *SCMphfBuild(const uint64_t *hashes, const uint64_t cnt)
+{
+    SCMphf *mphf = SCCalloc(1, sizeof(*mphf));
+    if (mphf == NULL)
+        return NULL;
+    mphf->cnt = cnt;
+
+    uint64_t *keys = SCMalloc(MAX(cnt, 1) * sizeof(uint64_t));
+    if (keys == NULL)
+        goto error;
+    if (cnt > 0)
+        memcpy(keys, hashes, cnt * sizeof(uint64_t));
+
+    uint64_t left = cnt;
+    while (left > 0) {
+        if (mphf->levels == SC_MPHF_MAX_LEVELS) {
+            SCLogDebug("%" PRIu64 " keys left after %u levels", left, mphf->levels);
+            goto error;
+        }
+        const uint32_t level = mphf->levels;
+        const uint64_t words = (left * MPHF_GAMMA + 63) / 64;
+        const uint64_t size = words * 64;
+
+        uint64_t *bits = SCRealloc(mphf->bits, (mphf->words + words) * sizeof(uint64_t));
+        if (bits == NULL)
+            goto error;
+        mphf->bits = bits;
+        uint64_t *lbits = bits + mphf->words;
+        memset(lbits, 0, words * sizeof(uint64_t));
+        uint64_t *collide = SCCalloc(words, sizeof(uint64_t));
+        if (collide == NULL)
+            goto error;
+
+        for (uint64_t i = 0; i < left; i++) {
+            const uint64_t p = MphfPosition(keys[i], level, size);
+            if (MphfBitIsSet(collide, p))
+                continue;
+            if (MphfBitIsSet(lbits, p)) {
+                lbits[p >> 6] &= ~(1ULL << (p & 63));
+                collide[p >> 6] |= 1ULL << (p & 63);
+            } else {
+                lbits[p >> 6] |= 1ULL << (p & 63);
+            }
+        }
+        SCFree(collide);
+
+        /* a set bit has exactly one key, the others go to the next level */
+        uint64_t next = 0;
+        for (uint64_t i = 0; i < left; i++) {
+            if (!MphfBitIsSet(lbits, MphfPosition(keys[i], level, size)))
+                keys[next++] = keys[i];
+        }
+
+        mphf->level_offset[level] = mphf->words * 64;
+        mphf->level_size[level] = size;
+        mphf->words += words;
+        mphf->levels++;
+        left = next;
+    }
+    SCFree(keys);
+    keys = NULL;
+
+    const uint64_t blocks = (mphf->words + MPHF_RANK_WORDS - 1) / MPHF_RANK_WORDS;
+    mphf->ranks = SCMalloc(MAX(blocks, 1) * sizeof(uint64_t));
+    if (mphf->ranks == NULL)
+        goto error;
+    uint64_t rank = 0;
+    for (uint64_t w = 0; w < mphf->words; w++) {
+        if (w % MPHF_RANK_WORDS == 0)
+            mphf->ranks[w / MPHF_RANK_WORDS] = rank;
+        rank += __builtin_popcountll(mphf->bits[w]);
+    }
+    BUG_ON(rank != cnt);
+    return mphf;
+
+error:
+    if (keys != NULL)
+        SCFree(keys);
+    SCMphfFree(mphf);
+    return NULL;
+}
+
+/**
+ * \brief get the index of a key hash
+ *
+ * \retval index in the range 0 to cnt - 1, or SC_MPHF_NOT_FOUND. Keys
+ *         outside of the set can map to the index of another key.
+ */
+uint64_t SCMphfLookup(const SCMphf *mphf, const uint64_t hash)
+{
+    for (uint32_t l = 0; l < mphf->levels; l++) {
+        const uint64_t bit =
+                mphf->level_offset[l] + MphfPosition(hash, l, mphf->level_size[l]);
+        if (MphfBitIsSet(mphf->bits, bit)) {
+            const uint64_t w = bit >> 6;
+            uint64_t rank = mphf->ranks[w / MPHF_RANK_WORDS];
+            for (uint64_t i = w - (w % MPHF_RANK_WORDS); i < w; i++)
+                rank += __builtin_popcountll(mphf->bits[i]);
+            rank += __builtin_popcountll(mphf->bits[w] & ((1ULL << (bit & 63)) - 1));
+            return rank;
+        }
+    }
+    return SC_MPHF_NOT_FOUND;
+}
+
+void SCMphfFree(SCMphf *mphf)
+{
+    if (mphf == NULL)
+        return;
+    if (mphf->bits != NULL)
+        SCFree(mphf->bits);
+    if (mphf->ranks != NULL)
+        SCFree(mphf->ranks);
+    SCFree(mphf);
+}
+
+uint64_t SCMphfMemoryUse(const SCMphf *mphf)
+{
+    const uint64_t blocks = (mphf->words + MPHF_RANK_WORDS - 1) / MPHF_RANK_WORDS;
+    return sizeof(*mphf) + mphf->words * sizeof(uint64_t) + blocks * sizeof(uint64_t);
+}
+
+#ifdef UNITTESTS
+
+/** \test every key gets a unique index */
+static int SCMphfTest01(void)
+{
+    const uint64_t cnt = 100000;
+    uint64_t *hashes = SCMalloc(cnt * sizeof(uint64_t));
+    FAIL_IF_NULL(hashes);
+    uint8_t *seen = SCCalloc(cnt, 1);
+    FAIL_IF_NULL(seen);
+
+    for (uint64_t i = 0; i < cnt; i++) {
+        hashes[i] = SCMphfHash((const uint8_t *)&i, sizeof(i));
+    }
+    SCMphf *mphf = SCMphfBuild(hashes, cnt);
+    FAIL_IF_NULL(mphf);
+    /* 2 bits per key for the first level plus the rest */
+    FAIL_IF(mphf->words * 64 > cnt * 4);
+
+    for (uint64_t i = 0; i < cnt; i++) {
+        uint64_t idx = SCMphfLookup(mphf, hashes[i]);
+        FAIL_IF(idx >= cnt);
+        FAIL_IF(seen[idx]);
+        seen[idx] = 1;
+    }
+
+    SCMphfFree(mphf);
+    SCFree(seen);
+    SCFree(hashes);
+    PASS;
+}
+
+/** \test empty and single key sets */
+static int SCMphfTest02(void)
+{
+    SCMphf *mphf = SCMphfBuild(NULL, 0);
+    FAIL_IF_NULL(mphf);
+    FAIL_IF(SCMphfLookup(mphf, SCMphfHash((const uint8_t *)"a", 1)) != SC_MPHF_NOT_FOUND);
+    SCMphfFree(mphf);
+
+    uint64_t hash = SCMphfHash((const uint8_t *)"suricata", 8);
+    mphf = SCMphfBuild(&hash, 1);
+    FAIL_IF_NULL(mphf);
+    FAIL_IF(SCMphfLookup(mphf, hash) != 0);
+    SCMphfFree(mphf);
+    PASS;
+}
+
+/** \test duplicate hashes fail the build */
+static int SCMphfTest03(void)
+{
+    uint64_t hashes[3] = { 1, 2, 1 };
+    SCMphf *mphf = SCMphfBuild(hashes, 3);
+    FAIL_IF_NOT_NULL(mphf);
+    PASS;
+}
+
+/** \test key hash covers all bytes and the length */
+static int SCMphfTest04(void)
+{
+    const uint8_t a[] = "abcdefghijklmnopq";
+    FAIL_IF(SCMphfHash(a, 16) == SCMphfHash(a, 17));
+    FAIL_IF(SCMphfHash(a, 0) == SCMphfHash(a, 1));
+    const uint8_t b[] = "abcdefghijklmnopr";
+    FAIL_IF(SCMphfHash(a, 17) == SCMphfHash(b, 17));
+    /* trailing zero bytes differ by length only */
+    const uint8_t z[4] = { 0 };
+    FAIL_IF(SCMphfHash(z, 3) == SCMphfHash(z, 4));
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void SCMphfRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SCMphfTest01", SCMphfTest01);
+    UtRegisterTest("SCMphfTest02", SCMphfTest02);
+    UtRegisterTest("SCMphfTest03", SCMphfTest03);
+    UtRegisterTest("SCMphfTest04", SCMphfTest04);
+#endif
+}
@@ -0,0 +1,56 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Minimal perfect hash function over a static set of 64 bit key hashes,
+ * using the BBHash construction: a cascade of bit arrays where each key
+ * is placed at the first level it doesn't collide in. The index of a key
+ * is the rank of its bit in the concatenated arrays. Uses about 3.7 bits
+ * per key.
+ */
+
+#ifndef SURICATA_UTIL_MPHF_H
+#define SURICATA_UTIL_MPHF_H
+
+#define SC_MPHF_MAX_LEVELS 32
+#define SC_MPHF_NOT_FOUND  UINT64_MAX
+
+typedef struct SCMphf_ {
+    /** number of keys, indexes are 0 to cnt - 1 */
+    uint64_t cnt;
+    uint32_t levels;
+    /** bit offset and size of each level in bits */
+    uint64_t level_offset[SC_MPHF_MAX_LEVELS];
+    uint64_t level_size[SC_MPHF_MAX_LEVELS];
+
+    uint64_t *bits;
+    uint64_t words;
+    /** number of set bits before each block of 8 words */
+    uint64_t *ranks;
+} SCMphf;
+
+uint64_t SCMphfHash(const uint8_t *key, const uint32_t key_len);
+SCMphf *SCMphfBuild(const uint64_t *hashes, const uint64_t cnt);
+uint64_t SCMphfLookup(const SCMphf *mphf, const uint64_t hash);
+void SCMphfFree(SCMphf *mphf);
+uint64_t SCMphfMemoryUse(const SCMphf *mphf);
+
+void SCMphfRegisterTests(void);
+
+#endif /* SURICATA_UTIL_MPHF_H */
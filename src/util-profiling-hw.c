@@ -0,0 +1,163 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Hardware performance counters for rule, keyword and prefilter profiling.
+ *
+ * Each thread opens a perf_event group with the cycles, instructions,
+ * cache-misses and branch-misses counters the first time it takes a
+ * sample. The group is read with a single read() call. Only user space
+ * is counted, so this works with perf_event_paranoid up to 2.
+ */
+
+#include "suricata-common.h"
+#include "util-profiling.h"
+#include "conf.h"
+
+#if defined(PROFILING) || defined(PROFILE_RULES)
+
+#if defined(HAVE_LINUX_PERF_EVENT_H) && defined(HAVE_SYS_SYSCALL_H)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#define PROFILE_HW_SUPPORTED 1
+#endif
+
+int profiling_hw_enabled = 0;
+
+static const char *hw_event_names[PROFILE_HW_MAX] = {
+    "cycles",
+    "instructions",
+    "cache_misses",
+    "branch_misses",
+};
+
+const char *SCProfilingHwEventName(int event)
+{
+    if (event < 0 || event >= PROFILE_HW_MAX)
+        return "unknown";
+    return hw_event_names[event];
+}
+
+#ifdef PROFILE_HW_SUPPORTED
+static const uint64_t hw_event_configs[PROFILE_HW_MAX] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+/* per thread counter group. The fds stay open for the lifetime of the
+ * thread. */
+static thread_local int hw_fds[PROFILE_HW_MAX] = { -1, -1, -1, -1 };
+static thread_local bool hw_opened = false;
+
+static int HwPerfEventOpen(struct perf_event_attr *attr, int group_fd)
+{
+    /* this thread, any cpu */
+    return (int)syscall(__NR_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+static void HwClose(void)
+{
+    for (int i = 0; i < PROFILE_HW_MAX; i++) {
+        if (hw_fds[i] >= 0) {
+            close(hw_fds[i]);
+            hw_fds[i] = -1;
+        }
+    }
+}
+
+static bool HwOpen(void)
+{
+    for (int i = 0; i < PROFILE_HW_MAX; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = hw_event_configs[i];
+        attr.disabled = (i == 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        hw_fds[i] = HwPerfEventOpen(&attr, i == 0 ? -1 : hw_fds[0]);
+        if (hw_fds[i] < 0) {
+            SCLogWarning("perf_event_open for %s failed: %s, hardware counters are "
+                         "disabled for this thread",
+                    hw_event_names[i], strerror(errno));
+            HwClose();
+            return false;
+        }
+    }
+
+    if (ioctl(hw_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) != 0 ||
+            ioctl(hw_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+        SCLogWarning("enabling hardware counters failed: %s", strerror(errno));
+        HwClose();
+        return false;
+    }
+    return true;
+}
+
+/**
+ *  \brief read the hardware counters of the calling thread
+ *
+ *  \retval true if hw holds the current counter values
+ */
+bool SCProfilingHwRead(SCProfileHw *hw)
+{
+    if (unlikely(!hw_opened)) {
+        hw_opened = true;
+        (void)HwOpen();
+    }
+    if (hw_fds[0] < 0)
+        return false;
+
+    /* PERF_FORMAT_GROUP layout: nr, then one value per event */
+    uint64_t buf[1 + PROFILE_HW_MAX];
+    ssize_t r = read(hw_fds[0], buf, sizeof(buf));
+    if (r != (ssize_t)sizeof(buf) || buf[0] != PROFILE_HW_MAX)
+        return false;
+
+    memcpy(hw->v, &buf[1], sizeof(hw->v));
+    return true;
+}
+#else
+bool SCProfilingHwRead(SCProfileHw *hw)
+{
+    return false;
+}
+#endif /* PROFILE_HW_SUPPORTED */
+
+void SCProfilingHwGlobalInit(void)
+{
+    int enabled = 0;
+    if (ConfGetBool("profiling.hw-counters", &enabled) != 1 || enabled == 0)
+        return;
+
+#ifdef PROFILE_HW_SUPPORTED
+    profiling_hw_enabled = 1;
+    SCLogConfig("profiling: using hardware performance counters");
+#else
+    SCLogWarning("profiling.hw-counters is not supported on this platform");
+#endif
+}
+
+#endif /* PROFILING || PROFILE_RULES */
@@ -0,0 +1,82 @@
+/* Copyright (C) 2024 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Hardware performance counters for rule, keyword and prefilter profiling.
+ */
+
+#ifndef SURICATA_UTIL_PROFILING_HW_H
+#define SURICATA_UTIL_PROFILING_HW_H
+
+#if defined(PROFILING) || defined(PROFILE_RULES)
+
+enum SCProfileHwEvent {
+    PROFILE_HW_CYCLES = 0,
+    PROFILE_HW_INSTRUCTIONS,
+    PROFILE_HW_CACHE_MISSES,
+    PROFILE_HW_BRANCH_MISSES,
+    PROFILE_HW_MAX,
+};
+
+typedef struct SCProfileHw_ {
+    uint64_t v[PROFILE_HW_MAX];
+} SCProfileHw;
+
+/** counter snapshot taken at the start of a profiled section */
+typedef struct SCProfileHwSample_ {
+    bool valid;
+    SCProfileHw hw;
+} SCProfileHwSample;
+
+extern int profiling_hw_enabled;
+
+void SCProfilingHwGlobalInit(void);
+bool SCProfilingHwRead(SCProfileHw *hw);
+const char *SCProfilingHwEventName(int event);
+
+static inline void SCProfilingHwStart(SCProfileHwSample *s)
+{
+    s->valid = profiling_hw_enabled && SCProfilingHwRead(&s->hw);
+}
+
+/**
+ *  \brief get the counter deltas since SCProfilingHwStart
+ *
+ *  \retval delta pointer to delta or NULL if not available
+ */
+static inline const SCProfileHw *SCProfilingHwEnd(const SCProfileHwSample *s, SCProfileHw *delta)
+{
+    if (!s->valid || !SCProfilingHwRead(delta))
+        return NULL;
+    for (int i = 0; i < PROFILE_HW_MAX; i++) {
+        delta->v[i] -= s->hw.v[i];
+    }
+    return delta;
+}
+
+static inline void SCProfilingHwAdd(SCProfileHw *dst, const SCProfileHw *src)
+{
+    for (int i = 0; i < PROFILE_HW_MAX; i++) {
+        dst->v[i] += src->v[i];
+    }
+}
+
+#endif /* PROFILING || PROFILE_RULES */
+
+#endif /* SURICATA_UTIL_PROFILING_HW_H */
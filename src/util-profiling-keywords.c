@@ -44,6 +44,7 @@ typedef struct SCProfileKeywordData_ {
     uint64_t max;
     uint64_t ticks_match;
     uint64_t ticks_no_match;
+    SCProfileHw hw;
 } SCProfileKeywordData;
 
 typedef struct SCProfileKeywordDetectCtx_ {
@@ -99,7 +100,12 @@ static void DoDump(SCProfileKeywordDetectCtx *rules_ctx, FILE *fp, const char *n
     fprintf(fp, "  ----------------------------------------------"
             "------------------------------------------------------"
             "----------------------------\n");
-    fprintf(fp, "  %-16s %-15s %-15s %-15s %-15s %-15s %-15s %-15s\n", "Keyword", "Ticks", "Checks", "Matches", "Max Ticks", "Avg", "Avg Match", "Avg No Match");
+    fprintf(fp, "  %-16s %-15s %-15s %-15s %-15s %-15s %-15s %-15s", "Keyword", "Ticks", "Checks", "Matches", "Max Ticks", "Avg", "Avg Match", "Avg No Match");
+    if (profiling_hw_enabled) {
+        fprintf(fp, " %-15s %-6s %-15s %-15s %-15s", "Cycles", "IPC", "Cache Misses", "Avg Misses",
+                "Branch Misses");
+    }
+    fprintf(fp, "\n");
     fprintf(fp, "  ---------------- "
                 "--------------- "
                 "--------------- "
@@ -107,8 +113,15 @@ static void DoDump(SCProfileKeywordDetectCtx *rules_ctx, FILE *fp, const char *n
                 "--------------- "
                 "--------------- "
                 "--------------- "
-                "--------------- "
-        "\n");
+                "--------------- ");
+    if (profiling_hw_enabled) {
+        fprintf(fp, "--------------- "
+                    "------ "
+                    "--------------- "
+                    "--------------- "
+                    "--------------- ");
+    }
+    fprintf(fp, "\n");
     for (i = 0; i < DETECT_TBLSIZE; i++) {
         SCProfileKeywordData *d = &rules_ctx->data[i];
         if (d == NULL || d->checks == 0)
@@ -128,7 +141,7 @@ static void DoDump(SCProfileKeywordDetectCtx *rules_ctx, FILE *fp, const char *n
         }
 
         fprintf(fp,
-            "  %-16s %-15"PRIu64" %-15"PRIu64" %-15"PRIu64" %-15"PRIu64" %-15.2f %-15.2f %-15.2f\n",
+            "  %-16s %-15"PRIu64" %-15"PRIu64" %-15"PRIu64" %-15"PRIu64" %-15.2f %-15.2f %-15.2f",
             sigmatch_table[i].name,
             ticks,
             d->checks,
@@ -137,6 +150,17 @@ static void DoDump(SCProfileKeywordDetectCtx *rules_ctx, FILE *fp, const char *n
             avgticks,
             avgticks_match,
             avgticks_no_match);
+        if (profiling_hw_enabled) {
+            const uint64_t cycles = d->hw.v[PROFILE_HW_CYCLES];
+            double ipc = 0;
+            if (cycles > 0)
+                ipc = (double)d->hw.v[PROFILE_HW_INSTRUCTIONS] / (double)cycles;
+            double avg_misses = (double)d->hw.v[PROFILE_HW_CACHE_MISSES] / (double)d->checks;
+            fprintf(fp, " %-15" PRIu64 " %-6.2f %-15" PRIu64 " %-15.2f %-15" PRIu64, cycles, ipc,
+                    d->hw.v[PROFILE_HW_CACHE_MISSES], avg_misses,
+                    d->hw.v[PROFILE_HW_BRANCH_MISSES]);
+        }
+        fprintf(fp, "\n");
     }
 }
 
@@ -211,9 +235,10 @@ SCProfilingKeywordDump(DetectEngineCtx *de_ctx)
  * \param id The ID of this counter.
  * \param ticks Number of CPU ticks for this rule.
  * \param match Did the rule match?
+ * \param hw Hardware counter deltas, NULL if not available.
  */
-void
-SCProfilingKeywordUpdateCounter(DetectEngineThreadCtx *det_ctx, int id, uint64_t ticks, int match)
+void SCProfilingKeywordUpdateCounter(
+        DetectEngineThreadCtx *det_ctx, int id, uint64_t ticks, int match, const SCProfileHw *hw)
 {
     if (det_ctx != NULL && det_ctx->keyword_perf_data != NULL && id < DETECT_TBLSIZE) {
         SCProfileKeywordData *p = &det_ctx->keyword_perf_data[id];
@@ -226,6 +251,8 @@ SCProfilingKeywordUpdateCounter(DetectEngineThreadCtx *det_ctx, int id, uint64_t
             p->ticks_match += ticks;
         else
             p->ticks_no_match += ticks;
+        if (hw != NULL)
+            SCProfilingHwAdd(&p->hw, hw);
 
         /* store per list (buffer type) as well */
         if (det_ctx->keyword_perf_list >= 0) {// && det_ctx->keyword_perf_list < DETECT_SM_LIST_MAX) {
@@ -238,6 +265,8 @@ SCProfilingKeywordUpdateCounter(DetectEngineThreadCtx *det_ctx, int id, uint64_t
                 p->ticks_match += ticks;
             else
                 p->ticks_no_match += ticks;
+            if (hw != NULL)
+                SCProfilingHwAdd(&p->hw, hw);
         }
     }
 }
@@ -317,6 +346,7 @@ static void SCProfilingKeywordThreadMerge(DetectEngineCtx *de_ctx, DetectEngineT
         de_ctx->profile_keyword_ctx->data[i].matches += det_ctx->keyword_perf_data[i].matches;
         de_ctx->profile_keyword_ctx->data[i].ticks_match += det_ctx->keyword_perf_data[i].ticks_match;
         de_ctx->profile_keyword_ctx->data[i].ticks_no_match += det_ctx->keyword_perf_data[i].ticks_no_match;
+        SCProfilingHwAdd(&de_ctx->profile_keyword_ctx->data[i].hw, &det_ctx->keyword_perf_data[i].hw);
         if (det_ctx->keyword_perf_data[i].max > de_ctx->profile_keyword_ctx->data[i].max)
             de_ctx->profile_keyword_ctx->data[i].max = det_ctx->keyword_perf_data[i].max;
     }
@@ -329,6 +359,8 @@ static void SCProfilingKeywordThreadMerge(DetectEngineCtx *de_ctx, DetectEngineT
             de_ctx->profile_keyword_ctx_per_list[j]->data[i].matches += det_ctx->keyword_perf_data_per_list[j][i].matches;
             de_ctx->profile_keyword_ctx_per_list[j]->data[i].ticks_match += det_ctx->keyword_perf_data_per_list[j][i].ticks_match;
             de_ctx->profile_keyword_ctx_per_list[j]->data[i].ticks_no_match += det_ctx->keyword_perf_data_per_list[j][i].ticks_no_match;
+            SCProfilingHwAdd(&de_ctx->profile_keyword_ctx_per_list[j]->data[i].hw,
+                    &det_ctx->keyword_perf_data_per_list[j][i].hw);
             if (det_ctx->keyword_perf_data_per_list[j][i].max > de_ctx->profile_keyword_ctx_per_list[j]->data[i].max)
                 de_ctx->profile_keyword_ctx_per_list[j]->data[i].max = det_ctx->keyword_perf_data_per_list[j][i].max;
         }
@@ -42,6 +42,7 @@ typedef struct SCProfilePrefilterData_ {
     uint64_t bytes_called; /**< number of times total_bytes was updated. Differs from `called` as a
                               prefilter engine may skip mpm if the smallest pattern is bigger than
                               the buffer to inspect. */
+    SCProfileHw hw;
     const char *name;
 } SCProfilePrefilterData;
 
@@ -99,9 +100,14 @@ static void DoDump(SCProfilePrefilterDetectCtx *rules_ctx, FILE *fp, const char
     fprintf(fp, "  ----------------------------------------------"
             "------------------------------------------------------"
             "----------------------------\n");
-    fprintf(fp, "  %-32s %-15s %-15s %-15s %-15s %-15s %-15s %-15s %-15s %-15s\n", "Prefilter",
+    fprintf(fp, "  %-32s %-15s %-15s %-15s %-15s %-15s %-15s %-15s %-15s %-15s", "Prefilter",
             "Ticks", "Called", "Max Ticks", "Avg", "Bytes", "Called", "Max Bytes", "Avg Bytes",
             "Ticks/Byte");
+    if (profiling_hw_enabled) {
+        fprintf(fp, " %-15s %-6s %-15s %-15s %-15s", "Cycles", "IPC", "Cache Misses",
+                "Misses/KB", "Branch Misses");
+    }
+    fprintf(fp, "\n");
     fprintf(fp, "  -------------------------------- "
                 "--------------- "
                 "--------------- "
@@ -111,8 +117,15 @@ static void DoDump(SCProfilePrefilterDetectCtx *rules_ctx, FILE *fp, const char
                 "--------------- "
                 "--------------- "
                 "--------------- "
-                "--------------- "
-                "\n");
+                "--------------- ");
+    if (profiling_hw_enabled) {
+        fprintf(fp, "--------------- "
+                    "------ "
+                    "--------------- "
+                    "--------------- "
+                    "--------------- ");
+    }
+    fprintf(fp, "\n");
     for (i = 0; i < (int)rules_ctx->size; i++) {
         SCProfilePrefilterData *d = &rules_ctx->data[i];
         if (d == NULL || d->called== 0)
@@ -134,9 +147,23 @@ static void DoDump(SCProfilePrefilterDetectCtx *rules_ctx, FILE *fp, const char
 
         fprintf(fp,
                 "  %-32s %-15" PRIu64 " %-15" PRIu64 " %-15" PRIu64 " %-15.2f %-15" PRIu64
-                " %-15" PRIu64 " %-15" PRIu64 " %-15.2f %-15.2f\n",
+                " %-15" PRIu64 " %-15" PRIu64 " %-15.2f %-15.2f",
                 d->name, ticks, d->called, d->max, avgticks, d->total_bytes, d->bytes_called,
                 d->max_bytes, avgbytes, ticks_per_byte);
+        if (profiling_hw_enabled) {
+            const uint64_t cycles = d->hw.v[PROFILE_HW_CYCLES];
+            double ipc = 0;
+            if (cycles > 0)
+                ipc = (double)d->hw.v[PROFILE_HW_INSTRUCTIONS] / (double)cycles;
+            double misses_per_kb = 0;
+            if (d->total_bytes > 0)
+                misses_per_kb = (double)d->hw.v[PROFILE_HW_CACHE_MISSES] * 1024.0 /
+                                (double)d->total_bytes;
+            fprintf(fp, " %-15" PRIu64 " %-6.2f %-15" PRIu64 " %-15.2f %-15" PRIu64, cycles, ipc,
+                    d->hw.v[PROFILE_HW_CACHE_MISSES], misses_per_kb,
+                    d->hw.v[PROFILE_HW_BRANCH_MISSES]);
+        }
+        fprintf(fp, "\n");
     }
 }
 
@@ -190,9 +217,10 @@ SCProfilingPrefilterDump(DetectEngineCtx *de_ctx)
  * \param id The ID of this counter.
  * \param ticks Number of CPU ticks for this rule.
  * \param match Did the rule match?
+ * \param hw Hardware counter deltas, NULL if not available.
  */
 void SCProfilingPrefilterUpdateCounter(DetectEngineThreadCtx *det_ctx, int id, uint64_t ticks,
-        uint64_t bytes, uint64_t bytes_called)
+        uint64_t bytes, uint64_t bytes_called, const SCProfileHw *hw)
 {
     if (det_ctx != NULL && det_ctx->prefilter_perf_data != NULL &&
             id < (int)det_ctx->de_ctx->prefilter_id)
@@ -208,6 +236,8 @@ void SCProfilingPrefilterUpdateCounter(DetectEngineThreadCtx *det_ctx, int id, u
         if (bytes > p->max_bytes)
             p->max_bytes = bytes;
         p->total_bytes += bytes;
+        if (hw != NULL)
+            SCProfilingHwAdd(&p->hw, hw);
     }
 }
 
@@ -275,6 +305,8 @@ static void SCProfilingPrefilterThreadMerge(DetectEngineCtx *de_ctx, DetectEngin
                     det_ctx->prefilter_perf_data[i].max_bytes;
         de_ctx->profile_prefilter_ctx->data[i].bytes_called +=
                 det_ctx->prefilter_perf_data[i].bytes_called;
+        SCProfilingHwAdd(
+                &de_ctx->profile_prefilter_ctx->data[i].hw, &det_ctx->prefilter_perf_data[i].hw);
     }
 }
 
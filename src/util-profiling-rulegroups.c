@@ -265,7 +265,7 @@ SCProfilingSghUpdateCounter(DetectEngineThreadCtx *det_ctx, const SigGroupHead *
         p->checks++;
 
         if (det_ctx->non_pf_store_cnt > 0) {
-            if (det_ctx->non_pf_store_ptr == sgh->non_pf_syn_store_array)
+            if (det_ctx->non_pf_syn)
                 p->non_mpm_syn++;
             else
                 p->non_mpm_generic++;
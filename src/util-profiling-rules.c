@@ -50,6 +50,8 @@ typedef struct SCProfileSummary_ {
     uint64_t max;
     uint64_t ticks_match;
     uint64_t ticks_no_match;
+    SCProfileHw hw;
+    double avg_cache_misses;
 } SCProfileSummary;
 
 extern int profiling_output_to_file;
@@ -69,9 +71,11 @@ enum {
     SC_PROFILING_RULES_SORT_BY_MAX_TICKS,
     SC_PROFILING_RULES_SORT_BY_AVG_TICKS_MATCH,
     SC_PROFILING_RULES_SORT_BY_AVG_TICKS_NO_MATCH,
+    SC_PROFILING_RULES_SORT_BY_CACHE_MISSES,
+    SC_PROFILING_RULES_SORT_BY_AVG_CACHE_MISSES,
 };
 
-static int profiling_rules_sort_orders[8] = {
+static int profiling_rules_sort_orders[10] = {
     SC_PROFILING_RULES_SORT_BY_TICKS,
     SC_PROFILING_RULES_SORT_BY_AVG_TICKS,
     SC_PROFILING_RULES_SORT_BY_AVG_TICKS_MATCH,
@@ -79,6 +83,8 @@ static int profiling_rules_sort_orders[8] = {
     SC_PROFILING_RULES_SORT_BY_CHECKS,
     SC_PROFILING_RULES_SORT_BY_MATCHES,
     SC_PROFILING_RULES_SORT_BY_MAX_TICKS,
+    -1, /* room for the hardware counter sort orders */
+    -1,
     -1 };
 
 /**
@@ -124,10 +130,19 @@ void SCProfilingRulesGlobalInit(void)
                 else if (strcmp(val, "maxticks") == 0) {
                     SET_ONE(SC_PROFILING_RULES_SORT_BY_MAX_TICKS);
                 }
+                else if (strcmp(val, "cachemisses") == 0 && profiling_hw_enabled) {
+                    SET_ONE(SC_PROFILING_RULES_SORT_BY_CACHE_MISSES);
+                }
+                else if (strcmp(val, "avgcachemisses") == 0 && profiling_hw_enabled) {
+                    SET_ONE(SC_PROFILING_RULES_SORT_BY_AVG_CACHE_MISSES);
+                }
                 else {
                     SCLogError("Invalid profiling sort order: %s", val);
                     exit(EXIT_FAILURE);
                 }
+            } else if (profiling_hw_enabled) {
+                profiling_rules_sort_orders[7] = SC_PROFILING_RULES_SORT_BY_CACHE_MISSES;
+                profiling_rules_sort_orders[8] = SC_PROFILING_RULES_SORT_BY_AVG_CACHE_MISSES;
             }
 
             val = ConfNodeLookupChildValue(conf, "limit");
@@ -263,6 +278,52 @@ SCProfileSummarySortByMaxTicks(const void *a, const void *b)
         return s0->max > s1->max ? -1 : 1;
 }
 
+/**
+ * \brief Qsort comparison function to sort by cache misses.
+ */
+static int
+SCProfileSummarySortByCacheMisses(const void *a, const void *b)
+{
+    const SCProfileSummary *s0 = a;
+    const SCProfileSummary *s1 = b;
+    if (s1->hw.v[PROFILE_HW_CACHE_MISSES] == s0->hw.v[PROFILE_HW_CACHE_MISSES])
+        return 0;
+    else
+        return s0->hw.v[PROFILE_HW_CACHE_MISSES] > s1->hw.v[PROFILE_HW_CACHE_MISSES] ? -1 : 1;
+}
+
+/**
+ * \brief Qsort comparison function to sort by average cache misses.
+ */
+static int
+SCProfileSummarySortByAvgCacheMisses(const void *a, const void *b)
+{
+    const SCProfileSummary *s0 = a;
+    const SCProfileSummary *s1 = b;
+    if (s1->avg_cache_misses == s0->avg_cache_misses)
+        return 0;
+    else
+        return s0->avg_cache_misses > s1->avg_cache_misses ? -1 : 1;
+}
+
+static json_t *BuildJsonHw(const SCProfileSummary *summary)
+{
+    json_t *jsh = json_object();
+    if (jsh == NULL)
+        return NULL;
+    for (int i = 0; i < PROFILE_HW_MAX; i++) {
+        json_object_set_new(jsh, SCProfilingHwEventName(i), json_integer(summary->hw.v[i]));
+    }
+    double ipc = 0;
+    if (summary->hw.v[PROFILE_HW_CYCLES] > 0) {
+        ipc = (double)summary->hw.v[PROFILE_HW_INSTRUCTIONS] /
+              (double)summary->hw.v[PROFILE_HW_CYCLES];
+    }
+    json_object_set_new(jsh, "ipc", json_real(ipc));
+    json_object_set_new(jsh, "cache_misses_avg", json_real(summary->avg_cache_misses));
+    return jsh;
+}
+
 static json_t *BuildJson(
         SCProfileSummary *summary, uint32_t count, uint64_t total_ticks, const char *sort_desc)
 {
@@ -310,6 +371,11 @@ static json_t *BuildJson(
             double percent = (long double)summary[i].ticks /
                 (long double)total_ticks * 100;
             json_object_set_new(jsm, "percent", json_integer(percent));
+            if (profiling_hw_enabled) {
+                json_t *jsh = BuildJsonHw(&summary[i]);
+                if (jsh != NULL)
+                    json_object_set_new(jsm, "hw", jsh);
+            }
             json_array_append_new(jsa, jsm);
         }
     }
@@ -353,7 +419,12 @@ static void DumpText(FILE *fp, SCProfileSummary *summary,
     fprintf(fp, " Sorted by: %s.\n", sort_desc);
     fprintf(fp, "  ----------------------------------------------"
             "----------------------------\n");
-    fprintf(fp, "   %-8s %-12s %-8s %-8s %-12s %-6s %-8s %-8s %-11s %-11s %-11s %-11s\n", "Num", "Rule", "Gid", "Rev", "Ticks", "%", "Checks", "Matches", "Max Ticks", "Avg Ticks", "Avg Match", "Avg No Match");
+    fprintf(fp, "   %-8s %-12s %-8s %-8s %-12s %-6s %-8s %-8s %-11s %-11s %-11s %-14s", "Num", "Rule", "Gid", "Rev", "Ticks", "%", "Checks", "Matches", "Max Ticks", "Avg Ticks", "Avg Match", "Avg No Match");
+    if (profiling_hw_enabled) {
+        fprintf(fp, " %-14s %-6s %-14s %-11s %-14s", "Cycles", "IPC", "Cache Misses", "Avg Misses",
+                "Branch Misses");
+    }
+    fprintf(fp, "\n");
     fprintf(fp, "  -------- "
         "------------ "
         "-------- "
@@ -365,8 +436,15 @@ static void DumpText(FILE *fp, SCProfileSummary *summary,
         "----------- "
         "----------- "
         "----------- "
-        "-------------- "
-        "\n");
+        "-------------- ");
+    if (profiling_hw_enabled) {
+        fprintf(fp, "-------------- "
+                    "------ "
+                    "-------------- "
+                    "----------- "
+                    "-------------- ");
+    }
+    fprintf(fp, "\n");
     for (i = 0; i < MIN(count, profiling_rules_limit); i++) {
 
         /* Stop dumping when we hit our first rule with 0 checks.  Due
@@ -378,7 +456,7 @@ static void DumpText(FILE *fp, SCProfileSummary *summary,
         double percent = (long double)summary[i].ticks /
             (long double)total_ticks * 100;
         fprintf(fp,
-            "  %-8"PRIu32" %-12u %-8"PRIu32" %-8"PRIu32" %-12"PRIu64" %-6.2f %-8"PRIu64" %-8"PRIu64" %-11"PRIu64" %-11.2f %-11.2f %-11.2f\n",
+            "  %-8"PRIu32" %-12u %-8"PRIu32" %-8"PRIu32" %-12"PRIu64" %-6.2f %-8"PRIu64" %-8"PRIu64" %-11"PRIu64" %-11.2f %-11.2f %-14.2f",
             i + 1,
             summary[i].sid,
             summary[i].gid,
@@ -391,6 +469,17 @@ static void DumpText(FILE *fp, SCProfileSummary *summary,
             summary[i].avgticks,
             summary[i].avgticks_match,
             summary[i].avgticks_no_match);
+        if (profiling_hw_enabled) {
+            const uint64_t cycles = summary[i].hw.v[PROFILE_HW_CYCLES];
+            double ipc = 0;
+            if (cycles > 0) {
+                ipc = (double)summary[i].hw.v[PROFILE_HW_INSTRUCTIONS] / (double)cycles;
+            }
+            fprintf(fp, " %-14" PRIu64 " %-6.2f %-14" PRIu64 " %-11.2f %-14" PRIu64, cycles, ipc,
+                    summary[i].hw.v[PROFILE_HW_CACHE_MISSES], summary[i].avg_cache_misses,
+                    summary[i].hw.v[PROFILE_HW_BRANCH_MISSES]);
+        }
+        fprintf(fp, "\n");
     }
 
     fprintf(fp,"\n");
@@ -460,6 +549,11 @@ static void *SCProfilingRuleDump(SCProfileDetectCtx *rules_ctx, int file_output)
             summary[i].avgticks_no_match = (long double)summary[i].ticks_no_match /
                 ((long double)summary[i].checks - (long double)summary[i].matches);
         }
+        summary[i].hw = rules_ctx->data[i].hw;
+        if (summary[i].checks > 0) {
+            summary[i].avg_cache_misses = (long double)summary[i].hw.v[PROFILE_HW_CACHE_MISSES] /
+                                          (long double)summary[i].checks;
+        }
         total_ticks += summary[i].ticks;
     }
 
@@ -502,6 +596,16 @@ static void *SCProfilingRuleDump(SCProfileDetectCtx *rules_ctx, int file_output)
                         SCProfileSummarySortByAvgTicksNoMatch);
                 sort_desc = "average ticks (no match)";
                 break;
+            case SC_PROFILING_RULES_SORT_BY_CACHE_MISSES:
+                qsort(summary, count, sizeof(SCProfileSummary),
+                        SCProfileSummarySortByCacheMisses);
+                sort_desc = "cache misses";
+                break;
+            case SC_PROFILING_RULES_SORT_BY_AVG_CACHE_MISSES:
+                qsort(summary, count, sizeof(SCProfileSummary),
+                        SCProfileSummarySortByAvgCacheMisses);
+                sort_desc = "average cache misses";
+                break;
         }
         if (profiling_rule_json) {
             if (file_output != 1) {
@@ -544,9 +648,10 @@ SCProfilingRegisterRuleCounter(SCProfileDetectCtx *ctx)
  * \param id The ID of this counter.
  * \param ticks Number of CPU ticks for this rule.
  * \param match Did the rule match?
+ * \param hw Hardware counter deltas for this rule, NULL if not available.
  */
-void
-SCProfilingRuleUpdateCounter(DetectEngineThreadCtx *det_ctx, uint16_t id, uint64_t ticks, int match)
+void SCProfilingRuleUpdateCounter(DetectEngineThreadCtx *det_ctx, uint16_t id, uint64_t ticks,
+        int match, const SCProfileHw *hw)
 {
     if (det_ctx != NULL && det_ctx->rule_perf_data != NULL && det_ctx->rule_perf_data_size > id) {
         SCProfileData *p = &det_ctx->rule_perf_data[id];
@@ -559,6 +664,8 @@ SCProfilingRuleUpdateCounter(DetectEngineThreadCtx *det_ctx, uint16_t id, uint64
             p->ticks_match += ticks;
         else
             p->ticks_no_match += ticks;
+        if (hw != NULL)
+            SCProfilingHwAdd(&p->hw, hw);
     }
 }
 
@@ -609,11 +716,13 @@ static void SCProfilingRuleThreadMerge(
         de_ctx->profile_ctx->data[i].matches += det_ctx->rule_perf_data[i].matches;
         de_ctx->profile_ctx->data[i].ticks_match += det_ctx->rule_perf_data[i].ticks_match;
         de_ctx->profile_ctx->data[i].ticks_no_match += det_ctx->rule_perf_data[i].ticks_no_match;
+        SCProfilingHwAdd(&de_ctx->profile_ctx->data[i].hw, &det_ctx->rule_perf_data[i].hw);
         if (reset) {
             det_ctx->rule_perf_data[i].checks = 0;
             det_ctx->rule_perf_data[i].matches = 0;
             det_ctx->rule_perf_data[i].ticks_match = 0;
             det_ctx->rule_perf_data[i].ticks_no_match = 0;
+            memset(&det_ctx->rule_perf_data[i].hw, 0, sizeof(det_ctx->rule_perf_data[i].hw));
         }
         if (det_ctx->rule_perf_data[i].max > de_ctx->profile_ctx->data[i].max)
             de_ctx->profile_ctx->data[i].max = det_ctx->rule_perf_data[i].max;
@@ -26,6 +26,7 @@
 #define SURICATA_UTIL_PROFILE_H
 
 #include "util-cpu.h"
+#include "util-profiling-hw.h"
 
 #include "detect.h"
 
@@ -50,22 +51,27 @@ extern thread_local int profiling_keyword_entered;
 #define KEYWORD_PROFILING_START                                                                    \
     uint64_t profile_keyword_start_ = 0;                                                           \
     uint64_t profile_keyword_end_ = 0;                                                             \
+    SCProfileHwSample profile_keyword_hw_start_ = { .valid = false };                              \
     if (profiling_keyword_enabled) {                                                               \
         if (profiling_keyword_entered > 0) {                                                       \
             SCLogError("Re-entered profiling, exiting.");                                          \
             abort();                                                                               \
         }                                                                                          \
         profiling_keyword_entered++;                                                               \
+        SCProfilingHwStart(&profile_keyword_hw_start_);                                            \
         profile_keyword_start_ = UtilCpuGetTicks();                                                \
     }
 
 /* we allow this macro to be called if profiling_keyword_entered == 0,
  * so that we don't have to refactor some of the detection code. */
-#define KEYWORD_PROFILING_END(ctx, type, m) \
-    if (profiling_keyword_enabled && profiling_keyword_entered) { \
-        profile_keyword_end_ = UtilCpuGetTicks(); \
-        SCProfilingKeywordUpdateCounter((ctx),(type),(profile_keyword_end_ - profile_keyword_start_),(m)); \
-        profiling_keyword_entered--; \
+#define KEYWORD_PROFILING_END(ctx, type, m)                                                        \
+    if (profiling_keyword_enabled && profiling_keyword_entered) {                                  \
+        profile_keyword_end_ = UtilCpuGetTicks();                                                  \
+        SCProfileHw profile_keyword_hw_;                                                           \
+        SCProfilingKeywordUpdateCounter((ctx), (type),                                             \
+                (profile_keyword_end_ - profile_keyword_start_), (m),                              \
+                SCProfilingHwEnd(&profile_keyword_hw_start_, &profile_keyword_hw_));               \
+        profiling_keyword_entered--;                                                               \
     }
 
 PktProfiling *SCProfilePacketStart(void);
@@ -262,12 +268,14 @@ extern thread_local int profiling_prefilter_entered;
     (det_ctx)->prefilter_bytes_called = 0;                                                         \
     uint64_t profile_prefilter_start_ = 0;                                                         \
     uint64_t profile_prefilter_end_ = 0;                                                           \
+    SCProfileHwSample profile_prefilter_hw_start_ = { .valid = false };                            \
     if (profiling_prefilter_enabled) {                                                             \
         if (profiling_prefilter_entered > 0) {                                                     \
             SCLogError("Re-entered profiling, exiting.");                                          \
             abort();                                                                               \
         }                                                                                          \
         profiling_prefilter_entered++;                                                             \
+        SCProfilingHwStart(&profile_prefilter_hw_start_);                                          \
         profile_prefilter_start_ = UtilCpuGetTicks();                                              \
     }
 
@@ -276,10 +284,12 @@ extern thread_local int profiling_prefilter_entered;
 #define PREFILTER_PROFILING_END(ctx, profile_id)                                                   \
     if (profiling_prefilter_enabled && profiling_prefilter_entered) {                              \
         profile_prefilter_end_ = UtilCpuGetTicks();                                                \
+        SCProfileHw profile_prefilter_hw_;                                                         \
         if (profile_prefilter_end_ > profile_prefilter_start_)                                     \
             SCProfilingPrefilterUpdateCounter((ctx), (profile_id),                                 \
                     (profile_prefilter_end_ - profile_prefilter_start_), (ctx)->prefilter_bytes,   \
-                    (ctx)->prefilter_bytes_called);                                                \
+                    (ctx)->prefilter_bytes_called,                                                 \
+                    SCProfilingHwEnd(&profile_prefilter_hw_start_, &profile_prefilter_hw_));       \
         profiling_prefilter_entered--;                                                             \
     }
 
@@ -290,7 +300,8 @@ extern thread_local int profiling_prefilter_entered;
 void SCProfilingKeywordsGlobalInit(void);
 void SCProfilingKeywordDestroyCtx(DetectEngineCtx *);//struct SCProfileKeywordDetectCtx_ *);
 void SCProfilingKeywordInitCounters(DetectEngineCtx *);
-void SCProfilingKeywordUpdateCounter(DetectEngineThreadCtx *det_ctx, int id, uint64_t ticks, int match);
+void SCProfilingKeywordUpdateCounter(
+        DetectEngineThreadCtx *det_ctx, int id, uint64_t ticks, int match, const SCProfileHw *hw);
 void SCProfilingKeywordThreadSetup(struct SCProfileKeywordDetectCtx_ *, DetectEngineThreadCtx *);
 void SCProfilingKeywordThreadCleanup(DetectEngineThreadCtx *);
 
@@ -299,7 +310,7 @@ void SCProfilingPrefilterGlobalInit(void);
 void SCProfilingPrefilterDestroyCtx(DetectEngineCtx *);
 void SCProfilingPrefilterInitCounters(DetectEngineCtx *);
 void SCProfilingPrefilterUpdateCounter(DetectEngineThreadCtx *det_ctx, int id, uint64_t ticks,
-        uint64_t bytes, uint64_t bytes_called);
+        uint64_t bytes, uint64_t bytes_called, const SCProfileHw *hw);
 void SCProfilingPrefilterThreadSetup(struct SCProfilePrefilterDetectCtx_ *, DetectEngineThreadCtx *);
 void SCProfilingPrefilterThreadCleanup(DetectEngineThreadCtx *);
 
@@ -375,6 +386,8 @@ typedef struct SCProfileData_ {
     uint64_t max;
     uint64_t ticks_match;
     uint64_t ticks_no_match;
+    /** hardware counter totals, if enabled */
+    SCProfileHw hw;
 } SCProfileData;
 
 typedef struct SCProfileDetectCtx_ {
@@ -387,7 +400,8 @@ typedef struct SCProfileDetectCtx_ {
 void SCProfilingRulesGlobalInit(void);
 void SCProfilingRuleDestroyCtx(struct SCProfileDetectCtx_ *);
 void SCProfilingRuleInitCounters(DetectEngineCtx *);
-void SCProfilingRuleUpdateCounter(DetectEngineThreadCtx *, uint16_t, uint64_t, int);
+void SCProfilingRuleUpdateCounter(
+        DetectEngineThreadCtx *, uint16_t, uint64_t, int, const SCProfileHw *);
 void SCProfilingRuleThreadSetup(struct SCProfileDetectCtx_ *, DetectEngineThreadCtx *);
 void SCProfilingRuleThreadCleanup(DetectEngineThreadCtx *);
 int SCProfileRuleStart(Packet *p);
@@ -399,19 +413,22 @@ void SCProfilingRuleThreatAggregate(DetectEngineThreadCtx *det_ctx);
 #define RULE_PROFILING_START(p)                                                                    \
     uint64_t profile_rule_start_ = 0;                                                              \
     uint64_t profile_rule_end_ = 0;                                                                \
+    SCProfileHwSample profile_rule_hw_start_ = { .valid = false };                                 \
     if (profiling_rules_enabled && SCProfileRuleStart((p))) {                                      \
         if (profiling_rules_entered > 0) {                                                         \
             FatalError("Re-entered profiling, exiting.");                                          \
         }                                                                                          \
         profiling_rules_entered++;                                                                 \
+        SCProfilingHwStart(&profile_rule_hw_start_);                                               \
         profile_rule_start_ = UtilCpuGetTicks();                                                   \
     }
 
 #define RULE_PROFILING_END(ctx, r, m, p)                                                           \
     if (profiling_rules_enabled && profiling_rules_entered) {                                      \
         profile_rule_end_ = UtilCpuGetTicks();                                                     \
-        SCProfilingRuleUpdateCounter(                                                              \
-                ctx, r->profiling_id, profile_rule_end_ - profile_rule_start_, m);                 \
+        SCProfileHw profile_rule_hw_;                                                              \
+        SCProfilingRuleUpdateCounter(ctx, r->profiling_id, profile_rule_end_ - profile_rule_start_, \
+                m, SCProfilingHwEnd(&profile_rule_hw_start_, &profile_rule_hw_));                  \
         profiling_rules_entered--;                                                                 \
         BUG_ON(profiling_rules_entered < 0);                                                       \
     }
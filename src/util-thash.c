@@ -34,9 +34,29 @@
 
 #include "util-hash-lookup3.h"
 #include "util-validate.h"
+#include "util-epoch.h"
+#include "util-optimize.h"
+#include "util-unittest.h"
+
+/** optimistic walks of a bucket before a lockless reader takes the lock */
+#define THASH_LOCKLESS_RETRIES 8
 
 static THashData *THashGetUsed(THashTableContext *ctx, uint32_t data_size);
 static void THashDataEnqueue (THashDataQueue *q, THashData *h);
+static void THashRetire(THashTableContext *ctx, THashData *h);
+static void THashReclaim(THashTableContext *ctx);
+
+/** \brief mark the start of a bucket list modification for lockless
+ *         readers. Called with the row lock held. */
+static inline void THashRowWriteBegin(THashHashRow *hb)
+{
+    (void)SC_ATOMIC_ADD(hb->seq, 1);
+}
+
+static inline void THashRowWriteEnd(THashHashRow *hb)
+{
+    (void)SC_ATOMIC_ADD(hb->seq, 1);
+}
 
 void THashDataMoveToSpare(THashTableContext *ctx, THashData *h)
 {
@@ -277,6 +297,7 @@ static int THashInitConfig(THashTableContext *ctx, const char *cnf_prefix)
     uint32_t i = 0;
     for (i = 0; i < ctx->config.hash_size; i++) {
         HRLOCK_INIT(&ctx->array[i]);
+        SC_ATOMIC_INIT(ctx->array[i].seq);
     }
     (void)SC_ATOMIC_ADD(ctx->memuse, (ctx->config.hash_size * sizeof(THashHashRow)));
 
@@ -340,6 +361,7 @@ THashTableContext *THashInit(const char *cnf_prefix, size_t data_size,
     SC_ATOMIC_INIT(ctx->memuse);
     SC_ATOMIC_INIT(ctx->prune_idx);
     THashDataQueueInit(&ctx->spare_q);
+    SCMutexInit(&ctx->retire_m, NULL);
 
     if (THashInitConfig(ctx, cnf_prefix) < 0) {
         THashShutdown(ctx);
@@ -369,6 +391,19 @@ void THashShutdown(THashTableContext *ctx)
         THashDataFree(ctx, h);
     }
 
+    /* free retired data, there are no readers anymore */
+    THashData *retired[2] = { ctx->retire_open, ctx->retire_closed };
+    for (int i = 0; i < 2; i++) {
+        h = retired[i];
+        while (h) {
+            THashData *p = h->prev;
+            THashDataFree(ctx, h);
+            h = p;
+        }
+    }
+    ctx->retire_open = ctx->retire_closed = NULL;
+    SCMutexDestroy(&ctx->retire_m);
+
     /* clear and free the hash */
     if (ctx->array != NULL) {
         for (uint32_t u = 0; u < ctx->config.hash_size; u++) {
@@ -449,6 +484,7 @@ uint32_t THashExpire(THashTableContext *ctx, const SCTime_t ts)
             /* only consider items with no references to it */
             if (SC_ATOMIC_GET(h->use_cnt) == 0 && ctx->config.DataExpired(h->data, ts)) {
                 /* remove from the hash */
+                THashRowWriteBegin(hb);
                 if (h->prev != NULL)
                     h->prev->next = h->next;
                 if (h->next != NULL)
@@ -459,7 +495,15 @@ uint32_t THashExpire(THashTableContext *ctx, const SCTime_t ts)
                     hb->tail = h->prev;
                 h->next = NULL;
                 h->prev = NULL;
+                THashRowWriteEnd(hb);
                 SCLogDebug("timeout: removing data %p", h);
+                if (ctx->lockless) {
+                    THashDataUnlock(h);
+                    THashRetire(ctx, h);
+                    cnt++;
+                    h = next;
+                    continue;
+                }
                 if (ctx->config.DataSize) {
                     uint32_t data_size = ctx->config.DataSize(h->data);
                     if (data_size > 0)
@@ -476,6 +520,8 @@ uint32_t THashExpire(THashTableContext *ctx, const SCTime_t ts)
         }
         HRLOCK_UNLOCK(hb);
     }
+    if (ctx->lockless)
+        THashReclaim(ctx);
 
     SCLogDebug("timeout: ending: %u entries expired", cnt);
     return cnt;
@@ -503,6 +549,7 @@ void THashCleanup(THashTableContext *ctx)
             } else {
                 THashData *n = h->next;
                 /* remove from the hash */
+                THashRowWriteBegin(hb);
                 if (h->prev != NULL)
                     h->prev->next = h->next;
                 if (h->next != NULL)
@@ -513,6 +560,12 @@ void THashCleanup(THashTableContext *ctx)
                     hb->tail = h->prev;
                 h->next = NULL;
                 h->prev = NULL;
+                THashRowWriteEnd(hb);
+                if (ctx->lockless) {
+                    THashRetire(ctx, h);
+                    h = n;
+                    continue;
+                }
                 if (ctx->config.DataSize) {
                     uint32_t data_size = ctx->config.DataSize(h->data);
                     if (data_size > 0)
@@ -524,6 +577,8 @@ void THashCleanup(THashTableContext *ctx)
         }
         HRLOCK_UNLOCK(hb);
     }
+    if (ctx->lockless)
+        THashReclaim(ctx);
 }
 
 /* calculate the hash key for this packet
@@ -609,6 +664,9 @@ static THashData *THashDataGetNew(THashTableContext *ctx, void *data)
 
     // setup the data
     BUG_ON(ctx->config.DataSet(h->data, data) != 0);
+    /* lockless readers must see the data before the link to it */
+    if (ctx->lockless)
+        hw_barrier();
     (void) SC_ATOMIC_ADD(ctx->counter, 1);
     SCMutexLock(&h->m);
     return h;
@@ -639,8 +697,10 @@ THashGetFromHash (THashTableContext *ctx, void *data)
         }
 
         /* data is locked */
+        THashRowWriteBegin(hb);
         hb->head = h;
         hb->tail = h;
+        THashRowWriteEnd(hb);
 
         /* initialize and return */
         (void) THashIncrUsecnt(h);
@@ -663,16 +723,19 @@ THashGetFromHash (THashTableContext *ctx, void *data)
             h = h->next;
 
             if (h == NULL) {
-                h = ph->next = THashDataGetNew(ctx, data);
+                h = THashDataGetNew(ctx, data);
                 if (h == NULL) {
                     HRLOCK_UNLOCK(hb);
                     return res;
                 }
+                THashRowWriteBegin(hb);
+                ph->next = h;
                 hb->tail = h;
 
                 /* data is locked */
 
                 h->prev = ph;
+                THashRowWriteEnd(hb);
 
                 /* initialize and return */
                 (void) THashIncrUsecnt(h);
@@ -686,6 +749,7 @@ THashGetFromHash (THashTableContext *ctx, void *data)
             if (THashCompare(&ctx->config, h->data, data) != 0) {
                 /* we found our data, lets put it on top of the
                  * hash list -- this rewards active data */
+                THashRowWriteBegin(hb);
                 if (h->next) {
                     h->next->prev = h->prev;
                 }
@@ -700,6 +764,7 @@ THashGetFromHash (THashTableContext *ctx, void *data)
                 h->prev = NULL;
                 hb->head->prev = h;
                 hb->head = h;
+                THashRowWriteEnd(hb);
 
                 /* found our data, lock & return */
                 SCMutexLock(&h->m);
@@ -759,6 +824,7 @@ THashData *THashLookupFromHash (THashTableContext *ctx, void *data)
             if (THashCompare(&ctx->config, h->data, data) != 0) {
                 /* we found our data, lets put it on top of the
                  * hash list -- this rewards active data */
+                THashRowWriteBegin(hb);
                 if (h->next) {
                     h->next->prev = h->prev;
                 }
@@ -773,6 +839,7 @@ THashData *THashLookupFromHash (THashTableContext *ctx, void *data)
                 h->prev = NULL;
                 hb->head->prev = h;
                 hb->head = h;
+                THashRowWriteEnd(hb);
 
                 /* found our data, lock & return */
                 SCMutexLock(&h->m);
@@ -790,6 +857,146 @@ THashData *THashLookupFromHash (THashTableContext *ctx, void *data)
     return h;
 }
 
+/** \brief allow THashLookupFromHashNoLock on this hash
+ *
+ *  Data removed from the hash is then retired and only released when no
+ *  lockless reader can be looking at it anymore. The DataSet callback
+ *  must fully initialize the data and the data must not change while it
+ *  is in the hash.
+ *
+ *  At memcap, data evicted to make room for new data can't be reused
+ *  while a lockless reader may still see it, so adding data can then
+ *  fail where it would have succeeded with locked reads.
+ *
+ *  \warning Not thread safe, call before the hash is in use */
+void THashEnableLocklessReads(THashTableContext *ctx)
+{
+    ctx->lockless = true;
+}
+
+/** \internal
+ *  \brief queue unlinked data for release once lockless readers are done
+ *
+ *  The retire lists are linked through prev, which lockless readers
+ *  don't use. */
+static void THashRetire(THashTableContext *ctx, THashData *h)
+{
+    (void)SC_ATOMIC_SUB(ctx->counter, 1);
+    SCMutexLock(&ctx->retire_m);
+    h->prev = ctx->retire_open;
+    ctx->retire_open = h;
+    SCMutexUnlock(&ctx->retire_m);
+}
+
+/** \internal
+ *  \brief move retired data that no reader can see anymore to the spare
+ *         queue
+ *
+ *  Retired data is collected in the open list. The open list is closed
+ *  by advancing the epoch, and the closed list is released when all
+ *  readers of that epoch are done. */
+static void THashReclaim(THashTableContext *ctx)
+{
+    THashData *h = NULL;
+
+    SCMutexLock(&ctx->retire_m);
+    if (ctx->retire_closed == NULL && ctx->retire_open != NULL) {
+        ctx->retire_closed = ctx->retire_open;
+        ctx->retire_open = NULL;
+        ctx->retire_epoch = SCEpochAdvance();
+    }
+    if (ctx->retire_closed != NULL && SCEpochPassed(ctx->retire_epoch)) {
+        h = ctx->retire_closed;
+        ctx->retire_closed = NULL;
+    }
+    SCMutexUnlock(&ctx->retire_m);
+
+    while (h != NULL) {
+        THashData *p = h->prev;
+        if (ctx->config.DataSize) {
+            uint32_t data_size = ctx->config.DataSize(h->data);
+            if (data_size > 0)
+                (void)SC_ATOMIC_SUB(ctx->memuse, (uint64_t)data_size);
+        }
+        ctx->config.DataFree(h->data);
+        /* spare data gets DataFree'd again at shutdown */
+        memset(h->data, 0, ctx->config.data_size);
+        h->next = NULL;
+        h->prev = NULL;
+        THashDataEnqueue(&ctx->spare_q, h);
+        h = p;
+    }
+}
+
+static inline THashData *THashLoadPtr(THashData *const *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+/** \brief look up data without taking locks or writing to shared memory
+ *
+ *  The bucket is walked optimistically and the walk is retried when a
+ *  writer modified the bucket meanwhile. After a few failed attempts
+ *  the bucket lock is used. Requires THashEnableLocklessReads.
+ *
+ *  Unlike THashLookupFromHash this doesn't move the data to the head of
+ *  the bucket or take a reference.
+ *
+ *  \param data data to look up
+ *  \param out if not NULL, data_size bytes of the found data are copied
+ *             here. Pointers in the copy must not be dereferenced.
+ *
+ *  \retval true found
+ */
+bool THashLookupFromHashNoLock(THashTableContext *ctx, void *data, void *out)
+{
+    DEBUG_VALIDATE_BUG_ON(!ctx->lockless);
+
+    const uint32_t key = THashGetKey(&ctx->config, data);
+    THashHashRow *hb = &ctx->array[key];
+
+    SCEpochEnter();
+    for (int i = 0; i < THASH_LOCKLESS_RETRIES; i++) {
+        const uint32_t seq = SC_ATOMIC_GET(hb->seq);
+        if (seq & 1)
+            continue;
+
+        /* a walk racing a writer can see a list that never existed, so
+         * bound it by the number of entries */
+        uint32_t steps = SC_ATOMIC_GET(ctx->counter) + 1;
+        bool found = false;
+        for (THashData *h = THashLoadPtr(&hb->head); h != NULL && steps > 0;
+                h = THashLoadPtr(&h->next), steps--) {
+            if (THashCompare(&ctx->config, h->data, data) != 0) {
+                if (out != NULL)
+                    memcpy(out, h->data, ctx->config.data_size);
+                found = true;
+                break;
+            }
+        }
+        hw_barrier();
+        if (SC_ATOMIC_GET(hb->seq) == seq) {
+            SCEpochExit();
+            return found;
+        }
+    }
+    SCEpochExit();
+
+    /* too much write activity on the bucket */
+    bool found = false;
+    HRLOCK_LOCK(hb);
+    for (THashData *h = hb->head; h != NULL; h = h->next) {
+        if (THashCompare(&ctx->config, h->data, data) != 0) {
+            if (out != NULL)
+                memcpy(out, h->data, ctx->config.data_size);
+            found = true;
+            break;
+        }
+    }
+    HRLOCK_UNLOCK(hb);
+    return found;
+}
+
 /** \internal
  *  \brief Get data from the hash directly.
  *
@@ -835,6 +1042,7 @@ static THashData *THashGetUsed(THashTableContext *ctx, uint32_t data_size)
         }
 
         /* remove from the hash */
+        THashRowWriteBegin(hb);
         if (h->prev != NULL)
             h->prev->next = h->next;
         if (h->next != NULL)
@@ -846,8 +1054,28 @@ static THashData *THashGetUsed(THashTableContext *ctx, uint32_t data_size)
 
         h->next = NULL;
         h->prev = NULL;
+        THashRowWriteEnd(hb);
         HRLOCK_UNLOCK(hb);
 
+        if (ctx->lockless) {
+            /* readers may still see it, so it can't be reused right away.
+             * Use whatever reclaiming made available instead. The first
+             * pass may only release older retired data and close the list
+             * holding this one, so try twice. If a reader is still in an
+             * older epoch nothing can be released and NULL is returned. */
+            SCMutexUnlock(&h->m);
+            THashRetire(ctx, h);
+            (void)SC_ATOMIC_ADD(ctx->prune_idx, (ctx->config.hash_size - cnt));
+            h = NULL;
+            for (int i = 0; i < 2 && h == NULL; i++) {
+                THashReclaim(ctx);
+                h = THashDataDequeue(&ctx->spare_q);
+            }
+            if (h != NULL && data_size > 0)
+                (void)SC_ATOMIC_ADD(ctx->memuse, data_size);
+            return h;
+        }
+
         if (h->data != NULL) {
             if (ctx->config.DataSize) {
                 uint32_t h_data_size = ctx->config.DataSize(h->data);
@@ -896,6 +1124,7 @@ int THashRemoveFromHash (THashTableContext *ctx, void *data)
         }
 
         /* remove from the hash */
+        THashRowWriteBegin(hb);
         if (h->prev != NULL)
             h->prev->next = h->next;
         if (h->next != NULL)
@@ -907,9 +1136,15 @@ int THashRemoveFromHash (THashTableContext *ctx, void *data)
 
         h->next = NULL;
         h->prev = NULL;
+        THashRowWriteEnd(hb);
         SCMutexUnlock(&h->m);
         HRLOCK_UNLOCK(hb);
-        THashDataFree(ctx, h);
+        if (ctx->lockless) {
+            THashRetire(ctx, h);
+            THashReclaim(ctx);
+        } else {
+            THashDataFree(ctx, h);
+        }
         SCLogDebug("found and removed");
         return 1;
     }
@@ -918,3 +1153,210 @@ int THashRemoveFromHash (THashTableContext *ctx, void *data)
     SCLogDebug("data not found");
     return -1;
 }
+
+#ifdef UNITTESTS
+static int THashTestSet(void *dst, void *src)
+{
+    memcpy(dst, src, sizeof(uint32_t));
+    return 0;
+}
+
+static void THashTestFree(void *data)
+{
+}
+
+static uint32_t THashTestHash(uint32_t hash_seed, void *data)
+{
+    return *(uint32_t *)data + hash_seed;
+}
+
+static bool THashTestCompare(void *a, void *b)
+{
+    return *(uint32_t *)a == *(uint32_t *)b;
+}
+
+static bool THashTestAdd(THashTableContext *ctx, uint32_t key)
+{
+    struct THashDataGetResult res = THashGetFromHash(ctx, &key);
+    if (res.data == NULL)
+        return false;
+    THashDecrUsecnt(res.data);
+    THashDataUnlock(res.data);
+    return true;
+}
+
+/** \test lockless lookups while data is retired and reclaimed */
+static int THashTest01(void)
+{
+    THashTableContext *ctx = THashInit("thash-test", sizeof(uint32_t), THashTestSet,
+            THashTestFree, THashTestHash, THashTestCompare, NULL, NULL, false, 0, 16);
+    FAIL_IF_NULL(ctx);
+    THashEnableLocklessReads(ctx);
+
+    for (uint32_t k = 1; k <= 64; k++) {
+        FAIL_IF_NOT(THashTestAdd(ctx, k));
+    }
+    const uint32_t spare = ctx->spare_q.len;
+
+    /* a reader in the middle of a lookup */
+    SCEpochEnter();
+    uint32_t k = 1;
+    FAIL_IF_NOT(THashRemoveFromHash(ctx, &k) == 1);
+    FAIL_IF(THashLookupFromHashNoLock(ctx, &k, NULL));
+    for (k = 2; k <= 64; k++) {
+        FAIL_IF_NOT(THashLookupFromHashNoLock(ctx, &k, NULL));
+    }
+    /* the reader may still see it, so it's not reused yet */
+    FAIL_IF_NOT(ctx->spare_q.len == spare);
+    FAIL_IF_NULL(ctx->retire_closed);
+    SCEpochExit();
+
+    /* the next removal reclaims the first one */
+    k = 2;
+    FAIL_IF_NOT(THashRemoveFromHash(ctx, &k) == 1);
+    FAIL_IF_NOT(ctx->spare_q.len == spare + 1);
+    for (k = 1; k <= 64; k++) {
+        FAIL_IF_NOT(THashLookupFromHashNoLock(ctx, &k, NULL) == (k > 2));
+    }
+
+    THashShutdown(ctx);
+    PASS;
+}
+
+/** \test at memcap evicted data is only reused once readers are done */
+static int THashTest02(void)
+{
+    THashTableContext *ctx = THashInit("thash-test", sizeof(uint32_t), THashTestSet,
+            THashTestFree, THashTestHash, THashTestCompare, NULL, NULL, false, 0, 16);
+    FAIL_IF_NULL(ctx);
+    THashEnableLocklessReads(ctx);
+
+    uint32_t k = 1;
+    while (ctx->spare_q.len > 0) {
+        FAIL_IF_NOT(THashTestAdd(ctx, k++));
+    }
+    SC_ATOMIC_SET(ctx->config.memcap, SC_ATOMIC_GET(ctx->memuse));
+    const uint32_t cnt = SC_ATOMIC_GET(ctx->counter);
+
+    SCEpochEnter();
+    FAIL_IF(THashTestAdd(ctx, k));
+    FAIL_IF(THashLookupFromHashNoLock(ctx, &k, NULL));
+    SCEpochExit();
+
+    FAIL_IF_NOT(THashTestAdd(ctx, k));
+    FAIL_IF_NOT(THashLookupFromHashNoLock(ctx, &k, NULL));
+    /* two evicted, one added */
+    FAIL_IF_NOT(SC_ATOMIC_GET(ctx->counter) == cnt - 1);
+
+    THashShutdown(ctx);
+    PASS;
+}
+
+/** set once all readers are created */
+static SC_ATOMIC_DECL_AND_INIT(int, thash_test_start);
+
+typedef struct THashTestReader_ {
+    THashTableContext *ctx;
+    bool lockless;
+    uint32_t keys;
+    uint32_t lookups;
+    uint32_t seed;
+    uint32_t found;
+} THashTestReader;
+
+static void *THashTestReaderRun(void *data)
+{
+    THashTestReader *r = data;
+    uint32_t x = r->seed;
+    while (SC_ATOMIC_GET(thash_test_start) == 0)
+        usleep(10);
+    for (uint32_t i = 0; i < r->lookups; i++) {
+        /* xorshift32 */
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        uint32_t k = 1 + x % r->keys;
+        if (r->lockless) {
+            r->found += THashLookupFromHashNoLock(r->ctx, &k, NULL);
+        } else {
+            THashData *h = THashLookupFromHash(r->ctx, &k);
+            if (h != NULL) {
+                r->found++;
+                THashDecrUsecnt(h);
+                THashDataUnlock(h);
+            }
+        }
+    }
+    return NULL;
+}
+
+static uint64_t THashTestNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * \test locked vs lockless lookups of stable keys from 1 to 64 threads
+ *
+ * Reports the lookup rate of each case, run the test on its own with
+ * "-U THashTest03" to compare them on a given host.
+ */
+static int THashTest03(void)
+{
+    const uint32_t keys = 4096;
+    const uint32_t lookups = 1 << 20;
+    const uint32_t threads[] = { 1, 4, 16, 64 };
+
+    THashTableContext *ctx = THashInit("thash-test", sizeof(uint32_t), THashTestSet,
+            THashTestFree, THashTestHash, THashTestCompare, NULL, NULL, false, 0, 1024);
+    FAIL_IF_NULL(ctx);
+    THashEnableLocklessReads(ctx);
+    for (uint32_t k = 1; k <= keys; k++) {
+        FAIL_IF_NOT(THashTestAdd(ctx, k));
+    }
+
+    THashTestReader r[64];
+    pthread_t t[64];
+    for (int lockless = 0; lockless < 2; lockless++) {
+        for (size_t n = 0; n < ARRAY_SIZE(threads); n++) {
+            SC_ATOMIC_SET(thash_test_start, 0);
+            for (uint32_t i = 0; i < threads[n]; i++) {
+                r[i] = (THashTestReader){ .ctx = ctx,
+                    .lockless = lockless,
+                    .keys = keys,
+                    .lookups = lookups / threads[n],
+                    .seed = 2463534242U + i };
+                FAIL_IF(pthread_create(&t[i], NULL, THashTestReaderRun, &r[i]) != 0);
+            }
+            const uint64_t begin = THashTestNowNs();
+            SC_ATOMIC_SET(thash_test_start, 1);
+            for (uint32_t i = 0; i < threads[n]; i++) {
+                pthread_join(t[i], NULL);
+            }
+            const uint64_t elapsed = MAX(THashTestNowNs() - begin, 1);
+
+            uint64_t done = 0;
+            for (uint32_t i = 0; i < threads[n]; i++) {
+                FAIL_IF_NOT(r[i].found == r[i].lookups);
+                done += r[i].found;
+            }
+            SCLogInfo("%s lookups, %u threads: %.2f M lookups/s", lockless ? "lockless" : "locked",
+                    threads[n], (double)done * 1000.0 / (double)elapsed);
+        }
+    }
+
+    THashShutdown(ctx);
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void THashRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("THashTest01", THashTest01);
+    UtRegisterTest("THashTest02", THashTest02);
+    UtRegisterTest("THashTest03", THashTest03);
+#endif
+}
@@ -99,6 +99,9 @@ typedef struct THashHashRow_ {
     HRLOCK_TYPE lock;
     THashData *head;
     THashData *tail;
+    /** odd while the list is being modified, changes with each
+     *  modification. Used by lockless readers to validate a walk. */
+    SC_ATOMIC_DECLARE(uint32_t, seq);
 } __attribute__((aligned(CLS))) THashHashRow;
 
 typedef struct THashDataQueue_
@@ -152,6 +155,16 @@ typedef struct THashTableContext_ {
 
     /* flag set if memcap was reached at least once. */
     SC_ATOMIC_DECLARE(bool, memcap_reached);
+
+    /** lockless reads are used: data unlinked from the hash is retired
+     *  and only released once no reader can see it anymore */
+    bool lockless;
+    SCMutex retire_m;
+    /** retired data, linked through prev */
+    THashData *retire_open;
+    /** retired data waiting for all readers of retire_epoch to finish */
+    THashData *retire_closed;
+    uint64_t retire_epoch;
 } THashTableContext;
 
 /** \brief check if a memory alloc would fit in the memcap
@@ -195,6 +208,8 @@ struct THashDataGetResult {
 
 struct THashDataGetResult THashGetFromHash (THashTableContext *ctx, void *data);
 THashData *THashLookupFromHash (THashTableContext *ctx, void *data);
+void THashEnableLocklessReads(THashTableContext *ctx);
+bool THashLookupFromHashNoLock(THashTableContext *ctx, void *data, void *out);
 THashDataQueue *THashDataQueueNew(void);
 void THashCleanup(THashTableContext *ctx);
 int THashWalk(THashTableContext *, THashFormatFunc, THashOutputFunc, void *);
@@ -203,4 +218,6 @@ void THashConsolidateMemcap(THashTableContext *ctx);
 void THashDataMoveToSpare(THashTableContext *ctx, THashData *h);
 uint32_t THashExpire(THashTableContext *ctx, const SCTime_t ts);
 
+void THashRegisterTests(void);
+
 #endif /* SURICATA_THASH_H */
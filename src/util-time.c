@@ -174,6 +174,26 @@ SCTime_t TimeGet(void)
     return SCTIME_FROM_TIMEVAL(&tv);
 }
 
+/** \brief get the time with a resolution of a clock tick
+ *
+ *  In live mode this reads the coarse realtime clock, which the vDSO serves
+ *  from a page the kernel updates every tick, so it doesn't enter the kernel
+ *  and is cheap enough to call per packet. In offline mode it's the same as
+ *  TimeGet. */
+SCTime_t TimeGetCoarse(void)
+{
+    if (live_time_tracking) {
+#ifdef CLOCK_REALTIME_COARSE
+        struct timespec ts;
+        if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0) {
+            return SCTIME_FROM_TIMESPEC(&ts);
+        }
+#endif
+        return SCTimeGetTime();
+    }
+    return TimeGet();
+}
+
 #ifdef UNITTESTS
 /** \brief increment the time in the engine
  *  \param tv_sec seconds to increment the time with */
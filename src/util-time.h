@@ -119,6 +119,7 @@ void TimeDeinit(void);
 
 void TimeSetByThread(const int thread_id, SCTime_t tv);
 SCTime_t TimeGet(void);
+SCTime_t TimeGetCoarse(void);
 
 /** \brief initialize a 'struct timespec' from a 'struct timeval'. */
 #define FROM_TIMEVAL(timev) { .tv_sec = (timev).tv_sec, .tv_nsec = (timev).tv_usec * 1000 }
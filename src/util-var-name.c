@@ -68,6 +68,9 @@ typedef struct VarNameStore_ {
     HashListTable *names;
     HashListTable *ids;
     uint32_t max_id;
+    /** flowbit ids index the per flow bitmap, so they get their own dense
+     *  range */
+    uint32_t max_flowbit_id;
     SCTime_t free_after;
     TAILQ_ENTRY(VarNameStore_) next;
 } VarNameStore;
@@ -85,7 +88,7 @@ typedef struct VariableName_ {
 #define VARID_HASHSIZE 0x1000
 
 static SCMutex base_lock = SCMUTEX_INITIALIZER;
-static VarNameStore base = { .names = NULL, .ids = NULL, .max_id = 0 };
+static VarNameStore base = { .names = NULL, .ids = NULL, .max_id = 0, .max_flowbit_id = 0 };
 static TAILQ_HEAD(, VarNameStore_) free_list = TAILQ_HEAD_INITIALIZER(free_list);
 static SC_ATOMIC_DECLARE(VarNameStorePtr, active);
 
@@ -146,6 +149,7 @@ void VarNameStoreDestroy(void)
     HashListTableFree(base.names);
     base.names = NULL;
     base.max_id = 0;
+    base.max_flowbit_id = 0;
     SCMutexUnlock(&base_lock);
 }
 
@@ -167,7 +171,11 @@ uint32_t VarNameStoreRegister(const char *name, const enum VarTypes type)
             vn->name = SCStrdup(name);
             if (vn->name != NULL) {
                 vn->ref_cnt = 1;
-                id = vn->id = ++base.max_id;
+                if (type == VAR_TYPE_FLOW_BIT) {
+                    id = vn->id = ++base.max_flowbit_id;
+                } else {
+                    id = vn->id = ++base.max_id;
+                }
                 HashListTableAdd(base.names, (void *)vn, 0);
                 HashListTableAdd(base.ids, (void *)vn, 0);
                 SCLogDebug(